@@ -96,9 +96,8 @@ typedef struct _cups_globals_s		// CUPS global state data
 #endif
 
   // debug.c
-#  ifdef DEBUG
   int			thread_id;	// Friendly thread ID
-#  endif // DEBUG
+  _cups_logbuf_t	*log_buffer;	// Asynchronous log buffer
 
   // file.c
   cups_file_t		*stdio_files[3];// stdin, stdout, stderr
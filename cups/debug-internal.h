@@ -53,10 +53,21 @@ extern "C" {
 #  endif // DEBUG
 
 
+//
+// Types...
+//
+
+typedef struct _cups_logbuf_s _cups_logbuf_t;
+					// Per-thread log buffer
+
+
 //
 // Prototypes...
 //
 
+extern void	_cupsLogFreeBuffer(_cups_logbuf_t *buf) _CUPS_INTERNAL;
+extern void	_cupsLogWrite(int fd, const char *s, size_t len) _CUPS_INTERNAL;
+
 #  ifdef DEBUG
 extern int	_cups_debug_fd _CUPS_INTERNAL;
 extern int	_cups_debug_level _CUPS_INTERNAL;
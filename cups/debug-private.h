@@ -37,11 +37,27 @@ extern "C" {
 #  endif // DEBUG
 
 
+//
+// Types...
+//
+
+typedef enum _cups_log_level_e		// Log message levels
+{
+  _CUPS_LOG_ERROR,			// Error messages
+  _CUPS_LOG_WARN,			// Warning messages
+  _CUPS_LOG_INFO,			// Informational messages
+  _CUPS_LOG_DEBUG			// Debugging messages
+} _cups_log_level_t;
+
+
 //
 // Prototypes...
 //
 
 extern void	_cups_debug_set(const char *logfile, const char *level, const char *filter, int force) _CUPS_PRIVATE;
+extern void	_cupsLogMessage(_cups_log_level_t level, const char *format, ...) _CUPS_FORMAT(2,3) _CUPS_PRIVATE;
+extern bool	_cupsLogStart(int fd, _cups_log_level_t level, bool structured) _CUPS_PRIVATE;
+extern void	_cupsLogStop(void) _CUPS_PRIVATE;
 #  ifdef _WIN32
 extern int	_cups_gettimeofday(struct timeval *tv, void *tz) _CUPS_PRIVATE;
 #    define gettimeofday(a,b) _cups_gettimeofday(a, b)
@@ -33,6 +33,64 @@ _cups_gettimeofday(struct timeval *tv,	// I  - Timeval struct
 #include <fcntl.h>
 
 
+//
+// Constants...
+//
+
+#define _CUPS_LOG_BUFSIZE	16384	// Size of per-thread log buffers
+
+
+//
+// Types...
+//
+
+struct _cups_logbuf_s			// Per-thread log buffer
+{
+  _cups_logbuf_t	*next;		// Next buffer
+  cups_mutex_t		mutex;		// Buffer mutex
+  size_t		used;		// Bytes used
+  char			data[_CUPS_LOG_BUFSIZE];
+					// Log records
+};
+
+typedef struct _cups_logrec_s		// Log record header
+{
+  int			fd;		// Destination file descriptor
+  size_t		length;		// Length of message
+} _cups_logrec_t;
+
+
+//
+// Local globals...
+//
+
+static _cups_logbuf_t	*log_buffers = NULL;
+					// Registered per-thread buffers
+static cups_cond_t	log_cond = CUPS_COND_INITIALIZER;
+					// Condition to wake the writer thread
+static int		log_fd = 2;	// Application log file descriptor
+static _cups_log_level_t log_level = _CUPS_LOG_DEBUG;
+					// Application log level
+static cups_mutex_t	log_mutex = CUPS_MUTEX_INITIALIZER,
+					// Mutex for buffer list and writer thread
+			log_write_mutex = CUPS_MUTEX_INITIALIZER;
+					// Mutex to serialize writes
+static bool		log_running = false,
+					// Is the writer thread running?
+			log_structured = false;
+					// Write key=value messages?
+static cups_thread_t	log_thread;	// Writer thread
+
+
+//
+// Local functions...
+//
+
+static void	log_flush(_cups_logbuf_t *buf);
+static void	*log_thread_func(void *data);
+static void	log_write_records(const char *data, size_t used);
+
+
 #ifdef DEBUG
 //
 // Globals...
@@ -51,10 +109,8 @@ int			_cups_debug_level = 1;
 static regex_t		*debug_filter = NULL;
 					// Filter expression for messages
 static int		debug_init = 0;	// Did we initialize debugging?
-static cups_mutex_t	debug_init_mutex = CUPS_MUTEX_INITIALIZER,
+static cups_mutex_t	debug_init_mutex = CUPS_MUTEX_INITIALIZER;
 					// Mutex to control initialization
-			debug_log_mutex = CUPS_MUTEX_INITIALIZER;
-					// Mutex to serialize log entries
 
 
 //
@@ -131,9 +187,7 @@ _cups_debug_printf(const char *format,	// I - Printf-style format string
   }
 
   // Write it out...
-  cupsMutexLock(&debug_log_mutex);
-  write(_cups_debug_fd, buffer, (size_t)bytes);
-  cupsMutexUnlock(&debug_log_mutex);
+  _cupsLogWrite(_cups_debug_fd, buffer, (size_t)bytes);
 
   done:
 
@@ -195,9 +249,7 @@ _cups_debug_puts(const char *s)		// I - String to output
   }
 
   // Write it out...
-  cupsMutexLock(&debug_log_mutex);
-  write(_cups_debug_fd, buffer, (size_t)bytes);
-  cupsMutexUnlock(&debug_log_mutex);
+  _cupsLogWrite(_cups_debug_fd, buffer, (size_t)bytes);
 
   done:
 
@@ -296,3 +348,397 @@ _cups_debug_set(const char *logfile,	// I - Log file or NULL
   (void)force;
 }
 #endif // DEBUG
+
+
+//
+// '_cupsLogFreeBuffer()' - Flush and free a per-thread log buffer.
+//
+// This function is called when a thread exits.
+//
+
+void
+_cupsLogFreeBuffer(_cups_logbuf_t *buf)	// I - Log buffer
+{
+  _cups_logbuf_t	*current,	// Current buffer
+			*prev;		// Previous buffer
+
+
+  if (!buf)
+    return;
+
+  // Remove the buffer from the list so the writer thread no longer sees it...
+  cupsMutexLock(&log_mutex);
+
+  for (current = log_buffers, prev = NULL; current; prev = current, current = current->next)
+  {
+    if (current == buf)
+    {
+      if (prev)
+        prev->next = buf->next;
+      else
+        log_buffers = buf->next;
+      break;
+    }
+  }
+
+  cupsMutexUnlock(&log_mutex);
+
+  // Then write any remaining messages and free the memory...
+  cupsMutexLock(&buf->mutex);
+  log_flush(buf);
+  cupsMutexUnlock(&buf->mutex);
+
+  cupsMutexDestroy(&buf->mutex);
+  free(buf);
+}
+
+
+//
+// '_cupsLogMessage()' - Log a message.
+//
+// Messages above the current log level are ignored.  When the writer thread is
+// running the message is queued in a per-thread buffer, otherwise it is
+// written immediately.  A trailing newline is added as needed.
+//
+
+void
+_cupsLogMessage(
+    _cups_log_level_t level,		// I - Log level
+    const char        *format,		// I - Printf-style format string
+    ...)				// I - Additional arguments as needed
+{
+  va_list	ap;			// Pointer to arguments
+  char		message[2048],		// Message
+		*msgptr,		// Pointer into message
+		buffer[4200],		// Output buffer
+		*bufptr,		// Pointer into output buffer
+		*bufend;		// End of output buffer
+  size_t	length;			// Length of message
+  int		myerrno = errno;	// Copy of errno value
+  static const char * const levels[] =	// Level names
+  {
+    "error",
+    "warn",
+    "info",
+    "debug"
+  };
+
+
+  if (level > log_level)
+    return;
+
+  // Format the message...
+  va_start(ap, format);
+  vsnprintf(message, sizeof(message), format, ap);
+  va_end(ap);
+
+  if ((length = strlen(message)) > 0 && message[length - 1] == '\n')
+    message[-- length] = '\0';
+
+  if (log_structured)
+  {
+    // Write "time=YYYY-MM-DDTHH:MM:SS.mmmZ level=LEVEL thread=N msg="MESSAGE""
+    struct timeval	curtime;	// Current time
+    time_t		cursecs;	// Current time in seconds
+    struct tm		curdate;	// Current date
+
+    gettimeofday(&curtime, NULL);
+    cursecs = (time_t)curtime.tv_sec;
+    gmtime_r(&cursecs, &curdate);
+
+    snprintf(buffer, sizeof(buffer), "time=%04d-%02d-%02dT%02d:%02d:%02d.%03dZ level=%s thread=%d msg=\"", curdate.tm_year + 1900, curdate.tm_mon + 1, curdate.tm_mday, curdate.tm_hour, curdate.tm_min, curdate.tm_sec, (int)(curtime.tv_usec / 1000), levels[level], _cupsGlobals()->thread_id);
+
+    for (bufptr = buffer + strlen(buffer), bufend = buffer + sizeof(buffer) - 3, msgptr = message; *msgptr && bufptr < bufend; msgptr ++)
+    {
+      if (*msgptr == '\"' || *msgptr == '\\')
+      {
+        *bufptr++ = '\\';
+        *bufptr++ = *msgptr;
+      }
+      else if ((*msgptr & 255) < ' ')
+      {
+        *bufptr++ = ' ';
+      }
+      else
+      {
+        *bufptr++ = *msgptr;
+      }
+    }
+
+    *bufptr++ = '\"';
+    *bufptr++ = '\n';
+
+    _cupsLogWrite(log_fd, buffer, (size_t)(bufptr - buffer));
+  }
+  else
+  {
+    // Write the message as-is...
+    message[length++] = '\n';
+
+    _cupsLogWrite(log_fd, message, length);
+  }
+
+  errno = myerrno;
+}
+
+
+//
+// '_cupsLogStart()' - Start asynchronous logging.
+//
+// This function sets the file descriptor, level, and format for messages
+// logged with `_cupsLogMessage` and starts a writer thread.  Messages from
+// each thread (including library debug messages) are then buffered and written
+// by the writer thread.
+//
+
+bool					// O - `true` on success, `false` on error
+_cupsLogStart(int               fd,	// I - File descriptor for messages
+              _cups_log_level_t level,	// I - Maximum level to log
+              bool              structured)
+					// I - Write structured key=value messages?
+{
+  bool	ret = true;			// Return value
+
+
+  cupsMutexLock(&log_mutex);
+
+  log_fd         = fd;
+  log_level      = level;
+  log_structured = structured;
+
+  if (!log_running)
+  {
+    log_running = true;
+
+    if ((log_thread = cupsThreadCreate(log_thread_func, NULL)) == CUPS_THREAD_INVALID)
+    {
+      log_running = false;
+      ret         = false;
+    }
+  }
+
+  cupsMutexUnlock(&log_mutex);
+
+  return (ret);
+}
+
+
+//
+// '_cupsLogStop()' - Stop asynchronous logging and flush all messages.
+//
+
+void
+_cupsLogStop(void)
+{
+  _cups_logbuf_t	*buf;		// Current buffer
+
+
+  cupsMutexLock(&log_mutex);
+
+  if (!log_running)
+  {
+    cupsMutexUnlock(&log_mutex);
+    return;
+  }
+
+  log_running = false;
+  cupsCondBroadcast(&log_cond);
+  cupsMutexUnlock(&log_mutex);
+
+  cupsThreadWait(log_thread);
+
+  // Write anything that is left...
+  cupsMutexLock(&log_mutex);
+
+  for (buf = log_buffers; buf; buf = buf->next)
+  {
+    cupsMutexLock(&buf->mutex);
+    log_flush(buf);
+    cupsMutexUnlock(&buf->mutex);
+  }
+
+  cupsMutexUnlock(&log_mutex);
+}
+
+
+//
+// '_cupsLogWrite()' - Write or queue a log message.
+//
+
+void
+_cupsLogWrite(int        fd,		// I - File descriptor
+              const char *s,		// I - Message
+              size_t     len)		// I - Length of message
+{
+  _cups_globals_t	*cg;		// Global data
+  _cups_logbuf_t	*buf;		// Log buffer for this thread
+  _cups_logrec_t	rec;		// Record header
+  bool			wake;		// Wake the writer thread?
+
+
+  if (!log_running)
+  {
+    // Write the message immediately...
+    cupsMutexLock(&log_write_mutex);
+    write(fd, s, len);
+    cupsMutexUnlock(&log_write_mutex);
+    return;
+  }
+
+  // Get the buffer for this thread...
+  cg = _cupsGlobals();
+
+  if ((buf = cg->log_buffer) == NULL)
+  {
+    if ((buf = calloc(1, sizeof(_cups_logbuf_t))) == NULL)
+    {
+      cupsMutexLock(&log_write_mutex);
+      write(fd, s, len);
+      cupsMutexUnlock(&log_write_mutex);
+      return;
+    }
+
+    cupsMutexInit(&buf->mutex);
+
+    cupsMutexLock(&log_mutex);
+    buf->next   = log_buffers;
+    log_buffers = buf;
+    cupsMutexUnlock(&log_mutex);
+
+    cg->log_buffer = buf;
+  }
+
+  // Add the message to the buffer, making room as needed...
+  rec.fd     = fd;
+  rec.length = len;
+
+  cupsMutexLock(&buf->mutex);
+
+  if ((buf->used + sizeof(rec) + len) > sizeof(buf->data))
+    log_flush(buf);
+
+  if ((sizeof(rec) + len) > sizeof(buf->data))
+  {
+    // Too big to buffer...
+    cupsMutexLock(&log_write_mutex);
+    write(fd, s, len);
+    cupsMutexUnlock(&log_write_mutex);
+  }
+  else
+  {
+    memcpy(buf->data + buf->used, &rec, sizeof(rec));
+    memcpy(buf->data + buf->used + sizeof(rec), s, len);
+    buf->used += sizeof(rec) + len;
+  }
+
+  wake = buf->used > (sizeof(buf->data) / 2);
+
+  cupsMutexUnlock(&buf->mutex);
+
+  if (wake)
+    cupsCondBroadcast(&log_cond);
+}
+
+
+//
+// 'log_flush()' - Write the messages in a log buffer.
+//
+// The caller must hold the buffer mutex.
+//
+
+static void
+log_flush(_cups_logbuf_t *buf)		// I - Log buffer
+{
+  if (buf->used > 0)
+  {
+    log_write_records(buf->data, buf->used);
+    buf->used = 0;
+  }
+}
+
+
+//
+// 'log_thread_func()' - Write buffered log messages.
+//
+
+static void *				// O - Thread exit status
+log_thread_func(void *data)		// I - Thread data (unused)
+{
+  _cups_logbuf_t	*buf;		// Current buffer
+  char			records[_CUPS_LOG_BUFSIZE];
+					// Copy of buffered records
+  size_t		used;		// Bytes in records
+
+
+  (void)data;
+
+  cupsMutexLock(&log_mutex);
+
+  while (log_running)
+  {
+    // Wait up to 100ms for messages...
+    cupsCondWait(&log_cond, &log_mutex, 0.1);
+
+    // Copy each thread's messages so the thread can continue while we write...
+    for (buf = log_buffers; buf; buf = buf->next)
+    {
+      cupsMutexLock(&buf->mutex);
+      memcpy(records, buf->data, used = buf->used);
+      buf->used = 0;
+      cupsMutexUnlock(&buf->mutex);
+
+      if (used > 0)
+        log_write_records(records, used);
+    }
+  }
+
+  cupsMutexUnlock(&log_mutex);
+
+  return (NULL);
+}
+
+
+//
+// 'log_write_records()' - Write log records, combining messages for the same
+//                         file descriptor.
+//
+
+static void
+log_write_records(const char *data,	// I - Log records
+                  size_t     used)	// I - Bytes in records
+{
+  _cups_logrec_t	rec;		// Current record header
+  char			output[_CUPS_LOG_BUFSIZE];
+					// Output buffer
+  size_t		outlen = 0;	// Bytes in output buffer
+  int			outfd = -1;	// Output file descriptor
+
+
+  cupsMutexLock(&log_write_mutex);
+
+  while (used >= sizeof(rec))
+  {
+    memcpy(&rec, data, sizeof(rec));
+    data += sizeof(rec);
+    used -= sizeof(rec);
+
+    if (rec.fd != outfd || (outlen + rec.length) > sizeof(output))
+    {
+      if (outlen > 0)
+        write(outfd, output, outlen);
+
+      outfd  = rec.fd;
+      outlen = 0;
+    }
+
+    memcpy(output + outlen, data, rec.length);
+    outlen += rec.length;
+    data   += rec.length;
+    used   -= rec.length;
+  }
+
+  if (outlen > 0)
+    write(outfd, output, outlen);
+
+  cupsMutexUnlock(&log_write_mutex);
+}
@@ -19,10 +19,8 @@
 // Local globals...
 //
 
-#ifdef DEBUG
 static int		cups_global_index = 0;
 					// Next thread number
-#endif // DEBUG
 static cups_thread_key_t cups_globals_key = CUPS_THREADKEY_INITIALIZER;
 					// Thread local storage key
 #ifndef _WIN32
@@ -181,10 +179,8 @@ cups_globals_alloc(void)
   cg->expired_certs  = -1;
   cg->validate_certs = -1;
 
-#ifdef DEBUG
-  // Friendly thread ID for debugging...
+  // Friendly thread ID for logging...
   cg->thread_id = ++ cups_global_index;
-#endif // DEBUG
 
   // Then set directories as appropriate...
 #ifdef _WIN32
@@ -373,6 +369,8 @@ cups_globals_free(_cups_globals_t *cg)	// I - Pointer to global data
   if (cg->last_status_message)
     _cupsStrFree(cg->last_status_message);
 
+  _cupsLogFreeBuffer(cg->log_buffer);
+
   for (buffer = cg->cups_buffers; buffer; buffer = next)
   {
     next = buffer->next;
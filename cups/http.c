@@ -2799,6 +2799,60 @@ httpWait(http_t *http,			// I - HTTP connection
 }
 
 
+//
+// 'httpWaitRequest()' - Wait for and read a HTTP request from a connection.
+//
+// This function waits up to "msec" milliseconds for a request line to arrive
+// on a server connection and then reads it like @link httpReadRequest@.  Blank
+// lines between requests are skipped without resetting the timeout.  The
+// function sleeps in the operating system until data arrives, so it can be
+// used for idle keep-alive connections.  `HTTP_STATE_WAITING` is returned if
+// no request is received before the timeout and `HTTP_STATE_ERROR` is returned
+// for a `NULL` connection.
+//
+
+http_state_t				// O - New state of connection
+httpWaitRequest(http_t *http,		// I - HTTP connection
+                char   *uri,		// I - URI buffer
+		size_t urilen,		// I - Size of URI buffer
+		int    msec)		// I - Milliseconds to wait
+{
+  http_state_t	state;			// New state of connection
+  double	end;			// End time
+  int		remaining;		// Remaining milliseconds
+
+
+  DEBUG_printf("httpWaitRequest(http=%p, uri=%p, urilen=" CUPS_LLFMT ", msec=%d)", (void *)http, (void *)uri, CUPS_LLCAST urilen, msec);
+
+  if (uri)
+    *uri = '\0';
+
+  // Range check input...
+  if (!http)
+  {
+    DEBUG_puts("1httpWaitRequest: No connection, returning HTTP_STATE_ERROR.");
+    return (HTTP_STATE_ERROR);
+  }
+
+  end = cupsGetClock() + 0.001 * msec;
+
+  do
+  {
+    if ((remaining = (int)(1000.0 * (end - cupsGetClock()))) < 0)
+      remaining = 0;
+
+    if (!httpWait(http, remaining))
+    {
+      DEBUG_puts("1httpWaitRequest: Timed out, returning HTTP_STATE_WAITING.");
+      return (HTTP_STATE_WAITING);
+    }
+  }
+  while ((state = httpReadRequest(http, uri, urilen)) == HTTP_STATE_WAITING);
+
+  return (state);
+}
+
+
 //
 // 'httpWrite()' - Write data to a HTTP connection.
 //
@@ -506,6 +506,7 @@ extern http_status_t	httpUpdate(http_t *http) _CUPS_PUBLIC;
 extern const char	*httpURIStatusString(http_uri_status_t status) _CUPS_PUBLIC;
 
 extern bool		httpWait(http_t *http, int msec) _CUPS_PUBLIC;
+extern http_state_t	httpWaitRequest(http_t *http, char *uri, size_t urilen, int msec) _CUPS_PUBLIC;
 extern ssize_t		httpWrite(http_t *http, const char *buffer, size_t length) _CUPS_PUBLIC;
 extern bool		httpWriteRequest(http_t *http, const char *method, const char *uri);
 extern bool		httpWriteResponse(http_t *http, http_status_t status) _CUPS_PUBLIC;
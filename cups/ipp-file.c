@@ -16,17 +16,33 @@
 // Private structures...
 //
 
+typedef struct _ipp_ftoken_s		// Pre-read IPP data file token
+{
+  char			*text;		// Token text (unexpanded)
+  int			linenum;	// Line number after token
+} _ipp_ftoken_t;
+
+struct _ipp_ftokens_s			// Pre-read IPP data file tokens
+{
+  char			*filename;	// Filename
+  size_t		num_tokens,	// Number of tokens
+			alloc_tokens;	// Allocated tokens
+  _ipp_ftoken_t		*tokens;	// Tokens, the last is the end of file
+};
+
 struct _ipp_file_s			// IPP data file
 {
   ipp_file_t		*parent;	// Parent data file, if any
   cups_file_t		*fp;		// File pointer
+  const _ipp_ftokens_t	*tokens;	// Pre-read tokens, if any
+  size_t		tokidx;		// Current token index
   char			*filename,	// Filename
 			mode;		// Read/write mode
   int			indent,		// Current indentation
 			column,		// Current column
 			linenum,	// Current line number
 			save_line;	// Saved line number
-  off_t			save_pos;	// Saved position
+  off_t			save_pos;	// Saved position or token index
   ipp_tag_t		group_tag;	// Current group for attributes
   ipp_t			*attrs;		// Current attributes
   size_t		num_vars;	// Number of variables
@@ -62,15 +78,19 @@ ippFileClose(ipp_file_t *file)		// I - IPP data file
   bool	ret;				// Return value
 
 
-  if (!file || !file->fp)
+  if (!file || (!file->fp && !file->tokens))
     return (false);
 
-  if ((ret = cupsFileClose(file->fp)) == false)
+  if (file->tokens)
+    ret = true;
+  else if ((ret = cupsFileClose(file->fp)) == false)
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
 
   free(file->filename);
 
   file->fp       = NULL;
+  file->tokens   = NULL;
+  file->tokidx   = 0;
   file->filename = NULL;
   file->mode     = '\0';
   file->attrs    = NULL;
@@ -95,7 +115,7 @@ ippFileDelete(ipp_file_t *file)		// I - IPP data file
     return (false);
   }
 
-  if (file->fp)
+  if (file->fp || file->tokens)
   {
     if (!ippFileClose(file))
       return (false);
@@ -292,8 +312,9 @@ ippFileGetLineNumber(ipp_file_t *file)	// I - IPP data file
 //
 // 'ippFileGetVar()' - Get the value of an IPP data file variable.
 //
-// This function returns the value of an IPP data file variable.  `NULL` is
-// returned if the variable is not set.
+// This function returns the value of an IPP data file variable.  Variables
+// that are not set in the data file are looked up in its parent data file(s).
+// `NULL` is returned if the variable is not set.
 //
 
 const char *				// O - Variable value or `NULL` if none.
@@ -307,12 +328,15 @@ ippFileGetVar(ipp_file_t *file,		// I - IPP data file
     return (NULL);
   else if (!strcmp(name, "user"))
     return (cupsGetUser());
-  else if ((value = cupsGetOption(name, file->num_vars, file->vars)) != NULL)
-    return (value);
-  else if (file->parent)
-    return (cupsGetOption(name, file->parent->num_vars, file->parent->vars));
-  else
-    return (NULL);
+
+  do
+  {
+    if ((value = cupsGetOption(name, file->num_vars, file->vars)) != NULL)
+      return (value);
+  }
+  while ((file = file->parent) != NULL);
+
+  return (NULL);
 }
 
 
@@ -370,7 +394,7 @@ ippFileOpen(ipp_file_t *file,		// I - IPP data file
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EINVAL), 0);
     return (false);
   }
-  else if (file->fp)
+  else if (file->fp || file->tokens)
   {
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EBUSY), 0);
     return (false);
@@ -394,6 +418,48 @@ ippFileOpen(ipp_file_t *file,		// I - IPP data file
 }
 
 
+//
+// '_ippFileOpenTokens()' - Open pre-read IPP data file tokens for reading.
+//
+// This function opens the tokens that were read by the `_ippFileTokensNew`
+// function.  Reading from the returned file behaves exactly like reading from
+// the original file, including variable expansion and line numbers, but does
+// not access the file system.
+//
+// The same tokens can be opened by any number of IPP data file objects at the
+// same time, including from different threads.  The tokens must not be freed
+// until all of the IPP data file objects using them have been closed.
+//
+
+bool					// O - `true` on success, `false` on error
+_ippFileOpenTokens(
+    ipp_file_t           *file,		// I - IPP data file
+    const _ipp_ftokens_t *tokens)	// I - Pre-read tokens
+{
+  // Range check input...
+  if (!file || !tokens)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EINVAL), 0);
+    return (false);
+  }
+  else if (file->fp || file->tokens)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EBUSY), 0);
+    return (false);
+  }
+
+  // Save the file information and return...
+  file->tokens   = tokens;
+  file->tokidx   = 0;
+  file->filename = strdup(tokens->filename);
+  file->mode     = 'r';
+  file->column   = 0;
+  file->linenum  = 1;
+
+  return (true);
+}
+
+
 //
 // 'ippFileRead()' - Read an IPP data file.
 //
@@ -791,6 +857,35 @@ ippFileReadToken(ipp_file_t *file,	// I - IPP data file
     return (false);
   }
 
+  if (file->tokens)
+  {
+    // Return the next pre-read token...
+    const _ipp_ftoken_t	*t = file->tokens->tokens + file->tokidx;
+					// Current token
+
+    file->linenum = t->linenum;
+
+    if (file->tokidx >= (file->tokens->num_tokens - 1))
+    {
+      // End of file or error, which is always returned from here on...
+      cupsCopyString(token, t->text, tokensize);
+      DEBUG_puts("1ippFileReadToken: EOF");
+      return (false);
+    }
+
+    file->tokidx ++;
+
+    if (cupsCopyString(token, t->text, tokensize) >= tokensize)
+    {
+      // Token too long...
+      DEBUG_printf("1ippFileReadToken: Too long: \"%s\".", token);
+      return (false);
+    }
+
+    DEBUG_printf("1ippFileReadToken: Returning \"%s\".", token);
+    return (true);
+  }
+
   // Skip whitespace and comments...
   DEBUG_printf("1ippFileReadToken: linenum=%d, pos=%ld", file->linenum, (long)cupsFileTell(file->fp));
 
@@ -964,7 +1059,9 @@ ippFileRestorePosition(ipp_file_t *file)// I - IPP data file
     return (false);
 
   // Seek back to the saved position...
-  if (cupsFileSeek(file->fp, file->save_pos) != file->save_pos)
+  if (file->tokens)
+    file->tokidx = (size_t)file->save_pos;
+  else if (cupsFileSeek(file->fp, file->save_pos) != file->save_pos)
     return (false);
 
   file->linenum   = file->save_line;
@@ -990,7 +1087,7 @@ ippFileSavePosition(ipp_file_t *file)	// I - IPP data file
     return (false);
 
   // Save the current position...
-  file->save_pos  = cupsFileTell(file->fp);
+  file->save_pos  = file->tokens ? (off_t)file->tokidx : cupsFileTell(file->fp);
   file->save_line = file->linenum;
 
   return (true);
@@ -1154,6 +1251,118 @@ ippFileSetVarf(ipp_file_t *file,	// I - IPP data file
 }
 
 
+//
+// '_ippFileTokensDelete()' - Free pre-read IPP data file tokens.
+//
+// This function frees the memory used by tokens returned by the
+// `_ippFileTokensNew` function.
+//
+
+void
+_ippFileTokensDelete(
+    _ipp_ftokens_t *tokens)		// I - Pre-read tokens
+{
+  size_t	i;			// Looping var
+
+
+  if (!tokens)
+    return;
+
+  for (i = 0; i < tokens->num_tokens; i ++)
+    free(tokens->tokens[i].text);
+
+  free(tokens->tokens);
+  free(tokens->filename);
+  free(tokens);
+}
+
+
+//
+// '_ippFileTokensNew()' - Read all of the tokens from an IPP data file.
+//
+// This function reads all of the tokens in the IPP data file specified by the
+// "filename" argument into memory.  Variables in the tokens are not expanded,
+// allowing the tokens to be read any number of times using the
+// `_ippFileOpenTokens` function with different variables.  This avoids
+// re-reading and re-tokenizing data files that are used repeatedly.
+//
+// Call the `_ippFileTokensDelete` function to free the tokens when they are no
+// longer needed.
+//
+
+_ipp_ftokens_t *			// O - Pre-read tokens or `NULL` on error
+_ippFileTokensNew(const char *filename)	// I - Filename to read
+{
+  ipp_file_t	file;			// IPP data file
+  _ipp_ftokens_t	*tokens;	// Pre-read tokens
+  _ipp_ftoken_t	*t;			// Current token
+  char		*token;			// Token buffer
+  bool		done = false;		// Done reading?
+
+
+  // Range check input...
+  if (!filename)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EINVAL), 0);
+    return (NULL);
+  }
+
+  // Allocate memory and open the file...
+  memset(&file, 0, sizeof(file));
+
+  if ((tokens = (_ipp_ftokens_t *)calloc(1, sizeof(_ipp_ftokens_t))) == NULL || (tokens->filename = strdup(filename)) == NULL || (token = (char *)malloc(IPP_MAX_LENGTH + 1)) == NULL)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+    _ippFileTokensDelete(tokens);
+    return (NULL);
+  }
+
+  if (!ippFileOpen(&file, filename, "r"))
+  {
+    free(token);
+    _ippFileTokensDelete(tokens);
+    return (NULL);
+  }
+
+  // Read tokens until the end of the file or an error, which is recorded as
+  // the last token...
+  while (!done)
+  {
+    *token = '\0';
+    done   = !ippFileReadToken(&file, token, IPP_MAX_LENGTH + 1);
+
+    if (tokens->num_tokens >= tokens->alloc_tokens)
+    {
+      if ((t = (_ipp_ftoken_t *)realloc(tokens->tokens, (tokens->alloc_tokens + 1024) * sizeof(_ipp_ftoken_t))) == NULL)
+        break;
+
+      tokens->tokens       = t;
+      tokens->alloc_tokens += 1024;
+    }
+
+    t = tokens->tokens + tokens->num_tokens;
+
+    if ((t->text = strdup(token)) == NULL)
+      break;
+
+    t->linenum = file.linenum;
+    tokens->num_tokens ++;
+  }
+
+  free(token);
+  ippFileClose(&file);
+
+  if (!done)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(ENOMEM), 0);
+    _ippFileTokensDelete(tokens);
+    return (NULL);
+  }
+
+  return (tokens);
+}
+
+
 //
 // 'ippFileWriteAttributes()' - Write an IPP message to an IPP data file.
 //
@@ -90,6 +90,9 @@ typedef struct _ipp_find_s		// IPP find data
   bool			atend;		// At the end of the message?
 } _ipp_find_t;
 
+typedef struct _ipp_ftokens_s _ipp_ftokens_t;
+					// Pre-read IPP data file tokens
+
 struct _ipp_s				// IPP Request/Response/Notification
 {
   ipp_state_t		state;		// State of request
@@ -123,6 +126,9 @@ typedef struct _ipp_option_s		// Attribute mapping data
 #ifdef DEBUG
 extern const char	*_ippCheckOptions(void) _CUPS_PRIVATE;
 #endif // DEBUG
+extern bool		_ippFileOpenTokens(ipp_file_t *file, const _ipp_ftokens_t *tokens) _CUPS_PRIVATE;
+extern void		_ippFileTokensDelete(_ipp_ftokens_t *tokens) _CUPS_PRIVATE;
+extern _ipp_ftokens_t	*_ippFileTokensNew(const char *filename) _CUPS_PRIVATE;
 extern _ipp_option_t	*_ippFindOption(const char *name) _CUPS_PRIVATE;
 
 
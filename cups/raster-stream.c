@@ -69,6 +69,7 @@ static const char * const cups_modes[] =
 // Local functions...
 //
 
+static bool	cups_raster_copy(cups_raster_t *src, cups_raster_t *dst);
 static ssize_t	cups_raster_io(cups_raster_t *r, unsigned char *buf, size_t bytes);
 static ssize_t	cups_raster_read(cups_raster_t *r, unsigned char *buf, size_t bytes);
 static bool	cups_raster_update(cups_raster_t *r);
@@ -181,6 +182,92 @@ cupsRasterClose(cups_raster_t *r)	// I - Stream to free
 }
 
 
+//
+// 'cupsRasterCopyPage()' - Copy the current page from one raster stream to
+//                          another.
+//
+// This function copies the pixels for the current page from the "src" raster
+// stream to the "dst" raster stream.  Call it after reading the page header
+// with @link cupsRasterReadHeader@ and writing the (possibly modified) page
+// header with @link cupsRasterWriteHeader@, for example:
+//
+// ```
+// cups_raster_t      *src = cupsRasterOpen(0, CUPS_RASTER_READ);
+// cups_raster_t      *dst = cupsRasterOpen(1, CUPS_RASTER_WRITE_APPLE);
+// cups_page_header_t header;
+//
+// while (cupsRasterReadHeader(src, &header))
+// {
+//   if (!cupsRasterWriteHeader(dst, &header) || !cupsRasterCopyPage(src, dst))
+//     break;
+// }
+// ```
+//
+// When both streams use the PackBits line encoding (PWG, Apple, and compressed
+// CUPS raster) with the same color space, bit depth, and byte order, the
+// compressed line data is passed through without decoding it.  Otherwise the
+// pixels are decoded and re-encoded one line at a time.
+//
+
+bool					// O - `true` on success, `false` on failure
+cupsRasterCopyPage(cups_raster_t *src,	// I - Source raster stream
+                   cups_raster_t *dst)	// I - Destination raster stream
+{
+  bool		ret = true;		// Return value
+  unsigned	y,			// Current line
+		lines;			// Number of lines to copy
+  unsigned char	*line;			// Line buffer
+
+
+  DEBUG_printf("cupsRasterCopyPage(src=%p, dst=%p)", (void *)src, (void *)dst);
+
+  if (!src || src->mode != CUPS_RASTER_READ || !dst || dst->mode == CUPS_RASTER_READ)
+  {
+    _cupsRasterAddError("%s", strerror(EINVAL));
+    return (false);
+  }
+
+  if (src->header.cupsBytesPerLine != dst->header.cupsBytesPerLine || src->header.cupsBytesPerLine == 0)
+  {
+    _cupsRasterAddError("Raster line length %u does not match %u.", src->header.cupsBytesPerLine, dst->header.cupsBytesPerLine);
+    return (false);
+  }
+
+  // Pass compressed lines through if the encoding is the same...
+  if (src->compressed && dst->compressed && src->count == 0 && dst->count == 0 && dst->pcurrent == dst->pixels && dst->rowheight == 1 && src->bpp == dst->bpp && src->remaining == dst->remaining && src->header.cupsColorSpace == dst->header.cupsColorSpace && src->header.cupsBitsPerColor == dst->header.cupsBitsPerColor && src->header.cupsBitsPerPixel == dst->header.cupsBitsPerPixel && src->header.cupsColorOrder == dst->header.cupsColorOrder && (src->swapped == dst->swapped || (src->header.cupsBitsPerColor != 16 && src->header.cupsBitsPerPixel != 12 && src->header.cupsBitsPerPixel != 16)))
+  {
+    DEBUG_puts("1cupsRasterCopyPage: Copying compressed line data.");
+    return (cups_raster_copy(src, dst));
+  }
+
+  // Otherwise decode and re-encode each line...
+  DEBUG_puts("1cupsRasterCopyPage: Decoding and encoding line data.");
+
+  if ((line = malloc(src->header.cupsBytesPerLine)) == NULL)
+  {
+    _cupsRasterAddError("Unable to allocate %u bytes for raster line: %s", src->header.cupsBytesPerLine, strerror(errno));
+    return (false);
+  }
+
+  lines = src->remaining < dst->remaining ? src->remaining : dst->remaining;
+
+  for (y = 0; y < lines; y ++)
+  {
+    if (cupsRasterReadPixels(src, line, src->header.cupsBytesPerLine) != src->header.cupsBytesPerLine || cupsRasterWritePixels(dst, line, dst->header.cupsBytesPerLine) != dst->header.cupsBytesPerLine)
+    {
+      ret = false;
+      break;
+    }
+  }
+
+  free(line);
+
+  DEBUG_printf("1cupsRasterCopyPage: Returning %s.", ret ? "true" : "false");
+
+  return (ret);
+}
+
+
 //
 // 'cupsRasterInitHeader()' - Initialize a page header for PWG Raster output.
 //
@@ -1378,6 +1465,132 @@ cupsRasterWritePixels(
 }
 
 
+//
+// 'cups_raster_copy()' - Copy compressed lines from one raster stream to
+//                        another.
+//
+// Each line is re-framed so that runs never extend past the end of the line,
+// but the pixel data itself is copied as-is.
+//
+
+static bool				// O - `true` on success, `false` on failure
+cups_raster_copy(cups_raster_t *src,	// I - Source raster stream
+                 cups_raster_t *dst)	// I - Destination raster stream
+{
+  unsigned char	byte,			// Byte from stream
+		*wptr;			// Pointer into write buffer
+  unsigned	bpp = src->bpp,		// Bytes per pixel
+		bytes,			// Bytes remaining in line
+		count,			// Number of bytes in run
+		rcount;			// Line repeat count
+  size_t	bufsize;		// Size of write buffer
+
+
+  // Allocate a write buffer as needed...
+  bufsize = 2 * (size_t)dst->header.cupsBytesPerLine + 1;
+  if (bufsize < 65536)
+    bufsize = 65536;
+
+  if (bufsize > dst->bufsize)
+  {
+    if (dst->buffer)
+      wptr = realloc(dst->buffer, bufsize);
+    else
+      wptr = malloc(bufsize);
+
+    if (!wptr)
+    {
+      _cupsRasterAddError("Unable to allocate " CUPS_LLFMT " bytes for raster buffer: %s", CUPS_LLCAST bufsize, strerror(errno));
+      return (false);
+    }
+
+    dst->buffer  = wptr;
+    dst->bufsize = bufsize;
+  }
+
+  while (src->remaining > 0)
+  {
+    // Get the line repeat count...
+    if (!cups_raster_read(src, &byte, 1))
+    {
+      DEBUG_puts("6cups_raster_copy: Read error, returning false.");
+      return (false);
+    }
+
+    if ((rcount = (unsigned)byte + 1) > src->remaining)
+      rcount = src->remaining;
+
+    wptr    = dst->buffer;
+    *wptr++ = (unsigned char)(rcount - 1);
+
+    // Copy the runs for the line...
+    for (bytes = src->header.cupsBytesPerLine; bytes > 0;)
+    {
+      if (!cups_raster_read(src, &byte, 1))
+      {
+	DEBUG_puts("6cups_raster_copy: Read error, returning false.");
+	return (false);
+      }
+
+      if (byte == 128)
+      {
+        // Clear to end of line...
+        *wptr++ = byte;
+        bytes   = 0;
+      }
+      else if (byte & 128)
+      {
+        // N literal pixels...
+        if ((count = (unsigned)(257 - byte) * bpp) > bytes)
+        {
+          count = bytes;
+          byte  = (unsigned char)(257 - count / bpp);
+        }
+
+        *wptr++ = byte;
+
+        if (cups_raster_read(src, wptr, count) != (ssize_t)count)
+	{
+	  DEBUG_puts("6cups_raster_copy: Read error, returning false.");
+	  return (false);
+	}
+
+        wptr  += count;
+        bytes -= count;
+      }
+      else
+      {
+        // Repeat the next pixel N times...
+        if ((count = ((unsigned)byte + 1) * bpp) > bytes)
+        {
+          count = bytes;
+          byte  = (unsigned char)(count / bpp - 1);
+        }
+
+        *wptr++ = byte;
+
+        if (cups_raster_read(src, wptr, bpp) != (ssize_t)bpp)
+	{
+	  DEBUG_puts("6cups_raster_copy: Read error, returning false.");
+	  return (false);
+	}
+
+        wptr  += bpp;
+        bytes -= count;
+      }
+    }
+
+    if (cups_raster_io(dst, dst->buffer, (size_t)(wptr - dst->buffer)) != (ssize_t)(wptr - dst->buffer))
+      return (false);
+
+    src->remaining -= rcount;
+    dst->remaining -= rcount;
+  }
+
+  return (true);
+}
+
+
 //
 // 'cups_raster_io()' - Read/write bytes from a context, handling interruptions.
 //
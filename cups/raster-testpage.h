@@ -14,6 +14,44 @@
 #include <stdbool.h>
 
 
+//
+// 'raster_test_reuse_line()' - Write a copy of the current test page line.
+//
+// Each row of the test page image is "yrep" lines tall, and only the first
+// line of a row needs to be rendered.  The remaining lines reuse that line,
+// except that 1-bit bitmap shading alternates between two patterns, so the
+// last bitmap line is rendered and the first one is saved in "oline".
+//
+// Returns `true` if a line was written and `false` if the caller needs to
+// render the line.
+//
+
+static bool				// O - `true` if line written, `false` to render it
+raster_test_reuse_line(
+    cups_raster_t      *ras,		// I - Raster stream
+    cups_page_header_t *header,		// I - Raster page header
+    unsigned char      *line,		// I - Last rendered line
+    unsigned char      *oline,		// I - Other line for bitmap shading
+    unsigned           bpp,		// I - Bytes per pixel (0 for bitmap)
+    unsigned           ycount,		// I - Lines remaining in row
+    unsigned           yrep)		// I - Lines per row
+{
+  if (ycount < yrep && (bpp || ycount < (yrep - 1)))
+  {
+    // Reuse the line already rendered for this row...
+    cupsRasterWritePixels(ras, (bpp || ((yrep - ycount) & 1)) ? line : oline, header->cupsBytesPerLine);
+    return (true);
+  }
+  else if (!bpp && ycount < yrep)
+  {
+    // Save the first line since the bitmap shading alternates...
+    memcpy(oline, line, header->cupsBytesPerLine);
+  }
+
+  return (false);
+}
+
+
 //
 // 'cupsRasterWriteTest()' - Write a series of raster test pages.
 //
@@ -44,6 +82,7 @@ cupsRasterWriteTest(
 			output[8][101];	// Output image
   unsigned char		*line,		// Line of raster data
 			*bline,		// Border line in raster data
+			*oline,		// Other line for bitmap shading
 			*lineptr,	// Pointer into line
 			*lineend,	// Pointer to end of line
 			black,		// Black pixel
@@ -165,6 +204,14 @@ cupsRasterWriteTest(
     return (false);
   }
 
+  if ((oline = malloc(header->cupsBytesPerLine)) == NULL)
+  {
+    _cupsRasterAddError("Unable to allocate %u bytes for line: %s", header->cupsBytesPerLine, strerror(errno));
+    free(line);
+    free(bline);
+    return (false);
+  }
+
   switch (header->cupsColorSpace)
   {
     default :
@@ -370,6 +417,9 @@ cupsRasterWriteTest(
                 // Write N scan lines...
 	        for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 	        {
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  // Format the current line in the output row...
 		  memcpy(line, bline, header->cupsBytesPerLine);
 		  colorptr = colors[color];
@@ -530,6 +580,9 @@ cupsRasterWriteTest(
 		// Write N scan lines...
 		for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 		{
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  memcpy(line, bline, header->cupsBytesPerLine);
 
 		  color = (int)rows - 1;
@@ -697,6 +750,9 @@ cupsRasterWriteTest(
                 // Write N scan lines...
 	        for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 	        {
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  // Format the current line in the output row...
 		  memcpy(line, bline, header->cupsBytesPerLine);
 		  colorptr = colors[color];
@@ -851,6 +907,9 @@ cupsRasterWriteTest(
 		// Write N scan lines...
 		for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 		{
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  memcpy(line, bline, header->cupsBytesPerLine);
 
 		  color = 0;
@@ -1016,6 +1075,9 @@ cupsRasterWriteTest(
                 // Write N scan lines...
 	        for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 	        {
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  // Format the current line in the output row...
 		  memcpy(line, bline, header->cupsBytesPerLine);
 		  colorptr = colors[color];
@@ -1171,6 +1233,9 @@ cupsRasterWriteTest(
 		// Write N scan lines...
 		for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 		{
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  memcpy(line, bline, header->cupsBytesPerLine);
 
 		  color = (int)rows - 1;
@@ -1344,6 +1409,9 @@ cupsRasterWriteTest(
                 // Write N scan lines...
 	        for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 	        {
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  // Format the current line in the output row...
 		  memcpy(line, bline, header->cupsBytesPerLine);
 		  colorptr = colors[color];
@@ -1503,6 +1571,9 @@ cupsRasterWriteTest(
 		// Write N scan lines...
 		for (ycount = yrep; ycount > 0 && y < yend; ycount --, y ++)
 		{
+		  if (raster_test_reuse_line(ras, header, line, oline, bpp, ycount, yrep))
+		    continue;
+
 		  memcpy(line, bline, header->cupsBytesPerLine);
 
 		  color = 0;
@@ -1701,6 +1772,7 @@ cupsRasterWriteTest(
   // Free memory and return...
   free(line);
   free(bline);
+  free(oline);
 
   return (true);
 }
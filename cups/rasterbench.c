@@ -1,43 +1,110 @@
 //
 // Raster benchmark program for CUPS.
 //
-// Copyright © 2021-2022 by OpenPrinting.
-// Copyright © 2007-2016 by Apple Inc.
-// Copyright © 1997-2006 by Easy Software Products.
+// Copyright © 2021-2026 by OpenPrinting.
+// Copyright © 2007-2016 by Apple Inc.
+// Copyright © 1997-2006 by Easy Software Products.
 //
 // Licensed under Apache License v2.0.  See the file "LICENSE" for more
 // information.
 //
+// Usage:
+//
+//   ./rasterbench [OPTIONS]
+//
+// Options:
+//
+//   --help         Show program help.
+//   -c CONTENT     Content to test ("all", "blank", "photo", or "text").
+//   -j             Produce JSON output.
+//   -m MEDIA       PWG media size name.
+//   -n PASSES      Number of passes to run for each test.
+//   -o MODE        Raster mode ("all", "apple", "compressed", "cups", or "pwg").
+//   -p PAGES       Number of pages per document.
+//   -r RES         Resolution in DPI ("RES" or "XRESxYRES").
+//   -t TYPE        PWG raster type ("black_1", "sgray_8", "srgb_8", etc.)
+//   -z             Same as "-o compressed".
+//
 
 #include <config.h>
 #include <cups/raster.h>
+#include <cups/json.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <ctype.h>
+#include <errno.h>
 #include <signal.h>
-#include <unistd.h>
-#include <sys/wait.h>
 
 
 //
 // Constants...
 //
 
-#define TEST_WIDTH	1024
-#define TEST_HEIGHT	1024
-#define TEST_PAGES	16
-#define TEST_PASSES	20
+#define BENCH_MAX_PASSES	1000	// Maximum number of passes
+#define BENCH_PHOTO_ROWS	64	// Number of distinct photo rows
+#define BENCH_TEXT_ROWS		32	// Number of distinct text rows
+
+
+//
+// Local types...
+//
+
+typedef struct bench_buffer_s		// Memory buffer for raster data
+{
+  unsigned char	*data;			// Buffer data
+  size_t	used,			// Bytes used
+		alloc,			// Bytes allocated
+		offset;			// Current read offset
+} bench_buffer_t;
+
+typedef struct bench_stats_s		// Timing statistics
+{
+  double	min,			// Minimum time in seconds
+		median,			// Median time in seconds
+		p90,			// 90th percentile time in seconds
+		p95,			// 95th percentile time in seconds
+		max;			// Maximum time in seconds
+} bench_stats_t;
+
+
+//
+// Local globals...
+//
+
+static const char * const contents[] =	// Content corpora
+{
+  "text",
+  "photo",
+  "blank"
+};
+static const char * const modes[] =	// Raster modes
+{
+  "cups",
+  "compressed",
+  "pwg",
+  "apple"
+};
+static const cups_raster_mode_t mode_values[] =
+{					// Raster mode values
+  CUPS_RASTER_WRITE,
+  CUPS_RASTER_WRITE_COMPRESSED,
+  CUPS_RASTER_WRITE_PWG,
+  CUPS_RASTER_WRITE_APPLE
+};
 
 
 //
 // Local functions...
 //
 
-static double	compute_median(double *secs);
-static double	get_time(void);
-static void	read_test(int fd);
-static int	run_read_test(void);
-static void	write_test(int fd, cups_raster_mode_t mode);
+static ssize_t	buffer_read_cb(bench_buffer_t *bb, unsigned char *buffer, size_t bytes);
+static ssize_t	buffer_write_cb(bench_buffer_t *bb, unsigned char *buffer, size_t bytes);
+static void	compute_stats(double *secs, int num_secs, bench_stats_t *stats);
+static void	json_add_stats(cups_json_t *parent, const char *key, bench_stats_t *stats, double mbytes);
+static unsigned char **make_content(const char *content, cups_page_header_t *header, unsigned char **pool);
+static bool	read_test(bench_buffer_t *bb, unsigned char *buffer, int num_pages);
+static int	usage(FILE *out);
+static bool	write_test(bench_buffer_t *bb, cups_raster_mode_t mode, cups_page_header_t *header, unsigned char **lines, int num_pages);
 
 
 //
@@ -48,74 +115,386 @@ int					// O - Exit status
 main(int  argc,				// I - Number of command-line args
      char *argv[])			// I - Command-line arguments
 {
-  int		i;			// Looping var
-  int		ras_fd,			// File descriptor for read process
-		status;			// Exit status of read process
-  double	start_secs,		// Start time
-		write_secs,		// Write time
-		read_secs,		// Read time
-		pass_secs[TEST_PASSES];	// Total test times
-  cups_raster_mode_t mode;		// Write mode
-
-
-  // See if we have anything on the command-line...
-  if (argc > 2 || (argc == 2 && strcmp(argv[1], "-z")))
+  int			i,		// Looping var
+			c,		// Current content
+			m,		// Current mode
+			pass;		// Current pass
+  const char		*opt;		// Current option
+  const char		*content = "all",
+					// Content to test
+			*media_name = "na_letter_8.5x11in",
+					// Media size name
+			*mode = "all",	// Mode to test
+			*type = "sgray_8";
+					// Raster type
+  int			xres = 300,	// Horizontal resolution
+			yres = 300,	// Vertical resolution
+			num_pages = 4,	// Number of pages
+			num_passes = 10;// Number of passes
+  bool			json = false,	// Produce JSON output?
+			apple_ok;	// Can Apple raster be tested?
+  pwg_media_t		*pwg;		// PWG media size
+  cups_media_t		media;		// Media information
+  cups_page_header_t	header;		// Page header
+  bench_buffer_t	bb;		// Raster data buffer
+  unsigned char		*pool,		// Content line pool
+			**lines,	// Lines for each page
+			*buffer;	// Read buffer
+  double		start,		// Start time
+			encode_secs[BENCH_MAX_PASSES],
+					// Encode times
+			decode_secs[BENCH_MAX_PASSES],
+					// Decode times
+			mbytes;		// Megabytes of raw pixels per document
+  bench_stats_t		encode,		// Encode statistics
+			decode;		// Decode statistics
+  cups_json_t		*root = NULL,	// JSON output
+			*results = NULL,// Results array
+			*result;	// Current result
+  char			*s;		// JSON string
+
+
+  // Parse command-line options...
+  for (i = 1; i < argc; i ++)
   {
-    puts("Usage: rasterbench [-z]");
+    if (!strcmp(argv[i], "--help"))
+    {
+      return (usage(stdout));
+    }
+    else if (argv[i][0] == '-' && argv[i][1] != '-')
+    {
+      for (opt = argv[i] + 1; *opt; opt ++)
+      {
+        switch (*opt)
+        {
+          case 'c' : // -c CONTENT
+              i ++;
+              if (i >= argc || (strcmp(argv[i], "all") && strcmp(argv[i], "blank") && strcmp(argv[i], "photo") && strcmp(argv[i], "text")))
+              {
+                fputs("rasterbench: Expected 'all', 'blank', 'photo', or 'text' after '-c'.\n", stderr);
+                return (usage(stderr));
+              }
+
+              content = argv[i];
+              break;
+
+          case 'j' : // -j
+              json = true;
+              break;
+
+          case 'm' : // -m MEDIA
+              i ++;
+              if (i >= argc)
+              {
+                fputs("rasterbench: Expected media size name after '-m'.\n", stderr);
+                return (usage(stderr));
+              }
+
+              media_name = argv[i];
+              break;
+
+          case 'n' : // -n PASSES
+              i ++;
+              if (i >= argc || !isdigit(argv[i][0] & 255) || (num_passes = atoi(argv[i])) < 1 || num_passes > BENCH_MAX_PASSES)
+              {
+                fprintf(stderr, "rasterbench: Expected number of passes from 1 to %d after '-n'.\n", BENCH_MAX_PASSES);
+                return (usage(stderr));
+              }
+              break;
+
+          case 'o' : // -o MODE
+              i ++;
+              if (i >= argc || (strcmp(argv[i], "all") && strcmp(argv[i], "apple") && strcmp(argv[i], "compressed") && strcmp(argv[i], "cups") && strcmp(argv[i], "pwg")))
+              {
+                fputs("rasterbench: Expected 'all', 'apple', 'compressed', 'cups', or 'pwg' after '-o'.\n", stderr);
+                return (usage(stderr));
+              }
+
+              mode = argv[i];
+              break;
+
+          case 'p' : // -p PAGES
+              i ++;
+              if (i >= argc || !isdigit(argv[i][0] & 255) || (num_pages = atoi(argv[i])) < 1)
+              {
+                fputs("rasterbench: Expected number of pages after '-p'.\n", stderr);
+                return (usage(stderr));
+              }
+              break;
+
+          case 'r' : // -r RES or -r XRESxYRES
+              i ++;
+              if (i >= argc)
+              {
+                fputs("rasterbench: Expected resolution after '-r'.\n", stderr);
+                return (usage(stderr));
+              }
+
+              switch (sscanf(argv[i], "%dx%d", &xres, &yres))
+              {
+                case 1 :
+                    yres = xres;
+                    break;
+                case 2 :
+                    break;
+                default :
+                    xres = 0;
+                    break;
+              }
+
+              if (xres < 1 || xres > 9600 || yres < 1 || yres > 9600)
+              {
+                fprintf(stderr, "rasterbench: Unexpected resolution '-r %s'.\n", argv[i]);
+                return (usage(stderr));
+              }
+              break;
+
+          case 't' : // -t TYPE
+              i ++;
+              if (i >= argc)
+              {
+                fputs("rasterbench: Expected raster type after '-t'.\n", stderr);
+                return (usage(stderr));
+              }
+
+              type = argv[i];
+              break;
+
+          case 'z' : // -z
+              mode = "compressed";
+              break;
+
+          default :
+              fprintf(stderr, "rasterbench: Unknown option '-%c'.\n", *opt);
+              return (usage(stderr));
+        }
+      }
+    }
+    else
+    {
+      fprintf(stderr, "rasterbench: Unknown option '%s'.\n", argv[i]);
+      return (usage(stderr));
+    }
+  }
+
+  // Initialize the page header...
+  if ((pwg = pwgMediaForPWG(media_name)) == NULL)
+  {
+    fprintf(stderr, "rasterbench: Unable to lookup media '%s'.\n", media_name);
+    return (1);
+  }
+
+  memset(&media, 0, sizeof(media));
+  cupsCopyString(media.media, pwg->pwg, sizeof(media.media));
+  media.width  = pwg->width;
+  media.length = pwg->length;
+
+  if (!cupsRasterInitHeader(&header, &media, /*optimize*/NULL, IPP_QUALITY_NORMAL, /*intent*/NULL, IPP_ORIENT_PORTRAIT, "one-sided", type, xres, yres, /*sheet_back*/NULL))
+  {
+    fprintf(stderr, "rasterbench: %s\n", cupsRasterGetErrorString());
     return (1);
   }
 
-  mode = argc > 1 ? CUPS_RASTER_WRITE_COMPRESSED : CUPS_RASTER_WRITE;
+  header.cupsInteger[CUPS_RASTER_PWG_TotalPageCount] = (unsigned)num_pages;
+
+  // Apple raster only supports integral resolution ratios and 8 or 16 bits per
+  // color...
+  apple_ok = xres >= yres && (xres % yres) == 0 && header.cupsBitsPerColor != 1;
+
+  if (!apple_ok && !strcmp(mode, "apple"))
+  {
+    fprintf(stderr, "rasterbench: Apple raster does not support '%s' at %dx%ddpi.\n", type, xres, yres);
+    return (1);
+  }
+
+  if ((buffer = malloc(header.cupsBytesPerLine)) == NULL)
+  {
+    perror("rasterbench: Unable to allocate line buffer");
+    return (1);
+  }
+
+  memset(&bb, 0, sizeof(bb));
+
+  mbytes = (double)header.cupsBytesPerLine * header.cupsHeight * num_pages / 1048576.0;
 
   // Ignore SIGPIPE...
+#ifndef _WIN32
   signal(SIGPIPE, SIG_IGN);
+#endif // !_WIN32
 
-  // Run the tests several times to get a good average...
-  printf("Test read/write speed of %d pages, %dx%d pixels...\n\n", TEST_PAGES, TEST_WIDTH, TEST_HEIGHT);
-  for (i = 0; i < TEST_PASSES; i ++)
+  if (json)
   {
-    printf("PASS %2d: ", i + 1);
-    fflush(stdout);
+    root = cupsJSONNew(/*parent*/NULL, /*after*/NULL, CUPS_JTYPE_OBJECT);
+    cupsJSONNewString(root, cupsJSONNewKey(root, /*after*/NULL, "media"), pwg->pwg);
+    cupsJSONNewString(root, cupsJSONNewKey(root, /*after*/NULL, "type"), type);
+    cupsJSONNewNumber(root, cupsJSONNewKey(root, /*after*/NULL, "x-resolution"), xres);
+    cupsJSONNewNumber(root, cupsJSONNewKey(root, /*after*/NULL, "y-resolution"), yres);
+    cupsJSONNewNumber(root, cupsJSONNewKey(root, /*after*/NULL, "width"), header.cupsWidth);
+    cupsJSONNewNumber(root, cupsJSONNewKey(root, /*after*/NULL, "height"), header.cupsHeight);
+    cupsJSONNewNumber(root, cupsJSONNewKey(root, /*after*/NULL, "bits-per-pixel"), header.cupsBitsPerPixel);
+    cupsJSONNewNumber(root, cupsJSONNewKey(root, /*after*/NULL, "pages"), num_pages);
+    cupsJSONNewNumber(root, cupsJSONNewKey(root, /*after*/NULL, "passes"), num_passes);
+    results = cupsJSONNew(root, cupsJSONNewKey(root, /*after*/NULL, "results"), CUPS_JTYPE_ARRAY);
+  }
+  else
+  {
+    printf("Test read/write speed of %d %s pages, %ux%ux%u @ %dx%ddpi, %d passes...\n\n", num_pages, pwg->pwg, header.cupsWidth, header.cupsHeight, header.cupsBitsPerPixel, xres, yres, num_passes);
+    puts("Mode        Content  Size(MiB)  Ratio   Encode ms (min/median/p95/max)       Decode ms (min/median/p95/max)");
+  }
+
+  // Run the tests...
+  for (c = 0; c < (int)(sizeof(contents) / sizeof(contents[0])); c ++)
+  {
+    if (strcmp(content, "all") && strcmp(content, contents[c]))
+      continue;
+
+    if ((lines = make_content(contents[c], &header, &pool)) == NULL)
+    {
+      perror("rasterbench: Unable to allocate content");
+      return (1);
+    }
+
+    for (m = 0; m < (int)(sizeof(modes) / sizeof(modes[0])); m ++)
+    {
+      if (strcmp(mode, "all") && strcmp(mode, modes[m]))
+        continue;
+
+      if (mode_values[m] == CUPS_RASTER_WRITE_APPLE && !apple_ok)
+        continue;
+
+      for (pass = 0; pass < num_passes; pass ++)
+      {
+        start = cupsGetClock();
+
+        if (!write_test(&bb, mode_values[m], &header, lines, num_pages))
+        {
+          fprintf(stderr, "rasterbench: Unable to write %s raster: %s\n", modes[m], cupsRasterGetErrorString());
+          return (1);
+        }
+
+        encode_secs[pass] = cupsGetClock() - start;
+        start             = cupsGetClock();
+
+        if (!read_test(&bb, buffer, num_pages))
+        {
+          fprintf(stderr, "rasterbench: Unable to read %s raster: %s\n", modes[m], cupsRasterGetErrorString());
+          return (1);
+        }
+
+        decode_secs[pass] = cupsGetClock() - start;
+      }
 
-    ras_fd     = run_read_test();
-    start_secs = get_time();
+      compute_stats(encode_secs, num_passes, &encode);
+      compute_stats(decode_secs, num_passes, &decode);
 
-    write_test(ras_fd, mode);
+      if (json)
+      {
+        result = cupsJSONNew(results, /*after*/NULL, CUPS_JTYPE_OBJECT);
+        cupsJSONNewString(result, cupsJSONNewKey(result, /*after*/NULL, "mode"), modes[m]);
+        cupsJSONNewString(result, cupsJSONNewKey(result, /*after*/NULL, "content"), contents[c]);
+        cupsJSONNewNumber(result, cupsJSONNewKey(result, /*after*/NULL, "raw-bytes"), mbytes * 1048576.0);
+        cupsJSONNewNumber(result, cupsJSONNewKey(result, /*after*/NULL, "encoded-bytes"), (double)bb.used);
+        json_add_stats(result, "encode", &encode, mbytes);
+        json_add_stats(result, "decode", &decode, mbytes);
+      }
+      else
+      {
+        printf("%-11s %-8s %9.2f %6.3f   %7.2f %7.2f %7.2f %7.2f   %7.2f %7.2f %7.2f %7.2f\n", modes[m], contents[c], bb.used / 1048576.0, bb.used / (mbytes * 1048576.0), 1000.0 * encode.min, 1000.0 * encode.median, 1000.0 * encode.p95, 1000.0 * encode.max, 1000.0 * decode.min, 1000.0 * decode.median, 1000.0 * decode.p95, 1000.0 * decode.max);
+        fflush(stdout);
+      }
+    }
 
-    write_secs = get_time();
-    printf(" %.3f write,", write_secs - start_secs);
-    fflush(stdout);
+    free(lines);
+    free(pool);
+  }
 
-    close(ras_fd);
-    wait(&status);
+  if (json)
+  {
+    if ((s = cupsJSONExportString(root)) != NULL)
+    {
+      puts(s);
+      free(s);
+    }
 
-    read_secs    = get_time();
-    pass_secs[i] = read_secs - start_secs;
-    printf(" %.3f read, %.3f total\n", read_secs - write_secs, pass_secs[i]);
+    cupsJSONDelete(root);
   }
 
-  printf("\nMedian Total Time: %.3f seconds per document\n",
-         compute_median(pass_secs));
+  free(bb.data);
+  free(buffer);
 
   return (0);
 }
 
 
 //
-// 'compute_median()' - Compute the median time for a test.
+// 'buffer_read_cb()' - Read raster data from a memory buffer.
+//
+
+static ssize_t				// O - Number of bytes read
+buffer_read_cb(bench_buffer_t *bb,	// I - Memory buffer
+               unsigned char  *buffer,	// I - Read buffer
+               size_t         bytes)	// I - Maximum number of bytes to read
+{
+  if (bytes > (bb->used - bb->offset))
+    bytes = bb->used - bb->offset;
+
+  memcpy(buffer, bb->data + bb->offset, bytes);
+  bb->offset += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+//
+// 'buffer_write_cb()' - Write raster data to a memory buffer.
+//
+
+static ssize_t				// O - Number of bytes written or `-1` on error
+buffer_write_cb(bench_buffer_t *bb,	// I - Memory buffer
+                unsigned char  *buffer,	// I - Write buffer
+                size_t         bytes)	// I - Number of bytes to write
+{
+  if ((bb->used + bytes) > bb->alloc)
+  {
+    // Grow the buffer...
+    size_t	alloc = bb->alloc ? 2 * bb->alloc : 1048576;
+					// New allocation
+    unsigned char *data;		// New buffer data
+
+    while (alloc < (bb->used + bytes))
+      alloc *= 2;
+
+    if ((data = realloc(bb->data, alloc)) == NULL)
+      return (-1);
+
+    bb->data  = data;
+    bb->alloc = alloc;
+  }
+
+  memcpy(bb->data + bb->used, buffer, bytes);
+  bb->used += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+//
+// 'compute_stats()' - Compute the timing statistics for a test.
 //
 
-static double				// O - Median time in seconds
-compute_median(double *secs)		// I - Array of time samples
+static void
+compute_stats(double        *secs,	// I - Array of time samples
+              int           num_secs,	// I - Number of samples
+              bench_stats_t *stats)	// O - Statistics
 {
   int		i, j;			// Looping vars
   double	temp;			// Swap variable
 
 
   // Sort the array into ascending order using a quicky bubble sort...
-  for (i = 0; i < (TEST_PASSES - 1); i ++)
+  for (i = 0; i < (num_secs - 1); i ++)
   {
-    for (j = i + 1; j < TEST_PASSES; j ++)
+    for (j = i + 1; j < num_secs; j ++)
     {
       if (secs[i] > secs[j])
       {
@@ -126,177 +505,271 @@ compute_median(double *secs)		// I - Array of time samples
     }
   }
 
-  // Return the average of the middle two samples...
-  return (0.5 * (secs[TEST_PASSES / 2 - 1] + secs[TEST_PASSES / 2]));
+  // Use the nearest-rank method for percentiles...
+  stats->min = secs[0];
+  stats->max = secs[num_secs - 1];
+  stats->p90 = secs[(90 * num_secs + 99) / 100 - 1];
+  stats->p95 = secs[(95 * num_secs + 99) / 100 - 1];
+
+  if (num_secs & 1)
+    stats->median = secs[num_secs / 2];
+  else
+    stats->median = 0.5 * (secs[num_secs / 2 - 1] + secs[num_secs / 2]);
 }
 
 
 //
-// 'get_time()' - Get the current time in seconds.
+// 'json_add_stats()' - Add timing statistics to the JSON output.
 //
 
-static double				// O - Time in seconds
-get_time(void)
+static void
+json_add_stats(cups_json_t   *parent,	// I - Parent object
+               const char    *key,	// I - Key for statistics
+               bench_stats_t *stats,	// I - Statistics
+               double        mbytes)	// I - Megabytes per document
 {
-  struct timeval	curtime;	// Current time
+  cups_json_t	*obj;			// Statistics object
+
 
+  obj = cupsJSONNew(parent, cupsJSONNewKey(parent, /*after*/NULL, key), CUPS_JTYPE_OBJECT);
 
-  gettimeofday(&curtime, NULL);
-  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+  cupsJSONNewNumber(obj, cupsJSONNewKey(obj, /*after*/NULL, "min-ms"), 1000.0 * stats->min);
+  cupsJSONNewNumber(obj, cupsJSONNewKey(obj, /*after*/NULL, "median-ms"), 1000.0 * stats->median);
+  cupsJSONNewNumber(obj, cupsJSONNewKey(obj, /*after*/NULL, "p90-ms"), 1000.0 * stats->p90);
+  cupsJSONNewNumber(obj, cupsJSONNewKey(obj, /*after*/NULL, "p95-ms"), 1000.0 * stats->p95);
+  cupsJSONNewNumber(obj, cupsJSONNewKey(obj, /*after*/NULL, "max-ms"), 1000.0 * stats->max);
+  cupsJSONNewNumber(obj, cupsJSONNewKey(obj, /*after*/NULL, "mib-per-sec"), stats->median > 0.0 ? mbytes / stats->median : 0.0);
 }
 
 
 //
-// 'read_test()' - Benchmark the raster read functions.
+// 'make_content()' - Make the lines for a page of content.
+//
+// The "text" content has lines of glyph-like runs with white leading, "photo"
+// content has a noisy gradient that changes on every line, and "blank" content
+// is white except for a header and footer line of text.
 //
 
-static void
-read_test(int fd)			// I - File descriptor to read from
+static unsigned char **			// O - Array of line pointers or `NULL` on error
+make_content(
+    const char         *content,	// I - Content name
+    cups_page_header_t *header,		// I - Page header
+    unsigned char      **pool)		// O - Pool of distinct lines
 {
-  unsigned		y;		// Looping var
-  cups_raster_t		*r;		// Raster stream
-  cups_page_header_t	header;		// Page header
-  unsigned char		buffer[8 * TEST_WIDTH];
-					// Read buffer
-
-
-  // Test read speed...
-  if ((r = cupsRasterOpen(fd, CUPS_RASTER_READ)) == NULL)
+  unsigned		x, y,		// Looping vars
+			count,		// Number of bytes in run
+			bpl = header->cupsBytesPerLine,
+					// Bytes per line
+			text_height,	// Height of a line of text
+			top;		// Top/bottom margin
+  unsigned char		**lines,	// Lines for the page
+			*white,		// White line
+			*text,		// Text lines
+			*photo,		// Photo lines
+			wvalue;		// White pixel value
+
+
+  // Allocate memory...
+  if ((lines = calloc(header->cupsHeight, sizeof(unsigned char *))) == NULL)
+    return (NULL);
+
+  if ((*pool = malloc((size_t)bpl * (1 + BENCH_TEXT_ROWS + BENCH_PHOTO_ROWS))) == NULL)
   {
-    perror("Unable to create raster input stream");
-    return;
+    free(lines);
+    return (NULL);
   }
 
-  while (cupsRasterReadHeader(r, &header))
+  white = *pool;
+  text  = white + bpl;
+  photo = text + bpl * BENCH_TEXT_ROWS;
+
+  // Generate the line pool...
+  switch (header->cupsColorSpace)
   {
-    for (y = 0; y < header.cupsHeight; y ++)
-      cupsRasterReadPixels(r, buffer, header.cupsBytesPerLine);
+    case CUPS_CSPACE_W :
+    case CUPS_CSPACE_SW :
+    case CUPS_CSPACE_RGB :
+    case CUPS_CSPACE_SRGB :
+    case CUPS_CSPACE_ADOBERGB :
+        wvalue = 0xff;
+        break;
+    default :
+        wvalue = 0x00;
+        break;
   }
 
-  cupsRasterClose(r);
-}
+  memset(white, wvalue, bpl);
 
+  for (y = 0; y < BENCH_TEXT_ROWS; y ++)
+  {
+    unsigned char *row = text + y * bpl;// Current text row
 
-//
-// 'run_read_test()' - Run the read test as a child process via pipes.
-//
+    memset(row, wvalue, bpl);
 
-static int				// O - Standard input of child
-run_read_test(void)
-{
-  int	ras_pipes[2];			// Raster data pipes
-  int	pid;				// Child process ID
+    for (x = cupsGetRand() & 127, count = (cupsGetRand() & 15) + 1; x < bpl; x ++, count --)
+    {
+      if (count == 0)
+      {
+	x     += (cupsGetRand() & 15) + 1;
+	count = (cupsGetRand() & 15) + 1;
 
+        if (x >= bpl)
+	  break;
+      }
 
-  if (pipe(ras_pipes))
-    return (-1);
+      row[x] = (unsigned char)(wvalue ^ (cupsGetRand() | 0x80));
+    }
+  }
 
-  if ((pid = fork()) < 0)
+  for (y = 0; y < BENCH_PHOTO_ROWS; y ++)
   {
-    // Fork error - return -1 on error...
-    close(ras_pipes[0]);
-    close(ras_pipes[1]);
+    unsigned char *row = photo + y * bpl;// Current photo row
 
-    return (-1);
+    for (x = 0; x < bpl; x ++)
+      row[x] = (unsigned char)(x * 256 / bpl + 2 * y + (cupsGetRand() & 15));
   }
-  else if (pid == 0)
-  {
-    // Child comes here - read data from the input pipe...
-    close(ras_pipes[1]);
-    read_test(ras_pipes[0]);
-    exit(0);
-  }
-  else
+
+  // Then lay out the page...
+  if ((text_height = header->HWResolution[1] / 6) < 2)
+    text_height = 2;			// 12pt text with 1.2x leading
+
+  top = header->HWResolution[1] / 2;	// 1/2" top and bottom margins
+
+  for (y = 0; y < header->cupsHeight; y ++)
   {
-    // Parent comes here - return the output pipe...
-    close(ras_pipes[0]);
-    return (ras_pipes[1]);
+    if (!strcmp(content, "photo"))
+    {
+      lines[y] = photo + (y % BENCH_PHOTO_ROWS) * bpl;
+    }
+    else if (y < top || (y + top) >= header->cupsHeight)
+    {
+      lines[y] = white;
+    }
+    else if (!strcmp(content, "blank") && (y - top) >= text_height && (y + top + text_height) < header->cupsHeight)
+    {
+      lines[y] = white;
+    }
+    else if (((y - top) % text_height) < (5 * text_height / 6))
+    {
+      lines[y] = text + (y % BENCH_TEXT_ROWS) * bpl;
+    }
+    else
+    {
+      lines[y] = white;
+    }
   }
+
+  return (lines);
 }
 
 
 //
-// 'write_test()' - Benchmark the raster write functions.
+// 'read_test()' - Benchmark the raster read functions.
 //
 
-static void
-write_test(int                fd,	// I - File descriptor to write to
-           cups_raster_mode_t mode)	// I - Write mode
+static bool				// O - `true` on success, `false` on error
+read_test(bench_buffer_t *bb,		// I - Memory buffer
+          unsigned char  *buffer,	// I - Line buffer
+          int            num_pages)	// I - Expected number of pages
 {
-  unsigned		page, x, y;	// Looping vars
-  unsigned		count;		// Number of bytes to set
+  int			pages = 0;	// Number of pages read
+  unsigned		y;		// Looping var
   cups_raster_t		*r;		// Raster stream
   cups_page_header_t	header;		// Page header
-  unsigned char		data[32][8 * TEST_WIDTH];
-					// Raster data to write
+  bool			ret = true;	// Return value
+
 
+  bb->offset = 0;
 
-  // Create a combination of random data and repeated data to simulate
-  // text with some whitespace.
-  memset(data, 0, sizeof(data));
+  if ((r = cupsRasterOpenIO((cups_raster_cb_t)buffer_read_cb, bb, CUPS_RASTER_READ)) == NULL)
+    return (false);
 
-  for (y = 0; y < 28; y ++)
+  while (ret && cupsRasterReadHeader(r, &header))
   {
-    for (x = cupsGetRand() & 127, count = (cupsGetRand() & 15) + 1;
-         x < sizeof(data[0]);
-         x ++, count --)
+    pages ++;
+
+    for (y = 0; y < header.cupsHeight; y ++)
     {
-      if (count <= 0)
+      if (cupsRasterReadPixels(r, buffer, header.cupsBytesPerLine) != header.cupsBytesPerLine)
       {
-	x     += (cupsGetRand() & 15) + 1;
-	count = (cupsGetRand() & 15) + 1;
-
-        if (x >= sizeof(data[0]))
-	  break;
+        ret = false;
+        break;
       }
-
-      data[y][x] = (unsigned char)cupsGetRand();
     }
   }
 
-  // Test write speed...
-  if ((r = cupsRasterOpen(fd, mode)) == NULL)
-  {
-    perror("Unable to create raster output stream");
-    return;
-  }
+  cupsRasterClose(r);
 
-  for (page = 0; page < TEST_PAGES; page ++)
-  {
-    memset(&header, 0, sizeof(header));
-    header.cupsWidth        = TEST_WIDTH;
-    header.cupsHeight       = TEST_HEIGHT;
-    header.cupsBytesPerLine = TEST_WIDTH;
+  // Make sure every page was decoded...
+  return (ret && pages == num_pages);
+}
 
-    if (page & 1)
-    {
-      header.cupsBytesPerLine *= 4;
-      header.cupsColorSpace = CUPS_CSPACE_CMYK;
-      header.cupsColorOrder = CUPS_ORDER_CHUNKED;
-    }
-    else
-    {
-      header.cupsColorSpace = CUPS_CSPACE_K;
-      header.cupsColorOrder = CUPS_ORDER_BANDED;
-    }
 
-    if (page & 2)
+//
+// 'usage()' - Show program usage.
+//
+
+static int				// O - Exit status
+usage(FILE *out)			// I - Output file
+{
+  fputs("Usage: rasterbench [OPTIONS]\n", out);
+  fputs("Options:\n", out);
+  fputs("  --help         Show program help.\n", out);
+  fputs("  -c CONTENT     Content to test ('all', 'blank', 'photo', or 'text').\n", out);
+  fputs("  -j             Produce JSON output.\n", out);
+  fputs("  -m MEDIA       PWG media size name (default 'na_letter_8.5x11in').\n", out);
+  fputs("  -n PASSES      Number of passes to run for each test (default 10).\n", out);
+  fputs("  -o MODE        Raster mode ('all', 'apple', 'compressed', 'cups', or 'pwg').\n", out);
+  fputs("  -p PAGES       Number of pages per document (default 4).\n", out);
+  fputs("  -r RES         Resolution in DPI ('RES' or 'XRESxYRES', default 300).\n", out);
+  fputs("  -t TYPE        PWG raster type (default 'sgray_8').\n", out);
+  fputs("  -z             Same as '-o compressed'.\n", out);
+
+  return (out == stdout ? 0 : 1);
+}
+
+
+//
+// 'write_test()' - Benchmark the raster write functions.
+//
+
+static bool				// O - `true` on success, `false` on error
+write_test(bench_buffer_t     *bb,	// I - Memory buffer
+           cups_raster_mode_t mode,	// I - Write mode
+           cups_page_header_t *header,	// I - Page header
+           unsigned char      **lines,	// I - Lines for each page
+           int                num_pages)// I - Number of pages
+{
+  int			page;		// Current page
+  unsigned		y;		// Looping var
+  cups_raster_t		*r;		// Raster stream
+  bool			ret = true;	// Return value
+
+
+  bb->used = 0;
+
+  if ((r = cupsRasterOpenIO((cups_raster_cb_t)buffer_write_cb, bb, mode)) == NULL)
+    return (false);
+
+  for (page = 0; ret && page < num_pages; page ++)
+  {
+    if (!cupsRasterWriteHeader(r, header))
     {
-      header.cupsBytesPerLine *= 2;
-      header.cupsBitsPerColor = 16;
-      header.cupsBitsPerPixel = (page & 1) ? 64 : 16;
+      ret = false;
+      break;
     }
-    else
+
+    for (y = 0; y < header->cupsHeight; y ++)
     {
-      header.cupsBitsPerColor = 8;
-      header.cupsBitsPerPixel = (page & 1) ? 32 : 8;
+      if (cupsRasterWritePixels(r, lines[y], header->cupsBytesPerLine) != header->cupsBytesPerLine)
+      {
+        ret = false;
+        break;
+      }
     }
-
-    cupsRasterWriteHeader(r, &header);
-
-    for (y = 0; y < TEST_HEIGHT; y ++)
-      cupsRasterWritePixels(r, data[y & 31], header.cupsBytesPerLine);
   }
 
   cupsRasterClose(r);
+
+  return (ret);
 }
@@ -255,6 +255,11 @@ main(int  argc,				// I - Number of command-line arguments
   off_t		length, total;		// Length and total bytes
   time_t	start, current;		// Start and end time
   const char	*encoding;		// Negotiated Content-Encoding
+  int		lfd;			// Listening socket
+  http_addr_t	laddr;			// Listening address
+  socklen_t	laddrlen;		// Length of listening address
+  http_t	*client;		// Client side of loopback connection
+  http_state_t	state;			// HTTP state
   static const char * const uri_status_strings[] =
   {					// URI encode/decode status strings
     "HTTP_URI_STATUS_OVERFLOW",
@@ -476,6 +481,63 @@ main(int  argc,				// I - Number of command-line arguments
     else
       testEndMessage(true, "%s", buffer);
 
+    // httpWaitRequest()
+    testBegin("httpWaitRequest(NULL)");
+    if ((state = httpWaitRequest(NULL, buffer, sizeof(buffer), 100)) == HTTP_STATE_ERROR)
+    {
+      testEnd(true);
+    }
+    else
+    {
+      testEndMessage(false, "got %s", httpStateString(state));
+      failures ++;
+    }
+
+    testBegin("httpWaitRequest(loopback)");
+    lfd    = -1;
+    http   = NULL;
+    client = NULL;
+
+    if ((addrlist = httpAddrGetList("127.0.0.1", AF_INET, "0")) == NULL || (lfd = httpAddrListen(&addrlist->addr, 0)) < 0)
+    {
+      testEndMessage(false, "%s", cupsGetErrorString());
+      failures ++;
+    }
+    else
+    {
+      laddrlen = sizeof(laddr);
+      if (getsockname(lfd, (struct sockaddr *)&laddr, &laddrlen) || (client = httpConnect("127.0.0.1", httpAddrGetPort(&laddr), NULL, AF_INET, HTTP_ENCRYPTION_NEVER, true, 10000, NULL)) == NULL || (http = httpAcceptConnection(lfd, true)) == NULL)
+      {
+	testEndMessage(false, "%s", cupsGetErrorString());
+	failures ++;
+      }
+      else if ((state = httpWaitRequest(http, buffer, sizeof(buffer), 100)) != HTTP_STATE_WAITING)
+      {
+	testEndMessage(false, "got %s before request", httpStateString(state));
+	failures ++;
+      }
+      else if (httpPrintf(client, "\r\nGET /test HTTP/1.1\r\nHost: localhost\r\n\r\n") < 0 || httpFlushWrite(client) < 0)
+      {
+	testEndMessage(false, "unable to send request");
+	failures ++;
+      }
+      else if ((state = httpWaitRequest(http, buffer, sizeof(buffer), 10000)) != HTTP_STATE_GET || strcmp(buffer, "/test"))
+      {
+	testEndMessage(false, "got %s for \"%s\"", httpStateString(state), buffer);
+	failures ++;
+      }
+      else
+      {
+	testEnd(true);
+      }
+
+      httpClose(client);
+      httpClose(http);
+      httpAddrClose(NULL, lfd);
+    }
+
+    httpAddrFreeList(addrlist);
+
     return (failures);
   }
   else if (strstr(argv[1], "._tcp"))
@@ -288,6 +288,7 @@ void	print_attributes(ipp_t *ipp, int indent);
 ssize_t	read_cb(_ippdata_t *data, ipp_uchar_t *buffer, size_t bytes);
 ssize_t	read_hex(cups_file_t *fp, ipp_uchar_t *buffer, size_t bytes);
 int	test_file(const char *color);
+int	test_tokens(const char *filename);
 bool	token_cb(ipp_file_t *f, void *user_data, const char *token);
 ssize_t	write_cb(_ippdata_t *data, ipp_uchar_t *buffer, size_t bytes);
 
@@ -924,6 +925,8 @@ main(int  argc,				// I - Number of command-line arguments
     // Test ippFile API...
     status |= test_file(/*color*/NULL);
     status |= test_file("blue");
+    status |= test_tokens("testipp.test");
+    status |= test_tokens("../examples/ipp-2.0.test");
 
     // Test ippDateToTime and ippTimeToDate
     testBegin("ippDateToTime(1970/01/02T00:00:00Z)");
@@ -1375,6 +1378,143 @@ test_file(const char *color)		// I - Media color or `NULL` for default
 }
 
 
+
+//
+// 'test_tokens()' - Test that pre-read tokens match the file tokens.
+//
+// The file is read using both @link ippFileOpen@ and `_ippFileOpenTokens`,
+// comparing each token and line number and rewinding once using
+// @link ippFileSavePosition@ and @link ippFileRestorePosition@.
+//
+
+int					// O - Status
+test_tokens(const char *filename)	// I - Test file
+{
+  int		status = 0;		// Status
+  _ipp_ftokens_t	*tokens;	// Pre-read tokens
+  ipp_file_t	*ffile = NULL,		// IPP file read from disk
+		*tfile = NULL;		// IPP file read from tokens
+  bool		fret,			// Got a file token?
+		tret;			// Got a pre-read token?
+  char		ftoken[1024],		// File token
+		ttoken[1024],		// Pre-read token
+		saved[1024] = "";	// Token after saved position
+  int		count = 0,		// Number of tokens
+		restored = 0;		// 0 = not yet, 1 = just restored, 2 = checked
+
+
+  testBegin("_ippFileTokensNew(\"%s\")", filename);
+  if ((tokens = _ippFileTokensNew(filename)) != NULL)
+  {
+    testEnd(true);
+  }
+  else
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    return (1);
+  }
+
+  testBegin("_ippFileOpenTokens(\"%s\")", filename);
+  ffile = ippFileNew(/*parent*/NULL, /*attr_cb*/NULL, /*error_cb*/NULL, /*cb_data*/NULL);
+  tfile = ippFileNew(/*parent*/NULL, /*attr_cb*/NULL, /*error_cb*/NULL, /*cb_data*/NULL);
+
+  if (!ippFileOpen(ffile, filename, "r") || !_ippFileOpenTokens(tfile, tokens))
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    status = 1;
+    goto done;
+  }
+
+  for (;;)
+  {
+    fret = ippFileReadToken(ffile, ftoken, sizeof(ftoken));
+    tret = ippFileReadToken(tfile, ttoken, sizeof(ttoken));
+
+    if (fret != tret)
+    {
+      testEndMessage(false, "token %d: got %s, expected %s", count + 1, tret ? "a token" : "EOF", fret ? "a token" : "EOF");
+      status = 1;
+      break;
+    }
+    else if (!fret)
+    {
+      break;
+    }
+    else if (strcmp(ftoken, ttoken))
+    {
+      testEndMessage(false, "token %d: got \"%s\", expected \"%s\"", count + 1, ttoken, ftoken);
+      status = 1;
+      break;
+    }
+    else if (ippFileGetLineNumber(ffile) != ippFileGetLineNumber(tfile))
+    {
+      testEndMessage(false, "token %d: got line %d, expected line %d", count + 1, ippFileGetLineNumber(tfile), ippFileGetLineNumber(ffile));
+      status = 1;
+      break;
+    }
+
+    count ++;
+
+    if (restored == 1)
+    {
+      // Make sure we went back to the saved position...
+      if (strcmp(ftoken, saved))
+      {
+        testEndMessage(false, "got \"%s\" after restore, expected \"%s\"", ftoken, saved);
+        status = 1;
+        break;
+      }
+
+      restored = 2;
+    }
+    else if (count == 5 && !restored)
+    {
+      if (!ippFileSavePosition(ffile) || !ippFileSavePosition(tfile))
+      {
+        testEndMessage(false, "ippFileSavePosition failed");
+        status = 1;
+        break;
+      }
+    }
+    else if (count == 6 && !restored)
+    {
+      cupsCopyString(saved, ftoken, sizeof(saved));
+    }
+    else if (count == 9 && !restored)
+    {
+      if (!ippFileRestorePosition(ffile) || !ippFileRestorePosition(tfile))
+      {
+        testEndMessage(false, "ippFileRestorePosition failed");
+        status = 1;
+        break;
+      }
+
+      restored = 1;
+    }
+  }
+
+  if (!status)
+  {
+    if (restored == 2)
+    {
+      testEndMessage(true, "%d tokens", count);
+    }
+    else
+    {
+      testEndMessage(false, "only %d tokens", count);
+      status = 1;
+    }
+  }
+
+  done:
+
+  ippFileDelete(ffile);
+  ippFileDelete(tfile);
+  _ippFileTokensDelete(tokens);
+
+  return (status);
+}
+
 //
 // 'token_cb()' - Token callback for ASCII IPP data file parser.
 //
@@ -18,6 +18,8 @@
 // Local functions...
 //
 
+static int	do_copy_tests(cups_raster_mode_t mode);
+static int	do_passthrough_test(void);
 static int	do_ras_file(const char *filename);
 static int	do_raster_tests(cups_raster_mode_t mode);
 static void	print_changes(cups_page_header_t *header, cups_page_header_t *expected);
@@ -36,10 +38,14 @@ main(int  argc,				// I - Number of command-line args
 
   if (argc == 1)
   {
-    errors += do_raster_tests(CUPS_RASTER_WRITE);
-    errors += do_raster_tests(CUPS_RASTER_WRITE_COMPRESSED);
-    errors += do_raster_tests(CUPS_RASTER_WRITE_PWG);
-    errors += do_raster_tests(CUPS_RASTER_WRITE_APPLE);
+    cups_raster_mode_t	mode;		// Current write mode
+
+    for (mode = CUPS_RASTER_WRITE; mode <= CUPS_RASTER_WRITE_APPLE; mode ++)
+      errors += do_raster_tests(mode);
+
+    errors += do_copy_tests(CUPS_RASTER_WRITE_PWG);
+    errors += do_copy_tests(CUPS_RASTER_WRITE_APPLE);
+    errors += do_passthrough_test();
   }
   else
   {
@@ -53,6 +59,236 @@ main(int  argc,				// I - Number of command-line args
 }
 
 
+//
+// 'do_copy_tests()' - Test copying of raster data from "test.raster".
+//
+
+static int				// O - Number of errors
+do_copy_tests(cups_raster_mode_t mode)	// I - Write mode
+{
+  unsigned		pages = 0,	// Number of pages
+			y;		// Looping var
+  int			srcfd,		// Source file
+			dstfd;		// Destination file
+  cups_raster_t		*src,		// Source raster stream
+			*dst;		// Destination raster stream
+  cups_page_header_t	header,		// Source page header
+			copyheader;	// Copied page header
+  unsigned char		data[2048],	// Source raster data
+			copydata[2048];	// Copied raster data
+  int			errors = 0;	// Number of errors
+
+
+  testBegin("cupsRasterCopyPage(%s)", mode == CUPS_RASTER_WRITE_PWG ? "CUPS_RASTER_WRITE_PWG" : "CUPS_RASTER_WRITE_APPLE");
+
+  // Copy all of the pages...
+  if ((srcfd = open("test.raster", O_RDONLY)) < 0 || (dstfd = open("test-copy.raster", O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+  {
+    testEndMessage(false, "%s", strerror(errno));
+    if (srcfd >= 0)
+      close(srcfd);
+    return (1);
+  }
+
+  src = cupsRasterOpen(srcfd, CUPS_RASTER_READ);
+  dst = cupsRasterOpen(dstfd, mode);
+
+  while (src && dst && cupsRasterReadHeader(src, &header))
+  {
+    pages ++;
+
+    if (!cupsRasterWriteHeader(dst, &header) || !cupsRasterCopyPage(src, dst))
+    {
+      testEndMessage(false, "page %u: %s", pages, cupsRasterGetErrorString());
+      errors ++;
+      break;
+    }
+  }
+
+  cupsRasterClose(src);
+  cupsRasterClose(dst);
+  close(srcfd);
+  close(dstfd);
+
+  if (errors)
+    return (errors);
+
+  // Then compare the copy against the original...
+  srcfd = open("test.raster", O_RDONLY);
+  dstfd = open("test-copy.raster", O_RDONLY);
+  src   = cupsRasterOpen(srcfd, CUPS_RASTER_READ);
+  dst   = cupsRasterOpen(dstfd, CUPS_RASTER_READ);
+
+  for (pages = 0; src && dst && cupsRasterReadHeader(src, &header); pages ++)
+  {
+    if (!cupsRasterReadHeader(dst, &copyheader))
+    {
+      testEndMessage(false, "page %u missing", pages + 1);
+      errors ++;
+      break;
+    }
+
+    if (copyheader.cupsBytesPerLine != header.cupsBytesPerLine || copyheader.cupsHeight != header.cupsHeight || copyheader.cupsColorSpace != header.cupsColorSpace)
+    {
+      testEndMessage(false, "page %u header differs", pages + 1);
+      errors ++;
+      break;
+    }
+
+    for (y = 0; y < header.cupsHeight; y ++)
+    {
+      if (!cupsRasterReadPixels(src, data, header.cupsBytesPerLine) || !cupsRasterReadPixels(dst, copydata, header.cupsBytesPerLine) || memcmp(data, copydata, header.cupsBytesPerLine))
+        break;
+    }
+
+    if (y < header.cupsHeight)
+    {
+      testEndMessage(false, "page %u raster line %u differs", pages + 1, y);
+      errors ++;
+      break;
+    }
+  }
+
+  if (!src || !dst || (!errors && pages != 4))
+  {
+    testEndMessage(false, "%s", cupsRasterGetErrorString());
+    errors ++;
+  }
+  else if (!errors)
+  {
+    testEnd(true);
+  }
+
+  cupsRasterClose(src);
+  cupsRasterClose(dst);
+  close(srcfd);
+  close(dstfd);
+  unlink("test-copy.raster");
+
+  return (errors);
+}
+
+
+//
+// 'do_passthrough_test()' - Test that compressed raster data is copied as-is.
+//
+// The source file encodes each line as literal pixels rather than runs, which
+// the raster encoder would never produce, so the copy only matches the source
+// byte for byte if the compressed line data was passed through.
+//
+
+static int				// O - Number of errors
+do_passthrough_test(void)
+{
+  int			fd,		// Source file
+			dstfd;		// Destination file
+  cups_raster_t		*src,		// Source raster stream
+			*dst;		// Destination raster stream
+  cups_page_header_t	header;		// Page header
+  unsigned char		srcbuf[4096],	// Source file data
+			dstbuf[4096];	// Copied file data
+  ssize_t		srclen,		// Length of source file
+			dstlen;		// Length of copied file
+  bool			ret = false;	// Did the copy succeed?
+  static const unsigned char lines[] =	// Literal-encoded raster lines
+  {
+    0x00, 0xf9, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x00, 0xf9, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40
+  };
+
+
+  testBegin("cupsRasterCopyPage(passthrough)");
+
+  // Write a PWG raster file with literal-encoded lines...
+  memset(&header, 0, sizeof(header));
+  header.HWResolution[0]  = 300;
+  header.HWResolution[1]  = 300;
+  header.cupsWidth        = 8;
+  header.cupsHeight       = 2;
+  header.cupsBitsPerColor = 8;
+  header.cupsBitsPerPixel = 8;
+  header.cupsBytesPerLine = 8;
+  header.cupsColorOrder   = CUPS_ORDER_CHUNKED;
+  header.cupsColorSpace   = CUPS_CSPACE_SW;
+  header.cupsNumColors    = 1;
+
+  if ((fd = open("test-literal.raster", O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+  {
+    testEndMessage(false, "%s", strerror(errno));
+    return (1);
+  }
+
+  if ((src = cupsRasterOpen(fd, CUPS_RASTER_WRITE_PWG)) != NULL && cupsRasterWriteHeader(src, &header))
+    ret = write(fd, lines, sizeof(lines)) == (ssize_t)sizeof(lines);
+
+  cupsRasterClose(src);
+  close(fd);
+
+  if (!ret)
+  {
+    testEndMessage(false, "unable to write test-literal.raster");
+    unlink("test-literal.raster");
+    return (1);
+  }
+
+  // Copy it...
+  ret = false;
+
+  if ((fd = open("test-literal.raster", O_RDONLY)) >= 0)
+  {
+    src = cupsRasterOpen(fd, CUPS_RASTER_READ);
+
+    if ((dstfd = open("test-copy.raster", O_WRONLY | O_CREAT | O_TRUNC, 0666)) >= 0)
+    {
+      dst = cupsRasterOpen(dstfd, CUPS_RASTER_WRITE_PWG);
+      ret = src && dst && cupsRasterReadHeader(src, &header) && cupsRasterWriteHeader(dst, &header) && cupsRasterCopyPage(src, dst);
+
+      cupsRasterClose(dst);
+      close(dstfd);
+    }
+
+    cupsRasterClose(src);
+    close(fd);
+  }
+
+  if (!ret)
+  {
+    testEndMessage(false, "%s", cupsRasterGetErrorString());
+    unlink("test-literal.raster");
+    unlink("test-copy.raster");
+    return (1);
+  }
+
+  // Then compare the files...
+  srclen = dstlen = -1;
+
+  if ((fd = open("test-literal.raster", O_RDONLY)) >= 0)
+  {
+    srclen = read(fd, srcbuf, sizeof(srcbuf));
+    close(fd);
+  }
+
+  if ((fd = open("test-copy.raster", O_RDONLY)) >= 0)
+  {
+    dstlen = read(fd, dstbuf, sizeof(dstbuf));
+    close(fd);
+  }
+
+  unlink("test-literal.raster");
+  unlink("test-copy.raster");
+
+  if (srclen <= 0 || srclen != dstlen || memcmp(srcbuf, dstbuf, (size_t)srclen))
+  {
+    testEndMessage(false, "compressed data was re-encoded (%ld bytes, expected %ld)", (long)dstlen, (long)srclen);
+    return (1);
+  }
+
+  testEnd(true);
+
+  return (0);
+}
+
+
 //
 // 'do_ras_file()' - Test reading of a raster file.
 //
@@ -43,6 +43,9 @@ extern char **environ;
 #ifndef O_BINARY
 #  define O_BINARY 0			// Windows "binary file" nonsense
 #endif // !O_BINARY
+#ifndef O_CLOEXEC
+#  define O_CLOEXEC 0			// No atomic close-on-exec
+#endif // !O_CLOEXEC
 
 #ifdef HAVE_SYS_MOUNT_H
 #  include <sys/mount.h>
@@ -130,11 +133,74 @@ static const char * const ippeve_preason_strings[] =
 #define WEB_SCHEME "https"
 
 
+//
+// Number of milliseconds to wait for a request on an idle client connection...
+//
+
+#define IPPEVE_IDLE_TIMEOUT 30000
+
+
+//
+// Size of the job-id lookup hash...
+//
+
+#define IPPEVE_JOB_HASH_SIZE 1024
+
+
+//
+// Static resources served from memory...
+//
+
+typedef enum ippeve_resource_e		// Static resources
+{
+  IPPEVE_RESOURCE_ICON_SM,		// /icon-sm.png
+  IPPEVE_RESOURCE_ICON,			// /icon.png
+  IPPEVE_RESOURCE_ICON_LG,		// /icon-lg.png
+  IPPEVE_RESOURCE_STRINGS,		// /en.strings
+  IPPEVE_RESOURCE_MAX			// Number of static resources
+} ippeve_resource_t;
+
+
+//
+// Maximum number of environment variables for the print command...
+//
+
+#define IPPEVE_MAX_ENV	400
+
+
+//
+// PAM authentication cache limits...
+//
+
+#define IPPEVE_AUTH_CACHE_SIZE	64	// Number of cached authentications
+#define IPPEVE_AUTH_CACHE_TIME	60	// Seconds to cache a successful authentication
+#define IPPEVE_AUTH_FAIL_MAX	60	// Maximum seconds to reject a user after failures
+#define IPPEVE_AUTH_FAIL_RESET	300	// Seconds before past failures are forgotten
+
+
+//
+// Metrics limits...
+//
+
+#define IPPEVE_METRICS_BUCKETS	16	// Number of histogram buckets
+#define IPPEVE_METRICS_MAX_OP	(IPP_OP_GET_ENCRYPTED_JOB_ATTRIBUTES + 1)
+					// Number of tracked IPP operations
+
+
 //
 // Structures...
 //
 
 #if HAVE_LIBPAM
+typedef struct ippeve_authcache_s	// Authentication cache entry
+{
+  unsigned char	hmac[32];		// Salted HMAC of Authorization value
+  char		address[256],		// Client address
+		username[256];		// Username
+  int		failures;		// Number of failures (0 = success)
+  time_t	expires;		// Expiration time
+} ippeve_authcache_t;
+
 typedef struct ippeve_authdata_s	// Authentication data
 {
   char	username[256],	// Username string
@@ -142,12 +208,62 @@ typedef struct ippeve_authdata_s	// Authentication data
 } ippeve_authdata_t;
 #endif // HAVE_LIBPAM
 
+typedef struct ippeve_attrs_s		// Shared printer attributes
+{
+  int			use;		// Number of printers using the attributes
+  ipp_t			*attrs;		// Attributes
+} ippeve_attrs_t;
+
+typedef struct ippeve_env_s		// Cached print command environment
+{
+  int			use;		// Use count
+  int			num_vars;	// Number of environment variables
+  char			**vars;		// Environment variables
+} ippeve_env_t;
+
+typedef struct ippeve_cache_s		// Cached static resource
+{
+  int			use;		// Use count
+  time_t		mtime;		// Last modification time
+  off_t			size;		// File size
+  char			etag[33];	// Entity tag (hex hash of data)
+  bool			is_static;	// Data is compiled into the program?
+  const unsigned char	*data;		// Resource data
+  size_t		length;		// Length of data
+} ippeve_cache_t;
+
 typedef struct ippeve_filter_s		// Attribute filter
 {
   cups_array_t		*ra;		// Requested attributes
   ipp_tag_t		group_tag;	// Group to copy
 } ippeve_filter_t;
 
+typedef struct ippeve_histogram_s	// Latency histogram
+{
+  unsigned long long	count;		// Number of observations
+  double		sum;		// Sum of observations in seconds
+  unsigned long long	buckets[IPPEVE_METRICS_BUCKETS];
+					// Observations for each bucket
+} ippeve_histogram_t;
+
+typedef struct ippeve_metrics_s		// Server metrics
+{
+  cups_mutex_t		mutex;		// Metrics mutex
+  size_t		active_clients;	// Current number of connections
+  unsigned long long	clients,	// Total number of connections
+			http_requests[HTTP_STATE_MAX],
+					// HTTP requests for each method
+			ipp_status[3],	// IPP responses (successful, client-error, server-error)
+			documents,	// Number of documents received
+			document_bytes,	// Number of document bytes received
+			jobs[IPP_JSTATE_COMPLETED - IPP_JSTATE_PENDING + 1];
+					// Processed jobs for each final job-state
+  ippeve_histogram_t	http_seconds,	// HTTP request times
+			ipp_seconds[IPPEVE_METRICS_MAX_OP],
+					// IPP request times for each operation
+			job_seconds;	// Job processing times
+} ippeve_metrics_t;
+
 typedef struct ippeve_job_s ippeve_job_t;
 
 typedef struct ippeve_printer_s		// Printer data
@@ -155,6 +271,8 @@ typedef struct ippeve_printer_s		// Printer data
   // Note: A "real" IPP implementation will support more than one IPv4 and one IPv6 listener
   int			ipv4,		// IPv4 listener
 			ipv6;		// IPv6 listener
+  struct ippeve_printer_s *parent;	// Printer with the listeners, if virtual
+  cups_array_t		*printers;	// Virtual printers by resource path
   cups_dnssd_t		*dnssd;		// DNS-SD context
   cups_dnssd_service_t	*services;	// DNS-SD services
   char			*dnssd_subtypes;// DNS-SD subtypes
@@ -167,22 +285,43 @@ typedef struct ippeve_printer_s		// Printer data
 			*hostname,	// Hostname
 			*device_uri,	// Device URI (if any)
 			*output_format,	// Output format
-			*command;	// Command to run with job file
+			*command,	// Command to run with job file
+			*resource;	// Resource path for printer-uri
   int			port;		// Port
   bool			web_forms;	// Enable web interface forms?
+  bool			stream;		// Stream document data to the command?
   size_t		urilen;		// Length of printer URI
-  ipp_t			*attrs;		// Static attributes
+  ipp_t			*attrs;		// Static attributes (shared)
+  ippeve_attrs_t	*shared;	// Shared static attributes
+  ipp_t			*local_attrs;	// Static attributes for this printer
   time_t		start_time;	// Startup time
   time_t		config_time;	// printer-config-change-time
+  ippeve_env_t		*env;		// Cached environment for the command
   ipp_pstate_t		state;		// printer-state value
   ippeve_preason_t	state_reasons;	// printer-state-reasons values
   char			state_keywords[8][128];
 					// Extra printer-state-reasons keywords
   time_t		state_time;	// printer-state-change-time
-  cups_array_t		*jobs;		// Jobs
-  ippeve_job_t		*active_job;	// Current active/pending job
+  cups_array_t		*jobs,		// Jobs by job-id
+			*active_jobs,	// Not-completed jobs by job-id
+			*completed_jobs,// Completed jobs by completion time
+			*state_jobs[IPP_JSTATE_COMPLETED - IPP_JSTATE_PENDING + 1];
+					// Jobs for each job-state value
+  int			history_time;	// Seconds to keep completed jobs
+  size_t		history_count;	// Maximum number of completed jobs (0 = no limit)
   int			next_job_id;	// Next job-id value
   cups_rwlock_t		rwlock;		// Printer lock
+  cups_array_t		*pending_jobs;	// Jobs waiting for a worker
+  size_t		num_workers,	// Number of job worker threads
+			num_threads,	// Number of job worker threads started
+			busy_workers;	// Number of jobs being processed
+  bool			shutdown;	// Stop the job worker threads?
+  cups_mutex_t		job_mutex;	// Job queue mutex
+  cups_cond_t		job_cond;	// Job queue condition
+  cups_mutex_t		cache_mutex;	// Resource cache mutex
+  ippeve_cache_t	*cache[IPPEVE_RESOURCE_MAX];
+					// Cached static resources
+  ippeve_metrics_t	metrics;	// Server metrics
 } ippeve_printer_t;
 
 struct ippeve_job_s			// Job data
@@ -192,6 +331,7 @@ struct ippeve_job_s			// Job data
 			*username,	// job-originating-user-name
 			*format;	// document-format
   ipp_jstate_t		state;		// job-state value
+  int			priority;	// job-priority value
   char			*message;	// job-state-message value
   int			msglevel;	// job-state-message log level (0=error, 1=info)
   time_t		created,	// time-at-creation value
@@ -204,6 +344,8 @@ struct ippeve_job_s			// Job data
   int			cancel;		// Non-zero when job canceled
   char			*filename;	// Print file name
   int			fd;		// Print file descriptor
+  int			stream_fd;	// Document pipe for streamed jobs or -1
+  bool			stream_eof;	// All document data sent to the streamed command?
   ippeve_printer_t	*printer;	// Printer
 };
 
@@ -213,6 +355,7 @@ typedef struct ippeve_client_s		// Client data
   ipp_t			*request,	// IPP request
 			*response;	// IPP response
   time_t		start;		// Request start time
+  double		start_clock;	// Request start time for metrics
   http_state_t		operation;	// Request operation
   ipp_op_t		operation_id;	// IPP operation-id
   char			uri[1024],	// Request URI
@@ -231,11 +374,20 @@ typedef struct ippeve_client_s		// Client data
 // Local functions...
 //
 
+#if HAVE_LIBPAM
+static http_status_t	auth_cache_check(const unsigned char *hmac, const char *address, const char *username);
+static void		auth_cache_update(const unsigned char *hmac, const char *address, const char *username, bool success);
+#endif // HAVE_LIBPAM
 static http_status_t	authenticate_request(ippeve_client_t *client);
+static void		cancel_job(ippeve_job_t *job);
 static void		clean_jobs(ippeve_printer_t *printer);
+static int		compare_completed(ippeve_job_t *a, ippeve_job_t *b, void *data);
 static int		compare_jobs(ippeve_job_t *a, ippeve_job_t *b, void *data);
+static int		compare_pending(ippeve_job_t *a, ippeve_job_t *b, void *data);
+static int		compare_printers(ippeve_printer_t *a, ippeve_printer_t *b, void *data);
 static void		copy_attributes(ipp_t *to, ipp_t *from, cups_array_t *ra, ipp_tag_t group_tag, bool quickcopy);
 static void		copy_job_attributes(ippeve_client_t *client, ippeve_job_t *job, cups_array_t *ra);
+static bool		copy_printer_attrs(ippeve_printer_t *printer);
 static ippeve_client_t	*create_client(ippeve_printer_t *printer, int sock);
 static ippeve_job_t	*create_job(ippeve_client_t *client);
 static int		create_job_file(ippeve_job_t *job, char *fname, size_t fnamesize, const char *dir, const char *ext);
@@ -244,6 +396,8 @@ static ipp_t		*create_media_col(const char *media, const char *source, const cha
 static ipp_t		*create_media_size(int width, int length);
 static ipp_t		*create_media_size_range(int min_width, int max_width, int min_length, int max_length);
 static ippeve_printer_t	*create_printer(const char *servername, int serverport, const char *name, const char *location, const char *icons, const char *strings, cups_array_t *docformats, const char *subtypes, const char *directory, const char *command, const char *device_uri, const char *output_format, ipp_t *attrs);
+static ippeve_env_t	*create_printer_env(ippeve_printer_t *printer);
+static ippeve_printer_t	*create_virtual_printer(ippeve_printer_t *parent, const char *name);
 static void		debug_attributes(const char *title, ipp_t *ipp, int response);
 static void		delete_client(ippeve_client_t *client);
 static void		delete_job(ippeve_job_t *job);
@@ -251,14 +405,18 @@ static void		delete_printer(ippeve_printer_t *printer);
 static void		dnssd_callback(cups_dnssd_service_t *service, ippeve_printer_t *printer, cups_dnssd_flags_t flags);
 static int		filter_cb(ippeve_filter_t *filter, ipp_t *dst, ipp_attribute_t *attr);
 static ippeve_job_t	*find_job(ippeve_client_t *client);
+static ippeve_printer_t	*find_printer(ippeve_printer_t *printer, const char *resource, bool job);
 static void		finish_document_data(ippeve_client_t *client, ippeve_job_t *job);
 static void		finish_document_uri(ippeve_client_t *client, ippeve_job_t *job);
 static void		flush_document_data(ippeve_client_t *client);
+static ippeve_cache_t	*get_resource(ippeve_printer_t *printer, ippeve_resource_t resource);
+static size_t		hash_job(ippeve_job_t *job, void *data);
 static bool		have_document_data(ippeve_client_t *client);
 static bool		html_escape(ippeve_client_t *client, const char *s, size_t slen);
 static bool		html_footer(ippeve_client_t *client);
 static bool		html_header(ippeve_client_t *client, const char *title, int refresh);
 static bool		html_printf(ippeve_client_t *client, const char *format, ...) _CUPS_FORMAT(2, 3);
+static void		init_printer(ippeve_printer_t *printer);
 static void		ipp_cancel_job(ippeve_client_t *client);
 static void		ipp_cancel_jobs(ippeve_client_t *client);
 static void		ipp_close_job(ippeve_client_t *client);
@@ -274,6 +432,7 @@ static void		ipp_send_uri(ippeve_client_t *client);
 static void		ipp_validate_job(ippeve_client_t *client);
 static ipp_t		*load_ippfile_attributes(const char *servername, int serverport, const char *filename, cups_array_t *docformats);
 static ipp_t		*load_legacy_attributes(const char *make, const char *model, int ppm, int ppm_color, int duplex, cups_array_t *docformats);
+static bool		metrics_printf(ippeve_client_t *client, const char *format, ...) _CUPS_FORMAT(2, 3);
 #if HAVE_LIBPAM
 static int		pam_func(int, const struct pam_message **, struct pam_response **, void *);
 #endif // HAVE_LIBPAM
@@ -282,24 +441,37 @@ static void		process_attr_message(ippeve_job_t *job, char *message);
 static void		*process_client(ippeve_client_t *client);
 static int		process_http(ippeve_client_t *client);
 static int		process_ipp(ippeve_client_t *client);
-static void		*process_job(ippeve_job_t *job);
+static ipp_jstate_t	process_job(ippeve_job_t *job);
+static void		*process_jobs(ippeve_printer_t *printer);
 static void		process_state_message(ippeve_printer_t *printer, const char *message);
+static void		queue_job(ippeve_job_t *job);
 static bool		register_printer(ippeve_printer_t *printer);
+static void		release_printer_attrs(ippeve_attrs_t *shared);
+static void		release_printer_env(ippeve_env_t *env);
+static void		release_resource(ippeve_printer_t *printer, ippeve_cache_t *cache);
 static bool		respond_http(ippeve_client_t *client, http_status_t code, const char *content_coding, const char *type, size_t length);
 static void		respond_ignored(ippeve_client_t *client, ipp_attribute_t *attr);
 static void		respond_ipp(ippeve_client_t *client, ipp_status_t status, const char *message, ...) _CUPS_FORMAT(3, 4);
+static bool		respond_metrics(ippeve_client_t *client);
+static bool		respond_resource(ippeve_client_t *client, ippeve_resource_t resource);
 static void		respond_unsupported(ippeve_client_t *client, ipp_attribute_t *attr);
 static void		run_printer(ippeve_printer_t *printer);
+static void		set_job_state(ippeve_job_t *job, ipp_jstate_t state);
 static int		show_media(ippeve_client_t *client);
 static int		show_status(ippeve_client_t *client);
 static int		show_supplies(ippeve_client_t *client);
 #ifndef _WIN32
 static void		signal_handler(int signum);
 #endif // !_WIN32
+static int		stream_job(ippeve_job_t *job, const char *filename);
+static void		*stream_job_thread(ippeve_job_t *job);
 static char		*time_string(time_t tv, char *buffer, size_t bufsize);
+static void		update_histogram(ippeve_histogram_t *hist, double secs);
 static int		usage(FILE *out);
 static bool		valid_doc_attributes(ippeve_client_t *client);
 static bool		valid_job_attributes(ippeve_client_t *client);
+static void		wake_workers(ippeve_printer_t *printer);
+static bool		write_histogram(ippeve_client_t *client, const char *name, const char *help, const char *label, const char *value, ippeve_histogram_t *hist, bool header);
 
 
 //
@@ -312,6 +484,22 @@ static int		MaxVersion = 20,// Maximum IPP version (20 = 2.0, 11 = 1.1, etc.)
 			Verbosity = 0;	// Verbosity level
 static const char	*PAMService = NULL;
 					// PAM service
+static cups_mutex_t	AttrsMutex = CUPS_MUTEX_INITIALIZER;
+					// Mutex for shared printer attributes
+#if HAVE_LIBPAM
+static ippeve_authcache_t AuthCache[IPPEVE_AUTH_CACHE_SIZE];
+					// PAM authentication cache
+static cups_mutex_t	AuthCacheMutex = CUPS_MUTEX_INITIALIZER;
+					// Mutex for authentication cache
+static unsigned char	AuthCacheSalt[32];
+					// Salt for cached Authorization values
+static bool		AuthCacheSalted = false;
+					// Has the salt been initialized?
+#endif // HAVE_LIBPAM
+static const double	MetricsBuckets[IPPEVE_METRICS_BUCKETS] =
+{					// Histogram bucket limits in seconds
+  0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0, 300.0
+};
 #ifndef _WIN32
 static bool		StopPrinter = false;
 					// Stop the printer server?
@@ -343,9 +531,15 @@ main(int  argc,				// I - Number of command-line args
 		*subtypes = "_print";	// DNS-SD service subtype
   bool		legacy = false,		// Legacy mode?
 		duplex = false,		// Duplex mode
+		log_structured = false,	// Log key-value pairs?
+		stream = false,		// Stream document data to command?
 		web_forms = true;	// Enable web site forms?
   int		ppm = 10,		// Pages per minute for mono
-		ppm_color = 0;		// Pages per minute for color
+		ppm_color = 0,		// Pages per minute for color
+		workers = 1,		// Number of job worker threads
+		virtual_printers = 0,	// Number of virtual printers
+		history_count = 0,	// Maximum number of completed jobs
+		history_time = 60;	// Seconds to keep completed jobs
   ipp_t		*attrs = NULL;		// Printer attributes
   char		directory[1024] = "";	// Spool directory
   cups_array_t	*docformats = NULL;	// Supported formats
@@ -363,6 +557,51 @@ main(int  argc,				// I - Number of command-line args
     {
       return (usage(stdout));
     }
+    else if (!strcmp(argv[i], "--job-history-count"))
+    {
+      i ++;
+      if (i >= argc || !isdigit(argv[i][0] & 255))
+      {
+        cupsLangPrintf(stderr, _("%s: Missing number of jobs after '--job-history-count'."), "ippeveprinter");
+        return (usage(stderr));
+      }
+
+      history_count = atoi(argv[i]);
+    }
+    else if (!strcmp(argv[i], "--job-history-time"))
+    {
+      i ++;
+      if (i >= argc || !isdigit(argv[i][0] & 255))
+      {
+        cupsLangPrintf(stderr, _("%s: Missing number of seconds after '--job-history-time'."), "ippeveprinter");
+        return (usage(stderr));
+      }
+
+      history_time = atoi(argv[i]);
+    }
+    else if (!strcmp(argv[i], "--log-format"))
+    {
+      i ++;
+      if (i >= argc)
+      {
+        cupsLangPrintf(stderr, _("%s: Missing format after '--log-format'."), "ippeveprinter");
+        return (usage(stderr));
+      }
+
+      if (!strcmp(argv[i], "key-value"))
+      {
+        log_structured = true;
+      }
+      else if (!strcmp(argv[i], "text"))
+      {
+        log_structured = false;
+      }
+      else
+      {
+        cupsLangPrintf(stderr, _("%s: Unknown log format '%s'."), "ippeveprinter", argv[i]);
+        return (usage(stderr));
+      }
+    }
     else if (!strcmp(argv[i], "--no-web-forms"))
     {
       web_forms = false;
@@ -378,11 +617,33 @@ main(int  argc,				// I - Number of command-line args
 
       PAMService = argv[i];
     }
+    else if (!strcmp(argv[i], "--stream"))
+    {
+      stream = true;
+    }
     else if (!strcmp(argv[i], "--version"))
     {
       puts(LIBCUPS_VERSION);
       return (0);
     }
+    else if (!strcmp(argv[i], "--virtual-printers"))
+    {
+      i ++;
+      if (i >= argc || !isdigit(argv[i][0] & 255) || (virtual_printers = atoi(argv[i])) < 0)
+      {
+        cupsLangPrintf(stderr, _("%s: Missing number of printers after '--virtual-printers'."), "ippeveprinter");
+        return (usage(stderr));
+      }
+    }
+    else if (!strcmp(argv[i], "--workers"))
+    {
+      i ++;
+      if (i >= argc || (workers = atoi(argv[i])) < 1)
+      {
+        cupsLangPrintf(stderr, _("%s: Missing number of workers after '--workers'."), "ippeveprinter");
+        return (usage(stderr));
+      }
+    }
     else if (!strncmp(argv[i], "--", 2))
     {
       cupsLangPrintf(stderr, _("%s: Unknown option '%s'."), "ippeveprinter", argv[i]);
@@ -699,7 +960,11 @@ main(int  argc,				// I - Number of command-line args
   if ((printer = create_printer(servername, serverport, name, location, icon, strings, docformats, subtypes, directory, command, device_uri, output_format, attrs)) == NULL)
     return (1);
 
-  printer->web_forms = web_forms;
+  printer->web_forms     = web_forms;
+  printer->stream        = stream;
+  printer->num_workers   = (size_t)workers;
+  printer->history_count = (size_t)history_count;
+  printer->history_time  = history_time;
 
   cupsSetServerCredentials(keypath, printer->hostname, true);
 
@@ -715,16 +980,37 @@ main(int  argc,				// I - Number of command-line args
 
     if (!fp)
     {
-      perror(logfile);
+      _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to open log file \"%s\": %s", logfile, strerror(errno));
       return (1);
     }
 
     setbuf(fp, NULL);
   }
 
+  // Start buffered logging...
+  _cupsLogStart(fileno(stderr), Verbosity ? _CUPS_LOG_DEBUG : _CUPS_LOG_INFO, log_structured);
+
+  // Create any virtual printers...
+  for (i = 1; i <= virtual_printers; i ++)
+  {
+    char	vname[256];		// Virtual printer name
+
+    snprintf(vname, sizeof(vname), "%s-%d", name, i);
+
+    if (!create_virtual_printer(printer, vname))
+    {
+      _cupsLogStop();
+      delete_printer(printer);
+      return (1);
+    }
+  }
+
   // Run the print service...
   run_printer(printer);
 
+  // Flush any pending log messages...
+  _cupsLogStop();
+
   // Destroy the printer and exit...
   delete_printer(printer);
 
@@ -732,6 +1018,133 @@ main(int  argc,				// I - Number of command-line args
 }
 
 
+#if HAVE_LIBPAM
+//
+// 'auth_cache_check()' - Check the authentication cache.
+//
+// Returns `HTTP_STATUS_CONTINUE` if the credentials were recently verified,
+// `HTTP_STATUS_UNAUTHORIZED` if the user is being rate limited after failed
+// attempts from the client's address, or `HTTP_STATUS_NONE` if PAM needs to
+// verify the credentials.
+//
+
+static http_status_t			// O - Cached authentication status
+auth_cache_check(
+    const unsigned char *hmac,		// I - Salted HMAC of Authorization value
+    const char          *address,	// I - Client address
+    const char          *username)	// I - Username
+{
+  size_t		i;		// Looping var
+  ippeve_authcache_t	*entry;		// Current cache entry
+  time_t		now = time(NULL);
+					// Current time
+  http_status_t		status = HTTP_STATUS_NONE;
+					// Cached status
+
+
+  cupsMutexLock(&AuthCacheMutex);
+
+  for (i = 0, entry = AuthCache; i < IPPEVE_AUTH_CACHE_SIZE; i ++, entry ++)
+  {
+    if (entry->expires <= now)
+      continue;
+
+    if (!entry->failures && !memcmp(entry->hmac, hmac, sizeof(entry->hmac)))
+    {
+      // Credentials verified recently...
+      status = HTTP_STATUS_CONTINUE;
+      break;
+    }
+    else if (entry->failures && !strcmp(entry->username, username) && !strcmp(entry->address, address))
+    {
+      // Recent failures for this user and address, keep looking for a
+      // successful match...
+      status = HTTP_STATUS_UNAUTHORIZED;
+    }
+  }
+
+  cupsMutexUnlock(&AuthCacheMutex);
+
+  return (status);
+}
+
+
+//
+// 'auth_cache_update()' - Add an authentication result to the cache.
+//
+// Successful authentications are cached by the salted HMAC of the
+// Authorization value so that the password is never stored.  Failures are
+// tracked by client address and username and block further attempts for that
+// user from that address for 1, 2, 4, ... seconds, up to
+// `IPPEVE_AUTH_FAIL_MAX` seconds, so that failures from one client cannot lock
+// the user out everywhere else.
+//
+
+static void
+auth_cache_update(
+    const unsigned char *hmac,		// I - Salted HMAC of Authorization value
+    const char          *address,	// I - Client address
+    const char          *username,	// I - Username
+    bool                success)	// I - `true` if authentication succeeded
+{
+  size_t		i;		// Looping var
+  ippeve_authcache_t	*entry,		// Current cache entry
+			*failed = NULL,	// Failure entry for this user and address
+			*oldest = NULL;	// Entry that expires first
+  time_t		now = time(NULL);
+					// Current time
+
+
+  cupsMutexLock(&AuthCacheMutex);
+
+  for (i = 0, entry = AuthCache; i < IPPEVE_AUTH_CACHE_SIZE; i ++, entry ++)
+  {
+    if (entry->failures && !strcmp(entry->username, username) && !strcmp(entry->address, address))
+      failed = entry;
+    else if (!oldest || entry->expires < oldest->expires)
+      oldest = entry;
+  }
+
+  if (success)
+  {
+    // Forget any failures and cache the credentials...
+    entry = failed ? failed : oldest;
+
+    memcpy(entry->hmac, hmac, sizeof(entry->hmac));
+    cupsCopyString(entry->address, address, sizeof(entry->address));
+    cupsCopyString(entry->username, username, sizeof(entry->username));
+    entry->failures = 0;
+    entry->expires  = now + IPPEVE_AUTH_CACHE_TIME;
+  }
+  else
+  {
+    // Record the failure and reject the user for a while...
+    if ((entry = failed) != NULL && (now - entry->expires) < IPPEVE_AUTH_FAIL_RESET)
+    {
+      entry->failures ++;
+    }
+    else
+    {
+      if (!entry)
+        entry = oldest;
+
+      memset(entry->hmac, 0, sizeof(entry->hmac));
+      cupsCopyString(entry->address, address, sizeof(entry->address));
+      cupsCopyString(entry->username, username, sizeof(entry->username));
+      entry->failures = 1;
+    }
+
+    if (entry->failures > 6)
+      entry->expires = now + IPPEVE_AUTH_FAIL_MAX;
+    else
+      entry->expires = now + (1 << (entry->failures - 1));
+  }
+
+  cupsMutexUnlock(&AuthCacheMutex);
+}
+#endif // HAVE_LIBPAM
+
+
 //
 // 'authenticate_request()' - Try to authenticate the request.
 //
@@ -743,11 +1156,15 @@ authenticate_request(
 #if HAVE_LIBPAM
   // If PAM isn't enabled, return 'continue' now...
   const char		*authorization;	// Pointer into Authorization string
-  int			userlen;	// Username:password length
+  size_t		userlen;	// Username:password length
   pam_handle_t		*pamh;		// PAM authentication handle
   int			pamerr;		// PAM error code
   struct pam_conv	pamdata;	// PAM conversation data
   ippeve_authdata_t	data;		// Authentication data
+  unsigned char		hmac[32];	// Salted HMAC of Authorization value
+  bool			cached;		// Can the result be cached?
+  http_status_t		status;		// Cached authentication status
+  size_t		i;		// Looping var
 
 
   if (!PAMService)
@@ -761,20 +1178,33 @@ authenticate_request(
 
   if (strncmp(authorization, "Basic ", 6))
   {
-    fputs("Unsupported scheme in Authorization header.\n", stderr);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unsupported scheme in Authorization header.");
     return (HTTP_STATUS_BAD_REQUEST);
   }
 
+  // Compute a salted HMAC of the Authorization value for the cache...
+  cupsMutexLock(&AuthCacheMutex);
+  if (!AuthCacheSalted)
+  {
+    for (i = 0; i < sizeof(AuthCacheSalt); i ++)
+      AuthCacheSalt[i] = (unsigned char)cupsGetRand();
+
+    AuthCacheSalted = true;
+  }
+  cupsMutexUnlock(&AuthCacheMutex);
+
+  cached = cupsHMACData("sha2-256", AuthCacheSalt, sizeof(AuthCacheSalt), authorization, strlen(authorization), hmac, sizeof(hmac)) == (ssize_t)sizeof(hmac);
+
   authorization += 5;
   while (isspace(*authorization & 255))
     authorization ++;
 
   userlen = sizeof(data.username);
-  httpDecode64_2(data.username, &userlen, authorization);
+  httpDecode64(data.username, &userlen, authorization, NULL);
 
   if ((data.password = strchr(data.username, ':')) == NULL)
   {
-    fputs("No password in Authorization header.\n", stderr);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "No password in Authorization header.");
     return (HTTP_STATUS_BAD_REQUEST);
   }
 
@@ -782,29 +1212,43 @@ authenticate_request(
 
   if (!data.username[0])
   {
-    fputs("No username in Authorization header.\n", stderr);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "No username in Authorization header.");
     return (HTTP_STATUS_BAD_REQUEST);
   }
 
+  if (cached && (status = auth_cache_check(hmac, client->hostname, data.username)) != HTTP_STATUS_NONE)
+  {
+    if (status == HTTP_STATUS_CONTINUE)
+      cupsCopyString(client->username, data.username, sizeof(client->username));
+    else
+      _cupsLogMessage(_CUPS_LOG_ERROR, "Too many failed authentication attempts for \"%s\" from %s.", data.username, client->hostname);
+
+    return (status);
+  }
+
   pamdata.conv        = pam_func;
   pamdata.appdata_ptr = &data;
 
   if ((pamerr = pam_start(PAMService, data.username, &pamdata, &pamh)) != PAM_SUCCESS)
   {
-    fprintf(stderr, "pam_start() returned %d (%s)\n", pamerr, pam_strerror(pamh, pamerr));
+    _cupsLogMessage(_CUPS_LOG_ERROR, "pam_start() returned %d (%s)", pamerr, pam_strerror(pamh, pamerr));
     return (HTTP_STATUS_SERVER_ERROR);
   }
 
   if ((pamerr = pam_authenticate(pamh, PAM_SILENT)) != PAM_SUCCESS)
   {
-    fprintf(stderr, "pam_authenticate() returned %d (%s)\n", pamerr, pam_strerror(pamh, pamerr));
+    _cupsLogMessage(_CUPS_LOG_ERROR, "pam_authenticate() returned %d (%s)", pamerr, pam_strerror(pamh, pamerr));
     pam_end(pamh, 0);
+
+    if (cached)
+      auth_cache_update(hmac, client->hostname, data.username, false);
+
     return (HTTP_STATUS_UNAUTHORIZED);
   }
 
   if ((pamerr = pam_acct_mgmt(pamh, PAM_SILENT)) != PAM_SUCCESS)
   {
-    fprintf(stderr, "pam_acct_mgmt() returned %d (%s)\n", pamerr, pam_strerror(pamh, pamerr));
+    _cupsLogMessage(_CUPS_LOG_ERROR, "pam_acct_mgmt() returned %d (%s)", pamerr, pam_strerror(pamh, pamerr));
     pam_end(pamh, 0);
     return (HTTP_STATUS_SERVER_ERROR);
   }
@@ -813,6 +1257,9 @@ authenticate_request(
 
   pam_end(pamh, PAM_SUCCESS);
 
+  if (cached)
+    auth_cache_update(hmac, client->hostname, data.username, true);
+
   return (HTTP_STATUS_CONTINUE);
 
 #else
@@ -824,6 +1271,37 @@ authenticate_request(
 }
 
 
+//
+// 'cancel_job()' - Cancel a job.
+//
+// Jobs that are processing or still receiving document data are flagged and
+// canceled by their worker, while pending jobs are removed from the queue and
+// canceled immediately.  The caller must hold the printer's write lock.
+//
+
+static void
+cancel_job(ippeve_job_t *job)		// I - Job
+{
+  ippeve_printer_t	*printer = job->printer;
+					// Printer
+
+
+  cupsMutexLock(&printer->job_mutex);
+
+  if (job->state == IPP_JSTATE_PROCESSING || (job->state == IPP_JSTATE_HELD && job->fd >= 0))
+  {
+    job->cancel = 1;
+  }
+  else
+  {
+    cupsArrayRemove(printer->pending_jobs, job);
+    set_job_state(job, IPP_JSTATE_CANCELED);
+  }
+
+  cupsMutexUnlock(&printer->job_mutex);
+}
+
+
 //
 // 'clean_jobs()' - Clean out old (completed) jobs.
 //
@@ -835,26 +1313,47 @@ clean_jobs(ippeve_printer_t *printer)	// I - Printer
   time_t	cleantime;		// Clean time
 
 
-  if (cupsArrayGetCount(printer->jobs) == 0)
+  if (cupsArrayGetCount(printer->completed_jobs) == 0)
     return;
 
-  cleantime = time(NULL) - 60;
+  cleantime = time(NULL) - printer->history_time;
 
   cupsRWLockWrite(&(printer->rwlock));
-  for (job = (ippeve_job_t *)cupsArrayGetFirst(printer->jobs);
-       job;
-       job = (ippeve_job_t *)cupsArrayGetNext(printer->jobs))
-    if (job->completed && job->completed < cleantime)
-    {
-      cupsArrayRemove(printer->jobs, job);
-      delete_job(job);
-    }
-    else
-      break;
+
+  // Completed jobs are sorted newest first, so remove jobs from the end of the
+  // list until we find one that should be kept...
+  while ((job = (ippeve_job_t *)cupsArrayGetLast(printer->completed_jobs)) != NULL && (job->completed < cleantime || (printer->history_count > 0 && cupsArrayGetCount(printer->completed_jobs) > printer->history_count)))
+  {
+    cupsArrayRemove(printer->completed_jobs, job);
+    cupsArrayRemove(printer->state_jobs[job->state - IPP_JSTATE_PENDING], job);
+    cupsArrayRemove(printer->jobs, job);
+    delete_job(job);
+  }
+
   cupsRWUnlock(&(printer->rwlock));
 }
 
 
+//
+// 'compare_completed()' - Compare two completed jobs.
+//
+// Completed jobs are sorted by descending completion time and job ID.
+//
+
+static int				// O - Result of comparison
+compare_completed(ippeve_job_t *a,	// I - First job
+                  ippeve_job_t *b,	// I - Second job
+                  void         *data)	// I - Callback data (unused)
+{
+  (void)data;
+
+  if (a->completed != b->completed)
+    return (a->completed > b->completed ? -1 : 1);
+  else
+    return (b->id - a->id);
+}
+
+
 //
 // 'compare_jobs()' - Compare two jobs.
 //
@@ -870,6 +1369,42 @@ compare_jobs(ippeve_job_t *a,		// I - First job
 }
 
 
+//
+// 'compare_pending()' - Compare two pending jobs.
+//
+// Pending jobs are sorted by descending priority and then by ascending job ID
+// so that equal priority jobs are processed in the order they were submitted.
+//
+
+static int				// O - Result of comparison
+compare_pending(ippeve_job_t *a,	// I - First job
+                ippeve_job_t *b,	// I - Second job
+                void         *data)	// I - Callback data (unused)
+{
+  (void)data;
+
+  if (a->priority != b->priority)
+    return (b->priority - a->priority);
+  else
+    return (a->id - b->id);
+}
+
+
+//
+// 'compare_printers()' - Compare two virtual printers.
+//
+
+static int				// O - Result of comparison
+compare_printers(ippeve_printer_t *a,	// I - First printer
+                 ippeve_printer_t *b,	// I - Second printer
+                 void             *data)// I - Callback data (unused)
+{
+  (void)data;
+
+  return (strcmp(a->resource, b->resource));
+}
+
+
 //
 // 'copy_attributes()' - Copy attributes from one request to another.
 //
@@ -1055,39 +1590,92 @@ copy_job_attributes(
 
 
 //
-// 'create_client()' - Accept a new network connection and create a client
-//                     object.
+// 'copy_printer_attrs()' - Make a private copy of shared printer attributes.
+//
+// Virtual printers share their static attributes until one of them changes
+// them, so this function must be called before changing the attributes of a
+// printer.  Returns `true` if the attributes were copied, which means that any
+// attribute pointers found before the call must be looked up again.
+//
+// The caller must hold the printer write lock.
 //
 
-static ippeve_client_t *			// O - Client
-create_client(ippeve_printer_t *printer,	// I - Printer
-              int            sock)	// I - Listen socket
+static bool				// O - `true` if copied, `false` otherwise
+copy_printer_attrs(
+    ippeve_printer_t *printer)		// I - Printer
 {
-  ippeve_client_t	*client;		// Client
+  ippeve_attrs_t	*shared = printer->shared,
+					// Shared attributes
+			*copy;		// Private copy of attributes
+  int			use;		// Number of printers using attributes
 
 
-  if ((client = calloc(1, sizeof(ippeve_client_t))) == NULL)
+  cupsMutexLock(&AttrsMutex);
+  use = shared->use;
+  cupsMutexUnlock(&AttrsMutex);
+
+  if (use == 1)
+    return (false);
+
+  if ((copy = calloc(1, sizeof(ippeve_attrs_t))) == NULL)
   {
-    perror("Unable to allocate memory for client");
-    return (NULL);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to allocate memory for printer attributes: %s", strerror(errno));
+    return (false);
   }
 
-  client->printer = printer;
+  copy->use   = 1;
+  copy->attrs = ippNew();
 
-  // Accept the client and get the remote address...
-  if ((client->http = httpAcceptConnection(sock, 1)) == NULL)
-  {
-    perror("Unable to accept client connection");
+  ippCopyAttributes(copy->attrs, shared->attrs, /*quickcopy*/false, /*cb*/NULL, /*cb_data*/NULL);
 
-    free(client);
+  printer->shared = copy;
+  printer->attrs  = copy->attrs;
 
-    return (NULL);
-  }
+  release_printer_attrs(shared);
+
+  return (true);
+}
+
+
+//
+// 'create_client()' - Accept a new network connection and create a client
+//                     object.
+//
+
+static ippeve_client_t *			// O - Client
+create_client(ippeve_printer_t *printer,	// I - Printer
+              int            sock)	// I - Listen socket
+{
+  ippeve_client_t	*client;		// Client
+
+
+  if ((client = calloc(1, sizeof(ippeve_client_t))) == NULL)
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to allocate memory for client: %s", strerror(errno));
+    return (NULL);
+  }
+
+  client->printer = printer;
+
+  // Accept the client and get the remote address...
+  if ((client->http = httpAcceptConnection(sock, 1)) == NULL)
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to accept client connection: %s", strerror(errno));
+
+    free(client);
+
+    return (NULL);
+  }
 
   httpGetHostname(client->http, client->hostname, sizeof(client->hostname));
 
   if (Verbosity)
-    fprintf(stderr, "Accepted connection from %s\n", client->hostname);
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "Accepted connection from %s", client->hostname);
+
+  cupsMutexLock(&printer->metrics.mutex);
+  printer->metrics.active_clients ++;
+  printer->metrics.clients ++;
+  cupsMutexUnlock(&printer->metrics.mutex);
 
   return (client);
 }
@@ -1108,26 +1696,20 @@ create_job(ippeve_client_t *client)	// I - Client
 
 
   cupsRWLockWrite(&(client->printer->rwlock));
-  if (client->printer->active_job &&
-      client->printer->active_job->state < IPP_JSTATE_CANCELED)
-  {
-    // Only accept a single job at a time...
-    cupsRWUnlock(&(client->printer->rwlock));
-    return (NULL);
-  }
 
   // Allocate and initialize the job object...
   if ((job = calloc(1, sizeof(ippeve_job_t))) == NULL)
   {
-    perror("Unable to allocate memory for job");
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to allocate memory for job: %s", strerror(errno));
     cupsRWUnlock(&(client->printer->rwlock));
     return (NULL);
   }
 
   job->printer    = client->printer;
   job->attrs      = ippNew();
-  job->state      = IPP_JSTATE_HELD;
+  job->priority   = 50;
   job->fd         = -1;
+  job->stream_fd  = -1;
 
   // Copy all of the job attributes...
   copy_attributes(job->attrs, client->request, NULL, IPP_TAG_JOB, 0);
@@ -1198,13 +1780,16 @@ create_job(ippeve_client_t *client)	// I - Client
   if ((attr = ippFindAttribute(client->request, "job-name", IPP_TAG_NAME)) != NULL)
     job->name = ippGetString(attr, 0, NULL);
 
+  if ((attr = ippFindAttribute(client->request, "job-priority", IPP_TAG_INTEGER)) != NULL)
+    job->priority = ippGetInteger(attr, 0);
+
   // Add job description attributes and add to the jobs array...
   job->id = client->printer->next_job_id ++;
 
   if ((attr = ippFindAttribute(client->request, "printer-uri", IPP_TAG_URI)) != NULL)
     snprintf(uri, sizeof(uri), "%s/%d", ippGetString(attr, 0, NULL), job->id);
   else
-    httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, client->printer->hostname, client->printer->port, "/ipp/print/%d", job->id);
+    httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, client->printer->hostname, client->printer->port, "%s/%d", client->printer->resource, job->id);
 
   httpAssembleUUID(client->printer->hostname, client->printer->port, client->printer->name, job->id, uuid, sizeof(uuid));
 
@@ -1220,14 +1805,14 @@ create_job(ippeve_client_t *client)	// I - Client
   {
     char printer_uri[1024];		// job-printer-uri value
 
-    httpAssembleURI(HTTP_URI_CODING_ALL, printer_uri, sizeof(printer_uri), "ipp", NULL, client->printer->hostname, client->printer->port, "/ipp/print");
+    httpAssembleURI(HTTP_URI_CODING_ALL, printer_uri, sizeof(printer_uri), "ipp", NULL, client->printer->hostname, client->printer->port, client->printer->resource);
     ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI, "job-printer-uri", NULL, printer_uri);
   }
 
   ippAddInteger(job->attrs, IPP_TAG_JOB, IPP_TAG_INTEGER, "time-at-creation", (int)(job->created - client->printer->start_time));
 
   cupsArrayAdd(client->printer->jobs, job);
-  client->printer->active_job = job;
+  set_job_state(job, IPP_JSTATE_HELD);
 
   cupsRWUnlock(&(client->printer->rwlock));
 
@@ -1297,7 +1882,7 @@ create_job_file(
   // Create a filename with the job-id, job-name, and document-format (extension)...
   snprintf(fname, fnamesize, "%s/%d-%s.%s", directory, job->id, name, ext);
 
-  return (open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666));
+  return (open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC, 0666));
 }
 
 
@@ -1672,8 +2257,8 @@ create_printer(
     return (NULL);
   }
 
-  printer->ipv4           = -1;
-  printer->ipv6           = -1;
+  init_printer(printer);
+
   printer->name           = strdup(name);
   printer->dnssd          = cupsDNSSDNew(NULL, NULL);
   printer->dnssd_name     = strdup(name);
@@ -1681,17 +2266,13 @@ create_printer(
   printer->command        = command ? strdup(command) : NULL;
   printer->device_uri     = device_uri ? strdup(device_uri) : NULL;
   printer->output_format  = output_format ? strdup(output_format) : NULL;
+  printer->resource       = strdup("/ipp/print");
   printer->directory      = strdup(directory);
   printer->icons[0]       = icons ? strdup(icons) : NULL;
   printer->strings        = strings ? strdup(strings) : NULL;
   printer->port           = serverport;
-  printer->start_time     = time(NULL);
-  printer->config_time    = printer->start_time;
-  printer->state          = IPP_PSTATE_IDLE;
-  printer->state_reasons  = IPPEVE_PREASON_NONE;
-  printer->state_time     = printer->start_time;
-  printer->jobs           = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, NULL, 0, NULL, NULL);
-  printer->next_job_id    = 1;
+  printer->history_time   = 60;
+  printer->num_workers    = 1;
 
   if (printer->icons[0])
   {
@@ -1723,14 +2304,12 @@ create_printer(
     printer->hostname = strdup(cupsDNSSDCopyHostName(printer->dnssd, temp, sizeof(temp)));
   }
 
-  cupsRWInit(&(printer->rwlock));
-
   // Create the listener sockets...
   if (printer->port)
   {
     if ((printer->ipv4 = create_listener(servername, printer->port, AF_INET)) < 0)
     {
-      perror("Unable to create IPv4 listener");
+      _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to create IPv4 listener: %s", strerror(errno));
       goto bad_printer;
     }
   }
@@ -1761,14 +2340,14 @@ create_printer(
     }
     else
     {
-      perror("Unable to create IPv4 listener");
+      _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to create IPv4 listener: %s", strerror(errno));
       goto bad_printer;
     }
   }
 
   if ((printer->ipv6 = create_listener(servername, printer->port, AF_INET6)) < 0)
   {
-    perror("Unable to create IPv6 listener");
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to create IPv6 listener: %s", strerror(errno));
     goto bad_printer;
   }
 
@@ -1779,8 +2358,8 @@ create_printer(
 
   if (Verbosity)
   {
-    fprintf(stderr, "printer-uri-supported=\"ipp://%s:%d/ipp/print\",\"ipps://%s:%d/ipp/print\"\n", printer->hostname, printer->port, printer->hostname, printer->port);
-    fprintf(stderr, "printer-uuid=\"%s\"\n", uuid);
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "printer-uri-supported=\"ipp://%s:%d/ipp/print\",\"ipps://%s:%d/ipp/print\"", printer->hostname, printer->port, printer->hostname, printer->port);
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "printer-uuid=\"%s\"", uuid);
   }
 
   // Get the maximum spool size based on the size of the filesystem used for
@@ -1857,8 +2436,19 @@ create_printer(
       sup_attrs[num_sup_attrs ++] = job_creation[i];
   }
 
-  // Fill out the rest of the printer attributes.
-  printer->attrs = attrs;
+  // Fill out the rest of the printer attributes.  The attributes that identify
+  // the printer are kept separately so that virtual printers can share the
+  // rest...
+  if ((printer->shared = calloc(1, sizeof(ippeve_attrs_t))) == NULL)
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to allocate memory for printer attributes: %s", strerror(errno));
+    goto bad_printer;
+  }
+
+  printer->shared->use   = 1;
+  printer->shared->attrs = attrs;
+  printer->attrs         = attrs;
+  printer->local_attrs   = ippNew();
 
   // charset-configured
   ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_CHARSET), "charset-configured", NULL, "utf-8");
@@ -1871,7 +2461,7 @@ create_printer(
     ippAddStrings(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "compression-supported", (int)(sizeof(compressions) / sizeof(compressions[0])), NULL, compressions);
 
   // device-uuid
-  ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_URI, "device-uuid", /*language*/NULL, uuid);
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_URI, "device-uuid", /*language*/NULL, uuid);
 
   if (docformats)
   {
@@ -1932,7 +2522,7 @@ create_printer(
   ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "job-priority-default", 50);
 
   // job-priority-supported
-  ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "job-priority-supported", 1);
+  ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "job-priority-supported", 100);
 
   // job-sheets-default
 //  ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_NAME), "job-sheets-default", NULL, "none");
@@ -2051,7 +2641,7 @@ create_printer(
   ippAddBoolean(printer->attrs, IPP_TAG_PRINTER, "printer-is-accepting-jobs", true);
 
   // printer-info
-  ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-info", NULL, name);
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-info", NULL, name);
 
   // printer-kind
   if (!ippFindAttribute(printer->attrs, "printer-kind", IPP_TAG_ZERO))
@@ -2061,7 +2651,7 @@ create_printer(
   ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-location", NULL, location);
 
   // printer-name
-  ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_NAME, "printer-name", NULL, name);
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_NAME, "printer-name", NULL, name);
 
   // printer-organization
   ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_TEXT), "printer-organization", NULL, "");
@@ -2073,7 +2663,7 @@ create_printer(
   ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_LANGUAGE, "printer-strings-languages-supported", NULL, "en");
 
   // printer-uuid
-  ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_URI, "printer-uuid", NULL, uuid);
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_URI, "printer-uuid", NULL, uuid);
 
   // reference-uri-schemes-supported
   ippAddStrings(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_URISCHEME), "reference-uri-schemes-supported", (int)(sizeof(reference_uri_schemes_supported) / sizeof(reference_uri_schemes_supported[0])), NULL, reference_uri_schemes_supported);
@@ -2097,6 +2687,7 @@ create_printer(
   ippAddStrings(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "which-jobs-supported", sizeof(which_jobs) / sizeof(which_jobs[0]), NULL, which_jobs);
 
   debug_attributes("Printer", printer->attrs, 0);
+  debug_attributes("Printer", printer->local_attrs, 0);
 
   // Register the printer with DNS-SD...
   if (!register_printer(printer))
@@ -2115,6 +2706,220 @@ create_printer(
 }
 
 
+//
+// 'create_printer_env()' - Create the cached environment for the print command.
+//
+// The environment contains a copy of the current environment, the device and
+// output format variables, and IPP_xxx variables for the Printer -default,
+// -ready, and -supported attributes.  The caller must hold the printer lock.
+//
+
+static ippeve_env_t *			// O - Environment or `NULL` on error
+create_printer_env(
+    ippeve_printer_t *printer)		// I - Printer
+{
+  ippeve_env_t		*env;		// Environment
+  int			max_vars = IPPEVE_MAX_ENV - 3;
+					// Maximum number of variables (leave
+					// room for CONTENT_TYPE and password)
+  ipp_attribute_t	*attr;		// Printer attribute
+  char			val[1280],	// IPP_NAME=value
+			*valptr;	// Pointer into string
+
+
+  if ((env = calloc(1, sizeof(ippeve_env_t))) == NULL || (env->vars = calloc((size_t)max_vars, sizeof(char *))) == NULL)
+  {
+    free(env);
+    return (NULL);
+  }
+
+  env->use = 1;
+
+  // Copy the current environment...
+  while (environ[env->num_vars] && env->num_vars < max_vars)
+  {
+    env->vars[env->num_vars] = strdup(environ[env->num_vars]);
+    env->num_vars ++;
+  }
+
+  if (env->num_vars > (IPPEVE_MAX_ENV - 32))
+    goto bad_env;
+
+  if (printer->device_uri)
+  {
+    snprintf(val, sizeof(val), "DEVICE_URI=%s", printer->device_uri);
+    env->vars[env->num_vars ++] = strdup(val);
+  }
+
+  if (printer->output_format)
+  {
+    snprintf(val, sizeof(val), "OUTPUT_TYPE=%s", printer->output_format);
+    env->vars[env->num_vars ++] = strdup(val);
+  }
+
+  // Then add environment variables for the Printer attributes...
+  for (attr = ippGetFirstAttribute(printer->attrs); attr && env->num_vars < max_vars; attr = ippGetNextAttribute(printer->attrs))
+  {
+    // Convert "attribute-name-default" to "IPP_ATTRIBUTE_NAME_DEFAULT=",
+    // "attribute-name-ready" to "IPP_ATTRIBUTE_NAME_READY",
+    // "attribute-name-supported" to "IPP_ATTRIBUTE_NAME_SUPPORTED",
+    // "pclm-xxx" to "IPP_PCLM_XXX", and "pwg-xxx" to "IPP_PWG_XXX",
+    // then add the value(s) from the attribute.
+    const char	*name = ippGetName(attr),
+					// Attribute name
+		*default_suffix = strstr(name, "-default"),
+					// Suffix on attribute name
+		*ready_suffix = strstr(name, "-ready"),
+					// Suffix on attribute name
+		*supported_suffix = strstr(name, "-supported");
+					// Suffix on attribute name
+
+    if (strncmp(name, "pclm-", 5) && strncmp(name, "pwg-", 4) && (!default_suffix || default_suffix[8]) && (!ready_suffix || ready_suffix[6]) && (!supported_suffix || supported_suffix[10]))
+      continue;
+
+    valptr = val;
+    *valptr++ = 'I';
+    *valptr++ = 'P';
+    *valptr++ = 'P';
+    *valptr++ = '_';
+    while (*name && valptr < (val + sizeof(val) - 2))
+    {
+      if (*name == '-')
+	*valptr++ = '_';
+      else
+	*valptr++ = (char)toupper(*name & 255);
+
+      name ++;
+    }
+    *valptr++ = '=';
+    ippAttributeString(attr, valptr, sizeof(val) - (size_t)(valptr - val));
+
+    env->vars[env->num_vars ++] = strdup(val);
+  }
+
+  if (attr)
+    goto bad_env;
+
+  return (env);
+
+  // If we get here there are too many environment variables...
+  bad_env:
+
+  release_printer_env(env);
+
+  return (NULL);
+}
+
+
+//
+// 'create_virtual_printer()' - Create a virtual printer.
+//
+// Virtual printers use the listeners of the parent printer and are accessed
+// using the "/ipp/print/NAME" resource path.  The static attributes of the
+// parent printer are shared until they are changed.
+//
+
+static ippeve_printer_t *		// O - Printer or `NULL` on error
+create_virtual_printer(
+    ippeve_printer_t *parent,		// I - Printer with the listeners
+    const char       *name)		// I - Printer name
+{
+  ippeve_printer_t	*printer;	// Printer
+  const char		*nameptr;	// Pointer into name
+  char			resource[256],	// Resource path
+			*resptr,	// Pointer into resource path
+			directory[1024];// Spool directory
+  unsigned char		sha256[32];	// SHA-256 digest/sum
+  char			uuid_data[1024],// Data to hash for printer-uuid
+			uuid[128];	// printer-uuid
+
+
+  // Make the resource path and spool directory from the name...
+  cupsCopyString(resource, "/ipp/print/", sizeof(resource));
+
+  for (nameptr = name, resptr = resource + 11; *nameptr && resptr < (resource + sizeof(resource) - 1); nameptr ++)
+  {
+    if (isalnum(*nameptr & 255) || strchr("-._", *nameptr))
+      *resptr++ = *nameptr;
+    else
+      *resptr++ = '_';
+  }
+
+  *resptr = '\0';
+
+  snprintf(directory, sizeof(directory), "%s/%s", parent->directory, resource + 11);
+
+  if (mkdir(directory, 0755) && errno != EEXIST)
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to create spool directory '%s': %s", directory, strerror(errno));
+    return (NULL);
+  }
+
+  // Allocate memory for the printer...
+  if ((printer = calloc(1, sizeof(ippeve_printer_t))) == NULL)
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to allocate memory for printer '%s': %s", name, strerror(errno));
+    return (NULL);
+  }
+
+  init_printer(printer);
+
+  printer->parent         = parent;
+  printer->name           = strdup(name);
+  printer->dnssd_name     = strdup(name);
+  printer->command        = parent->command ? strdup(parent->command) : NULL;
+  printer->device_uri     = parent->device_uri ? strdup(parent->device_uri) : NULL;
+  printer->output_format  = parent->output_format ? strdup(parent->output_format) : NULL;
+  printer->resource       = strdup(resource);
+  printer->directory      = strdup(directory);
+  printer->hostname       = strdup(parent->hostname);
+  printer->port           = parent->port;
+  printer->web_forms      = parent->web_forms;
+  printer->stream         = parent->stream;
+  printer->history_time   = parent->history_time;
+  printer->history_count  = parent->history_count;
+  printer->num_workers    = parent->num_workers;
+
+  // Share the static attributes of the parent printer...
+  cupsMutexLock(&AttrsMutex);
+  printer->shared = parent->shared;
+  printer->shared->use ++;
+  cupsMutexUnlock(&AttrsMutex);
+
+  printer->attrs = printer->shared->attrs;
+
+  // Add the attributes that identify this printer...
+  snprintf(uuid_data, sizeof(uuid_data), "_IPPEVEPRINTER_:%s:%d:%s", printer->hostname, printer->port, printer->name);
+  cupsHashData("sha2-256", (unsigned char *)uuid_data, strlen(uuid_data), sha256, sizeof(sha256));
+  snprintf(uuid, sizeof(uuid), "urn:uuid:%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x", sha256[0], sha256[1], sha256[3], sha256[4], sha256[5], sha256[6], (sha256[10] & 15) | 0x30, sha256[11], (sha256[15] & 0x3f) | 0x40, sha256[16], sha256[20], sha256[21], sha256[25], sha256[26], sha256[30], sha256[31]);
+
+  printer->local_attrs = ippNew();
+
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_URI, "device-uuid", /*language*/NULL, uuid);
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-info", NULL, name);
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_NAME, "printer-name", NULL, name);
+  ippAddString(printer->local_attrs, IPP_TAG_PRINTER, IPP_TAG_URI, "printer-uuid", NULL, uuid);
+
+  // Add the printer to the parent...
+  if (!parent->printers)
+    parent->printers = cupsArrayNew((cups_array_cb_t)compare_printers, NULL, NULL, 0, NULL, NULL);
+
+  if (cupsArrayFind(parent->printers, printer))
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Duplicate printer resource path '%s'.", printer->resource);
+    delete_printer(printer);
+    return (NULL);
+  }
+
+  cupsArrayAdd(parent->printers, printer);
+
+  if (Verbosity)
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "Created virtual printer '%s' at '%s'.", printer->name, printer->resource);
+
+  return (printer);
+}
+
+
 //
 // 'debug_attributes()' - Print attributes in a request or response.
 //
@@ -2133,16 +2938,16 @@ debug_attributes(const char *title,	// I - Title
   if (Verbosity <= 1)
     return;
 
-  fprintf(stderr, "%s:\n", title);
+  _cupsLogMessage(_CUPS_LOG_DEBUG, "%s:", title);
   major = ippGetVersion(ipp, &minor);
-  fprintf(stderr, "  version=%d.%d\n", major, minor);
+  _cupsLogMessage(_CUPS_LOG_DEBUG, "  version=%d.%d", major, minor);
   if (type == 1)
-    fprintf(stderr, "  operation-id=%s(%04x)\n",
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "  operation-id=%s(%04x)",
             ippOpString(ippGetOperation(ipp)), ippGetOperation(ipp));
   else if (type == 2)
-    fprintf(stderr, "  status-code=%s(%04x)\n",
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "  status-code=%s(%04x)",
             ippErrorString(ippGetStatusCode(ipp)), ippGetStatusCode(ipp));
-  fprintf(stderr, "  request-id=%d\n\n", ippGetRequestId(ipp));
+  _cupsLogMessage(_CUPS_LOG_DEBUG, "  request-id=%d", ippGetRequestId(ipp));
 
   for (attr = ippGetFirstAttribute(ipp), group_tag = IPP_TAG_ZERO;
        attr;
@@ -2151,13 +2956,13 @@ debug_attributes(const char *title,	// I - Title
     if (ippGetGroupTag(attr) != group_tag)
     {
       group_tag = ippGetGroupTag(attr);
-      fprintf(stderr, "  %s\n", ippTagString(group_tag));
+      _cupsLogMessage(_CUPS_LOG_DEBUG, "  %s", ippTagString(group_tag));
     }
 
     if (ippGetName(attr))
     {
       ippAttributeString(attr, buffer, sizeof(buffer));
-      fprintf(stderr, "    %s (%s%s) %s\n", ippGetName(attr),
+      _cupsLogMessage(_CUPS_LOG_DEBUG, "    %s (%s%s) %s", ippGetName(attr),
 	      ippGetCount(attr) > 1 ? "1setOf " : "",
 	      ippTagString(ippGetValueTag(attr)), buffer);
     }
@@ -2174,7 +2979,7 @@ static void
 delete_client(ippeve_client_t *client)	// I - Client
 {
   if (Verbosity)
-    fprintf(stderr, "Closing connection from %s\n", client->hostname);
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "Closing connection from %s", client->hostname);
 
   // Flush pending writes before closing...
   httpFlushWrite(client->http);
@@ -2185,6 +2990,13 @@ delete_client(ippeve_client_t *client)	// I - Client
   ippDelete(client->request);
   ippDelete(client->response);
 
+  if (client->printer->parent)
+    client->printer = client->printer->parent;
+
+  cupsMutexLock(&client->printer->metrics.mutex);
+  client->printer->metrics.active_clients --;
+  cupsMutexUnlock(&client->printer->metrics.mutex);
+
   free(client);
 }
 
@@ -2198,7 +3010,7 @@ static void
 delete_job(ippeve_job_t *job)		// I - Job
 {
   if (Verbosity)
-    fprintf(stderr, "[Job %d] Removing job from history.\n", job->id);
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "[Job %d] Removing job from history.", job->id);
 
   ippDelete(job->attrs);
 
@@ -2225,6 +3037,15 @@ static void
 delete_printer(
     ippeve_printer_t *printer)		// I - Printer
 {
+  size_t	i;			// Looping var
+  ippeve_printer_t *vprinter;		// Current virtual printer
+
+
+  for (vprinter = (ippeve_printer_t *)cupsArrayGetFirst(printer->printers); vprinter; vprinter = (ippeve_printer_t *)cupsArrayGetNext(printer->printers))
+    delete_printer(vprinter);
+
+  cupsArrayDelete(printer->printers);
+
   if (printer->ipv4 >= 0)
     httpAddrClose(/*addr*/NULL, printer->ipv4);
 
@@ -2239,11 +3060,25 @@ delete_printer(
   free(printer->strings);
   free(printer->command);
   free(printer->device_uri);
+  free(printer->output_format);
+  free(printer->resource);
   free(printer->directory);
   free(printer->hostname);
 
-  ippDelete(printer->attrs);
+  if (printer->shared)
+    release_printer_attrs(printer->shared);
+  else
+    ippDelete(printer->attrs);
+  ippDelete(printer->local_attrs);
+  release_printer_env(printer->env);
+  for (i = 0; i < IPPEVE_RESOURCE_MAX; i ++)
+    release_resource(printer, printer->cache[i]);
   cupsArrayDelete(printer->jobs);
+  cupsArrayDelete(printer->active_jobs);
+  cupsArrayDelete(printer->completed_jobs);
+  for (i = 0; i < (sizeof(printer->state_jobs) / sizeof(printer->state_jobs[0])); i ++)
+    cupsArrayDelete(printer->state_jobs[i]);
+  cupsArrayDelete(printer->pending_jobs);
 
   free(printer);
 }
@@ -2263,7 +3098,7 @@ dnssd_callback(
 
   if (flags & CUPS_DNSSD_FLAGS_COLLISION)
   {
-    fputs("DNS-SD service name collision detected.\n", stderr);
+    _cupsLogMessage(_CUPS_LOG_WARN, "DNS-SD service name collision detected.");
     printer->dnssd_collision = 1;
   }
 }
@@ -2328,6 +3163,52 @@ find_job(ippeve_client_t *client)		// I - Client
 }
 
 
+//
+// 'find_printer()' - Find the printer for a printer-uri or job-uri resource path.
+//
+// The resource path "/ipp/print" is used for the printer with the listeners,
+// while "/ipp/print/NAME" is used for virtual printers.  Job URIs append "/JOB-ID" to the printer resource path.
+//
+
+static ippeve_printer_t *		// O - Printer or `NULL` if not found
+find_printer(
+    ippeve_printer_t *printer,		// I - Printer with the listeners
+    const char       *resource,		// I - Resource path
+    bool             job)		// I - `true` for a job-uri, `false` for a printer-uri
+{
+  ippeve_printer_t	key;		// Search key
+  char			temp[256],	// Virtual printer resource path
+			*ptr;		// Pointer into resource path
+
+
+  if (strncmp(resource, "/ipp/print/", 11))
+    return (job || strcmp(resource, "/ipp/print") ? NULL : printer);
+
+  if (job && isdigit(resource[11] & 255) && !strchr(resource + 11, '/'))
+    return (printer);
+
+  if (!printer->printers)
+    return (NULL);
+
+  cupsCopyString(temp, resource, sizeof(temp));
+
+  if ((ptr = strchr(temp + 11, '/')) != NULL)
+  {
+    // Strip the job-id from job URIs...
+    if (!job)
+      return (NULL);
+
+    *ptr = '\0';
+  }
+  else if (job)
+    return (NULL);
+
+  key.resource = temp;
+
+  return ((ippeve_printer_t *)cupsArrayFind(printer->printers, &key));
+}
+
+
 //
 // 'finish_document()' - Finish receiving a document file and start processing.
 //
@@ -2339,9 +3220,14 @@ finish_document_data(
 {
   char			filename[1024],	// Filename buffer
 			buffer[4096];	// Copy buffer
-  ssize_t		bytes;		// Bytes read
+  ssize_t		bytes,		// Bytes read
+			sbytes;		// Bytes written to command
+  unsigned long long	total = 0;	// Total bytes read
+  int			streamfd = -1;	// Pipe to print command, if any
+  bool			streaming = false;
+					// Is the print command processing the job?
   cups_array_t		*ra;		// Attributes to send in response
-  cups_thread_t        t;              // Thread
+  ippeve_metrics_t	*metrics;	// Server metrics
 
 
   // Create a file for the request data...
@@ -2352,7 +3238,11 @@ finish_document_data(
   }
 
   if (Verbosity)
-    fprintf(stderr, "Created job file \"%s\", format \"%s\".\n", filename, job->format);
+    _cupsLogMessage(_CUPS_LOG_DEBUG, "Created job file \"%s\", format \"%s\".", filename, job->format);
+
+  // Start the print command now if the document can be streamed to it...
+  if (client->printer->stream && (streamfd = stream_job(job, filename)) >= 0)
+    streaming = true;
 
   while ((bytes = httpRead(client->http, buffer, sizeof(buffer))) > 0)
   {
@@ -2361,6 +3251,34 @@ finish_document_data(
       respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to write print file: %s", strerror(errno));
       goto cleanup_and_abort;
     }
+
+    total += (unsigned long long)bytes;
+
+    if (streamfd >= 0)
+    {
+      // Copy the data to the command, blocking until it has read the previous
+      // data...
+      char *bufptr = buffer;		// Pointer into buffer
+
+      while (bytes > 0)
+      {
+        if ((sbytes = write(streamfd, bufptr, (size_t)bytes)) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          // The command exited early, keep spooling the document and let the
+          // streaming thread report the job state...
+          _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to stream document data: %s", job->id, strerror(errno));
+          close(streamfd);
+          streamfd = -1;
+          break;
+        }
+
+        bufptr += sbytes;
+        bytes  -= sbytes;
+      }
+    }
   }
 
   if (bytes < 0)
@@ -2378,21 +3296,39 @@ finish_document_data(
     goto cleanup_and_abort;
   }
 
-  job->fd       = -1;
-  job->filename = strdup(filename);
-  job->state    = IPP_JSTATE_PENDING;
+  metrics = client->printer->parent ? &client->printer->parent->metrics : &client->printer->metrics;
 
-  // Process the job...
-  t = cupsThreadCreate((cups_thread_func_t)process_job, job);
+  cupsMutexLock(&metrics->mutex);
+  metrics->documents ++;
+  metrics->document_bytes += total;
+  cupsMutexUnlock(&metrics->mutex);
 
-  if (t)
+  if (streaming)
   {
-    cupsThreadDetach(t);
+    // The streaming thread owns the job state from here on...
+    cupsRWLockWrite(&(client->printer->rwlock));
+    job->fd = -1;
+    if (streamfd >= 0)
+      job->stream_eof = true;
+    cupsRWUnlock(&(client->printer->rwlock));
+
+    // Send EOF to the command, which is already processing the job...
+    if (streamfd >= 0)
+      close(streamfd);
   }
   else
   {
-    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to process job.");
-    goto abort_job;
+    cupsRWLockWrite(&(client->printer->rwlock));
+
+    job->fd = -1;
+    if (!job->filename)
+      job->filename = strdup(filename);
+    set_job_state(job, IPP_JSTATE_PENDING);
+
+    cupsRWUnlock(&(client->printer->rwlock));
+
+    // Queue the job for processing...
+    queue_job(job);
   }
 
   // Return the job info...
@@ -2418,13 +3354,17 @@ finish_document_data(
     job->fd = -1;
   }
 
+  if (streamfd >= 0)
+    close(streamfd);
+
   unlink(filename);
 
   // If we get here we had to abort the job...
   abort_job:
 
-  job->state     = IPP_JSTATE_ABORTED;
-  job->completed = time(NULL);
+  cupsRWLockWrite(&(client->printer->rwlock));
+  set_job_state(job, IPP_JSTATE_ABORTED);
+  cupsRWUnlock(&(client->printer->rwlock));
 
   ra = cupsArrayNew(_cupsArrayStrcmp, NULL, NULL, 0, NULL, NULL);
   cupsArrayAdd(ra, "job-id");
@@ -2524,7 +3464,7 @@ finish_document_uri(
 
   if (!strcmp(scheme, "file"))
   {
-    if ((infile = open(resource, O_RDONLY | O_BINARY)) < 0)
+    if ((infile = open(resource, O_RDONLY | O_BINARY | O_CLOEXEC)) < 0)
     {
       respond_ipp(client, IPP_STATUS_ERROR_DOCUMENT_ACCESS, "Unable to access URI '%s': %s", ippGetString(uri, 0, NULL), strerror(errno));
 
@@ -2607,12 +3547,12 @@ finish_document_uri(
 
   job->fd       = -1;
   job->filename = strdup(filename);
-  job->state    = IPP_JSTATE_PENDING;
+  set_job_state(job, IPP_JSTATE_PENDING);
 
   cupsRWUnlock(&(client->printer->rwlock));
 
-  // Process the job...
-  process_job(job);
+  // Queue the job for processing...
+  queue_job(job);
 
   // Return the job info...
   respond_ipp(client, IPP_STATUS_OK, NULL);
@@ -2641,8 +3581,9 @@ finish_document_uri(
   // If we get here we had to abort the job...
   abort_job:
 
-  job->state     = IPP_JSTATE_ABORTED;
-  job->completed = time(NULL);
+  cupsRWLockWrite(&(client->printer->rwlock));
+  set_job_state(job, IPP_JSTATE_ABORTED);
+  cupsRWUnlock(&(client->printer->rwlock));
 
   ra = cupsArrayNew(_cupsArrayStrcmp, NULL, NULL, 0, NULL, NULL);
   cupsArrayAdd(ra, "job-id");
@@ -2674,56 +3615,195 @@ flush_document_data(
 
 
 //
-// 'have_document_data()' - Determine whether we have more document data.
+// 'get_resource()' - Get a cached static resource.
+//
+// Resources are loaded into memory on first use and reloaded when the
+// underlying file changes.  Release the returned resource with
+// `release_resource()`.
 //
 
-static bool				// O - `true` if data is present, `false` otherwise
-have_document_data(
-    ippeve_client_t *client)		// I - Client
+static ippeve_cache_t *			// O - Resource or `NULL` if not available
+get_resource(
+    ippeve_printer_t  *printer,		// I - Printer
+    ippeve_resource_t resource)		// I - Resource
 {
-  char temp;				// Data
+  ippeve_cache_t	*cache,		// Cached resource
+			*old = NULL;	// Old cached resource, if any
+  const char		*filename;	// Resource filename, if any
+  struct stat		fileinfo;	// File information
+  int			fd;		// File descriptor
+  unsigned char		*data,		// Data from file
+			hash[32];	// SHA2-256 hash of data
+  ssize_t		bytes;		// Bytes read
 
 
-  if (httpGetState(client->http) != HTTP_STATE_POST_RECV)
-    return (false);
+  // See if the resource is available...
+  if (resource == IPPEVE_RESOURCE_STRINGS)
+  {
+    if ((filename = printer->strings) == NULL)
+      return (NULL);
+  }
   else
-    return (httpPeek(client->http, &temp, 1) > 0);
-}
-
+  {
+    filename = printer->icons[resource];
+  }
 
-//
-// 'html_escape()' - Write a HTML-safe string.
-//
+  if (filename && stat(filename, &fileinfo))
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to access \"%s\": %s", filename, strerror(errno));
+    return (NULL);
+  }
 
-static bool				// O - `true` on success, `false` on error
-html_escape(ippeve_client_t *client,	// I - Client
-	    const char    *s,		// I - String to write
-	    size_t        slen)		// I - Number of characters to write
-{
-  const char	*start,			// Start of segment
-		*end;			// End of string
+  cupsMutexLock(&printer->cache_mutex);
 
+  if ((cache = printer->cache[resource]) != NULL && filename && (cache->mtime != fileinfo.st_mtime || cache->size != fileinfo.st_size))
+  {
+    // File has changed, reload it...
+    _cupsLogMessage(_CUPS_LOG_INFO, "Reloading \"%s\".", filename);
 
-  start = s;
-  end   = s + (slen > 0 ? slen : strlen(s));
+    old   = cache;
+    cache = printer->cache[resource] = NULL;
+  }
 
-  while (*s && s < end)
+  if (!cache && (cache = calloc(1, sizeof(ippeve_cache_t))) != NULL)
   {
-    if (*s == '&' || *s == '<')
+    cache->use = 1;
+
+    if (filename)
     {
-      if (s > start)
-      {
-        if (httpWrite(client->http, start, (size_t)(s - start)) < 0)
-          return (false);
-      }
+      // Load the file into memory...
+      cache->mtime = fileinfo.st_mtime;
+      cache->size  = fileinfo.st_size;
 
-      if (*s == '&')
+      if ((fd = open(filename, O_RDONLY | O_BINARY | O_CLOEXEC)) < 0 || (data = malloc((size_t)fileinfo.st_size + 1)) == NULL)
       {
-        if (httpWrite(client->http, "&amp;", 5) < 0)
-          return (false);
-      }
-      else if (httpWrite(client->http, "&lt;", 4) < 0)
-        return (false);
+        _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to load \"%s\": %s", filename, strerror(errno));
+        if (fd >= 0)
+          close(fd);
+
+        free(cache);
+        cache = NULL;
+      }
+      else
+      {
+        while (cache->length < (size_t)fileinfo.st_size && (bytes = read(fd, data + cache->length, (size_t)fileinfo.st_size - cache->length)) > 0)
+          cache->length += (size_t)bytes;
+
+        close(fd);
+
+        cache->data = data;
+      }
+    }
+    else
+    {
+      // Use the built-in icons...
+      cache->mtime     = printer->start_time;
+      cache->is_static = true;
+
+      switch (resource)
+      {
+        case IPPEVE_RESOURCE_ICON_SM :
+            cache->data   = printer_sm_png;
+            cache->length = sizeof(printer_sm_png);
+            break;
+        case IPPEVE_RESOURCE_ICON :
+            cache->data   = printer_png;
+            cache->length = sizeof(printer_png);
+            break;
+        default :
+            cache->data   = printer_lg_png;
+            cache->length = sizeof(printer_lg_png);
+            break;
+      }
+    }
+
+    if (cache)
+    {
+      // Use (part of) a hash of the data as the entity tag...
+      cupsHashData("sha2-256", cache->data, cache->length, hash, sizeof(hash));
+      cupsHashString(hash, 16, cache->etag, sizeof(cache->etag));
+
+      printer->cache[resource] = cache;
+    }
+  }
+
+  if (cache)
+    cache->use ++;
+
+  cupsMutexUnlock(&printer->cache_mutex);
+
+  // Release the cache's reference to the old resource...
+  release_resource(printer, old);
+
+  return (cache);
+}
+
+
+//
+// 'hash_job()' - Compute the job-id lookup hash for a job.
+//
+
+static size_t				// O - Hash value
+hash_job(ippeve_job_t *job,		// I - Job
+         void         *data)		// I - Callback data (unused)
+{
+  (void)data;
+
+  return ((size_t)job->id % IPPEVE_JOB_HASH_SIZE);
+}
+
+
+//
+// 'have_document_data()' - Determine whether we have more document data.
+//
+
+static bool				// O - `true` if data is present, `false` otherwise
+have_document_data(
+    ippeve_client_t *client)		// I - Client
+{
+  char temp;				// Data
+
+
+  if (httpGetState(client->http) != HTTP_STATE_POST_RECV)
+    return (false);
+  else
+    return (httpPeek(client->http, &temp, 1) > 0);
+}
+
+
+//
+// 'html_escape()' - Write a HTML-safe string.
+//
+
+static bool				// O - `true` on success, `false` on error
+html_escape(ippeve_client_t *client,	// I - Client
+	    const char    *s,		// I - String to write
+	    size_t        slen)		// I - Number of characters to write
+{
+  const char	*start,			// Start of segment
+		*end;			// End of string
+
+
+  start = s;
+  end   = s + (slen > 0 ? slen : strlen(s));
+
+  while (*s && s < end)
+  {
+    if (*s == '&' || *s == '<')
+    {
+      if (s > start)
+      {
+        if (httpWrite(client->http, start, (size_t)(s - start)) < 0)
+          return (false);
+      }
+
+      if (*s == '&')
+      {
+        if (httpWrite(client->http, "&amp;", 5) < 0)
+          return (false);
+      }
+      else if (httpWrite(client->http, "&lt;", 4) < 0)
+        return (false);
 
       start = s + 1;
     }
@@ -3046,6 +4126,48 @@ html_printf(ippeve_client_t *client,	// I - Client
 }
 
 
+//
+// 'init_printer()' - Initialize the job arrays, locks, and state of a printer.
+//
+// This is shared by normal and virtual printers, which otherwise get their
+// names, paths, and attributes from different places.
+//
+
+static void
+init_printer(ippeve_printer_t *printer)	// I - Printer
+{
+  size_t	i;			// Looping var
+
+
+  printer->ipv4           = -1;
+  printer->ipv6           = -1;
+  printer->start_time     = time(NULL);
+  printer->config_time    = printer->start_time;
+  printer->state          = IPP_PSTATE_IDLE;
+  printer->state_reasons  = IPPEVE_PREASON_NONE;
+  printer->state_time     = printer->start_time;
+  printer->jobs           = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, (cups_ahash_cb_t)hash_job, IPPEVE_JOB_HASH_SIZE, NULL, NULL);
+  printer->active_jobs    = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, NULL, 0, NULL, NULL);
+  printer->completed_jobs = cupsArrayNew((cups_array_cb_t)compare_completed, NULL, NULL, 0, NULL, NULL);
+  printer->next_job_id    = 1;
+  printer->pending_jobs   = cupsArrayNew((cups_array_cb_t)compare_pending, NULL, NULL, 0, NULL, NULL);
+
+  for (i = 0; i < (sizeof(printer->state_jobs) / sizeof(printer->state_jobs[0])); i ++)
+  {
+    if ((i + IPP_JSTATE_PENDING) >= IPP_JSTATE_CANCELED)
+      printer->state_jobs[i] = cupsArrayNew((cups_array_cb_t)compare_completed, NULL, NULL, 0, NULL, NULL);
+    else
+      printer->state_jobs[i] = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, NULL, 0, NULL, NULL);
+  }
+
+  cupsRWInit(&(printer->rwlock));
+  cupsMutexInit(&(printer->job_mutex));
+  cupsCondInit(&(printer->job_cond));
+  cupsMutexInit(&(printer->cache_mutex));
+  cupsMutexInit(&(printer->metrics.mutex));
+}
+
+
 //
 // 'ipp_cancel_job()' - Cancel a job.
 //
@@ -3084,16 +4206,7 @@ ipp_cancel_job(ippeve_client_t *client)	// I - Client
     default :
         // Cancel the job...
 	cupsRWLockWrite(&(client->printer->rwlock));
-
-	if (job->state == IPP_JSTATE_PROCESSING ||
-	    (job->state == IPP_JSTATE_HELD && job->fd >= 0))
-          job->cancel = 1;
-	else
-	{
-	  job->state     = IPP_JSTATE_CANCELED;
-	  job->completed = time(NULL);
-	}
-
+	cancel_job(job);
 	cupsRWUnlock(&(client->printer->rwlock));
 
 	respond_ipp(client, IPP_STATUS_OK, NULL);
@@ -3105,36 +4218,23 @@ ipp_cancel_job(ippeve_client_t *client)	// I - Client
 //
 // 'ipp_cancel_jobs()' - Cancel all jobs.
 //
-// Note: Since ippeveprinter doesn't do spooling, this really just cancels the
-// current job.
+// Note: This cancels all pending, held, and processing jobs regardless of the
+// requesting user.
 //
 
 static void
 ipp_cancel_jobs(
     ippeve_client_t *client)		// I - Client
 {
-  ippeve_job_t		*job;		// Job information
+  size_t		i;		// Looping var
 
 
   cupsRWLockWrite(&client->printer->rwlock);
 
-  if ((job = client->printer->active_job) != NULL)
-  {
-    // See if the job is already completed, canceled, or aborted; if so, we can't cancel...
-    if (job->state < IPP_JSTATE_CANCELED)
-    {
-      // Cancel the job...
-      if (job->state == IPP_JSTATE_PROCESSING || (job->state == IPP_JSTATE_HELD && job->fd >= 0))
-      {
-	job->cancel = 1;
-      }
-      else
-      {
-	job->state     = IPP_JSTATE_CANCELED;
-	job->completed = time(NULL);
-      }
-    }
-  }
+  // Canceling a pending job removes it from the list of not-completed jobs, so
+  // work from the end of the list...
+  for (i = cupsArrayGetCount(client->printer->active_jobs); i > 0; i --)
+    cancel_job((ippeve_job_t *)cupsArrayGetElement(client->printer->active_jobs, i - 1));
 
   respond_ipp(client, IPP_STATUS_OK, NULL);
 
@@ -3217,7 +4317,7 @@ ipp_create_job(ippeve_client_t *client)	// I - Client
   // Create the job...
   if ((job = create_job(client)) == NULL)
   {
-    respond_ipp(client, IPP_STATUS_ERROR_BUSY, "Currently printing another job.");
+    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create job.");
     return;
   }
 
@@ -3272,8 +4372,7 @@ ipp_get_jobs(ippeve_client_t *client)	// I - Client
   ipp_attribute_t	*attr;		// Current attribute
   const char		*which_jobs = NULL;
 					// which-jobs values
-  int			job_comparison;	// Job comparison
-  ipp_jstate_t		job_state;	// job-state value
+  cups_array_t		*jobs;		// Jobs to report
   int			first_index,	// First job index (1-based)
 			limit,		// Maximum number of jobs to return
 			matches;	// Number of jobs that match
@@ -3289,54 +4388,28 @@ ipp_get_jobs(ippeve_client_t *client)	// I - Client
   if ((attr = ippFindAttribute(client->request, "which-jobs", IPP_TAG_KEYWORD)) != NULL)
   {
     which_jobs = ippGetString(attr, 0, NULL);
-    fprintf(stderr, "%s Get-Jobs which-jobs=%s", client->hostname, which_jobs);
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s Get-Jobs which-jobs=%s", client->hostname, which_jobs);
   }
 
+  // Choose the job index to report from...
   if (!which_jobs || !strcmp(which_jobs, "not-completed"))
-  {
-    job_comparison = -1;
-    job_state      = IPP_JSTATE_STOPPED;
-  }
+    jobs = client->printer->active_jobs;
   else if (!strcmp(which_jobs, "completed"))
-  {
-    job_comparison = 1;
-    job_state      = IPP_JSTATE_CANCELED;
-  }
+    jobs = client->printer->completed_jobs;
   else if (!strcmp(which_jobs, "aborted"))
-  {
-    job_comparison = 0;
-    job_state      = IPP_JSTATE_ABORTED;
-  }
+    jobs = client->printer->state_jobs[IPP_JSTATE_ABORTED - IPP_JSTATE_PENDING];
   else if (!strcmp(which_jobs, "all"))
-  {
-    job_comparison = 1;
-    job_state      = IPP_JSTATE_PENDING;
-  }
+    jobs = client->printer->jobs;
   else if (!strcmp(which_jobs, "canceled"))
-  {
-    job_comparison = 0;
-    job_state      = IPP_JSTATE_CANCELED;
-  }
+    jobs = client->printer->state_jobs[IPP_JSTATE_CANCELED - IPP_JSTATE_PENDING];
   else if (!strcmp(which_jobs, "pending"))
-  {
-    job_comparison = 0;
-    job_state      = IPP_JSTATE_PENDING;
-  }
+    jobs = client->printer->state_jobs[IPP_JSTATE_PENDING - IPP_JSTATE_PENDING];
   else if (!strcmp(which_jobs, "pending-held"))
-  {
-    job_comparison = 0;
-    job_state      = IPP_JSTATE_HELD;
-  }
+    jobs = client->printer->state_jobs[IPP_JSTATE_HELD - IPP_JSTATE_PENDING];
   else if (!strcmp(which_jobs, "processing"))
-  {
-    job_comparison = 0;
-    job_state      = IPP_JSTATE_PROCESSING;
-  }
+    jobs = client->printer->state_jobs[IPP_JSTATE_PROCESSING - IPP_JSTATE_PENDING];
   else if (!strcmp(which_jobs, "processing-stopped"))
-  {
-    job_comparison = 0;
-    job_state      = IPP_JSTATE_STOPPED;
-  }
+    jobs = client->printer->state_jobs[IPP_JSTATE_STOPPED - IPP_JSTATE_PENDING];
   else
   {
     respond_ipp(client, IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES,
@@ -3351,7 +4424,7 @@ ipp_get_jobs(ippeve_client_t *client)	// I - Client
   {
     limit = ippGetInteger(attr, 0);
 
-    fprintf(stderr, "%s Get-Jobs limit=%d", client->hostname, limit);
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s Get-Jobs limit=%d", client->hostname, limit);
   }
   else
   {
@@ -3362,7 +4435,7 @@ ipp_get_jobs(ippeve_client_t *client)	// I - Client
   {
     first_i = (size_t)first_index - 1;
 
-    fprintf(stderr, "%s Get-Jobs first-index=%d", client->hostname, first_index);
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s Get-Jobs first-index=%d", client->hostname, first_index);
   }
   else
   {
@@ -3376,7 +4449,7 @@ ipp_get_jobs(ippeve_client_t *client)	// I - Client
   {
     int my_jobs = ippGetBoolean(attr, 0);
 
-    fprintf(stderr, "%s Get-Jobs my-jobs=%s\n", client->hostname, my_jobs ? "true" : "false");
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s Get-Jobs my-jobs=%s", client->hostname, my_jobs ? "true" : "false");
 
     if (my_jobs)
     {
@@ -3388,7 +4461,7 @@ ipp_get_jobs(ippeve_client_t *client)	// I - Client
 
       username = ippGetString(attr, 0, NULL);
 
-      fprintf(stderr, "%s Get-Jobs requesting-user-name=\"%s\"\n", client->hostname, username);
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s Get-Jobs requesting-user-name=\"%s\"", client->hostname, username);
     }
   }
 
@@ -3399,17 +4472,24 @@ ipp_get_jobs(ippeve_client_t *client)	// I - Client
 
   cupsRWLockRead(&(client->printer->rwlock));
 
-  for (i = 0, count = cupsArrayGetCount(client->printer->jobs), matches = 0; i < count && (limit <= 0 || matches < limit); i ++)
+  // Each job index is sorted newest first and only contains matching jobs, so
+  // first-index maps directly to an array index unless we filter by user...
+  for (i = username ? 0 : first_i, count = cupsArrayGetCount(jobs), matches = 0; i < count && (limit <= 0 || matches < limit); i ++)
   {
-    // Filter out jobs that don't match...
-    job = (ippeve_job_t *)cupsArrayGetElement(client->printer->jobs, i);
+    job = (ippeve_job_t *)cupsArrayGetElement(jobs, i);
 
-    if ((job_comparison < 0 && job->state > job_state) ||
-	(job_comparison == 0 && job->state != job_state) ||
-	(job_comparison > 0 && job->state < job_state) ||
-	i < first_i ||
-	(username && job->username && strcasecmp(username, job->username)))
-      continue;
+    if (username)
+    {
+      // Filter out jobs for other users, then skip to the first index...
+      if (job->username && strcasecmp(username, job->username))
+        continue;
+
+      if (first_i > 0)
+      {
+        first_i --;
+        continue;
+      }
+    }
 
     if (matches > 0)
       ippAddSeparator(client->response);
@@ -3446,6 +4526,8 @@ ipp_get_printer_attributes(
 
   copy_attributes(client->response, printer->attrs, ra, IPP_TAG_ZERO,
 		  IPP_TAG_CUPS_CONST);
+  copy_attributes(client->response, printer->local_attrs, ra, IPP_TAG_ZERO,
+		  IPP_TAG_CUPS_CONST);
 
   if (!ra || cupsArrayFind(ra, "printer-config-change-date-time"))
     ippAddDate(client->response, IPP_TAG_PRINTER, "printer-config-change-date-time", ippTimeToDate(printer->config_time));
@@ -3558,17 +4640,25 @@ ipp_get_printer_attributes(
     const char	*values[2];		// Values for attribute
     size_t	num_values = 0;		// Number of values
 
-    httpAssembleURI(HTTP_URI_CODING_ALL, uris[0], sizeof(uris[0]), "ipp", NULL, client->host_field, client->host_port, "/ipp/print");
+    httpAssembleURI(HTTP_URI_CODING_ALL, uris[0], sizeof(uris[0]), "ipp", NULL, client->host_field, client->host_port, printer->resource);
     values[num_values ++] = uris[0];
 
-    httpAssembleURI(HTTP_URI_CODING_ALL, uris[1], sizeof(uris[1]), "ipps", NULL, client->host_field, client->host_port, "/ipp/print");
+    httpAssembleURI(HTTP_URI_CODING_ALL, uris[1], sizeof(uris[1]), "ipps", NULL, client->host_field, client->host_port, printer->resource);
     values[num_values ++] = uris[1];
 
     ippAddStrings(client->response, IPP_TAG_PRINTER, IPP_TAG_URI, "printer-uri-supported", num_values, NULL, values);
   }
 
   if (!ra || cupsArrayFind(ra, "queued-job-count"))
-    ippAddInteger(client->response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", printer->active_job && printer->active_job->state < IPP_JSTATE_CANCELED);
+  {
+    size_t	queued;			// Number of pending and processing jobs
+
+    cupsMutexLock(&printer->job_mutex);
+    queued = cupsArrayGetCount(printer->pending_jobs) + printer->busy_workers;
+    cupsMutexUnlock(&printer->job_mutex);
+
+    ippAddInteger(client->response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", (int)queued);
+  }
 
   cupsRWUnlock(&(printer->rwlock));
 
@@ -3644,7 +4734,7 @@ ipp_print_job(ippeve_client_t *client)	// I - Client
   // Create the job...
   if ((job = create_job(client)) == NULL)
   {
-    respond_ipp(client, IPP_STATUS_ERROR_BUSY, "Currently printing another job.");
+    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create job.");
     return;
   }
 
@@ -3673,7 +4763,7 @@ ipp_print_uri(ippeve_client_t *client)	// I - Client
   // Create the job...
   if ((job = create_job(client)) == NULL)
   {
-    respond_ipp(client, IPP_STATUS_ERROR_BUSY, "Currently printing another job.");
+    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create job.");
     return;
   }
 
@@ -3747,12 +4837,12 @@ ipp_send_document(
     return;
   }
 
-  if (!have_data && !job->filename)
-    job->state = IPP_JSTATE_ABORTED;
-
   // Then finish getting the document data and process things...
   cupsRWLockWrite(&(client->printer->rwlock));
 
+  if (!have_data && !job->filename)
+    set_job_state(job, IPP_JSTATE_ABORTED);
+
   copy_attributes(job->attrs, client->request, NULL, IPP_TAG_JOB, 0);
 
   if ((attr = ippFindAttribute(job->attrs, "document-format-detected", IPP_TAG_MIMETYPE)) != NULL)
@@ -4798,6 +5888,31 @@ load_legacy_attributes(
 }
 
 
+//
+// 'metrics_printf()' - Send formatted text for the metrics resource.
+//
+
+static bool				// O - `true` on success, `false` on error
+metrics_printf(ippeve_client_t *client,	// I - Client
+	       const char      *format,	// I - Printf-style format string
+	       ...)			// I - Additional arguments as needed
+{
+  va_list	ap;			// Pointer to arguments
+  char		buffer[4096];		// Formatted text
+  int		bytes;			// Number of bytes
+
+
+  va_start(ap, format);
+  bytes = vsnprintf(buffer, sizeof(buffer), format, ap);
+  va_end(ap);
+
+  if (bytes < 0 || (size_t)bytes >= sizeof(buffer))
+    return (false);
+
+  return (httpWrite(client->http, buffer, (size_t)bytes) >= 0);
+}
+
+
 #if HAVE_LIBPAM
 //
 // 'pam_func()' - PAM conversation function.
@@ -4914,6 +6029,8 @@ process_attr_message(
       // Update Printer Status attribute...
       cupsRWLockWrite(&job->printer->rwlock);
 
+      copy_printer_attrs(job->printer);
+
       if ((attr = ippFindAttribute(job->printer->attrs, option->name, IPP_TAG_ZERO)) != NULL)
         ippDeleteAttribute(job->printer->attrs, attr);
 
@@ -4924,7 +6041,7 @@ process_attr_message(
     else
     {
       // Something else that isn't currently supported...
-      fprintf(stderr, "[Job %d] Ignoring update of attribute \"%s\" with value \"%s\".\n", job->id, option->name, option->value);
+      _cupsLogMessage(_CUPS_LOG_WARN, "[Job %d] Ignoring update of attribute \"%s\" with value \"%s\".", job->id, option->name, option->value);
     }
   }
 
@@ -4939,36 +6056,45 @@ process_attr_message(
 static void *				// O - Exit status
 process_client(ippeve_client_t *client)	// I - Client
 {
-  // Loop until we are out of requests or timeout (30 seconds)...
-  bool first_time = true;		// First time request?
+  bool		ok;			// Continue processing requests?
+  char		buf[1];			// First byte from client
+  double	start;			// Start time of request
+  ippeve_metrics_t *metrics = &client->printer->metrics;
+					// Server metrics
 
-  while (httpWait(client->http, 30000))
-  {
-    if (first_time)
-    {
-      // See if we need to negotiate a TLS connection...
-      char buf[1];			// First byte from client
 
-      if (recv(httpGetFd(client->http), buf, 1, MSG_PEEK) == 1 && (!buf[0] || !strchr("DGHOPT", buf[0])))
-      {
-        char	security[256];		// Security description
+  // Wait for the first request and see if we need to negotiate a TLS
+  // connection...
+  if ((ok = httpWait(client->http, IPPEVE_IDLE_TIMEOUT)) && recv(httpGetFd(client->http), buf, 1, MSG_PEEK) == 1 && (!buf[0] || !strchr("DGHOPT", buf[0])))
+  {
+    char	security[256];		// Security description
 
-        fprintf(stderr, "%s Starting HTTPS session.\n", client->hostname);
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s Starting HTTPS session.", client->hostname);
 
-	if (!httpSetEncryption(client->http, HTTP_ENCRYPTION_ALWAYS))
-	{
-	  fprintf(stderr, "%s Unable to encrypt connection: %s\n", client->hostname, cupsGetErrorString());
-	  break;
-        }
+    if (!httpSetEncryption(client->http, HTTP_ENCRYPTION_ALWAYS))
+    {
+      _cupsLogMessage(_CUPS_LOG_ERROR, "%s Unable to encrypt connection: %s", client->hostname, cupsGetErrorString());
+      ok = false;
+    }
+    else
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s Connection now encrypted (%s).", client->hostname, httpGetSecurity(client->http, security, sizeof(security)));
+  }
 
-	fprintf(stderr, "%s Connection now encrypted (%s).\n", client->hostname, httpGetSecurity(client->http, security, sizeof(security)));
-      }
+  // Then loop until we are out of requests or the connection is idle - the
+  // thread sleeps in the OS until each request arrives...
+  while (ok)
+  {
+    ok    = process_http(client) != 0;
+    start = client->start_clock;
 
-      first_time = false;
+    if (client->operation > HTTP_STATE_WAITING && client->operation < HTTP_STATE_MAX)
+    {
+      // Update the HTTP request metrics...
+      cupsMutexLock(&metrics->mutex);
+      metrics->http_requests[client->operation] ++;
+      update_histogram(&metrics->http_seconds, cupsGetClock() - start);
+      cupsMutexUnlock(&metrics->mutex);
     }
-
-    if (!process_http(client))
-      break;
   }
 
   // Close the conection to the client and return...
@@ -4995,11 +6121,15 @@ process_http(ippeve_client_t *client)	// I - Client connection
 					// Hostname
 			*ptr;		// Pointer into value
   int			port;		// Port number
+  ippeve_resource_t	resource;	// Static resource, if any
 
 
   // Clear state variables...
   client->username[0] = '\0';
 
+  if (client->printer->parent)
+    client->printer = client->printer->parent;
+
   ippDelete(client->request);
   ippDelete(client->response);
 
@@ -5007,39 +6137,43 @@ process_http(ippeve_client_t *client)	// I - Client connection
   client->response  = NULL;
   client->operation = HTTP_STATE_WAITING;
 
-  // Read a request from the connection...
-  while ((http_state = httpReadRequest(client->http, uri, sizeof(uri))) == HTTP_STATE_WAITING)
-    usleep(1);
+  // Wait for a request on the connection...
+  http_state = httpWaitRequest(client->http, uri, sizeof(uri), IPPEVE_IDLE_TIMEOUT);
 
   // Parse the request line...
-  if (http_state == HTTP_STATE_ERROR)
+  if (http_state == HTTP_STATE_WAITING)
+  {
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s Closing idle connection.", client->hostname);
+    return (0);
+  }
+  else if (http_state == HTTP_STATE_ERROR)
   {
     if (httpGetError(client->http) == EPIPE)
-      fprintf(stderr, "%s Client closed connection.\n", client->hostname);
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s Client closed connection.", client->hostname);
     else
-      fprintf(stderr, "%s Bad request line (%s).\n", client->hostname, strerror(httpGetError(client->http)));
+      _cupsLogMessage(_CUPS_LOG_ERROR, "%s Bad request line (%s).", client->hostname, strerror(httpGetError(client->http)));
 
     return (0);
   }
   else if (http_state == HTTP_STATE_UNKNOWN_METHOD)
   {
-    fprintf(stderr, "%s Bad/unknown operation.\n", client->hostname);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "%s Bad/unknown operation.", client->hostname);
     respond_http(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0);
     return (0);
   }
   else if (http_state == HTTP_STATE_UNKNOWN_VERSION)
   {
-    fprintf(stderr, "%s Bad HTTP version.\n", client->hostname);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "%s Bad HTTP version.", client->hostname);
     respond_http(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0);
     return (0);
   }
 
-  fprintf(stderr, "%s %s %s\n", client->hostname, httpStateString(http_state), uri);
+  _cupsLogMessage(_CUPS_LOG_INFO, "%s %s %s", client->hostname, httpStateString(http_state), uri);
 
   // Separate the URI into its components...
   if (httpSeparateURI(HTTP_URI_CODING_MOST, uri, scheme, sizeof(scheme), userpass, sizeof(userpass), hostname, sizeof(hostname), &port, client->uri, sizeof(client->uri)) < HTTP_URI_STATUS_OK && (http_state != HTTP_STATE_OPTIONS || strcmp(uri, "*")))
   {
-    fprintf(stderr, "%s Bad URI \"%s\".\n", client->hostname, uri);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "%s Bad URI \"%s\".", client->hostname, uri);
     respond_http(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0);
     return (0);
   }
@@ -5048,8 +6182,9 @@ process_http(ippeve_client_t *client)	// I - Client connection
     *(client->options)++ = '\0';
 
   // Process the request...
-  client->start     = time(NULL);
-  client->operation = httpGetState(client->http);
+  client->start       = time(NULL);
+  client->start_clock = cupsGetClock();
+  client->operation   = httpGetState(client->http);
 
   // Parse incoming parameters until the status changes...
   while ((http_status = httpUpdate(client->http)) == HTTP_STATUS_CONTINUE);
@@ -5064,7 +6199,7 @@ process_http(ippeve_client_t *client)	// I - Client connection
   if (!httpGetField(client->http, HTTP_FIELD_HOST)[0] && httpGetVersion(client->http) >= HTTP_VERSION_1_1)
   {
     // HTTP/1.1 and higher require the "Host:" field...
-    fprintf(stderr, "%s Missing Host: header.\n", client->hostname);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "%s Missing Host: header.", client->hostname);
     respond_http(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0);
     return (0);
   }
@@ -5088,7 +6223,7 @@ process_http(ippeve_client_t *client)	// I - Client connection
   if (!isdigit(client->host_field[0] & 255) && client->host_field[0] != '[' && strcmp(client->host_field, client->printer->hostname) && strcmp(client->host_field, "localhost") &&
       (!ptr || (strcmp(ptr, ".local") && strcmp(ptr, ".local."))))
   {
-    fprintf(stderr, "%s Bad Host: header '%s'.\n", client->hostname, client->host_field);
+    _cupsLogMessage(_CUPS_LOG_ERROR, "%s Bad Host: header '%s'.", client->hostname, client->host_field);
     respond_http(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0);
     return (0);
   }
@@ -5103,20 +6238,32 @@ process_http(ippeve_client_t *client)	// I - Client connection
       if (!respond_http(client, HTTP_STATUS_SWITCHING_PROTOCOLS, NULL, NULL, 0))
         return (0);
 
-      fprintf(stderr, "%s Upgrading to encrypted connection.\n", client->hostname);
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s Upgrading to encrypted connection.", client->hostname);
 
       if (!httpSetEncryption(client->http, HTTP_ENCRYPTION_REQUIRED))
       {
-        fprintf(stderr, "%s Unable to encrypt connection: %s\n", client->hostname, cupsGetErrorString());
+        _cupsLogMessage(_CUPS_LOG_ERROR, "%s Unable to encrypt connection: %s", client->hostname, cupsGetErrorString());
 	return (0);
       }
 
-      fprintf(stderr, "%s Connection now encrypted (%s).\n", client->hostname, httpGetSecurity(client->http, security, sizeof(security)));
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s Connection now encrypted (%s).", client->hostname, httpGetSecurity(client->http, security, sizeof(security)));
     }
     else if (!respond_http(client, HTTP_STATUS_NOT_IMPLEMENTED, NULL, NULL, 0))
       return (0);
   }
 
+  // Map static resources...
+  if (!strcmp(client->uri, "/icon-sm.png"))
+    resource = IPPEVE_RESOURCE_ICON_SM;
+  else if (!strcmp(client->uri, "/icon.png"))
+    resource = IPPEVE_RESOURCE_ICON;
+  else if (!strcmp(client->uri, "/icon-lg.png"))
+    resource = IPPEVE_RESOURCE_ICON_LG;
+  else if (!strcmp(client->uri, "/en.strings"))
+    resource = IPPEVE_RESOURCE_STRINGS;
+  else
+    resource = IPPEVE_RESOURCE_MAX;
+
   // Handle new transfers...
   switch (client->operation)
   {
@@ -5125,183 +6272,18 @@ process_http(ippeve_client_t *client)	// I - Client connection
 	return (respond_http(client, HTTP_STATUS_OK, NULL, NULL, 0));
 
     case HTTP_STATE_HEAD :
-        if (!strcmp(client->uri, "/en.strings"))
-	  return (respond_http(client, HTTP_STATUS_OK, NULL, "text/strings", 0));
-        else if (!strcmp(client->uri, "/icon.png") || !strcmp(client->uri, "/icon-lg.png") || !strcmp(client->uri, "/icon-sm.png"))
-	  return (respond_http(client, HTTP_STATUS_OK, NULL, "image/png", 0));
+        if (resource < IPPEVE_RESOURCE_MAX)
+	  return (respond_resource(client, resource));
 	else if (!strcmp(client->uri, "/") || !strcmp(client->uri, "/media") || !strcmp(client->uri, "/supplies"))
 	  return (respond_http(client, HTTP_STATUS_OK, NULL, "text/html", 0));
 	else
 	  return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
 
     case HTTP_STATE_GET :
-        if (!strcmp(client->uri, "/en.strings"))
-	{
-	  // Send strings file.
-          if (client->printer->strings)
-          {
-	    int		fd;		// Icon file
-	    struct stat	fileinfo;	// Icon file information
-	    char	buffer[4096];	// Copy buffer
-	    ssize_t	bytes;		// Bytes
-
-	    if ((fd = open(client->printer->strings, O_RDONLY | O_BINARY)) >= 0)
-	    {
-	      if (fstat(fd, &fileinfo))
-	      {
-		close(fd);
-		return (0);
-	      }
-	      else if (!respond_http(client, HTTP_STATUS_OK, NULL, "text/strings", (size_t)fileinfo.st_size))
-	      {
-		close(fd);
-		return (0);
-	      }
-
-	      while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
-		httpWrite(client->http, buffer, (size_t)bytes);
-
-	      httpFlushWrite(client->http);
-
-	      close(fd);
-	    }
-	    else
-	      return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
-	  }
-	  else
-	    return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
-        }
-        else if (!strcmp(client->uri, "/icon.png"))
-	{
-	  // Send medium PNG icon file.
-          if (client->printer->icons[1])
-          {
-	    int		fd;		// Icon file
-	    struct stat	fileinfo;	// Icon file information
-	    char	buffer[4096];	// Copy buffer
-	    ssize_t	bytes;		// Bytes
-
-	    if ((fd = open(client->printer->icons[1], O_RDONLY | O_BINARY)) >= 0)
-	    {
-	      if (fstat(fd, &fileinfo))
-	      {
-		close(fd);
-		return (0);
-	      }
-	      else if (!respond_http(client, HTTP_STATUS_OK, NULL, "image/png", (size_t)fileinfo.st_size))
-	      {
-		close(fd);
-		return (0);
-	      }
-
-	      while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
-		httpWrite(client->http, buffer, (size_t)bytes);
-
-	      httpFlushWrite(client->http);
-
-	      close(fd);
-	    }
-	    else
-	      return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
-	  }
-	  else
-	  {
-	    fputs("Icon file is internal printer.png.\n", stderr);
-
-	    if (!respond_http(client, HTTP_STATUS_OK, NULL, "image/png", sizeof(printer_png)))
-	      return (0);
-
-            httpWrite(client->http, (const char *)printer_png, sizeof(printer_png));
-	    httpFlushWrite(client->http);
-	  }
-	}
-        else if (!strcmp(client->uri, "/icon-lg.png"))
-	{
-	  // Send large PNG icon file.
-          if (client->printer->icons[2])
-          {
-	    int		fd;		// Icon file
-	    struct stat	fileinfo;	// Icon file information
-	    char	buffer[4096];	// Copy buffer
-	    ssize_t	bytes;		// Bytes
-
-	    if ((fd = open(client->printer->icons[2], O_RDONLY | O_BINARY)) >= 0)
-	    {
-	      if (fstat(fd, &fileinfo))
-	      {
-		close(fd);
-		return (0);
-	      }
-	      else if (!respond_http(client, HTTP_STATUS_OK, NULL, "image/png", (size_t)fileinfo.st_size))
-	      {
-		close(fd);
-		return (0);
-	      }
-
-	      while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
-		httpWrite(client->http, buffer, (size_t)bytes);
-
-	      httpFlushWrite(client->http);
-
-	      close(fd);
-	    }
-	    else
-	      return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
-	  }
-	  else
-	  {
-	    fputs("Icon file is internal printer-lg.png.\n", stderr);
-
-	    if (!respond_http(client, HTTP_STATUS_OK, NULL, "image/png", sizeof(printer_lg_png)))
-	      return (0);
-
-            httpWrite(client->http, (const char *)printer_lg_png, sizeof(printer_lg_png));
-	    httpFlushWrite(client->http);
-	  }
-	}
-        else if (!strcmp(client->uri, "/icon-sm.png"))
+        if (resource < IPPEVE_RESOURCE_MAX)
 	{
-	  // Send small PNG icon file.
-          if (client->printer->icons[0])
-          {
-	    int		fd;		// Icon file
-	    struct stat	fileinfo;	// Icon file information
-	    char	buffer[4096];	// Copy buffer
-	    ssize_t	bytes;		// Bytes
-
-	    if ((fd = open(client->printer->icons[0], O_RDONLY | O_BINARY)) >= 0)
-	    {
-	      if (fstat(fd, &fileinfo))
-	      {
-		close(fd);
-		return (0);
-	      }
-	      else if (!respond_http(client, HTTP_STATUS_OK, NULL, "image/png", (size_t)fileinfo.st_size))
-	      {
-		close(fd);
-		return (0);
-	      }
-
-	      while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
-		httpWrite(client->http, buffer, (size_t)bytes);
-
-	      httpFlushWrite(client->http);
-
-	      close(fd);
-	    }
-	    else
-	      return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
-	  }
-	  else
-	  {
-	    fputs("Icon file is internal printer-sm.png.\n", stderr);
-
-	    if (!respond_http(client, HTTP_STATUS_OK, NULL, "image/png", sizeof(printer_sm_png)))
-	      return (0);
-
-            httpWrite(client->http, (const char *)printer_sm_png, sizeof(printer_sm_png));
-	    httpFlushWrite(client->http);
-	  }
+	  // Send strings or PNG icon file.
+	  return (respond_resource(client, resource));
 	}
 	else
 	{
@@ -5321,6 +6303,11 @@ process_http(ippeve_client_t *client)	// I - Client connection
 	    // Show web media page...
 	    return (show_media(client));
 	  }
+	  else if (!strcmp(client->uri, "/metrics"))
+	  {
+	    // Send server metrics...
+	    return (respond_metrics(client));
+	  }
 	  else if (!strcmp(client->uri, "/supplies"))
 	  {
 	    // Show web supplies page...
@@ -5346,7 +6333,7 @@ process_http(ippeve_client_t *client)	// I - Client connection
 	{
 	  if (ipp_state == IPP_STATE_ERROR)
 	  {
-            fprintf(stderr, "%s IPP read error (%s).\n", client->hostname, cupsGetErrorString());
+            _cupsLogMessage(_CUPS_LOG_ERROR, "%s IPP read error (%s).", client->hostname, cupsGetErrorString());
 	    respond_http(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0);
 	    return (0);
 	  }
@@ -5375,9 +6362,15 @@ process_ipp(ippeve_client_t *client)	// I - Client
   ipp_attribute_t	*charset;	// Character set attribute
   ipp_attribute_t	*language;	// Language attribute
   ipp_attribute_t	*uri;		// Printer URI attribute
+  ippeve_printer_t	*printer;	// Printer for request
   int			major, minor;	// Version number
   const char		*name;		// Name of attribute
   http_status_t		status;		// Authentication status
+  double		start = cupsGetClock();
+					// Start time of request
+  ipp_status_t		ipp_status;	// Response status
+  ippeve_metrics_t	*metrics = &client->printer->metrics;
+					// Server metrics
 
 
   debug_attributes("Request", client->request, 1);
@@ -5484,7 +6477,7 @@ process_ipp(ippeve_client_t *client)	// I - Client
 	{
 	  respond_ipp(client, IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES, "Bad %s value '%s'.", name, ippGetString(uri, 0, NULL));
         }
-        else if ((!strcmp(name, "job-uri") && strncmp(resource, "/ipp/print/", 11)) || (!strcmp(name, "printer-uri") && strcmp(resource, "/ipp/print") && (strcmp(resource, "/") || ippGetOperation(client->request) != IPP_OP_GET_PRINTER_ATTRIBUTES)))
+        else if ((printer = (!strcmp(name, "printer-uri") && !strcmp(resource, "/") && ippGetOperation(client->request) == IPP_OP_GET_PRINTER_ATTRIBUTES) ? client->printer : find_printer(client->printer, resource, !strcmp(name, "job-uri"))) == NULL)
 	{
 	  respond_ipp(client, IPP_STATUS_ERROR_NOT_FOUND, "%s %s not found.", name, ippGetString(uri, 0, NULL));
 	}
@@ -5496,6 +6489,9 @@ process_ipp(ippeve_client_t *client)	// I - Client
         }
         else
 	{
+	  // Use the printer for this request...
+	  client->printer = printer;
+
 	  // Handle HTTP Expect...
 	  if (httpGetExpect(client->http))
 	  {
@@ -5581,6 +6577,19 @@ process_ipp(ippeve_client_t *client)	// I - Client
     }
   }
 
+  // Update the IPP request metrics...
+  ipp_status = ippGetStatusCode(client->response);
+
+  cupsMutexLock(&metrics->mutex);
+  if (ipp_status < IPP_STATUS_ERROR_BAD_REQUEST)
+    metrics->ipp_status[0] ++;
+  else if (ipp_status < IPP_STATUS_ERROR_INTERNAL)
+    metrics->ipp_status[1] ++;
+  else
+    metrics->ipp_status[2] ++;
+  update_histogram(metrics->ipp_seconds + (client->operation_id > 0 && client->operation_id < IPPEVE_METRICS_MAX_OP ? client->operation_id : 0), cupsGetClock() - start);
+  cupsMutexUnlock(&metrics->mutex);
+
   // Send the HTTP header and return...
   if (httpGetState(client->http) != HTTP_STATE_POST_SEND)
     httpFlush(client->http);		// Flush trailing (junk) data
@@ -5592,79 +6601,80 @@ process_ipp(ippeve_client_t *client)	// I - Client
 //
 // 'process_job()' - Process a print job.
 //
+// This function is called by a worker thread after the job has been moved to
+// the processing state and returns the final job state.
+//
 
-static void *				// O - Thread exit status
+static ipp_jstate_t			// O - Final job state
 process_job(ippeve_job_t *job)		// I - Job
 {
-  job->state          = IPP_JSTATE_PROCESSING;
-  job->printer->state = IPP_PSTATE_PROCESSING;
-  job->processing     = time(NULL);
-
-  while (job->printer->state_reasons & IPPEVE_PREASON_MEDIA_EMPTY)
-  {
-    job->printer->state_reasons |= IPPEVE_PREASON_MEDIA_NEEDED;
-
-    sleep(1);
-  }
+  ipp_jstate_t	state = IPP_JSTATE_PROCESSING;
+					// Final job state
+  double	started = cupsGetClock();// Start time
+  ippeve_metrics_t *metrics = job->printer->parent ? &job->printer->parent->metrics : &job->printer->metrics;
+					// Server metrics
 
-  job->printer->state_reasons &= (ippeve_preason_t)~IPPEVE_PREASON_MEDIA_NEEDED;
 
   if (job->printer->command)
   {
     // Execute a command with the job spool file and wait for it to complete...
-    int 		pid,		// Process ID
-			status;		// Exit status
+    int			status;		// Exit status
     struct timeval	start,		// Start time
 			end;		// End time
     char		*myargv[3],	// Command-line arguments
-			*myenvp[400];	// Environment variables
-    int			myenvc;		// Number of environment variables
+			*myenvp[IPPEVE_MAX_ENV];
+					// Environment variables
+    int			myenvc,		// Number of environment variables
+			jobenvc;	// First job environment variable
+    ippeve_env_t	*env;		// Cached printer environment
     ipp_attribute_t	*attr;		// Job attribute
     char		val[1280],	// IPP_NAME=value
 			*valptr;	// Pointer into string
 #ifndef _WIN32
+    pid_t		pid;		// Process ID
     int			mystdout = -1;	// File for stdout
     int			mypipe[2];	// Pipe for stderr
+    posix_spawn_file_actions_t actions;	// Spawn file actions
     char		line[2048],	// Line from stderr
 			*ptr,		// Pointer into line
 			*endptr;	// End of line
     ssize_t		bytes;		// Bytes read
 #endif // !_WIN32
 
-    fprintf(stderr, "[Job %d] Running command \"%s %s\".\n", job->id, job->printer->command, job->filename);
+    _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Running command \"%s %s\".", job->id, job->printer->command, job->filename);
     gettimeofday(&start, NULL);
 
     // Setup the command-line arguments...
     myargv[0] = job->printer->command;
-    myargv[1] = job->filename;
+    myargv[1] = job->stream_fd >= 0 ? (char *)"/dev/stdin" : job->filename;
     myargv[2] = NULL;
 
-    // Copy the current environment, then add environment variables for every
-    // Job attribute and Printer -default attributes...
-    for (myenvc = 0; environ[myenvc] && myenvc < (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 1); myenvc ++)
-      myenvp[myenvc] = strdup(environ[myenvc]);
+    // Use the cached printer environment, then add environment variables for
+    // the document format and every Job attribute...
+    cupsRWLockWrite(&job->printer->rwlock);
+
+    if (!job->printer->env)
+      job->printer->env = create_printer_env(job->printer);
+
+    if ((env = job->printer->env) != NULL)
+      env->use ++;
+
+    cupsRWUnlock(&job->printer->rwlock);
 
-    if (myenvc > (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 32))
+    if (!env)
     {
-      fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
-      job->state = IPP_JSTATE_ABORTED;
+      _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Too many environment variables to process job.", job->id);
+      state = IPP_JSTATE_ABORTED;
       goto error;
     }
 
-    snprintf(val, sizeof(val), "CONTENT_TYPE=%s", job->format);
-    myenvp[myenvc ++] = strdup(val);
+    for (myenvc = 0; myenvc < env->num_vars; myenvc ++)
+      myenvp[myenvc] = env->vars[myenvc];
 
-    if (job->printer->device_uri)
-    {
-      snprintf(val, sizeof(val), "DEVICE_URI=%s", job->printer->device_uri);
-      myenvp[myenvc ++] = strdup(val);
-    }
+    jobenvc = myenvc;
 
-    if (job->printer->output_format)
-    {
-      snprintf(val, sizeof(val), "OUTPUT_TYPE=%s", job->printer->output_format);
-      myenvp[myenvc ++] = strdup(val);
-    }
+    snprintf(val, sizeof(val), "CONTENT_TYPE=%s", job->format);
+    myenvp[myenvc ++] = strdup(val);
 
     if (job->password[0])
     {
@@ -5672,46 +6682,7 @@ process_job(ippeve_job_t *job)		// I - Job
       myenvp[myenvc ++] = strdup(val);
     }
 
-    for (attr = ippGetFirstAttribute(job->printer->attrs); attr && myenvc < (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 1); attr = ippGetNextAttribute(job->printer->attrs))
-    {
-      // Convert "attribute-name-default" to "IPP_ATTRIBUTE_NAME_DEFAULT=",
-      // "attribute-name-ready" to "IPP_ATTRIBUTE_NAME_READY",
-      // "attribute-name-supported" to "IPP_ATTRIBUTE_NAME_SUPPORTED",
-      // "pclm-xxx" to "IPP_PCLM_XXX", and "pwg-xxx" to "IPP_PWG_XXX",
-      // then add the value(s) from the attribute.
-      const char	*name = ippGetName(attr),
-					// Attribute name
-			*default_suffix = strstr(name, "-default"),
-					// Suffix on attribute name
-			*ready_suffix = strstr(name, "-ready"),
-					// Suffix on attribute name
-			*supported_suffix = strstr(name, "-supported");
-					// Suffix on attribute name
-
-      if (strncmp(name, "pclm-", 5) && strncmp(name, "pwg-", 4) && (!default_suffix || default_suffix[8]) && (!ready_suffix || ready_suffix[6]) && (!supported_suffix || supported_suffix[10]))
-        continue;
-
-      valptr = val;
-      *valptr++ = 'I';
-      *valptr++ = 'P';
-      *valptr++ = 'P';
-      *valptr++ = '_';
-      while (*name && valptr < (val + sizeof(val) - 2))
-      {
-        if (*name == '-')
-	  *valptr++ = '_';
-	else
-	  *valptr++ = (char)toupper(*name & 255);
-
-	name ++;
-      }
-      *valptr++ = '=';
-      ippAttributeString(attr, valptr, sizeof(val) - (size_t)(valptr - val));
-
-      myenvp[myenvc++] = strdup(val);
-    }
-
-    for (attr = ippGetFirstAttribute(job->attrs); attr && myenvc < (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 1); attr = ippGetNextAttribute(job->attrs))
+    for (attr = ippGetFirstAttribute(job->attrs); attr && myenvc < (IPPEVE_MAX_ENV - 1); attr = ippGetNextAttribute(job->attrs))
     {
       // Convert "attribute-name" to "IPP_ATTRIBUTE_NAME=" and then add the
       // value(s) from the attribute.
@@ -5741,15 +6712,22 @@ process_job(ippeve_job_t *job)		// I - Job
       myenvp[myenvc++] = strdup(val);
     }
 
+    myenvp[myenvc] = NULL;
+
     if (attr)
     {
-      fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
-      job->state = IPP_JSTATE_ABORTED;
+      _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Too many environment variables to process job.", job->id);
+      state = IPP_JSTATE_ABORTED;
+
+      while (myenvc > jobenvc)
+	free(myenvp[-- myenvc]);
+
+      cupsRWLockWrite(&job->printer->rwlock);
+      release_printer_env(env);
+      cupsRWUnlock(&job->printer->rwlock);
       goto error;
     }
 
-    myenvp[myenvc] = NULL;
-
     // Now run the program...
 #ifdef _WIN32
     status = _spawnvpe(_P_WAIT, job->printer->command, myargv, myenvp);
@@ -5766,7 +6744,7 @@ process_job(ippeve_job_t *job)		// I - Job
 
       if (httpSeparateURI(HTTP_URI_CODING_ALL, job->printer->device_uri, scheme, sizeof(scheme), userpass, sizeof(userpass), host, sizeof(host), &port, resource, sizeof(resource)) < HTTP_URI_STATUS_OK)
       {
-        fprintf(stderr, "[Job %d] Bad device URI '%s'.\n", job->id, job->printer->device_uri);
+        _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Bad device URI '%s'.", job->id, job->printer->device_uri);
       }
       else if (!strcmp(scheme, "file"))
       {
@@ -5776,37 +6754,37 @@ process_job(ippeve_job_t *job)		// I - Job
         {
           if (errno == ENOENT)
           {
-            if ((mystdout = open(resource, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666)) >= 0)
-	      fprintf(stderr, "[Job %d] Saving print command output to '%s'.\n", job->id, resource);
+            if ((mystdout = open(resource, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC, 0666)) >= 0)
+	      _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Saving print command output to '%s'.", job->id, resource);
 	    else
-	      fprintf(stderr, "[Job %d] Unable to create '%s': %s\n", job->id, resource, strerror(errno));
+	      _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to create '%s': %s", job->id, resource, strerror(errno));
           }
           else
           {
-            fprintf(stderr, "[Job %d] Unable to access '%s': %s\n", job->id, resource, strerror(errno));
+            _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to access '%s': %s", job->id, resource, strerror(errno));
           }
         }
         else if (S_ISDIR(fileinfo.st_mode))
         {
           if ((mystdout = create_job_file(job, line, sizeof(line), resource, "prn")) >= 0)
-	    fprintf(stderr, "[Job %d] Saving print command output to '%s'.\n", job->id, line);
+	    _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Saving print command output to '%s'.", job->id, line);
           else
-            fprintf(stderr, "[Job %d] Unable to create '%s': %s\n", job->id, line, strerror(errno));
+            _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to create '%s': %s", job->id, line, strerror(errno));
         }
 	else if (!S_ISREG(fileinfo.st_mode))
 	{
-	  if ((mystdout = open(resource, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666)) >= 0)
-	    fprintf(stderr, "[Job %d] Saving print command output to '%s'.\n", job->id, resource);
+	  if ((mystdout = open(resource, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC, 0666)) >= 0)
+	    _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Saving print command output to '%s'.", job->id, resource);
 	  else
-            fprintf(stderr, "[Job %d] Unable to create '%s': %s\n", job->id, resource, strerror(errno));
+            _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to create '%s': %s", job->id, resource, strerror(errno));
 	}
-        else if ((mystdout = open(resource, O_WRONLY | O_BINARY)) >= 0)
+        else if ((mystdout = open(resource, O_WRONLY | O_BINARY | O_CLOEXEC)) >= 0)
         {
-	  fprintf(stderr, "[Job %d] Saving print command output to '%s'.\n", job->id, resource);
+	  _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Saving print command output to '%s'.", job->id, resource);
 	}
 	else
 	{
-	  fprintf(stderr, "[Job %d] Unable to open '%s': %s\n", job->id, resource, strerror(errno));
+	  _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to open '%s': %s", job->id, resource, strerror(errno));
 	}
       }
       else if (!strcmp(scheme, "socket"))
@@ -5817,59 +6795,68 @@ process_job(ippeve_job_t *job)		// I - Job
         snprintf(service, sizeof(service), "%d", port);
 
         if ((addrlist = httpAddrGetList(host, AF_UNSPEC, service)) == NULL)
-          fprintf(stderr, "[Job %d] Unable to find '%s': %s\n", job->id, host, cupsGetErrorString());
+          _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to find '%s': %s", job->id, host, cupsGetErrorString());
         else if (!httpAddrConnect(addrlist, &mystdout, 30000, &(job->cancel)))
-          fprintf(stderr, "[Job %d] Unable to connect to '%s' on port %d: %s\n", job->id, host, port, cupsGetErrorString());
+          _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to connect to '%s' on port %d: %s", job->id, host, port, cupsGetErrorString());
 
         httpAddrFreeList(addrlist);
       }
       else
       {
-        fprintf(stderr, "[Job %d] Unsupported device URI scheme '%s'.\n", job->id, scheme);
+        _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unsupported device URI scheme '%s'.", job->id, scheme);
       }
     }
     else if ((mystdout = create_job_file(job, line, sizeof(line), job->printer->directory, "prn")) >= 0)
     {
-      fprintf(stderr, "[Job %d] Saving print command output to '%s'.\n", job->id, line);
+      _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Saving print command output to '%s'.", job->id, line);
     }
 
     if (mystdout < 0)
     {
-      if ((mystdout = open("/dev/null", O_WRONLY | O_BINARY)) < 0)
-        fprintf(stderr, "[Job %d] Unable to redirect command output to /dev/null: %s", job->id, strerror(errno));
+      if ((mystdout = open("/dev/null", O_WRONLY | O_BINARY | O_CLOEXEC)) < 0)
+        _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to redirect command output to /dev/null: %s", job->id, strerror(errno));
     }
 
+    // Don't let commands for other jobs inherit the output file and pipe.  The
+    // files and pipe are created close-on-exec where possible since another
+    // thread can start a command at any time...
+#ifdef HAVE_PIPE2
+    if (pipe2(mypipe, O_CLOEXEC))
+#else
     if (pipe(mypipe))
+#endif // HAVE_PIPE2
     {
-      fprintf(stderr, "[Job %d] Unable to create pipe for stderr: %s\n", job->id, strerror(errno));
+      _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to create pipe for stderr: %s", job->id, strerror(errno));
       mypipe[0] = mypipe[1] = -1;
     }
 
-    if ((pid = fork()) == 0)
+    if (mystdout >= 0)
+      fcntl(mystdout, F_SETFD, fcntl(mystdout, F_GETFD) | FD_CLOEXEC);
+
+#ifndef HAVE_PIPE2
+    if (mypipe[0] >= 0)
     {
-      // Child comes here...
-      if (mystdout >= 0)
-      {
-        close(1);
-        dup2(mystdout, 1);
-        close(mystdout);
-      }
+      fcntl(mypipe[0], F_SETFD, fcntl(mypipe[0], F_GETFD) | FD_CLOEXEC);
+      fcntl(mypipe[1], F_SETFD, fcntl(mypipe[1], F_GETFD) | FD_CLOEXEC);
+    }
+#endif // !HAVE_PIPE2
 
-      if (mypipe[1] >= 0)
-      {
-        close(2);
-	dup2(mypipe[1], 2);
-	close(mypipe[0]);
-	close(mypipe[1]);
-      }
+    // Redirect stdin, stdout, and stderr in the child process...
+    posix_spawn_file_actions_init(&actions);
 
-      execve(job->printer->command, myargv, myenvp);
-      exit(errno);
-    }
-    else if (pid < 0)
+    if (job->stream_fd >= 0)
+      posix_spawn_file_actions_adddup2(&actions, job->stream_fd, 0);
+
+    if (mystdout >= 0)
+      posix_spawn_file_actions_adddup2(&actions, mystdout, 1);
+
+    if (mypipe[1] >= 0)
+      posix_spawn_file_actions_adddup2(&actions, mypipe[1], 2);
+
+    if ((status = posix_spawn(&pid, job->printer->command, &actions, NULL, myargv, myenvp)) != 0)
     {
-      // Unable to fork process...
-      fprintf(stderr, "[Job %d] Unable to start job processing command: %s\n", job->id, strerror(errno));
+      // Unable to start process...
+      _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to start job processing command: %s", job->id, strerror(status));
       status = -1;
 
       if (mystdout >= 0)
@@ -5880,21 +6867,19 @@ process_job(ippeve_job_t *job)		// I - Job
 	close(mypipe[0]);
 	close(mypipe[1]);
       }
-
-      // Free memory used for environment...
-      while (myenvc > 0)
-	free(myenvp[-- myenvc]);
     }
     else
     {
-      // Free memory used for environment...
-      while (myenvc > 0)
-	free(myenvp[-- myenvc]);
-
-      // Close the output file in the parent process...
+      // Close the output file and document pipe in the parent process...
       if (mystdout >= 0)
 	close(mystdout);
 
+      if (job->stream_fd >= 0)
+      {
+        close(job->stream_fd);
+        job->stream_fd = -1;
+      }
+
       // If the pipe exists, read from it until EOF...
       if (mypipe[0] >= 0)
       {
@@ -5946,7 +6931,7 @@ process_job(ippeve_job_t *job)		// I - Job
 	    }
 
 	    if (Verbosity >= level)
-	      fprintf(stderr, "[Job %d] Command - %s\n", job->id, line);
+	      _cupsLogMessage(level == 0 ? _CUPS_LOG_ERROR : level == 1 ? _CUPS_LOG_INFO : _CUPS_LOG_DEBUG, "[Job %d] Command - %s", job->id, line);
 
 	    bytes = ptr - line;
             if (ptr < endptr)
@@ -5966,29 +6951,39 @@ process_job(ippeve_job_t *job)		// I - Job
       while (wait(&status) < 0);
 #  endif // HAVE_WAITPID
     }
+
+    posix_spawn_file_actions_destroy(&actions);
 #endif // _WIN32
 
+    // Free memory used for the job environment...
+    while (myenvc > jobenvc)
+      free(myenvp[-- myenvc]);
+
+    cupsRWLockWrite(&job->printer->rwlock);
+    release_printer_env(env);
+    cupsRWUnlock(&job->printer->rwlock);
+
     if (status)
     {
 #ifndef _WIN32
       if (WIFEXITED(status))
 #endif // !_WIN32
-	fprintf(stderr, "[Job %d] Command \"%s\" exited with status %d.\n", job->id,  job->printer->command, WEXITSTATUS(status));
+	_cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Command \"%s\" exited with status %d.", job->id,  job->printer->command, WEXITSTATUS(status));
 #ifndef _WIN32
       else
-	fprintf(stderr, "[Job %d] Command \"%s\" terminated with signal %d.\n", job->id, job->printer->command, WTERMSIG(status));
+	_cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Command \"%s\" terminated with signal %d.", job->id, job->printer->command, WTERMSIG(status));
 #endif // !_WIN32
-      job->state = IPP_JSTATE_ABORTED;
+      state = IPP_JSTATE_ABORTED;
     }
     else
     {
-      fprintf(stderr, "[Job %d] Command \"%s\" completed successfully.\n", job->id, job->printer->command);
+      _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Command \"%s\" completed successfully.", job->id, job->printer->command);
     }
 
     // Report the total processing time...
     gettimeofday(&end, NULL);
 
-    fprintf(stderr, "[Job %d] Processing time was %.3f seconds.\n", job->id, end.tv_sec - start.tv_sec + 0.000001 * (end.tv_usec - start.tv_usec));
+    _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Processing time was %.3f seconds.", job->id, end.tv_sec - start.tv_sec + 0.000001 * (end.tv_usec - start.tv_usec));
   }
   else
   {
@@ -5997,15 +6992,113 @@ process_job(ippeve_job_t *job)		// I - Job
   }
 
   if (job->cancel)
-    job->state = IPP_JSTATE_CANCELED;
-  else if (job->state == IPP_JSTATE_PROCESSING)
-    job->state = IPP_JSTATE_COMPLETED;
+    state = IPP_JSTATE_CANCELED;
+  else if (state == IPP_JSTATE_PROCESSING)
+    state = IPP_JSTATE_COMPLETED;
 
   error:
 
-  job->completed           = time(NULL);
-  job->printer->state      = IPP_PSTATE_IDLE;
-  job->printer->active_job = NULL;
+  if (job->stream_fd >= 0)
+  {
+    // Close the document pipe so the client stops streaming data...
+    close(job->stream_fd);
+    job->stream_fd = -1;
+  }
+
+  // Update the job metrics...
+  cupsMutexLock(&metrics->mutex);
+  metrics->jobs[state - IPP_JSTATE_PENDING] ++;
+  update_histogram(&metrics->job_seconds, cupsGetClock() - started);
+  cupsMutexUnlock(&metrics->mutex);
+
+  return (state);
+}
+
+
+//
+// 'process_jobs()' - Process pending jobs on a worker thread.
+//
+// Each worker waits on the printer's job condition until a job is queued or
+// the printer state changes.  Pending jobs are held while the printer is out
+// of media.
+//
+
+static void *				// O - Thread exit status
+process_jobs(ippeve_printer_t *printer)	// I - Printer
+{
+  ippeve_job_t	*job;			// Current job
+  ipp_jstate_t	state;			// Job state
+
+
+  cupsMutexLock(&printer->job_mutex);
+
+  while (!printer->shutdown)
+  {
+    if ((job = (ippeve_job_t *)cupsArrayGetFirst(printer->pending_jobs)) == NULL)
+    {
+      // Wait for a job to be queued...
+      cupsCondWait(&printer->job_cond, &printer->job_mutex, 0.0);
+      continue;
+    }
+
+    if (printer->busy_workers >= printer->num_workers)
+    {
+      // Wait for a streamed job to finish...
+      cupsCondWait(&printer->job_cond, &printer->job_mutex, 0.0);
+      continue;
+    }
+
+    if (printer->state_reasons & IPPEVE_PREASON_MEDIA_EMPTY)
+    {
+      // Wait for media to be loaded...
+      printer->state_reasons |= IPPEVE_PREASON_MEDIA_NEEDED;
+      cupsCondWait(&printer->job_cond, &printer->job_mutex, 0.0);
+      continue;
+    }
+
+    printer->state_reasons &= (ippeve_preason_t)~IPPEVE_PREASON_MEDIA_NEEDED;
+
+    cupsArrayRemove(printer->pending_jobs, job);
+
+    printer->state = IPP_PSTATE_PROCESSING;
+    printer->busy_workers ++;
+
+    cupsMutexUnlock(&printer->job_mutex);
+
+    // Start the job unless it was canceled after being queued or while the
+    // document data was being received...
+    cupsRWLockWrite(&printer->rwlock);
+
+    if (job->cancel)
+    {
+      set_job_state(job, IPP_JSTATE_CANCELED);
+    }
+    else if (job->state == IPP_JSTATE_PENDING)
+    {
+      job->processing = time(NULL);
+      set_job_state(job, IPP_JSTATE_PROCESSING);
+    }
+
+    state = job->state;
+
+    cupsRWUnlock(&printer->rwlock);
+
+    if (state == IPP_JSTATE_PROCESSING)
+    {
+      state = process_job(job);
+
+      cupsRWLockWrite(&printer->rwlock);
+      set_job_state(job, state);
+      cupsRWUnlock(&printer->rwlock);
+    }
+
+    cupsMutexLock(&printer->job_mutex);
+
+    if (-- printer->busy_workers == 0)
+      printer->state = IPP_PSTATE_IDLE;
+  }
+
+  cupsMutexUnlock(&printer->job_mutex);
 
   return (NULL);
 }
@@ -6121,22 +7214,140 @@ process_state_message(
 	}
       }
 
-      if (i >= (int)(sizeof(printer->state_keywords) / sizeof(printer->state_keywords[0])) && !remove)
-      {
-	for (i = 0; i < (int)(sizeof(printer->state_keywords) / sizeof(printer->state_keywords[0])); i ++)
-	{
-	  if (!printer->state_keywords[i][0])
-	  {
-	    // Add this keyword to the empty slot...
-	    cupsCopyString(printer->state_keywords[i], keyword, sizeof(printer->state_keywords[i]));
-	    break;
-	  }
-	}
-      }
-    }
+      if (i >= (int)(sizeof(printer->state_keywords) / sizeof(printer->state_keywords[0])) && !remove)
+      {
+	for (i = 0; i < (int)(sizeof(printer->state_keywords) / sizeof(printer->state_keywords[0])); i ++)
+	{
+	  if (!printer->state_keywords[i][0])
+	  {
+	    // Add this keyword to the empty slot...
+	    cupsCopyString(printer->state_keywords[i], keyword, sizeof(printer->state_keywords[i]));
+	    break;
+	  }
+	}
+      }
+    }
+  }
+
+  printer->state_reasons = state_reasons;
+
+  // Let any workers waiting for media re-check the printer state...
+  wake_workers(printer);
+}
+
+
+//
+// 'queue_job()' - Queue a job for processing by a worker thread.
+//
+
+static void
+queue_job(ippeve_job_t *job)		// I - Job
+{
+  ippeve_printer_t	*printer = job->printer;
+					// Printer
+
+
+  cupsMutexLock(&printer->job_mutex);
+  cupsArrayAdd(printer->pending_jobs, job);
+  cupsCondBroadcast(&printer->job_cond);
+
+  // Start job worker threads as needed so that idle (virtual) printers don't
+  // use any threads...
+  if (printer->num_threads < printer->num_workers)
+  {
+    cups_thread_t t = cupsThreadCreate((cups_thread_func_t)process_jobs, printer);
+
+    if (t)
+    {
+      cupsThreadDetach(t);
+      printer->num_threads ++;
+    }
+    else if (printer->num_threads == 0)
+    {
+      _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to create job worker thread: %s", strerror(errno));
+    }
+  }
+
+  cupsMutexUnlock(&printer->job_mutex);
+}
+
+
+//
+// 'release_printer_attrs()' - Release a reference to shared printer attributes.
+//
+
+static void
+release_printer_attrs(
+    ippeve_attrs_t *shared)		// I - Shared attributes
+{
+  int	use;				// Number of remaining users
+
+
+  if (!shared)
+    return;
+
+  cupsMutexLock(&AttrsMutex);
+  use = -- shared->use;
+  cupsMutexUnlock(&AttrsMutex);
+
+  if (use > 0)
+    return;
+
+  ippDelete(shared->attrs);
+  free(shared);
+}
+
+
+//
+// 'release_printer_env()' - Release a reference to a cached environment.
+//
+// The environment is freed when the last reference is released.  The caller
+// must hold the printer lock.
+//
+
+static void
+release_printer_env(ippeve_env_t *env)	// I - Environment
+{
+  int	i;				// Looping var
+
+
+  if (!env || -- env->use > 0)
+    return;
+
+  for (i = 0; i < env->num_vars; i ++)
+    free(env->vars[i]);
+
+  free(env->vars);
+  free(env);
+}
+
+
+//
+// 'release_resource()' - Release a reference to a cached static resource.
+//
+
+static void
+release_resource(
+    ippeve_printer_t *printer,		// I - Printer
+    ippeve_cache_t   *cache)		// I - Cached resource
+{
+  bool	unused;				// Resource no longer used?
+
+
+  if (!cache)
+    return;
+
+  cupsMutexLock(&printer->cache_mutex);
+  unused = -- cache->use == 0;
+  cupsMutexUnlock(&printer->cache_mutex);
+
+  if (unused)
+  {
+    if (!cache->is_static)
+      free((void *)cache->data);
+
+    free(cache);
   }
-
-  printer->state_reasons = state_reasons;
 }
 
 
@@ -6175,7 +7386,7 @@ register_printer(
   document_format_supported = ippFindAttribute(printer->attrs, "document-format-supported", IPP_TAG_MIMETYPE);
   printer_location          = ippFindAttribute(printer->attrs, "printer-location", IPP_TAG_TEXT);
   printer_make_and_model    = ippFindAttribute(printer->attrs, "printer-make-and-model", IPP_TAG_TEXT);
-  printer_uuid              = ippFindAttribute(printer->attrs, "printer-uuid", IPP_TAG_URI);
+  printer_uuid              = ippFindAttribute(printer->local_attrs, "printer-uuid", IPP_TAG_URI);
   sides_supported           = ippFindAttribute(printer->attrs, "sides-supported", IPP_TAG_KEYWORD);
   urf_supported             = ippFindAttribute(printer->attrs, "urf-supported", IPP_TAG_KEYWORD);
 
@@ -6227,7 +7438,7 @@ register_printer(
     free(printer->dnssd_name);
     printer->dnssd_name = strdup(new_dnssd_name);
 
-    fprintf(stderr, "DNS-SD name collision, trying new DNS-SD service name '%s'.\n", printer->dnssd_name);
+    _cupsLogMessage(_CUPS_LOG_WARN, "DNS-SD name collision, trying new DNS-SD service name '%s'.", printer->dnssd_name);
 
     cupsRWUnlock(&printer->rwlock);
 
@@ -6292,7 +7503,7 @@ register_printer(
   if (!cupsDNSSDServicePublish(printer->services))
     goto error;
 
-  fprintf(stderr, "Registered printer '%s' for discovery using DNS-SD.\n", printer->dnssd_name);
+  _cupsLogMessage(_CUPS_LOG_INFO, "Registered printer '%s' for discovery using DNS-SD.", printer->dnssd_name);
 
   cupsFreeOptions(num_txt, txt);
 
@@ -6301,7 +7512,7 @@ register_printer(
   // If we get here there was a problem...
   error:
 
-  fprintf(stderr, "Unable to register printer '%s' for discovery using DNS-SD: %s\n", printer->dnssd_name, cupsGetErrorString());
+  _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to register printer '%s' for discovery using DNS-SD: %s", printer->dnssd_name, cupsGetErrorString());
 
   cupsFreeOptions(num_txt, txt);
 
@@ -6324,7 +7535,7 @@ respond_http(
   char	message[1024];			// Text message
 
 
-  fprintf(stderr, "%s %s\n", client->hostname, httpStatusString(code));
+  _cupsLogMessage(_CUPS_LOG_INFO, "%s %s", client->hostname, httpStatusString(code));
 
   if (code == HTTP_STATUS_CONTINUE)
   {
@@ -6450,9 +7661,256 @@ respond_ipp(ippeve_client_t *client,	// I - Client
   }
 
   if (formatted)
-    fprintf(stderr, "%s %s %s (%s)\n", client->hostname, ippOpString(client->operation_id), ippErrorString(status), formatted);
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s %s %s (%s)", client->hostname, ippOpString(client->operation_id), ippErrorString(status), formatted);
+  else
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s %s %s", client->hostname, ippOpString(client->operation_id), ippErrorString(status));
+}
+
+
+//
+// 'respond_metrics()' - Send the server metrics.
+//
+// The metrics are sent in the Prometheus text exposition format.
+//
+
+static bool				// O - `true` on success, `false` on failure
+respond_metrics(ippeve_client_t *client)// I - Client
+{
+  ippeve_printer_t *printer = client->printer,
+					// Printer
+		*vprinter;		// Current virtual printer
+  ippeve_metrics_t *metrics;		// Copy of server metrics
+  size_t	i,			// Looping var
+		active_jobs,		// Number of active jobs
+		pending_jobs,		// Number of queued jobs
+		busy_workers,		// Number of busy workers
+		num_workers;		// Number of job workers
+  bool		header,			// Write histogram header?
+		ret = false;		// Return value
+  static const char * const statuses[3] =
+  {					// IPP status classes
+    "successful",
+    "client-error",
+    "server-error"
+  };
+
+
+  // Copy the metrics so that we don't block other threads while sending...
+  if ((metrics = malloc(sizeof(ippeve_metrics_t))) == NULL)
+    return (respond_http(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0));
+
+  cupsMutexLock(&printer->metrics.mutex);
+  memcpy(metrics, &printer->metrics, sizeof(ippeve_metrics_t));
+  cupsMutexUnlock(&printer->metrics.mutex);
+
+  // Add up the jobs and workers for the printer and any virtual printers...
+  active_jobs  = 0;
+  pending_jobs = 0;
+  busy_workers = 0;
+  num_workers  = 0;
+
+  for (i = 0, vprinter = printer; vprinter; vprinter = (ippeve_printer_t *)cupsArrayGetElement(printer->printers, i ++))
+  {
+    cupsRWLockRead(&vprinter->rwlock);
+    active_jobs += cupsArrayGetCount(vprinter->active_jobs);
+    cupsRWUnlock(&vprinter->rwlock);
+
+    cupsMutexLock(&vprinter->job_mutex);
+    pending_jobs += cupsArrayGetCount(vprinter->pending_jobs);
+    busy_workers += vprinter->busy_workers;
+    num_workers  += vprinter->num_workers;
+    cupsMutexUnlock(&vprinter->job_mutex);
+  }
+
+  if (!respond_http(client, HTTP_STATUS_OK, NULL, "text/plain; version=0.0.4", 0))
+    goto done;
+
+  // Connections...
+  if (!metrics_printf(client,
+                   "# HELP ippeve_connections Current number of client connections.\n"
+                   "# TYPE ippeve_connections gauge\n"
+                   "ippeve_connections %u\n"
+                   "# HELP ippeve_connections_total Total number of client connections.\n"
+                   "# TYPE ippeve_connections_total counter\n"
+                   "ippeve_connections_total %llu\n"
+                   "# HELP ippeve_http_requests_total Total number of HTTP requests.\n"
+                   "# TYPE ippeve_http_requests_total counter\n", (unsigned)metrics->active_clients, metrics->clients))
+    goto done;
+
+  // HTTP requests...
+  for (i = 0; i < HTTP_STATE_MAX; i ++)
+  {
+    if (metrics->http_requests[i] && !metrics_printf(client, "ippeve_http_requests_total{method=\"%s\"} %llu\n", httpStateString((http_state_t)i), metrics->http_requests[i]))
+      goto done;
+  }
+
+  if (!write_histogram(client, "ippeve_http_request_duration_seconds", "HTTP request processing time.", NULL, NULL, &metrics->http_seconds, true))
+    goto done;
+
+  // IPP requests...
+  if (!metrics_printf(client,
+                   "# HELP ippeve_ipp_responses_total Total number of IPP responses.\n"
+                   "# TYPE ippeve_ipp_responses_total counter\n"))
+    goto done;
+
+  for (i = 0; i < (sizeof(statuses) / sizeof(statuses[0])); i ++)
+  {
+    if (!metrics_printf(client, "ippeve_ipp_responses_total{status=\"%s\"} %llu\n", statuses[i], metrics->ipp_status[i]))
+      goto done;
+  }
+
+  for (i = 0, header = true; i < IPPEVE_METRICS_MAX_OP; i ++)
+  {
+    if (!metrics->ipp_seconds[i].count)
+      continue;
+
+    if (!write_histogram(client, "ippeve_ipp_request_duration_seconds", "IPP request processing time.", "operation", i ? ippOpString((ipp_op_t)i) : "other", metrics->ipp_seconds + i, header))
+      goto done;
+
+    header = false;
+  }
+
+  // Documents and jobs...
+  if (!metrics_printf(client,
+                   "# HELP ippeve_documents_total Total number of documents received.\n"
+                   "# TYPE ippeve_documents_total counter\n"
+                   "ippeve_documents_total %llu\n"
+                   "# HELP ippeve_document_bytes_total Total number of document bytes received.\n"
+                   "# TYPE ippeve_document_bytes_total counter\n"
+                   "ippeve_document_bytes_total %llu\n"
+                   "# HELP ippeve_jobs_active Current number of active jobs.\n"
+                   "# TYPE ippeve_jobs_active gauge\n"
+                   "ippeve_jobs_active %u\n"
+                   "# HELP ippeve_jobs_queued Current number of jobs waiting for a worker.\n"
+                   "# TYPE ippeve_jobs_queued gauge\n"
+                   "ippeve_jobs_queued %u\n"
+                   "# HELP ippeve_workers Number of job worker threads.\n"
+                   "# TYPE ippeve_workers gauge\n"
+                   "ippeve_workers %u\n"
+                   "# HELP ippeve_workers_busy Current number of busy job worker threads.\n"
+                   "# TYPE ippeve_workers_busy gauge\n"
+                   "ippeve_workers_busy %u\n"
+                   "# HELP ippeve_jobs_processed_total Total number of processed jobs.\n"
+                   "# TYPE ippeve_jobs_processed_total counter\n"
+                   "ippeve_jobs_processed_total{state=\"canceled\"} %llu\n"
+                   "ippeve_jobs_processed_total{state=\"aborted\"} %llu\n"
+                   "ippeve_jobs_processed_total{state=\"completed\"} %llu\n", metrics->documents, metrics->document_bytes, (unsigned)active_jobs, (unsigned)pending_jobs, (unsigned)num_workers, (unsigned)busy_workers, metrics->jobs[IPP_JSTATE_CANCELED - IPP_JSTATE_PENDING], metrics->jobs[IPP_JSTATE_ABORTED - IPP_JSTATE_PENDING], metrics->jobs[IPP_JSTATE_COMPLETED - IPP_JSTATE_PENDING]))
+    goto done;
+
+  if (!write_histogram(client, "ippeve_job_duration_seconds", "Job processing time.", NULL, NULL, &metrics->job_seconds, true))
+    goto done;
+
+  ret = httpWrite(client->http, "", 0) >= 0;
+
+  done:
+
+  free(metrics);
+
+  return (ret);
+}
+
+
+//
+// 'respond_resource()' - Send a cached static resource.
+//
+// The response includes ETag and Last-Modified validators, and a 304 (Not
+// Modified) response is sent when the client's copy is current.  Text
+// resources are gzip/deflate encoded for clients that accept it.
+//
+
+static bool				// O - `true` on success, `false` on failure
+respond_resource(
+    ippeve_client_t   *client,		// I - Client
+    ippeve_resource_t resource)		// I - Resource
+{
+  ippeve_cache_t *cache;		// Cached resource
+  bool		ret = false;		// Return value
+  http_status_t	code = HTTP_STATUS_OK;	// HTTP status of response
+  const char	*type,			// MIME media type of resource
+		*coding = NULL,		// Content-Encoding of response
+		*value;			// Request field value
+  char		etag[64],		// ETag value
+		date[256];		// Last-Modified value
+
+
+  if ((cache = get_resource(client->printer, resource)) == NULL)
+    return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
+
+  type = resource == IPPEVE_RESOURCE_STRINGS ? "text/strings" : "image/png";
+
+  // PNG images are already compressed, but text can benefit from content
+  // coding...
+  if (!strncmp(type, "text/", 5) && client->operation == HTTP_STATE_GET && httpGetVersion(client->http) >= HTTP_VERSION_1_1)
+    coding = httpGetContentEncoding(client->http);
+
+  if (coding)
+    snprintf(etag, sizeof(etag), "\"%s-%s\"", cache->etag, coding);
+  else
+    snprintf(etag, sizeof(etag), "\"%s\"", cache->etag);
+
+  // Check whether the client already has the current resource...
+  if ((value = httpGetField(client->http, HTTP_FIELD_IF_NONE_MATCH)) != NULL && *value)
+  {
+    if (!strcmp(value, "*") || strstr(value, etag))
+      code = HTTP_STATUS_NOT_MODIFIED;
+  }
+  else if ((value = httpGetField(client->http, HTTP_FIELD_IF_MODIFIED_SINCE)) != NULL && *value && httpGetDateTime(value) >= cache->mtime)
+  {
+    code = HTTP_STATUS_NOT_MODIFIED;
+  }
+
+  _cupsLogMessage(_CUPS_LOG_INFO, "%s %s", client->hostname, httpStatusString(code));
+
+  // Send the HTTP response header...
+  httpClearFields(client->http);
+
+  httpSetField(client->http, HTTP_FIELD_CONTENT_TYPE, type);
+  httpSetField(client->http, HTTP_FIELD_ETAG, etag);
+  httpSetField(client->http, HTTP_FIELD_LAST_MODIFIED, httpGetDateString(cache->mtime, date, sizeof(date)));
+
+  if (!strncmp(type, "text/", 5))
+    httpSetField(client->http, HTTP_FIELD_VARY, "Accept-Encoding");
+
+  if (code == HTTP_STATUS_NOT_MODIFIED)
+  {
+    ret = httpWriteResponse(client->http, code);
+    goto done;
+  }
+
+  if (coding)
+  {
+    // Let the HTTP connection compress the data...
+    httpSetField(client->http, HTTP_FIELD_CONTENT_ENCODING, coding);
+    httpSetLength(client->http, 0);
+  }
   else
-    fprintf(stderr, "%s %s %s\n", client->hostname, ippOpString(client->operation_id), ippErrorString(status));
+  {
+    httpSetLength(client->http, cache->length);
+  }
+
+  if (!httpWriteResponse(client->http, code))
+    goto done;
+
+  if (client->operation == HTTP_STATE_HEAD)
+  {
+    ret = true;
+    goto done;
+  }
+
+  // Send the response data...
+  if (httpWrite(client->http, (const char *)cache->data, cache->length) < 0)
+    goto done;
+
+  if (coding && httpWrite(client->http, "", 0) < 0)
+    goto done;
+
+  ret = httpFlushWrite(client->http) >= 0;
+
+  done:
+
+  release_resource(client->printer, cache);
+
+  return (ret);
 }
 
 
@@ -6485,12 +7943,16 @@ run_printer(ippeve_printer_t *printer)	// I - Printer
   int			num_fds;	// Number of file descriptors
   struct pollfd		polldata[3];	// poll() data
   ippeve_client_t	*client;	// New client
+  ippeve_printer_t	*vprinter;	// Current virtual printer
+  size_t		i;		// Looping var
 
 
 #ifndef _WIN32
-  // Set signal handlers for SIGINT and SIGTERM...
+  // Set signal handlers for SIGINT and SIGTERM, and ignore SIGPIPE from
+  // streamed print commands that exit early...
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
+  signal(SIGPIPE, SIG_IGN);
 #endif // !_WIN32
 
   // Setup poll() data for the DNS-SD service socket and IPv4/6 listeners...
@@ -6507,7 +7969,7 @@ run_printer(ippeve_printer_t *printer)	// I - Printer
   {
     if (poll(polldata, (nfds_t)num_fds, 1000) < 0 && errno != EINTR)
     {
-      perror("poll() failed");
+      _cupsLogMessage(_CUPS_LOG_ERROR, "poll() failed: %s", strerror(errno));
       break;
     }
 
@@ -6528,7 +7990,7 @@ run_printer(ippeve_printer_t *printer)	// I - Printer
         }
         else
 	{
-	  perror("Unable to create client thread");
+	  _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to create client thread: %s", strerror(errno));
 	  delete_client(client);
 	}
       }
@@ -6546,7 +8008,7 @@ run_printer(ippeve_printer_t *printer)	// I - Printer
         }
         else
 	{
-	  perror("Unable to create client thread");
+	  _cupsLogMessage(_CUPS_LOG_ERROR, "Unable to create client thread: %s", strerror(errno));
 	  delete_client(client);
 	}
       }
@@ -6557,7 +8019,66 @@ run_printer(ippeve_printer_t *printer)	// I - Printer
 
     // Clean out old jobs...
     clean_jobs(printer);
+
+    for (i = 0; (vprinter = (ippeve_printer_t *)cupsArrayGetElement(printer->printers, i)) != NULL; i ++)
+      clean_jobs(vprinter);
+  }
+
+  // Stop the job worker threads...
+  for (i = 0, vprinter = printer; vprinter; vprinter = (ippeve_printer_t *)cupsArrayGetElement(printer->printers, i ++))
+  {
+    cupsMutexLock(&vprinter->job_mutex);
+    vprinter->shutdown = true;
+    cupsCondBroadcast(&vprinter->job_cond);
+    cupsMutexUnlock(&vprinter->job_mutex);
+  }
+}
+
+
+//
+// 'set_job_state()' - Set the state of a job and update the job indices.
+//
+// The caller must hold the printer's write lock.  Jobs entering the canceled,
+// aborted, or completed state have their completion time set.
+//
+
+static void
+set_job_state(ippeve_job_t *job,	// I - Job
+              ipp_jstate_t state)	// I - New job state
+{
+  ippeve_printer_t	*printer = job->printer;
+					// Printer
+
+
+  if (job->state == state)
+    return;
+
+  if (job->state >= IPP_JSTATE_PENDING)
+  {
+    // Remove the job from the indices for the old state...
+    cupsArrayRemove(printer->state_jobs[job->state - IPP_JSTATE_PENDING], job);
+
+    if (job->state < IPP_JSTATE_CANCELED)
+      cupsArrayRemove(printer->active_jobs, job);
+    else
+      cupsArrayRemove(printer->completed_jobs, job);
+  }
+
+  job->state = state;
+
+  if (state >= IPP_JSTATE_CANCELED)
+  {
+    if (!job->completed)
+      job->completed = time(NULL);
+
+    cupsArrayAdd(printer->completed_jobs, job);
   }
+  else
+  {
+    cupsArrayAdd(printer->active_jobs, job);
+  }
+
+  cupsArrayAdd(printer->state_jobs[state - IPP_JSTATE_PENDING], job);
 }
 
 
@@ -6678,6 +8199,14 @@ show_media(ippeve_client_t  *client)	// I - Client connection
 
     cupsRWLockWrite(&printer->rwlock);
 
+    if (copy_printer_attrs(printer))
+    {
+      // Update the printer's own copy of the attributes...
+      media_col_ready = ippFindAttribute(printer->attrs, "media-col-ready", IPP_TAG_BEGIN_COLLECTION);
+      media_ready     = ippFindAttribute(printer->attrs, "media-ready", IPP_TAG_ZERO);
+      input_tray      = ippFindAttribute(printer->attrs, "printer-input-tray", IPP_TAG_STRING);
+    }
+
     ippDeleteAttribute(printer->attrs, media_col_ready);
     media_col_ready = NULL;
 
@@ -6733,11 +8262,7 @@ show_media(ippeve_client_t  *client)	// I - Client connection
       ippSetOctetString(printer->attrs, &input_tray, i, tray_str, strlen(tray_str));
 
       if (ready_sheets == 0)
-      {
         printer->state_reasons |= IPPEVE_PREASON_MEDIA_EMPTY;
-        if (printer->active_job)
-          printer->state_reasons |= IPPEVE_PREASON_MEDIA_NEEDED;
-      }
       else if (ready_sheets < 25 && ready_sheets > 0)
         printer->state_reasons |= IPPEVE_PREASON_MEDIA_LOW;
     }
@@ -6748,7 +8273,16 @@ show_media(ippeve_client_t  *client)	// I - Client connection
     if (!media_ready)
       media_ready = ippAddOutOfBand(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_NOVALUE, "media-ready");
 
+    // The ready media is part of the configuration and the command environment...
+    printer->config_time = time(NULL);
+
+    release_printer_env(printer->env);
+    printer->env = NULL;
+
     cupsRWUnlock(&printer->rwlock);
+
+    // Start any jobs that are waiting for media, or report media-needed...
+    wake_workers(printer);
   }
 
   if (printer->web_forms)
@@ -7100,6 +8634,12 @@ show_supplies(
 
     cupsRWLockWrite(&printer->rwlock);
 
+    if (copy_printer_attrs(printer))
+    {
+      // Update the printer's own copy of the attributes...
+      supply = ippFindAttribute(printer->attrs, "printer-supply", IPP_TAG_STRING);
+    }
+
     ippDeleteAttribute(printer->attrs, supply);
     supply = NULL;
 
@@ -7209,6 +8749,151 @@ signal_handler(int signum)		// I - Signal number (not used)
 #endif // !_WIN32
 
 
+//
+// 'stream_job()' - Start processing a job while the document is received.
+//
+// Streaming is only used for raster formats that the print command can read
+// sequentially from the standard input, and only if a job slot is free and
+// no other jobs are waiting.  The document data is still copied to the spool
+// file.  Returns the pipe for the document data or -1 if the job must be
+// spooled and queued instead.
+//
+
+static int				// O - Pipe to command or -1
+stream_job(ippeve_job_t *job,		// I - Job
+           const char   *filename)	// I - Spool filename
+{
+#ifdef _WIN32
+  (void)job;
+  (void)filename;
+
+  return (-1);
+
+#else
+  ippeve_printer_t	*printer = job->printer;
+					// Printer
+  int			fds[2];		// Document pipe
+  bool			claimed = false;// Did we get a job slot?
+  cups_thread_t		t;		// Processing thread
+
+
+  if (!printer->command || !job->format || (strcmp(job->format, "image/pwg-raster") && strcmp(job->format, "image/urf")))
+    return (-1);
+
+  cupsMutexLock(&printer->job_mutex);
+  if (printer->busy_workers < printer->num_workers && cupsArrayGetCount(printer->pending_jobs) == 0 && !(printer->state_reasons & IPPEVE_PREASON_MEDIA_EMPTY))
+  {
+    printer->busy_workers ++;
+    printer->state = IPP_PSTATE_PROCESSING;
+    claimed        = true;
+  }
+  cupsMutexUnlock(&printer->job_mutex);
+
+  if (!claimed)
+    return (-1);
+
+  // Create the pipe close-on-exec so that other print commands don't inherit
+  // it...
+#ifdef HAVE_PIPE2
+  if (pipe2(fds, O_CLOEXEC))
+#else
+  if (pipe(fds))
+#endif // HAVE_PIPE2
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to create pipe for document: %s", job->id, strerror(errno));
+    goto release;
+  }
+
+#ifndef HAVE_PIPE2
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif // !HAVE_PIPE2
+
+  cupsRWLockWrite(&printer->rwlock);
+
+  job->filename   = strdup(filename);
+  job->stream_fd  = fds[0];
+  job->processing = time(NULL);
+  set_job_state(job, IPP_JSTATE_PROCESSING);
+
+  cupsRWUnlock(&printer->rwlock);
+
+  t = cupsThreadCreate((cups_thread_func_t)stream_job_thread, job);
+
+  if (!t)
+  {
+    _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Unable to create job streaming thread: %s", job->id, strerror(errno));
+
+    cupsRWLockWrite(&printer->rwlock);
+    job->stream_fd = -1;
+    set_job_state(job, IPP_JSTATE_HELD);
+    cupsRWUnlock(&printer->rwlock);
+
+    close(fds[0]);
+    close(fds[1]);
+    goto release;
+  }
+
+  cupsThreadDetach(t);
+
+  _cupsLogMessage(_CUPS_LOG_INFO, "[Job %d] Streaming document data to command.", job->id);
+
+  return (fds[1]);
+
+  // Release the job slot if we can't stream...
+  release:
+
+  cupsMutexLock(&printer->job_mutex);
+  if (-- printer->busy_workers == 0)
+    printer->state = IPP_PSTATE_IDLE;
+  cupsCondBroadcast(&printer->job_cond);
+  cupsMutexUnlock(&printer->job_mutex);
+
+  return (-1);
+#endif // _WIN32
+}
+
+
+//
+// 'stream_job_thread()' - Process a streamed job.
+//
+
+static void *				// O - Thread exit status
+stream_job_thread(ippeve_job_t *job)	// I - Job
+{
+  ippeve_printer_t	*printer = job->printer;
+					// Printer
+  ipp_jstate_t		state;		// Final job state
+
+
+  state = process_job(job);
+
+  // Update the job state unless the document upload was aborted, aborting the
+  // job if the command exited before reading all of the document data...
+  cupsRWLockWrite(&printer->rwlock);
+  if (job->state == IPP_JSTATE_PROCESSING)
+  {
+    if (state == IPP_JSTATE_COMPLETED && !job->stream_eof)
+    {
+      _cupsLogMessage(_CUPS_LOG_ERROR, "[Job %d] Print command exited before reading all document data.", job->id);
+      state = IPP_JSTATE_ABORTED;
+    }
+
+    set_job_state(job, state);
+  }
+  cupsRWUnlock(&printer->rwlock);
+
+  // Release the job slot and let the workers start any pending jobs...
+  cupsMutexLock(&printer->job_mutex);
+  if (-- printer->busy_workers == 0)
+    printer->state = IPP_PSTATE_IDLE;
+  cupsCondBroadcast(&printer->job_cond);
+  cupsMutexUnlock(&printer->job_mutex);
+
+  return (NULL);
+}
+
+
 //
 // 'time_string()' - Return the local time in hours, minutes, and seconds.
 //
@@ -7228,6 +8913,34 @@ time_string(time_t tv,			// I - Time value
 }
 
 
+//
+// 'update_histogram()' - Add an observation to a histogram.
+//
+// The caller must hold the metrics mutex.
+//
+
+static void
+update_histogram(
+    ippeve_histogram_t *hist,		// I - Histogram
+    double             secs)		// I - Observed time in seconds
+{
+  size_t	i;			// Looping var
+
+
+  for (i = 0; i < IPPEVE_METRICS_BUCKETS; i ++)
+  {
+    if (secs <= MetricsBuckets[i])
+    {
+      hist->buckets[i] ++;
+      break;
+    }
+  }
+
+  hist->count ++;
+  hist->sum += secs;
+}
+
+
 //
 // 'usage()' - Show program usage.
 //
@@ -7238,9 +8951,15 @@ usage(FILE *out)			// I - Output file
   cupsLangPuts(out, _("Usage: ippeveprinter [OPTIONS] \"NAME\""));
   cupsLangPuts(out, _("Options:"));
   cupsLangPuts(out, _("--help                         Show this help"));
+  cupsLangPuts(out, _("--job-history-count NUMBER     Set maximum number of completed jobs to keep (default=no limit)"));
+  cupsLangPuts(out, _("--job-history-time SECONDS     Set number of seconds to keep completed jobs (default=60)"));
+  cupsLangPuts(out, _("--log-format FORMAT            Set log format - 'text' (default) or 'key-value'"));
   cupsLangPuts(out, _("--no-web-forms                 Disable web forms for media and supplies"));
   cupsLangPuts(out, _("--pam-service SERVICE          Use the named PAM service"));
+  cupsLangPuts(out, _("--stream                       Stream raster documents to the print command"));
   cupsLangPuts(out, _("--version                      Show the program version"));
+  cupsLangPuts(out, _("--virtual-printers NUMBER      Set number of additional virtual printers (default=0)"));
+  cupsLangPuts(out, _("--workers NUMBER               Set number of jobs to process at once (default=1)"));
   cupsLangPuts(out, _("-2                             Set 2-sided printing support (default=1-sided)"));
   cupsLangPuts(out, _("-a FILENAME                    Load printer attributes from IPP file"));
   cupsLangPuts(out, _("-A                             Enable authentication"));
@@ -7312,14 +9031,14 @@ valid_doc_attributes(
     }
     else
     {
-      fprintf(stderr, "%s %s compression=\"%s\"\n", client->hostname, op_name, compression);
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s %s compression=\"%s\"", client->hostname, op_name, compression);
 
       ippAddString(client->request, IPP_TAG_JOB, IPP_TAG_KEYWORD, "compression-supplied", NULL, compression);
 
       if (strcmp(compression, "none"))
       {
 	if (Verbosity)
-	  fprintf(stderr, "Receiving job file with \"%s\" compression.\n", compression);
+	  _cupsLogMessage(_CUPS_LOG_DEBUG, "Receiving job file with \"%s\" compression.", compression);
         httpSetField(client->http, HTTP_FIELD_CONTENT_ENCODING, compression);
       }
     }
@@ -7338,7 +9057,7 @@ valid_doc_attributes(
     {
       format = ippGetString(attr, 0, NULL);
 
-      fprintf(stderr, "%s %s document-format=\"%s\"\n", client->hostname, op_name, format);
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s %s document-format=\"%s\"", client->hostname, op_name, format);
 
       ippAddString(client->request, IPP_TAG_JOB, IPP_TAG_MIMETYPE, "document-format-supplied", NULL, format);
     }
@@ -7360,7 +9079,7 @@ valid_doc_attributes(
     memset(header, 0, sizeof(header));
     httpPeek(client->http, (char *)header, sizeof(header));
 
-    fprintf(stderr, "%s %s Auto-type header: %02X%02X%02X%02X%02X%02X%02X%02X\n", client->hostname, op_name, header[0], header[1], header[2], header[3], header[4], header[5], header[6], header[7]);
+    _cupsLogMessage(_CUPS_LOG_INFO, "%s %s Auto-type header: %02X%02X%02X%02X%02X%02X%02X%02X", client->hostname, op_name, header[0], header[1], header[2], header[3], header[4], header[5], header[6], header[7]);
     if (!memcmp(header, "%PDF", 4))
       format = "application/pdf";
     else if (!memcmp(header, "%!", 2))
@@ -7378,7 +9097,7 @@ valid_doc_attributes(
 
     if (format)
     {
-      fprintf(stderr, "%s %s Auto-typed document-format=\"%s\"\n", client->hostname, op_name, format);
+      _cupsLogMessage(_CUPS_LOG_INFO, "%s %s Auto-typed document-format=\"%s\"", client->hostname, op_name, format);
 
       ippAddString(client->request, IPP_TAG_JOB, IPP_TAG_MIMETYPE, "document-format-detected", NULL, format);
     }
@@ -7899,3 +9618,65 @@ valid_job_attributes(
 
   return (valid);
 }
+
+
+//
+// 'wake_workers()' - Wake the job worker threads after a printer state change.
+//
+
+static void
+wake_workers(ippeve_printer_t *printer)	// I - Printer
+{
+  cupsMutexLock(&printer->job_mutex);
+  cupsCondBroadcast(&printer->job_cond);
+  cupsMutexUnlock(&printer->job_mutex);
+}
+
+
+//
+// 'write_histogram()' - Write a histogram metric.
+//
+// The bucket counts are written cumulatively as required by the Prometheus
+// text exposition format.
+//
+
+static bool				// O - `true` on success, `false` on failure
+write_histogram(
+    ippeve_client_t    *client,		// I - Client
+    const char         *name,		// I - Metric name
+    const char         *help,		// I - Metric description
+    const char         *label,		// I - Label name or `NULL` for none
+    const char         *value,		// I - Label value
+    ippeve_histogram_t *hist,		// I - Histogram
+    bool               header)		// I - Write HELP and TYPE lines?
+{
+  size_t		i;		// Looping var
+  unsigned long long	count;		// Cumulative count
+  char			prefix[256],	// Labels before "le"
+			labels[256];	// Labels for sum and count
+
+
+  if (header && !metrics_printf(client, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name))
+    return (false);
+
+  if (label)
+  {
+    snprintf(prefix, sizeof(prefix), "%s=\"%s\",", label, value);
+    snprintf(labels, sizeof(labels), "{%s=\"%s\"}", label, value);
+  }
+  else
+  {
+    prefix[0] = '\0';
+    labels[0] = '\0';
+  }
+
+  for (i = 0, count = 0; i < IPPEVE_METRICS_BUCKETS; i ++)
+  {
+    count += hist->buckets[i];
+
+    if (!metrics_printf(client, "%s_bucket{%sle=\"%g\"} %llu\n", name, prefix, MetricsBuckets[i], count))
+      return (false);
+  }
+
+  return (metrics_printf(client, "%s_bucket{%sle=\"+Inf\"} %llu\n%s_sum%s %.6f\n%s_count%s %llu\n", name, prefix, hist->count, name, labels, hist->sum, name, labels, hist->count));
+}
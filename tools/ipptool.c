@@ -78,6 +78,20 @@ typedef enum ipptool_with_e		// WITH flags
   IPPTOOL_WITH_SCHEME = 16		// Match string is a URI scheme
 } ipptool_with_t;
 
+typedef struct ipptool_intval_s		// WITH-VALUE integer comparison
+{
+  char		op;			// Comparison operator ('=', '!', '<', or '>')
+  int		value;			// Value to compare against
+} ipptool_intval_t;
+
+typedef struct ipptool_type_s		// OF-TYPE value syntax
+{
+  ipp_tag_t	value_tag,		// Value tag
+		lang_tag;		// Alternate value tag ("name" and "text")
+  int		lower,			// Lower bound for value or length
+		upper;			// Upper bound for value or length
+} ipptool_type_t;
+
 typedef struct ipptool_expect_s		// Expected attribute info
 {
   bool		optional,		// Optional attribute?
@@ -104,6 +118,12 @@ typedef struct ipptool_expect_s		// Expected attribute info
   int		with_flags;		// WITH flags
   size_t	count;			// Expected count if > 0
   ipp_tag_t	in_group;		// IN-GROUP value
+  size_t	num_of_types;		// Number of OF-TYPE syntaxes
+  ipptool_type_t *of_types;		// Compiled OF-TYPE syntaxes
+  regex_t	*with_regex;		// Compiled WITH-VALUE regular expression
+  size_t	num_with_ints;		// Number of WITH-VALUE integer comparisons
+  ipptool_intval_t *with_ints;		// Compiled WITH-VALUE integer comparisons
+  bool		with_boolean;		// Compiled WITH-VALUE boolean value
 } ipptool_expect_t;
 
 typedef struct ipptool_generate_s	//// GENERATE-FILE parameters
@@ -133,6 +153,37 @@ typedef struct ipptool_status_s		// Status info
 		repeat_no_match;	// Repeat the test when it matches
 } ipptool_status_t;
 
+typedef struct ipptool_stats_s		// Load test statistics for a test
+{
+  char		*name;			// Test name
+  size_t	requests,		// Number of requests
+		errors,			// Number of failed tests
+		num_samples,		// Number of latency samples
+		alloc_samples;		// Allocated latency samples
+  double	*samples;		// Latency samples in seconds
+} ipptool_stats_t;
+
+typedef struct ipptool_load_s		// Load test parameters
+{
+  const char	*testfile;		// Test file
+  int		repeat;			// Number of times to run test file
+  useconds_t	interval;		// Delay between runs
+  double	end_time;		// End time or 0.0 to use repeat count
+} ipptool_load_t;
+
+typedef struct ipptool_tokens_s		// Cached tokens for a test file
+{
+  char		*filename;		// Test filename
+  _ipp_ftokens_t	*tokens;	// Pre-read tokens
+} ipptool_tokens_t;
+
+typedef struct ipptool_timing_s		// Request timing
+{
+  double	connect,		// Time to connect in seconds
+		send,			// Time to send request and get the response status in seconds
+		parse;			// Time to read response in seconds
+} ipptool_timing_t;
+
 typedef struct ipptool_test_s		// Test Data
 {
   // Global Options
@@ -145,8 +196,11 @@ typedef struct ipptool_test_s		// Test Data
   bool		stop_after_include_error;
 					// Stop after include errors?
   double	timeout;		// Timeout for connection
+  bool		timing;			// Show request timing?
   bool		validate_headers;	// Validate HTTP headers in response?
   int		verbosity;		// Show all attributes?
+  ipptool_load_t *load;			// Load test parameters, if any
+  cups_array_t	*stats;			// Load test statistics, if any
 
   char		*bearer_token,		// HTTP Bearer token
 		*client_name,		// TLS client certificate name
@@ -159,7 +213,9 @@ typedef struct ipptool_test_s		// Test Data
 
   // Global State
   http_t	*http;			// HTTP connection to printer/server
+  double	connect_time;		// Time for initial connection
   cups_file_t	*outfile;		// Output file
+  cups_array_t	*timings;		// Timing rows for CSV and list output
   bool		show_header,		// Show the test header?
 		xml_header,		// `true` if XML plist header was written
 		pass;			// Have we passed all tests?
@@ -215,30 +271,45 @@ typedef struct ipptool_test_s		// Test Data
 //
 
 static bool	Cancel = false;		// Cancel test?
+static cups_array_t *Tokens = NULL;	// Cached test file tokens
+static cups_mutex_t TokensMutex = CUPS_MUTEX_INITIALIZER;
+					// Mutex for cached tokens
 
 
 //
 // Local functions...
 //
 
+static void	add_stats(ipptool_stats_t *stats, size_t requests, size_t errors, double seconds);
 static void	add_stringf(cups_array_t *a, const char *s, ...) _CUPS_FORMAT(2, 3);
 static ipptool_test_t *alloc_data(void);
 static bool	check_vars(ipp_file_t *f, cups_array_t *vars, bool need_all);
 static void	clear_data(ipptool_test_t *data);
+static int	compare_samples(const double *a, const double *b);
+static int	compare_tokens(ipptool_tokens_t *a, ipptool_tokens_t *b, void *cb_data);
 static int	compare_uris(const char *a, const char *b);
+static bool	compile_of_type(ipptool_test_t *data, ipptool_expect_t *expect);
+static bool	compile_with_value(ipp_file_t *f, ipptool_test_t *data, ipptool_expect_t *expect);
 static http_t	*connect_printer(ipptool_test_t *data);
 static void	copy_hex_string(char *buffer, unsigned char *data, int datalen, size_t bufsize);
 static int	create_file(const char *filespec, const char *resource, size_t idx, char *filename, size_t filenamesize);
+static bool	do_load(const char *testfile, ipptool_test_t *data, int clients, double duration, int repeat, int interval);
+static void	*do_load_client(ipptool_test_t *data);
 static void	*do_monitor_printer_state(ipptool_test_t *data);
 static bool	do_test(ipp_file_t *file, ipptool_test_t *data);
 static bool	do_tests(const char *testfile, ipptool_test_t *data);
 static bool	error_cb(ipp_file_t *f, ipptool_test_t *data, const char *error);
 static bool	expect_matches(ipptool_expect_t *expect, ipp_attribute_t *attr);
 static void	free_data(ipptool_test_t *data);
+static void	free_stats(ipptool_stats_t *stats, void *cb_data);
+static void	free_tokens(ipptool_tokens_t *tokens, void *cb_data);
 static http_status_t generate_file(http_t *http, ipptool_generate_t *params);
 static char	*get_filename(const char *testfile, char *dst, const char *src, size_t dstsize);
+static void	get_percentiles(ipptool_stats_t *stats, double *pmin, double *p50, double *p95, double *p99, double *pmax);
+static ipptool_stats_t *get_stats(cups_array_t *a, const char *name);
 static const char *get_string(ipp_attribute_t *attr, size_t element, int flags, char *buffer, size_t bufsize);
-static char	*iso_date(const ipp_uchar_t *date);
+static ipptool_tokens_t *get_tokens(const char *testfile);
+static char	*iso_date(const ipp_uchar_t *date, char *buffer, size_t bufsize);
 static bool	parse_generate_file(ipp_file_t *f, ipptool_test_t *data);
 static bool	parse_monitor_printer_state(ipp_file_t *f, ipptool_test_t *data);
 static const char *password_cb(const char *prompt, http_t *http, const char *method, const char *resource, void *user_data);
@@ -252,6 +323,9 @@ static void	print_ippserver_string(ipptool_test_t *data, const char *s, size_t l
 static void	print_json_attr(ipptool_test_t *data, ipp_attribute_t *attr, int indent);
 static void	print_json_string(ipptool_test_t *data, const char *s, size_t len);
 static ipp_attribute_t *print_line(ipptool_test_t *data, ipp_t *ipp, ipp_attribute_t *attr, int num_displayed, char **displayed, size_t *widths);
+static void	print_stats(ipptool_test_t *data, cups_array_t *stats, int clients, double seconds);
+static void	print_timing(ipptool_test_t *data, ipptool_timing_t *timing, ipptool_stats_t *stats);
+static void	print_timings(ipptool_test_t *data);
 static void	print_xml_header(ipptool_test_t *data);
 static void	print_xml_string(cups_file_t *outfile, const char *element, const char *s);
 static void	print_xml_trailer(ipptool_test_t *data, int success, const char *message);
@@ -266,7 +340,7 @@ static bool	valid_image(const char *filename, int *width, int *height, int *dept
 static bool	with_content(cups_array_t *errors, ipp_attribute_t *attr, ipptool_content_t content, cups_array_t *mime_types, const char *filespec);
 static bool	with_distinct_values(cups_array_t *errors, ipp_attribute_t *attr);
 static const char *with_flags_string(int flags);
-static bool	with_value(ipptool_test_t *data, cups_array_t *errors, char *value, int flags, ipp_attribute_t *attr, char *matchbuf, size_t matchlen);
+static bool	with_value(ipptool_test_t *data, cups_array_t *errors, ipptool_expect_t *expect, ipp_attribute_t *attr, char *matchbuf, size_t matchlen);
 static bool	with_value_from(cups_array_t *errors, ipp_attribute_t *fromattr, ipp_attribute_t *attr, char *matchbuf, size_t matchlen);
 
 
@@ -289,7 +363,10 @@ main(int  argc,				// I - Number of command-line args
 			*ext,		// Extension on filename
 			*testfile;	// Test file to use
   int			interval,	// Test interval in microseconds
-			repeat;		// Repeat count
+			repeat,		// Repeat count
+			clients = 0;	// Number of load test clients
+  double		duration = 0.0;	// Duration of load test in seconds
+  bool			load = false;	// Run a load test?
   ipptool_test_t	*data;		// Test data
   _cups_globals_t	*cg = _cupsGlobals();
 					// Global data
@@ -342,6 +419,32 @@ main(int  argc,				// I - Number of command-line args
 
       data->client_name = argv[i];
     }
+    else if (!strcmp(argv[i], "--clients"))
+    {
+      i ++;
+
+      if (i >= argc || (clients = atoi(argv[i])) < 1)
+      {
+	cupsLangPrintf(stderr, _("%s: Missing number of clients after '--clients'."), "ipptool");
+	free_data(data);
+	return (usage(stderr));
+      }
+
+      load = true;
+    }
+    else if (!strcmp(argv[i], "--duration"))
+    {
+      i ++;
+
+      if (i >= argc || (duration = _cupsStrScand(argv[i], NULL, localeconv())) <= 0.0)
+      {
+	cupsLangPrintf(stderr, _("%s: Missing seconds after '--duration'."), "ipptool");
+	free_data(data);
+	return (usage(stderr));
+      }
+
+      load = true;
+    }
     else if (!strcmp(argv[i], "--help"))
     {
       free_data(data);
@@ -380,6 +483,10 @@ main(int  argc,				// I - Number of command-line args
     {
       data->stop_after_include_error = true;
     }
+    else if (!strcmp(argv[i], "--timing"))
+    {
+      data->timing = true;
+    }
     else if (!strcmp(argv[i], "--user-agent"))
     {
       i ++;
@@ -763,6 +870,12 @@ main(int  argc,				// I - Number of command-line args
         cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), "ipptool", testfile, strerror(errno));
         status = 1;
       }
+      else if (load)
+      {
+        // Run the tests using concurrent clients...
+        if (!do_load(testfile, data, clients, duration, repeat, interval))
+          status = 1;
+      }
       else if (!do_tests(testfile, data))
       {
         status = 1;
@@ -781,7 +894,7 @@ main(int  argc,				// I - Number of command-line args
   {
     print_xml_trailer(data, !status, NULL);
   }
-  else if (interval > 0 && repeat > 0)
+  else if (interval > 0 && repeat > 0 && !load)
   {
     while (repeat > 1)
     {
@@ -790,7 +903,7 @@ main(int  argc,				// I - Number of command-line args
       repeat --;
     }
   }
-  else if (interval > 0)
+  else if (interval > 0 && !load)
   {
     for (;;)
     {
@@ -799,7 +912,7 @@ main(int  argc,				// I - Number of command-line args
     }
   }
 
-  if ((data->output == IPPTOOL_OUTPUT_TEST || (data->output == IPPTOOL_OUTPUT_PLIST && data->outfile)) && data->test_count > 1)
+  if ((data->output == IPPTOOL_OUTPUT_TEST || (data->output == IPPTOOL_OUTPUT_PLIST && data->outfile != cupsFileStdout())) && data->test_count > 1)
   {
     // Show a summary report if there were multiple tests...
     cupsFilePrintf(cupsFileStdout(), "\nSummary: %d tests, %d passed, %d failed, %d skipped\nScore: %d%%\n", data->test_count, data->pass_count, data->fail_count, data->skip_count, 100 * (data->pass_count + data->skip_count) / data->test_count);
@@ -807,12 +920,45 @@ main(int  argc,				// I - Number of command-line args
 
   cupsFileClose(data->outfile);
   free_data(data);
+  cupsArrayDelete(Tokens);
 
   // Exit...
   return (status);
 }
 
 
+//
+// 'add_stats()' - Add a latency sample to the load test statistics.
+//
+
+static void
+add_stats(ipptool_stats_t *stats,	// I - Test statistics
+          size_t          requests,	// I - Number of requests
+          size_t          errors,	// I - Number of failed tests
+          double          seconds)	// I - Time for requests in seconds
+{
+  double	*samples;		// New samples array
+
+
+  if (!stats)
+    return;
+
+  stats->requests += requests;
+  stats->errors   += errors;
+
+  if (stats->num_samples >= stats->alloc_samples)
+  {
+    if ((samples = realloc(stats->samples, (stats->alloc_samples + 1024) * sizeof(double))) == NULL)
+      return;
+
+    stats->samples       = samples;
+    stats->alloc_samples += 1024;
+  }
+
+  stats->samples[stats->num_samples ++] = seconds;
+}
+
+
 //
 // 'add_stringf()' - Add a formatted string to an array.
 //
@@ -848,6 +994,7 @@ static ipptool_test_t *		// O - Test data
 alloc_data(void)
 {
   ipptool_test_t *data;		// Test data
+  char		date[32];		// ISO 8601 date/time string
 
 
   if ((data = calloc(1, sizeof(ipptool_test_t))) == NULL)
@@ -863,12 +1010,13 @@ alloc_data(void)
   data->def_transfer = IPPTOOL_TRANSFER_AUTO;
   data->def_version  = 20;
   data->errors       = cupsArrayNew(NULL, NULL, NULL, 0, _cupsArrayStrdup, _cupsArrayFree);
+  data->timings      = cupsArrayNew(NULL, NULL, NULL, 0, _cupsArrayStrdup, _cupsArrayFree);
   data->pass         = true;
   data->prev_pass    = true;
   data->request_id   = (cupsGetRand() % 1000) * 137;
   data->show_header  = true;
 
-  ippFileSetVar(data->parent, "date-start", iso_date(ippTimeToDate(time(NULL))));
+  ippFileSetVar(data->parent, "date-start", iso_date(ippTimeToDate(time(NULL)), date, sizeof(date)));
 
   return (data);
 }
@@ -928,10 +1076,18 @@ clear_data(ipptool_test_t *data)	// I - Test data
   {
     free(expect->name);
     free(expect->of_type);
+    free(expect->of_types);
     free(expect->same_count_as);
     cupsArrayDelete(expect->if_defined);
     cupsArrayDelete(expect->if_not_defined);
     free(expect->with_value);
+    free(expect->with_value_from);
+    if (expect->with_regex)
+    {
+      regfree(expect->with_regex);
+      free(expect->with_regex);
+    }
+    free(expect->with_ints);
     free(expect->define_match);
     free(expect->define_no_match);
     free(expect->define_value);
@@ -958,10 +1114,18 @@ clear_data(ipptool_test_t *data)	// I - Test data
   {
     free(expect->name);
     free(expect->of_type);
+    free(expect->of_types);
     free(expect->same_count_as);
     cupsArrayDelete(expect->if_defined);
     cupsArrayDelete(expect->if_not_defined);
     free(expect->with_value);
+    free(expect->with_value_from);
+    if (expect->with_regex)
+    {
+      regfree(expect->with_regex);
+      free(expect->with_regex);
+    }
+    free(expect->with_ints);
     free(expect->define_match);
     free(expect->define_no_match);
     free(expect->define_value);
@@ -974,6 +1138,39 @@ clear_data(ipptool_test_t *data)	// I - Test data
 }
 
 
+//
+// 'compare_samples()' - Compare two latency samples.
+//
+
+static int				// O - Result of comparison
+compare_samples(const double *a,	// I - First sample
+                const double *b)	// I - Second sample
+{
+  if (*a < *b)
+    return (-1);
+  else if (*a > *b)
+    return (1);
+  else
+    return (0);
+}
+
+
+//
+// 'compare_tokens()' - Compare the filenames of two cached test files.
+//
+
+static int				// O - Result of comparison
+compare_tokens(ipptool_tokens_t *a,	// I - First cached test file
+               ipptool_tokens_t *b,	// I - Second cached test file
+               void             *cb_data)
+					// I - Callback data (unused)
+{
+  (void)cb_data;
+
+  return (strcmp(a->filename, b->filename));
+}
+
+
 //
 // 'compare_uris()' - Compare two URIs...
 //
@@ -1030,6 +1227,233 @@ compare_uris(const char *a,             // I - First URI
 }
 
 
+//
+// 'compile_of_type()' - Compile the OF-TYPE value for an expected attribute.
+//
+// The OF-TYPE string contains one or more value syntaxes separated by "," or
+// "|".  Each syntax can be followed by "(MAX)", "(UPPER)", "(LOWER:UPPER)",
+// or "(MIN:UPPER)" to limit the range of integer values or the length of
+// string values.
+//
+
+static bool				// O - `true` on success, `false` on error
+compile_of_type(
+    ipptool_test_t   *data,		// I - Test data
+    ipptool_expect_t *expect)		// I - Expected attribute
+{
+  char		temp[1024],		// Copy of OF-TYPE value
+		*of_type,		// Type name
+		*paren,			// Pointer to opening parenthesis
+		*next,			// Next name
+		*ptr;			// Pointer into syntax string
+  ipptool_type_t *type;			// Current syntax
+
+
+  free(expect->of_types);
+  expect->of_types     = NULL;
+  expect->num_of_types = 0;
+
+  if (!expect->of_type)
+  {
+    print_fatal_error(data, "Unable to allocate memory for OF-TYPE: %s", strerror(errno));
+    return (false);
+  }
+
+  cupsCopyString(temp, expect->of_type, sizeof(temp));
+
+  for (of_type = temp; *of_type; of_type = next)
+  {
+    // Find the next separator...
+    for (next = of_type; *next && *next != '|' && *next != ','; next ++);
+
+    if (*next)
+      *next++ = '\0';
+
+    if ((type = realloc(expect->of_types, (expect->num_of_types + 1) * sizeof(ipptool_type_t))) == NULL)
+    {
+      print_fatal_error(data, "Unable to allocate memory for OF-TYPE: %s", strerror(errno));
+      return (false);
+    }
+
+    expect->of_types = type;
+    type             += expect->num_of_types ++;
+
+    // Get any bounds...
+    if ((paren = strchr(of_type, '(')) != NULL)
+    {
+      *paren = '\0';
+
+      if (!strncmp(paren + 1, "MIN:", 4))
+      {
+        type->lower = INT_MIN;
+        ptr         = paren + 5;
+      }
+      else if ((ptr = strchr(paren + 1, ':')) != NULL)
+      {
+        type->lower = atoi(paren + 1);
+        ptr ++;
+      }
+      else
+      {
+        type->lower = 0;
+        ptr         = paren + 1;
+      }
+
+      if (!strcmp(ptr, "MAX)"))
+        type->upper = INT_MAX;
+      else
+        type->upper = atoi(ptr);
+    }
+    else
+    {
+      type->lower = INT_MIN;
+      type->upper = INT_MAX;
+    }
+
+    // Then the value tag(s) and default string lengths...  The "collection",
+    // "name", and "text" meta-types make it easier to write the test file.
+    if (!strcmp(of_type, "text"))
+    {
+      type->value_tag = IPP_TAG_TEXT;
+      type->lang_tag  = IPP_TAG_TEXTLANG;
+
+      if (type->upper == INT_MAX)
+        type->upper = 1023;
+    }
+    else if (!strcmp(of_type, "name"))
+    {
+      type->value_tag = IPP_TAG_NAME;
+      type->lang_tag  = IPP_TAG_NAMELANG;
+
+      if (type->upper == INT_MAX)
+        type->upper = 255;
+    }
+    else if (!strcmp(of_type, "collection"))
+    {
+      type->value_tag = type->lang_tag = IPP_TAG_BEGIN_COLLECTION;
+    }
+    else
+    {
+      type->value_tag = type->lang_tag = ippTagValue(of_type);
+
+      if (type->upper == INT_MAX)
+      {
+        if (type->value_tag == IPP_TAG_KEYWORD)
+          type->upper = 255;
+        else if (type->value_tag == IPP_TAG_URI || type->value_tag == IPP_TAG_STRING)
+          type->upper = 1023;
+      }
+    }
+  }
+
+  return (true);
+}
+
+
+//
+// 'compile_with_value()' - Compile the WITH-VALUE value for an expected attribute.
+//
+// Regular expressions are compiled and integer comparisons are parsed once so
+// that repeated tests only need to compare the attribute values.
+//
+
+static bool				// O - `true` on success, `false` on error
+compile_with_value(
+    ipp_file_t       *f,		// I - IPP data file
+    ipptool_test_t   *data,		// I - Test data
+    ipptool_expect_t *expect)		// I - Expected attribute
+{
+  int		r;			// Error, if any
+  char		temp[1024],		// Error string
+		op,			// Comparison operator
+		*valptr,		// Pointer into value
+		*nextptr;		// Next pointer
+  int		intvalue;		// Integer value
+  ipptool_intval_t *intval;		// Integer comparison
+
+
+  // Free any previous WITH-VALUE...
+  if (expect->with_regex)
+  {
+    regfree(expect->with_regex);
+    free(expect->with_regex);
+    expect->with_regex = NULL;
+  }
+
+  free(expect->with_ints);
+  expect->with_ints     = NULL;
+  expect->num_with_ints = 0;
+
+  if (!expect->with_value)
+  {
+    print_fatal_error(data, "Unable to allocate memory for WITH-VALUE: %s", strerror(errno));
+    return (false);
+  }
+
+  // Compile the extended, case-sensitive POSIX regular expression...
+  if (expect->with_flags & IPPTOOL_WITH_REGEX)
+  {
+    if ((expect->with_regex = calloc(1, sizeof(regex_t))) == NULL)
+    {
+      print_fatal_error(data, "Unable to allocate memory for WITH-VALUE: %s", strerror(errno));
+      return (false);
+    }
+
+    if ((r = regcomp(expect->with_regex, expect->with_value, REG_EXTENDED | REG_NOSUB)) != 0)
+    {
+      regerror(r, expect->with_regex, temp, sizeof(temp));
+
+      print_fatal_error(data, "Unable to compile WITH-VALUE regular expression \"%s\" on line %d of '%s' - %s", expect->with_value, ippFileGetLineNumber(f), ippFileGetFilename(f), temp);
+
+      free(expect->with_regex);
+      expect->with_regex = NULL;
+      return (false);
+    }
+  }
+
+  // Parse the integer comparisons ("N", "<N", ">N", "!N", or "=N" separated by
+  // commas and/or whitespace) for integer, enum, and rangeOfInteger values...
+  valptr = expect->with_value;
+
+  while (isspace(*valptr & 255) || isdigit(*valptr & 255) ||
+	 *valptr == '-' || *valptr == ',' || *valptr == '!' || *valptr == '<' ||
+	 *valptr == '=' || *valptr == '>')
+  {
+    op = '=';
+    while (*valptr && !isdigit(*valptr & 255) && *valptr != '-')
+    {
+      if (*valptr == '<' || *valptr == '>' || *valptr == '=' || *valptr == '!')
+	op = *valptr;
+      valptr ++;
+    }
+
+    if (!*valptr)
+      break;
+
+    intvalue = (int)strtol(valptr, &nextptr, 0);
+    if (nextptr == valptr)
+      break;
+    valptr = nextptr;
+
+    if ((intval = realloc(expect->with_ints, (expect->num_with_ints + 1) * sizeof(ipptool_intval_t))) == NULL)
+    {
+      print_fatal_error(data, "Unable to allocate memory for WITH-VALUE: %s", strerror(errno));
+      return (false);
+    }
+
+    expect->with_ints = intval;
+    intval            += expect->num_with_ints ++;
+    intval->op        = op;
+    intval->value     = intvalue;
+  }
+
+  // And the boolean value...
+  expect->with_boolean = !strcmp(expect->with_value, "true") || !strcmp(expect->with_value, "1");
+
+  return (true);
+}
+
+
 //
 // 'connect_printer()' - Connect to the printer.
 //
@@ -1217,6 +1641,199 @@ create_file(const char *filespec,	// I - Filespec string or NULL
 }
 
 
+//
+// 'do_load()' - Run the tests in a file using concurrent clients.
+//
+// Each client uses its own connection, variables, and test state, and runs the
+// test file until the repeat count or duration is reached.  The request counts,
+// errors, and latencies for each test are then reported using the current
+// output format.
+//
+
+static bool				// O - `true` on success, `false` on failure
+do_load(const char     *testfile,	// I - Test file to use
+        ipptool_test_t *data,		// I - Test data
+        int            clients,		// I - Number of clients
+        double         duration,	// I - Duration in seconds or 0.0 for none
+        int            repeat,		// I - Repeat count
+        int            interval)	// I - Delay between runs in microseconds
+{
+  int		i;			// Looping var
+  bool		ret = true;		// Return value
+  ipptool_load_t load;			// Load test parameters
+  ipptool_test_t **cdata,		// Client test data
+		*client;		// Current client
+  cups_thread_t	*threads;		// Client threads
+  cups_array_t	*stats;			// Combined test statistics
+  ipptool_stats_t *cstats,		// Client test statistics
+		*tstats;		// Combined statistics for test
+  double	*samples,		// New samples array
+		start;			// Start time
+
+
+  if (data->output == IPPTOOL_OUTPUT_IPPFILE)
+  {
+    print_fatal_error(data, "Unable to produce an IPP attribute file for a load test.");
+    return (false);
+  }
+
+  if (clients < 1)
+    clients = 1;
+
+  load.testfile = testfile;
+  load.repeat   = repeat > 0 ? repeat : 1;
+  load.interval = (useconds_t)interval;
+  load.end_time = 0.0;
+
+  if ((cdata = calloc((size_t)clients, sizeof(ipptool_test_t *))) == NULL || (threads = calloc((size_t)clients, sizeof(cups_thread_t))) == NULL)
+  {
+    free(cdata);
+    print_fatal_error(data, "Unable to allocate memory for %d clients.", clients);
+    return (false);
+  }
+
+  // Create the clients, which inherit the options and variables of the main
+  // test data...
+  for (i = 0; i < clients; i ++)
+  {
+    client = alloc_data();
+
+    ippFileDelete(client->parent);
+
+    client->parent                   = ippFileNew(data->parent, /*attr_cb*/NULL, (ipp_ferror_cb_t)error_cb, client);
+    client->encryption               = data->encryption;
+    client->family                   = data->family;
+    client->output                   = IPPTOOL_OUTPUT_QUIET;
+    client->repeat_on_busy           = data->repeat_on_busy;
+    client->stop_after_include_error = data->stop_after_include_error;
+    client->timeout                  = data->timeout;
+    client->validate_headers         = data->validate_headers;
+    client->bearer_token             = data->bearer_token;
+    client->client_name              = data->client_name;
+    client->user_agent               = data->user_agent;
+    client->def_ignore_errors        = data->def_ignore_errors;
+    client->def_transfer             = data->def_transfer;
+    client->def_version              = data->def_version;
+    client->load                     = &load;
+    client->stats                    = cupsArrayNew(/*cb*/NULL, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, (cups_afree_cb_t)free_stats);
+
+    cdata[i] = client;
+  }
+
+  // Run the clients...
+  start = cupsGetClock();
+
+  if (duration > 0.0)
+    load.end_time = start + duration;
+
+  for (i = 0; i < clients; i ++)
+  {
+    if ((threads[i] = cupsThreadCreate((cups_thread_func_t)do_load_client, cdata[i])) == CUPS_THREAD_INVALID)
+    {
+      print_fatal_error(data, "Unable to create client thread: %s", strerror(errno));
+      cdata[i]->pass = false;
+    }
+  }
+
+  for (i = 0; i < clients; i ++)
+  {
+    if (threads[i] != CUPS_THREAD_INVALID)
+      cupsThreadWait(threads[i]);
+  }
+
+  // Combine the results from each client...
+  stats = cupsArrayNew(/*cb*/NULL, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, (cups_afree_cb_t)free_stats);
+
+  for (i = 0; i < clients; i ++)
+  {
+    client = cdata[i];
+
+    data->test_count += client->test_count;
+    data->pass_count += client->pass_count;
+    data->fail_count += client->fail_count;
+    data->skip_count += client->skip_count;
+
+    if (!client->pass)
+      ret = data->pass = false;
+
+    for (cstats = (ipptool_stats_t *)cupsArrayGetFirst(client->stats); cstats; cstats = (ipptool_stats_t *)cupsArrayGetNext(client->stats))
+    {
+      if ((tstats = get_stats(stats, cstats->name)) == NULL)
+        continue;
+
+      tstats->requests += cstats->requests;
+      tstats->errors   += cstats->errors;
+
+      if (cstats->num_samples == 0)
+        continue;
+
+      if ((samples = realloc(tstats->samples, (tstats->num_samples + cstats->num_samples) * sizeof(double))) == NULL)
+        continue;
+
+      memcpy(samples + tstats->num_samples, cstats->samples, cstats->num_samples * sizeof(double));
+
+      tstats->samples       = samples;
+      tstats->num_samples   += cstats->num_samples;
+      tstats->alloc_samples = tstats->num_samples;
+    }
+
+    cupsArrayDelete(client->stats);
+    free_data(client);
+  }
+
+  // Report the results...
+  print_stats(data, stats, clients, cupsGetClock() - start);
+
+  cupsArrayDelete(stats);
+  free(cdata);
+  free(threads);
+
+  return (ret);
+}
+
+
+//
+// 'do_load_client()' - Run the tests for a load test client.
+//
+
+static void *				// O - Thread exit status
+do_load_client(ipptool_test_t *data)	// I - Client test data
+{
+  int	count;				// Number of runs
+
+
+  // Use the credentials from the URI, if any...
+  if (ippFileGetVar(data->parent, "uriuser") && ippFileGetVar(data->parent, "uripassword"))
+    cupsSetPasswordCB(password_cb, data->parent);
+
+  // Connect to the printer/server, reusing the connection for every run...
+  if ((data->http = connect_printer(data)) == NULL)
+  {
+    data->pass = false;
+    return (NULL);
+  }
+
+  for (count = 0; !Cancel; count ++)
+  {
+    if (data->load->end_time > 0.0 ? cupsGetClock() >= data->load->end_time : count >= data->load->repeat)
+      break;
+
+    if (count > 0 && data->load->interval > 0)
+      usleep(data->load->interval);
+
+    data->prev_pass   = true;
+    data->show_header = true;
+
+    do_tests(data->load->testfile, data);
+  }
+
+  httpClose(data->http);
+  data->http = NULL;
+
+  return (NULL);
+}
+
+
 //
 // 'do_monitor_printer_state()' - Do the MONITOR-PRINTER-STATE tests in the background.
 //
@@ -1359,7 +1976,7 @@ do_monitor_printer_state(
       if (found)
 	ippAttributeString(found, buffer, sizeof(buffer));
 
-      if (found && !with_value(data, NULL, expect->with_value, expect->with_flags, found, buffer, sizeof(buffer)))
+      if (found && !with_value(data, NULL, expect, found, buffer, sizeof(buffer)))
       {
 	if (expect->define_no_match)
 	{
@@ -1482,18 +2099,27 @@ do_test(ipp_file_t     *f,		// I - IPP data file
   ssize_t	bytes;			// Bytes read/written
   size_t	widths[200];		// Width of columns
   const char	*error;			// Current error
+  double	start,			// Start time of request
+		phase,			// Start time of request phase
+		wait_time,		// Time to wait for first response byte
+		elapsed = 0.0;		// Total time for requests
+  ipptool_timing_t timing;		// Timing for current request
+  ipptool_stats_t rstats;		// Latency of repeated requests
 
 
   if (Cancel)
     return (false);
 
+  if (data->load && data->load->end_time > 0.0 && cupsGetClock() >= data->load->end_time)
+    return (false);
+
   if (getenv("IPPTOOL_DEBUG"))
     fprintf(stderr, "ipptool: Doing test '%s', num_expects=%u, num_statuses=%u.\n", data->name, (unsigned)data->num_expects, (unsigned)data->num_statuses);
 
   // Show any PAUSE message, as needed...
   if (data->pause[0])
   {
-    if (!data->skip_test && !data->pass_test)
+    if (!data->skip_test && !data->pass_test && !data->load)
       pause_message(data->pause);
 
     data->pause[0] = '\0';
@@ -1603,6 +2229,10 @@ do_test(ipp_file_t     *f,		// I - IPP data file
 
   data->password_tries = 0;
 
+  memset(&rstats, 0, sizeof(rstats));
+
+  wait_time = data->timeout > 0.0 ? data->timeout : 30.0;
+
   do
   {
     if (data->delay > 0)
@@ -1640,6 +2270,22 @@ do_test(ipp_file_t     *f,		// I - IPP data file
     data->prev_pass = true;
     repeat_test     = false;
     response        = NULL;
+    start           = cupsGetClock();
+
+    memset(&timing, 0, sizeof(timing));
+    timing.connect     = data->connect_time;
+    data->connect_time = 0.0;
+
+    if (data->http && !_cups_strcasecmp(httpGetField(data->http, HTTP_FIELD_CONNECTION), "close"))
+    {
+      // Reconnect now so the time is not counted as part of sending...
+      httpClearFields(data->http);
+
+      if (!httpConnectAgain(data->http, /*msec*/30000, /*cancel*/NULL))
+        status = HTTP_STATUS_ERROR;
+
+      timing.connect += cupsGetClock() - start;
+    }
 
     if (status != HTTP_STATUS_ERROR)
     {
@@ -1647,6 +2293,7 @@ do_test(ipp_file_t     *f,		// I - IPP data file
       {
         ippSetRequestId(request, ++ data->request_id);
 
+        phase  = cupsGetClock();
 	status = cupsSendRequest(data->http, request, data->resource, length);
 
 	if (data->compression[0])
@@ -1679,11 +2326,34 @@ do_test(ipp_file_t     *f,		// I - IPP data file
 	  status = generate_file(data->http, data->generate_params);
 	}
 
-        // Get the server's response...
+        // Finish a chunked request so the server can respond...
+        if (!Cancel && status == HTTP_STATUS_CONTINUE && length == 0 && httpGetState(data->http) == HTTP_STATE_POST_RECV)
+          httpWrite(data->http, "", 0);
+
+        // Get the server's response.  cupsSendRequest may have already read
+        // the response status, so the wait for the response is counted as
+        // part of sending the request...
 	if (!Cancel && status != HTTP_STATUS_ERROR)
 	{
+	  if (httpGetState(data->http) == HTTP_STATE_POST_SEND)
+	  {
+	    double wait_start = cupsGetClock();
+					// Start of wait
+
+	    while (!Cancel && !httpWait(data->http, 1000) && (cupsGetClock() - wait_start) < wait_time);
+	  }
+
+	  timing.send += cupsGetClock() - phase;
+	  phase       = cupsGetClock();
+
 	  response = cupsGetResponse(data->http, data->resource);
 	  status   = httpGetStatus(data->http);
+
+	  timing.parse += cupsGetClock() - phase;
+	}
+	else
+	{
+	  timing.send += cupsGetClock() - phase;
 	}
 
 	if (!Cancel && status == HTTP_STATUS_ERROR && httpGetError(data->http) != EINVAL &&
@@ -1693,8 +2363,12 @@ do_test(ipp_file_t     *f,		// I - IPP data file
 	    httpGetError(data->http) != ETIMEDOUT)
 #endif // _WIN32
 	{
+	  phase = cupsGetClock();
+
 	  if (!httpConnectAgain(data->http, /*msec*/30000, /*cancel*/NULL))
 	    data->prev_pass = false;
+
+	  timing.connect += cupsGetClock() - phase;
 	}
 	else if (status == HTTP_STATUS_ERROR || status == HTTP_STATUS_CUPS_AUTHORIZATION_CANCELED)
 	{
@@ -1736,6 +2410,10 @@ do_test(ipp_file_t     *f,		// I - IPP data file
       data->prev_pass = false;
     }
 
+    elapsed += cupsGetClock() - start;
+
+    add_stats(&rstats, 1, data->prev_pass ? 0 : 1, timing.connect + timing.send + timing.parse);
+
     // Check results of request...
     cupsArrayClear(data->errors);
 
@@ -2086,7 +2764,7 @@ do_test(ipp_file_t     *f,		// I - IPP data file
             ippRestore(response);
 	    break;
 	  }
-	  else if (found && !with_value(data, NULL, expect->with_value, expect->with_flags, found, data->buffer, sizeof(data->buffer)))
+	  else if (found && !with_value(data, NULL, expect, found, data->buffer, sizeof(data->buffer)))
 	  {
 	    if (expect->define_no_match)
 	    {
@@ -2101,7 +2779,7 @@ do_test(ipp_file_t     *f,		// I - IPP data file
 	      else
 		add_stringf(exp_errors, "EXPECTED: %s %s \"%s\"", expect->name, with_flags_string(expect->with_flags), expect->with_value);
 
-	      with_value(data, exp_errors, expect->with_value, expect->with_flags, found, data->buffer, sizeof(data->buffer));
+	      with_value(data, exp_errors, expect, found, data->buffer, sizeof(data->buffer));
 	    }
 
 	    if (expect->repeat_no_match && repeat_count < expect->repeat_limit)
@@ -2307,6 +2985,9 @@ do_test(ipp_file_t     *f,		// I - IPP data file
   else
     data->fail_count ++;
 
+  if (data->stats)
+    add_stats(get_stats(data->stats, data->name), (size_t)repeat_count, data->prev_pass ? 0 : 1, elapsed);
+
   if (data->output == IPPTOOL_OUTPUT_PLIST)
   {
     cupsFilePuts(data->outfile, "<key>Successful</key>\n");
@@ -2366,7 +3047,9 @@ do_test(ipp_file_t     *f,		// I - IPP data file
     }
 
     if (cur_tag)
-      cupsFilePuts(data->outfile, "    }\n");
+      cupsFilePuts(data->outfile, data->timing ? "    },\n" : "    }\n");
+    if (data->timing)
+      print_timing(data, &timing, &rstats);
     cupsFilePuts(data->outfile, "]\n");
   }
 
@@ -2473,6 +3156,11 @@ do_test(ipp_file_t     *f,		// I - IPP data file
     }
   }
 
+  if (data->timing && data->output != IPPTOOL_OUTPUT_JSON)
+    print_timing(data, &timing, &rstats);
+
+  free(rstats.samples);
+
   skip_error:
 
   if (data->monitor_thread)
@@ -2502,10 +3190,19 @@ do_tests(const char     *testfile,	// I - Test file to use
          ipptool_test_t *data)		// I - Test data
 {
   ipp_file_t	*file;			// IPP data file
+  ipptool_tokens_t *tokens;		// Cached test file tokens
+  bool		close_http = !data->http;
+					// Close the connection when done?
+  double	start;			// Start of connection
 
 
-  // Connect to the printer/server...
-  data->http = connect_printer(data);
+  // Connect to the printer/server as needed...
+  if (!data->http)
+  {
+    start              = cupsGetClock();
+    data->http         = connect_printer(data);
+    data->connect_time = cupsGetClock() - start;
+  }
 
   // Run tests...
   if ((file = ippFileNew(data->parent, NULL, (ipp_ferror_cb_t)error_cb, data)) == NULL)
@@ -2514,9 +3211,10 @@ do_tests(const char     *testfile,	// I - Test file to use
     return (false);
   }
 
-  if (!ippFileOpen(file, testfile, "r"))
+  if ((tokens = get_tokens(testfile)) == NULL || !_ippFileOpenTokens(file, tokens->tokens))
   {
     print_fatal_error(data, "Unable to open '%s': %s", testfile, cupsGetErrorString());
+    ippFileDelete(file);
     return (false);
   }
 
@@ -2524,9 +3222,15 @@ do_tests(const char     *testfile,	// I - Test file to use
 
   ippFileDelete(file);
 
+  if (data->timing)
+    print_timings(data);
+
   // Close connection and return...
-  httpClose(data->http);
-  data->http = NULL;
+  if (close_http)
+  {
+    httpClose(data->http);
+    data->http = NULL;
+  }
 
   return (data->pass);
 }
@@ -2558,183 +3262,88 @@ expect_matches(
     ipptool_expect_t *expect,		// I - Expected attribute
     ipp_attribute_t  *attr)		// I - Attribute
 {
-  size_t	i,			// Looping var
+  size_t	i, j,			// Looping vars
 		count;			// Number of values
   bool		match;			// Match?
-  char		*of_type,		// Type name to match
-		*paren,			// Pointer to opening parenthesis
-		*next,			// Next name to match
-		sep;			// Separator character
+  ipptool_type_t *type;			// Current syntax
   ipp_tag_t	value_tag;		// Syntax/value tag
-  int		lower, upper;		// Lower and upper bounds for syntax
 
 
   // If we don't expect a particular type, return immediately...
   if (!expect->of_type)
     return (true);
 
-  // Parse the "of_type" value since the string can contain multiple attribute
-  // types separated by "," or "|"...
+  // Check each of the syntaxes compiled from the "of_type" value...
   value_tag = ippGetValueTag(attr);
   count     = ippGetCount(attr);
 
-  for (of_type = expect->of_type, match = false; !match && *of_type; of_type = next)
+  for (i = expect->num_of_types, type = expect->of_types, match = false; !match && i > 0; i --, type ++)
   {
-    // Find the next separator, and set it (temporarily) to nul if present.
-    for (next = of_type; *next && *next != '|' && *next != ','; next ++);
-
-    if ((sep = *next) != '\0')
-      *next = '\0';
-
-    // Support some meta-types to make it easier to write the test file.
-    if ((paren = strchr(of_type, '(')) != NULL)
-    {
-      char *ptr;			// Pointer into syntax string
-
-      *paren = '\0';
-
-      if (!strncmp(paren + 1, "MIN:", 4))
-      {
-        lower = INT_MIN;
-        ptr   = paren + 5;
-      }
-      else if ((ptr = strchr(paren + 1, ':')) != NULL)
-      {
-        lower = atoi(paren + 1);
-        ptr ++;
-      }
-      else
-      {
-        lower = 0;
-        ptr   = paren + 1;
-      }
-
-      if (!strcmp(ptr, "MAX)"))
-        upper = INT_MAX;
-      else
-        upper = atoi(ptr);
-    }
-    else
-    {
-      lower = INT_MIN;
-      upper = INT_MAX;
-    }
-
-    if (!strcmp(of_type, "text"))
-    {
-      if (upper == INT_MAX)
-        upper = 1023;
-
-      if (value_tag == IPP_TAG_TEXTLANG || value_tag == IPP_TAG_TEXT)
-      {
-        for (i = 0; i < count; i ++)
-	{
-	  if (strlen(ippGetString(attr, i, NULL)) > (size_t)upper)
-	    break;
-	}
-
-	match = (i == count);
-      }
-    }
-    else if (!strcmp(of_type, "name"))
-    {
-      if (upper == INT_MAX)
-        upper = 255;
-
-      if (value_tag == IPP_TAG_NAMELANG || value_tag == IPP_TAG_NAME)
-      {
-        for (i = 0; i < count; i ++)
-	{
-	  if (strlen(ippGetString(attr, i, NULL)) > (size_t)upper)
-	    break;
-	}
+    if (value_tag != type->value_tag && value_tag != type->lang_tag)
+      continue;
 
-	match = (i == count);
-      }
-    }
-    else if (!strcmp(of_type, "collection"))
-    {
-      match = value_tag == IPP_TAG_BEGIN_COLLECTION;
-    }
-    else if (value_tag == ippTagValue(of_type))
+    switch (value_tag)
     {
-      switch (value_tag)
-      {
-        case IPP_TAG_KEYWORD :
-        case IPP_TAG_URI :
-            if (upper == INT_MAX)
-            {
-              if (value_tag == IPP_TAG_KEYWORD)
-		upper = 255;
-	      else
-	        upper = 1023;
-	    }
-
-	    for (i = 0; i < count; i ++)
-	    {
-	      if (strlen(ippGetString(attr, i, NULL)) > (size_t)upper)
-		break;
-	    }
-
-	    match = (i == count);
-	    break;
+      case IPP_TAG_KEYWORD :
+      case IPP_TAG_NAME :
+      case IPP_TAG_NAMELANG :
+      case IPP_TAG_TEXT :
+      case IPP_TAG_TEXTLANG :
+      case IPP_TAG_URI :
+	  for (j = 0; j < count; j ++)
+	  {
+	    if (strlen(ippGetString(attr, j, NULL)) > (size_t)type->upper)
+	      break;
+	  }
 
-        case IPP_TAG_STRING :
-            if (upper == INT_MAX)
-	      upper = 1023;
+	  match = (j == count);
+	  break;
 
-	    for (i = 0; i < count; i ++)
-	    {
-	      size_t	datalen;	// Length of octetString value
+      case IPP_TAG_STRING :
+	  for (j = 0; j < count; j ++)
+	  {
+	    size_t	datalen;	// Length of octetString value
 
-	      ippGetOctetString(attr, i, &datalen);
+	    ippGetOctetString(attr, j, &datalen);
 
-	      if (datalen > (size_t)upper)
-		break;
-	    }
+	    if (datalen > (size_t)type->upper)
+	      break;
+	  }
 
-	    match = (i == count);
-	    break;
+	  match = (j == count);
+	  break;
 
-	case IPP_TAG_INTEGER :
-	    for (i = 0; i < count; i ++)
-	    {
-	      int value = ippGetInteger(attr, i);
+      case IPP_TAG_INTEGER :
+	  for (j = 0; j < count; j ++)
+	  {
+	    int value = ippGetInteger(attr, j);
 					// Integer value
 
-	      if (value < lower || value > upper)
-		break;
-	    }
+	    if (value < type->lower || value > type->upper)
+	      break;
+	  }
 
-	    match = (i == count);
-	    break;
+	  match = (j == count);
+	  break;
 
-	case IPP_TAG_RANGE :
-	    for (i = 0; i < count; i ++)
-	    {
-	      int vupper, vlower = ippGetRange(attr, i, &vupper);
+      case IPP_TAG_RANGE :
+	  for (j = 0; j < count; j ++)
+	  {
+	    int vupper, vlower = ippGetRange(attr, j, &vupper);
 					// Range value
 
-	      if (vlower < lower || vlower > upper || vupper < lower || vupper > upper)
-		break;
-	    }
+	    if (vlower < type->lower || vlower > type->upper || vupper < type->lower || vupper > type->upper)
+	      break;
+	  }
 
-	    match = (i == count);
-	    break;
+	  match = (j == count);
+	  break;
 
-	default :
-	    // No other constraints, so this is a match
-	    match = true;
-	    break;
-      }
+      default :
+	  // No other constraints, so this is a match
+	  match = true;
+	  break;
     }
-
-    // Restore the separators if we have them...
-    if (paren)
-      *paren = '(';
-
-    if (sep)
-      *next++ = sep;
   }
 
   return (match);
@@ -2752,11 +3361,44 @@ free_data(ipptool_test_t *data)		// I - Test data
 
   ippFileDelete(data->parent);
   cupsArrayDelete(data->errors);
+  cupsArrayDelete(data->timings);
 
   free(data);
 }
 
 
+//
+// 'free_stats()' - Free load test statistics.
+//
+
+static void
+free_stats(ipptool_stats_t *stats,	// I - Test statistics
+           void            *cb_data)	// I - Callback data (unused)
+{
+  (void)cb_data;
+
+  free(stats->name);
+  free(stats->samples);
+  free(stats);
+}
+
+
+//
+// 'free_tokens()' - Free the cached tokens for a test file.
+//
+
+static void
+free_tokens(ipptool_tokens_t *tokens,	// I - Cached test file tokens
+            void             *cb_data)	// I - Callback data (unused)
+{
+  (void)cb_data;
+
+  _ippFileTokensDelete(tokens->tokens);
+  free(tokens->filename);
+  free(tokens);
+}
+
+
 //
 // 'generate_file()' - Generate a print file.
 //
@@ -2883,6 +3525,72 @@ get_filename(const char *testfile,	// I - Current test file
 }
 
 
+//
+// 'get_percentiles()' - Get the latency percentiles for a test.
+//
+
+static void
+get_percentiles(ipptool_stats_t *stats,	// I - Test statistics
+                double          *pmin,	// O - Minimum latency
+                double          *p50,	// O - Median latency
+                double          *p95,	// O - 95th percentile latency
+                double          *p99,	// O - 99th percentile latency
+                double          *pmax)	// O - Maximum latency
+{
+  size_t	n;			// Number of samples
+
+
+  // Sort the samples to find the percentiles...
+  if ((n = stats->num_samples) > 0)
+  {
+    qsort(stats->samples, n, sizeof(double), (int (*)(const void *, const void *))compare_samples);
+
+    *pmin = stats->samples[0];
+    *p50  = stats->samples[(n - 1) * 50 / 100];
+    *p95  = stats->samples[(n - 1) * 95 / 100];
+    *p99  = stats->samples[(n - 1) * 99 / 100];
+    *pmax = stats->samples[n - 1];
+  }
+  else
+  {
+    *pmin = *p50 = *p95 = *p99 = *pmax = 0.0;
+  }
+}
+
+
+//
+// 'get_stats()' - Find or add the load test statistics for a test.
+//
+
+static ipptool_stats_t *		// O - Test statistics or `NULL` on error
+get_stats(cups_array_t *a,		// I - Statistics array
+          const char   *name)		// I - Test name
+{
+  ipptool_stats_t	*stats;		// Test statistics
+
+
+  // Tests are reported in the order they are run, so use a linear search...
+  for (stats = (ipptool_stats_t *)cupsArrayGetFirst(a); stats; stats = (ipptool_stats_t *)cupsArrayGetNext(a))
+  {
+    if (!strcmp(stats->name, name))
+      return (stats);
+  }
+
+  if ((stats = calloc(1, sizeof(ipptool_stats_t))) == NULL)
+    return (NULL);
+
+  if ((stats->name = strdup(name)) == NULL)
+  {
+    free(stats);
+    return (NULL);
+  }
+
+  cupsArrayAdd(a, stats);
+
+  return (stats);
+}
+
+
 //
 // 'get_string()' - Get a pointer to a string value or the portion of interest.
 //
@@ -2957,23 +3665,69 @@ get_string(ipp_attribute_t *attr,	// I - IPP attribute
 }
 
 
+//
+// 'get_tokens()' - Find or read the cached tokens for a test file.
+//
+// Test files are only read and tokenized once, the first time they are used.
+// Repeated runs (-i/-n), included files, and load test clients all read from
+// the same in-memory tokens, with variables expanded as each run reads them.
+//
+
+static ipptool_tokens_t *		// O - Cached test file tokens or `NULL` on error
+get_tokens(const char *testfile)	// I - Test file
+{
+  ipptool_tokens_t	key,		// Search key
+			*tokens;	// Cached test file tokens
+
+
+  cupsMutexLock(&TokensMutex);
+
+  if (!Tokens)
+    Tokens = cupsArrayNew((cups_array_cb_t)compare_tokens, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, (cups_afree_cb_t)free_tokens);
+
+  key.filename = (char *)testfile;
+
+  if ((tokens = (ipptool_tokens_t *)cupsArrayFind(Tokens, &key)) == NULL)
+  {
+    if ((tokens = calloc(1, sizeof(ipptool_tokens_t))) != NULL)
+    {
+      if ((tokens->filename = strdup(testfile)) == NULL || (tokens->tokens = _ippFileTokensNew(testfile)) == NULL)
+      {
+        free(tokens->filename);
+        free(tokens);
+        tokens = NULL;
+      }
+      else
+      {
+        cupsArrayAdd(Tokens, tokens);
+      }
+    }
+  }
+
+  cupsMutexUnlock(&TokensMutex);
+
+  return (tokens);
+}
+
+
 //
 // 'iso_date()' - Return an ISO 8601 date/time string for the given IPP dateTime
 //                value.
 //
 
 static char *				// O - ISO 8601 date/time string
-iso_date(const ipp_uchar_t *date)	// I - IPP (RFC 1903) date/time value
+iso_date(const ipp_uchar_t *date,	// I - IPP (RFC 1903) date/time value
+         char              *buffer,	// I - String buffer
+         size_t            bufsize)	// I - Size of string buffer
 {
   time_t	utctime;		// UTC time since 1970
   struct tm	utcdate;		// UTC date/time
-  static char	buffer[255];		// String buffer
 
 
   utctime = ippDateToTime(date);
   gmtime_r(&utctime, &utcdate);
 
-  snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02dZ",
+  snprintf(buffer, bufsize, "%04d-%02d-%02dT%02d:%02d:%02dZ",
 	   utcdate.tm_year + 1900, utcdate.tm_mon + 1, utcdate.tm_mday,
 	   utcdate.tm_hour, utcdate.tm_min, utcdate.tm_sec);
 
@@ -3892,7 +4646,11 @@ parse_monitor_printer_state(
 
       if (data->last_expect)
       {
+        free(data->last_expect->of_type);
 	data->last_expect->of_type = strdup(temp);
+
+	if (!compile_of_type(data, data->last_expect))
+	  return (0);
       }
       else
       {
@@ -4027,6 +4785,7 @@ parse_monitor_printer_state(
 	if (value[0] == '/' && ptr > value && *ptr == '/')
 	{
 	  // WITH-VALUE is a POSIX extended regular expression.
+	  free(data->last_expect->with_value);
 	  data->last_expect->with_value = calloc(1, (size_t)(ptr - value));
 	  data->last_expect->with_flags |= IPPTOOL_WITH_REGEX;
 
@@ -4045,9 +4804,13 @@ parse_monitor_printer_state(
 	    }
 	  }
 
+	  free(data->last_expect->with_value);
 	  data->last_expect->with_value = strdup(value);
 	  data->last_expect->with_flags |= IPPTOOL_WITH_LITERAL;
 	}
+
+	if (!compile_with_value(f, data, data->last_expect))
+	  return (0);
       }
       else
       {
@@ -4208,6 +4971,7 @@ print_attr(cups_file_t      *outfile,	// I  - Output file
   size_t		i,		// Looping var
 			count;		// Number of values
   ipp_attribute_t	*colattr;	// Collection attribute
+  char			date[32];	// ISO 8601 date/time string
 
 
   if (output == IPPTOOL_OUTPUT_PLIST)
@@ -4267,7 +5031,7 @@ print_attr(cups_file_t      *outfile,	// I  - Output file
 
       case IPP_TAG_DATE :
 	  for (i = 0; i < count; i ++)
-	    cupsFilePrintf(outfile, "<date>%s</date>\n", iso_date(ippGetDate(attr, i)));
+	    cupsFilePrintf(outfile, "<date>%s</date>\n", iso_date(ippGetDate(attr, i), date, sizeof(date)));
 	  break;
 
       case IPP_TAG_STRING :
@@ -4493,6 +5257,8 @@ print_fatal_error(
   va_end(ap);
 
   // Then output it...
+  data->pass = false;
+
   if (data->output == IPPTOOL_OUTPUT_PLIST)
   {
     print_xml_header(data);
@@ -4517,6 +5283,7 @@ print_ippserver_attr(
 			count = ippGetCount(attr);
 					// Number of values
   ipp_attribute_t	*colattr;	// Collection attribute
+  char			date[32];	// ISO 8601 date/time string
 
 
   if (indent == 0)
@@ -4560,7 +5327,7 @@ print_ippserver_attr(
 
     case IPP_TAG_DATE :
 	for (i = 0; i < count; i ++)
-	  cupsFilePrintf(data->outfile, "%s%s", i ? "," : " ", iso_date(ippGetDate(attr, i)));
+	  cupsFilePrintf(data->outfile, "%s%s", i ? "," : " ", iso_date(ippGetDate(attr, i), date, sizeof(date)));
 	break;
 
     case IPP_TAG_STRING :
@@ -4654,6 +5421,7 @@ print_json_attr(
 		count = ippGetCount(attr);
 					// Number of values
   ipp_attribute_t *colattr;		// Collection attribute
+  char		date[32];		// ISO 8601 date/time string
 
 
   cupsFilePrintf(data->outfile, "%*s", indent, "");
@@ -4735,13 +5503,13 @@ print_json_attr(
     case IPP_TAG_DATE :
         if (count == 1)
         {
-	  cupsFilePrintf(data->outfile, ": \"%s\"", iso_date(ippGetDate(attr, 0)));
+	  cupsFilePrintf(data->outfile, ": \"%s\"", iso_date(ippGetDate(attr, 0), date, sizeof(date)));
         }
         else
         {
           cupsFilePuts(data->outfile, ": [\n");
 	  for (i = 0; i < count; i ++)
-	    cupsFilePrintf(data->outfile, "%*s\"%s\"%s", indent + 4, "", iso_date(ippGetDate(attr, i)), (i + 1) < count ? ",\n" : "\n");
+	    cupsFilePrintf(data->outfile, "%*s\"%s\"%s", indent + 4, "", iso_date(ippGetDate(attr, i), date, sizeof(date)), (i + 1) < count ? ",\n" : "\n");
           cupsFilePrintf(data->outfile, "%*s]", indent, "");
 	}
 	break;
@@ -5000,6 +5768,208 @@ print_line(
 }
 
 
+//
+// 'print_stats()' - Print load test statistics.
+//
+// Latencies are reported in seconds for plist, JSON, and CSV output and in
+// milliseconds for the test and list output.
+//
+
+static void
+print_stats(ipptool_test_t *data,	// I - Test data
+            cups_array_t   *stats,	// I - Test statistics
+            int            clients,	// I - Number of clients
+            double         seconds)	// I - Duration of test in seconds
+{
+  ipptool_stats_t *tstats;		// Current test statistics
+  double	rate,			// Requests per second
+		pmin, p50, p95, p99, pmax;
+					// Latency percentiles
+  cups_file_t	*outfile;		// Output file for report
+
+
+  if (seconds <= 0.0)
+    seconds = 0.000001;
+
+  if (data->output == IPPTOOL_OUTPUT_PLIST)
+  {
+    print_xml_header(data);
+  }
+  else if (data->output == IPPTOOL_OUTPUT_JSON)
+  {
+    cupsFilePrintf(data->outfile, "{\n    \"clients\": %d,\n    \"duration\": %.3f,\n    \"tests\": [\n", clients, seconds);
+  }
+  else if (data->output == IPPTOOL_OUTPUT_CSV)
+  {
+    cupsFilePuts(data->outfile, "Test,Requests,Errors,RequestsPerSecond,Min,Median,P95,P99,Max\n");
+  }
+
+  if (data->output == IPPTOOL_OUTPUT_TEST || data->output == IPPTOOL_OUTPUT_LIST || (data->output == IPPTOOL_OUTPUT_PLIST && data->outfile != cupsFileStdout()))
+  {
+    outfile = data->output == IPPTOOL_OUTPUT_LIST ? data->outfile : cupsFileStdout();
+
+    cupsFilePrintf(outfile, "%d clients, %.3f seconds\n", clients, seconds);
+    cupsFilePrintf(outfile, "%-40s %8s %8s %9s %9s %9s %9s %9s %9s\n", "Test", "Requests", "Errors", "Req/s", "Min ms", "Median ms", "P95 ms", "P99 ms", "Max ms");
+  }
+  else
+  {
+    outfile = NULL;
+  }
+
+  for (tstats = (ipptool_stats_t *)cupsArrayGetFirst(stats); tstats; tstats = (ipptool_stats_t *)cupsArrayGetNext(stats))
+  {
+    get_percentiles(tstats, &pmin, &p50, &p95, &p99, &pmax);
+
+    rate = tstats->requests / seconds;
+
+    if (data->output == IPPTOOL_OUTPUT_PLIST)
+    {
+      cupsFilePuts(data->outfile, "<dict>\n");
+      cupsFilePuts(data->outfile, "<key>Name</key>\n");
+      print_xml_string(data->outfile, "string", tstats->name);
+      cupsFilePuts(data->outfile, "<key>Clients</key>\n");
+      cupsFilePrintf(data->outfile, "<integer>%d</integer>\n", clients);
+      cupsFilePuts(data->outfile, "<key>Duration</key>\n");
+      cupsFilePrintf(data->outfile, "<real>%.6f</real>\n", seconds);
+      cupsFilePuts(data->outfile, "<key>Requests</key>\n");
+      cupsFilePrintf(data->outfile, "<integer>%lu</integer>\n", (unsigned long)tstats->requests);
+      cupsFilePuts(data->outfile, "<key>Errors</key>\n");
+      cupsFilePrintf(data->outfile, "<integer>%lu</integer>\n", (unsigned long)tstats->errors);
+      cupsFilePuts(data->outfile, "<key>RequestsPerSecond</key>\n");
+      cupsFilePrintf(data->outfile, "<real>%.3f</real>\n", rate);
+      cupsFilePuts(data->outfile, "<key>Latency</key>\n");
+      cupsFilePrintf(data->outfile, "<dict><key>Min</key><real>%.6f</real><key>Median</key><real>%.6f</real><key>P95</key><real>%.6f</real><key>P99</key><real>%.6f</real><key>Max</key><real>%.6f</real></dict>\n", pmin, p50, p95, p99, pmax);
+      cupsFilePuts(data->outfile, "<key>Successful</key>\n");
+      cupsFilePuts(data->outfile, tstats->errors ? "<false />\n" : "<true />\n");
+      cupsFilePuts(data->outfile, "</dict>\n");
+    }
+    else if (data->output == IPPTOOL_OUTPUT_JSON)
+    {
+      cupsFilePuts(data->outfile, "        {\n            \"name\": ");
+      print_json_string(data, tstats->name, strlen(tstats->name));
+      cupsFilePrintf(data->outfile, ",\n            \"requests\": %lu,\n            \"errors\": %lu,\n            \"requests-per-second\": %.3f,\n            \"latency\": {\n                \"min\": %.6f,\n                \"median\": %.6f,\n                \"p95\": %.6f,\n                \"p99\": %.6f,\n                \"max\": %.6f\n            }\n        }%s\n", (unsigned long)tstats->requests, (unsigned long)tstats->errors, rate, pmin, p50, p95, p99, pmax, cupsArrayGetIndex(stats) + 1 < cupsArrayGetCount(stats) ? "," : "");
+    }
+    else if (data->output == IPPTOOL_OUTPUT_CSV)
+    {
+      cupsFilePrintf(data->outfile, "\"%s\",%lu,%lu,%.3f,%.6f,%.6f,%.6f,%.6f,%.6f\n", tstats->name, (unsigned long)tstats->requests, (unsigned long)tstats->errors, rate, pmin, p50, p95, p99, pmax);
+    }
+
+    if (outfile)
+      cupsFilePrintf(outfile, "%-40.40s %8lu %8lu %9.1f %9.3f %9.3f %9.3f %9.3f %9.3f\n", tstats->name, (unsigned long)tstats->requests, (unsigned long)tstats->errors, rate, 1000.0 * pmin, 1000.0 * p50, 1000.0 * p95, 1000.0 * p99, 1000.0 * pmax);
+  }
+
+  if (data->output == IPPTOOL_OUTPUT_JSON)
+    cupsFilePuts(data->outfile, "    ]\n}\n");
+}
+
+
+//
+// 'print_timing()' - Print the timing for a test.
+//
+// The phase times are for the last request and the latency is for all of the
+// requests sent for the test, including any REPEAT-xxx requests.  The send
+// time includes waiting for the response status since cupsSendRequest may read
+// it.  Times are reported in seconds for plist, JSON, CSV, and ippserver output
+// and in milliseconds for the test and list output.  CSV and list rows are
+// saved for the summary table printed by @link print_timings@ so they don't
+// end up in the middle of the attribute table.
+//
+
+static void
+print_timing(ipptool_test_t   *data,	// I - Test data
+             ipptool_timing_t *timing,	// I - Timing for last request
+             ipptool_stats_t  *stats)	// I - Latency of all requests
+{
+  double	total,			// Total time for last request
+		pmin, p50, p95, p99, pmax;
+					// Latency percentiles
+  const char	*nameptr;		// Pointer into test name
+  char		row[1024],		// Summary table row
+		*rowptr;		// Pointer into row
+
+
+  total = timing->connect + timing->send + timing->parse;
+
+  get_percentiles(stats, &pmin, &p50, &p95, &p99, &pmax);
+
+  switch (data->output)
+  {
+    case IPPTOOL_OUTPUT_PLIST :
+        cupsFilePuts(data->outfile, "<key>Timing</key>\n");
+        cupsFilePrintf(data->outfile, "<dict><key>Connect</key><real>%.6f</real><key>Send</key><real>%.6f</real><key>Parse</key><real>%.6f</real><key>Total</key><real>%.6f</real></dict>\n", timing->connect, timing->send, timing->parse, total);
+        cupsFilePuts(data->outfile, "<key>Requests</key>\n");
+        cupsFilePrintf(data->outfile, "<integer>%lu</integer>\n", (unsigned long)stats->requests);
+        cupsFilePuts(data->outfile, "<key>Latency</key>\n");
+        cupsFilePrintf(data->outfile, "<dict><key>Min</key><real>%.6f</real><key>Median</key><real>%.6f</real><key>P95</key><real>%.6f</real><key>Max</key><real>%.6f</real></dict>\n", pmin, p50, p95, pmax);
+        break;
+
+    case IPPTOOL_OUTPUT_IPPFILE :
+        cupsFilePrintf(data->outfile, "# %s: connect=%.6f send=%.6f parse=%.6f total=%.6f requests=%lu min=%.6f median=%.6f p95=%.6f max=%.6f\n", data->name, timing->connect, timing->send, timing->parse, total, (unsigned long)stats->requests, pmin, p50, p95, pmax);
+        break;
+
+    case IPPTOOL_OUTPUT_JSON :
+        cupsFilePrintf(data->outfile, "    {\n        \"timing\": {\n            \"connect\": %.6f,\n            \"send\": %.6f,\n            \"parse\": %.6f,\n            \"total\": %.6f\n        },\n        \"requests\": %lu,\n        \"latency\": {\n            \"min\": %.6f,\n            \"median\": %.6f,\n            \"p95\": %.6f,\n            \"max\": %.6f\n        }\n    }\n", timing->connect, timing->send, timing->parse, total, (unsigned long)stats->requests, pmin, p50, p95, pmax);
+        break;
+
+    case IPPTOOL_OUTPUT_CSV :
+        row[0] = '\"';
+        for (nameptr = data->name, rowptr = row + 1; *nameptr && rowptr < (row + sizeof(row) / 2); nameptr ++)
+        {
+          if (*nameptr == '\\' || *nameptr == '\"')
+            *rowptr++ = '\\';
+          *rowptr++ = *nameptr;
+        }
+        snprintf(rowptr, sizeof(row) - (size_t)(rowptr - row), "\",%.6f,%.6f,%.6f,%.6f,%lu,%.6f,%.6f,%.6f,%.6f", timing->connect, timing->send, timing->parse, total, (unsigned long)stats->requests, pmin, p50, p95, pmax);
+        cupsArrayAdd(data->timings, row);
+        break;
+
+    case IPPTOOL_OUTPUT_LIST :
+        snprintf(row, sizeof(row), "%-40.40s %10.3f %10.3f %10.3f %10.3f %8lu %10.3f %10.3f %10.3f %10.3f", data->name, 1000.0 * timing->connect, 1000.0 * timing->send, 1000.0 * timing->parse, 1000.0 * total, (unsigned long)stats->requests, 1000.0 * pmin, 1000.0 * p50, 1000.0 * p95, 1000.0 * pmax);
+        cupsArrayAdd(data->timings, row);
+        break;
+
+    default :
+        break;
+  }
+
+  if (data->output == IPPTOOL_OUTPUT_TEST || (data->output == IPPTOOL_OUTPUT_PLIST && data->outfile != cupsFileStdout()))
+  {
+    cupsFilePrintf(cupsFileStdout(), "        TIMING: connect=%.3fms, send=%.3fms, parse=%.3fms, total=%.3fms\n", 1000.0 * timing->connect, 1000.0 * timing->send, 1000.0 * timing->parse, 1000.0 * total);
+
+    if (stats->requests > 1)
+      cupsFilePrintf(cupsFileStdout(), "        LATENCY: %lu requests, min=%.3fms, median=%.3fms, p95=%.3fms, max=%.3fms\n", (unsigned long)stats->requests, 1000.0 * pmin, 1000.0 * p50, 1000.0 * p95, 1000.0 * pmax);
+  }
+}
+
+
+
+//
+// 'print_timings()' - Print the timing summary table for CSV and list output.
+//
+
+static void
+print_timings(ipptool_test_t *data)	// I - Test data
+{
+  const char	*row;			// Current row
+
+
+  if (cupsArrayGetCount(data->timings) == 0)
+    return;
+
+  // Separate the summary from the attribute table, if any...
+  cupsFilePuts(data->outfile, "\n");
+
+  if (data->output == IPPTOOL_OUTPUT_CSV)
+    cupsFilePuts(data->outfile, "Test,Connect,Send,Parse,Total,Requests,Min,Median,P95,Max\n");
+  else
+    cupsFilePrintf(data->outfile, "%-40s %10s %10s %10s %10s %8s %10s %10s %10s %10s\n", "Test", "Connect ms", "Send ms", "Parse ms", "Total ms", "Requests", "Min ms", "Median ms", "P95 ms", "Max ms");
+
+  for (row = (const char *)cupsArrayGetFirst(data->timings); row; row = (const char *)cupsArrayGetNext(data->timings))
+    cupsFilePrintf(data->outfile, "%s\n", row);
+
+  cupsArrayClear(data->timings);
+}
+
 //
 // 'print_xml_header()' - Print a standard XML plist header.
 //
@@ -5229,6 +6199,7 @@ token_cb(ipp_file_t     *f,		// I - IPP file data
   char	name[1024],			// Name string
 	temp[1024],			// Temporary string
 	value[1024],			// Value string
+	date[32],			// ISO 8601 date/time string
 	*ptr;				// Pointer into value
 
 
@@ -5864,7 +6835,11 @@ token_cb(ipp_file_t     *f,		// I - IPP file data
 
       if (data->last_expect)
       {
+        free(data->last_expect->of_type);
 	data->last_expect->of_type = strdup(temp);
+
+	if (!compile_of_type(data, data->last_expect))
+	  return (false);
       }
       else
       {
@@ -6181,6 +7156,7 @@ token_cb(ipp_file_t     *f,		// I - IPP file data
 	if (value[0] == '/' && ptr > value && *ptr == '/')
 	{
 	  // WITH-VALUE is a POSIX extended regular expression.
+	  free(data->last_expect->with_value);
 	  data->last_expect->with_value = calloc(1, (size_t)(ptr - value));
 	  data->last_expect->with_flags |= IPPTOOL_WITH_REGEX;
 
@@ -6199,9 +7175,13 @@ token_cb(ipp_file_t     *f,		// I - IPP file data
 	    }
 	  }
 
+	  free(data->last_expect->with_value);
 	  data->last_expect->with_value = strdup(value);
 	  data->last_expect->with_flags |= IPPTOOL_WITH_LITERAL;
 	}
+
+	if (!compile_with_value(f, data, data->last_expect))
+	  return (false);
       }
       else
       {
@@ -6308,14 +7288,14 @@ token_cb(ipp_file_t     *f,		// I - IPP file data
       data->num_monitor_expects = 0;
 
       ippFileSetAttributes(f, ippNew());
-      ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL))));
+      ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL)), date, sizeof(date)));
     }
     else if (!strcmp(token, "DEFINE"))
     {
       // DEFINE name value
       if (ippFileReadToken(f, name, sizeof(name)) && ippFileReadToken(f, temp, sizeof(temp)))
       {
-        ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL))));
+        ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL)), date, sizeof(date)));
         ippFileExpandVars(f, value, temp, sizeof(value));
 	ippFileSetVar(f, name, value);
       }
@@ -6332,7 +7312,7 @@ token_cb(ipp_file_t     *f,		// I - IPP file data
       {
         if (!ippFileGetVar(f, name))
         {
-          ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL))));
+          ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL)), date, sizeof(date)));
 	  ippFileExpandVars(f, value, temp, sizeof(value));
 	  ippFileSetVar(f, name, value);
 	}
@@ -6348,7 +7328,7 @@ token_cb(ipp_file_t     *f,		// I - IPP file data
       // FILE-ID "string"
       if (ippFileReadToken(f, temp, sizeof(temp)))
       {
-        ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL))));
+        ippFileSetVar(f, "date-current", iso_date(ippTimeToDate(time(NULL)), date, sizeof(date)));
         ippFileExpandVars(f, data->file_id, temp, sizeof(data->file_id));
       }
       else
@@ -6612,10 +7592,13 @@ usage(FILE *out)
   cupsLangPuts(out, _("Options:"));
   cupsLangPuts(out, _("--bearer-token BEARER-TOKEN    Set the OAuth Bearer token for authentication"));
   cupsLangPuts(out, _("--client-name CLIENT-NAME      Set the TLS client certificate name"));
+  cupsLangPuts(out, _("--clients NUMBER               Run the next file using concurrent clients"));
+  cupsLangPuts(out, _("--duration SECONDS             Run the next file repeatedly for the given time"));
   cupsLangPuts(out, _("--help                         Show this help"));
   cupsLangPuts(out, _("--help                         Show this help"));
   cupsLangPuts(out, _("--ippfile FILENAME             Produce IPP attribute file"));
   cupsLangPuts(out, _("--stop-after-include-error     Stop tests after a failed INCLUDE"));
+  cupsLangPuts(out, _("--timing                       Show the time taken by each request"));
   cupsLangPuts(out, _("--user-agent USER-AGENT        Set the HTTP User-Agent string"));
   cupsLangPuts(out, _("--version                      Show the program version"));
   cupsLangPuts(out, _("-4                             Connect using IPv4"));
@@ -7210,20 +8193,24 @@ with_flags_string(int flags)            // I - WITH flags
 //
 
 static bool				// O - `true` on match, `false` on non-match
-with_value(ipptool_test_t  *data,	// I - Test data
-           cups_array_t    *errors,	// I - Errors array
-           char            *value,	// I - Value string
-           int             flags,	// I - Flags for match
-           ipp_attribute_t *attr,	// I - Attribute to compare
-	   char            *matchbuf,	// I - Buffer to hold matching value
-	   size_t          matchlen)	// I - Length of match buffer
+with_value(ipptool_test_t   *data,	// I - Test data
+           cups_array_t     *errors,	// I - Errors array
+           ipptool_expect_t *expect,	// I - Expected attribute
+           ipp_attribute_t  *attr,	// I - Attribute to compare
+	   char             *matchbuf,	// I - Buffer to hold matching value
+	   size_t           matchlen)	// I - Length of match buffer
 {
-  size_t	i,			// Looping var
+  size_t	i, j,			// Looping vars
     		count;			// Number of values
   bool		match;			// Match?
   char		temp[1024],		// Temporary value string
+		*value = expect->with_value,
+					// Value string
 		*valptr;		// Pointer into value
+  int		flags = expect->with_flags;
+					// Flags for match
   const char	*name;			// Attribute name
+  ipptool_intval_t *intval;		// Current integer comparison
 
 
   *matchbuf = '\0';
@@ -7243,39 +8230,16 @@ with_value(ipptool_test_t  *data,	// I - Test data
     case IPP_TAG_ENUM :
         for (i = 0; i < count; i ++)
         {
-	  char	op,			// Comparison operator
-	  	*nextptr;		// Next pointer
-	  int	intvalue,		// Integer value
-		attrvalue = ippGetInteger(attr, i);
+	  int	attrvalue = ippGetInteger(attr, i);
 					// Attribute value
 	  bool	valmatch = false;	// Does the current value match?
 
-          valptr = value;
-
-	  while (isspace(*valptr & 255) || isdigit(*valptr & 255) ||
-		 *valptr == '-' || *valptr == ',' || *valptr == '!' || *valptr == '<' ||
-		 *valptr == '=' || *valptr == '>')
+	  for (j = expect->num_with_ints, intval = expect->with_ints; j > 0; j --, intval ++)
 	  {
-	    op = '=';
-	    while (*valptr && !isdigit(*valptr & 255) && *valptr != '-')
-	    {
-	      if (*valptr == '<' || *valptr == '>' || *valptr == '=' || *valptr == '!')
-		op = *valptr;
-	      valptr ++;
-	    }
-
-            if (!*valptr)
-	      break;
-
-	    intvalue = (int)strtol(valptr, &nextptr, 0);
-	    if (nextptr == valptr)
-	      break;
-	    valptr = nextptr;
-
-            if ((op == '=' && attrvalue == intvalue) ||
-                (op == '!' && attrvalue != intvalue) ||
-                (op == '<' && attrvalue < intvalue) ||
-                (op == '>' && attrvalue > intvalue))
+            if ((intval->op == '=' && attrvalue == intval->value) ||
+                (intval->op == '!' && attrvalue != intval->value) ||
+                (intval->op == '<' && attrvalue < intval->value) ||
+                (intval->op == '>' && attrvalue > intval->value))
 	    {
 	      if (!matchbuf[0])
 		snprintf(matchbuf, matchlen, "%d", attrvalue);
@@ -7310,40 +8274,18 @@ with_value(ipptool_test_t  *data,	// I - Test data
     case IPP_TAG_RANGE :
         for (i = 0; i < count; i ++)
         {
-	  char	op,			// Comparison operator
-	  	*nextptr;		// Next pointer
-	  int	intvalue,		// Integer value
-	        lower,			// Lower range
+	  int	lower,			// Lower range
 	        upper;			// Upper range
 	  bool	valmatch = false;	// Does the current value match?
 
 	  lower = ippGetRange(attr, i, &upper);
-          valptr = value;
 
-	  while (isspace(*valptr & 255) || isdigit(*valptr & 255) ||
-		 *valptr == '-' || *valptr == ',' || *valptr == '<' ||
-		 *valptr == '=' || *valptr == '>' || *valptr == '!')
+	  for (j = expect->num_with_ints, intval = expect->with_ints; j > 0; j --, intval ++)
 	  {
-	    op = '=';
-	    while (*valptr && !isdigit(*valptr & 255) && *valptr != '-')
-	    {
-	      if (*valptr == '<' || *valptr == '>' || *valptr == '=' || *valptr == '!')
-		op = *valptr;
-	      valptr ++;
-	    }
-
-            if (!*valptr)
-	      break;
-
-	    intvalue = (int)strtol(valptr, &nextptr, 0);
-	    if (nextptr == valptr)
-	      break;
-	    valptr = nextptr;
-
-            if ((op == '=' && lower <= intvalue && upper >= intvalue) ||
-		(op == '!' && (lower > intvalue || upper < intvalue)) ||
-		(op == '<' && upper < intvalue) ||
-		(op == '>' && upper > intvalue))
+            if ((intval->op == '=' && lower <= intval->value && upper >= intval->value) ||
+		(intval->op == '!' && (lower > intval->value || upper < intval->value)) ||
+		(intval->op == '<' && upper < intval->value) ||
+		(intval->op == '>' && upper > intval->value))
 	    {
 	      if (!matchbuf[0])
 		snprintf(matchbuf, matchlen, "%d-%d", lower, upper);
@@ -7383,7 +8325,7 @@ with_value(ipptool_test_t  *data,	// I - Test data
     case IPP_TAG_BOOLEAN :
 	for (i = 0; i < count; i ++)
 	{
-          if ((!strcmp(value, "true") || !strcmp(value, "1")) == ippGetBoolean(attr, i))
+          if (expect->with_boolean == ippGetBoolean(attr, i))
           {
             if (!matchbuf[0])
 	      cupsCopyString(matchbuf, value, matchlen);
@@ -7474,21 +8416,9 @@ with_value(ipptool_test_t  *data,	// I - Test data
         if (flags & IPPTOOL_WITH_REGEX)
 	{
 	  // Value is an extended, case-sensitive POSIX regular expression...
-          int		r;		// Error, if any
-	  regex_t	re;		// Regular expression
-
-          if ((r = regcomp(&re, value, REG_EXTENDED | REG_NOSUB)) != 0)
-	  {
-            regerror(r, &re, temp, sizeof(temp));
-
-	    print_fatal_error(data, "Unable to compile WITH-VALUE regular expression \"%s\" - %s", value, temp);
-	    return (false);
-	  }
-
-          // See if ALL of the values match the given regular expression.
 	  for (i = 0; i < count; i ++)
 	  {
-	    if (!regexec(&re, get_string(attr, i, flags, temp, sizeof(temp)),
+	    if (!regexec(expect->with_regex, get_string(attr, i, flags, temp, sizeof(temp)),
 	                 0, NULL, 0))
 	    {
 	      if (!matchbuf[0])
@@ -7506,8 +8436,6 @@ with_value(ipptool_test_t  *data,	// I - Test data
 	      break;
 	    }
 	  }
-
-	  regfree(&re);
 	}
 	else if (ippGetValueTag(attr) == IPP_TAG_URI && !(flags & (IPPTOOL_WITH_SCHEME | IPPTOOL_WITH_HOSTNAME | IPPTOOL_WITH_RESOURCE)))
 	{
@@ -7599,16 +8527,6 @@ with_value(ipptool_test_t  *data,	// I - Test data
 	  // Value is an extended, case-sensitive POSIX regular expression...
 	  void		*adata;		// Pointer to octetString data
 	  size_t	adatalen;	// Length of octetString
-	  int		r;		// Error, if any
-	  regex_t	re;		// Regular expression
-
-          if ((r = regcomp(&re, value, REG_EXTENDED | REG_NOSUB)) != 0)
-	  {
-            regerror(r, &re, temp, sizeof(temp));
-
-	    print_fatal_error(data, "Unable to compile WITH-VALUE regular expression \"%s\" - %s", value, temp);
-	    return (false);
-	  }
 
           // See if ALL of the values match the given regular expression.
 	  for (i = 0; i < count; i ++)
@@ -7621,7 +8539,7 @@ with_value(ipptool_test_t  *data,	// I - Test data
             memcpy(temp, adata, (size_t)adatalen);
             temp[adatalen] = '\0';
 
-	    if (!regexec(&re, temp, 0, NULL, 0))
+	    if (!regexec(expect->with_regex, temp, 0, NULL, 0))
 	    {
 	      if (!matchbuf[0])
 		cupsCopyString(matchbuf, temp, matchlen);
@@ -7639,8 +8557,6 @@ with_value(ipptool_test_t  *data,	// I - Test data
 	    }
 	  }
 
-	  regfree(&re);
-
 	  if (!match && errors)
 	  {
 	    for (i = 0; i < count; i ++)
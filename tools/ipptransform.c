@@ -24,6 +24,9 @@ extern void CGContextSetCTM(CGContextRef c, CGAffineTransform m);
 #endif // HAVE_COREGRAPHICS_H
 
 #include "dither.h"
+#include "xform-pack.h"
+#include "xform-png.h"
+#include <zlib.h>
 
 #if _WIN32
 #  include <fcntl.h>
@@ -34,6 +37,8 @@ extern void CGContextSetCTM(CGContextRef c, CGAffineTransform m);
 extern char **environ;
 #  include <spawn.h>
 #  include <sys/fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
 #  include <sys/wait.h>
 #endif // _WIN32
 
@@ -43,6 +48,11 @@ extern char **environ;
 
 
 // Constants...
+#define XFORM_MAX_BAND		1048576
+#define XFORM_MAX_CACHE		67108864
+#define XFORM_MAX_CHUNK		4
+#define XFORM_MAX_IMAGE		67108864
+#define XFORM_MAX_JOBS		32
 #define XFORM_MAX_LAYOUT	16
 #define XFORM_MAX_PAGES		10000
 #define XFORM_MAX_RASTER	16777216
@@ -51,13 +61,6 @@ extern char **environ;
 #define XFORM_TEXT_HEIGHT	12.0	// Point height of plain text output
 #define XFORM_TEXT_WIDTH	0.6	// Width of monospaced characters
 
-#define XFORM_RED_MASK		0x000000ff
-#define XFORM_GREEN_MASK	0x0000ff00
-#define XFORM_BLUE_MASK		0x00ff0000
-#define XFORM_RGB_MASK		(XFORM_RED_MASK | XFORM_GREEN_MASK |  XFORM_BLUE_MASK)
-#define XFORM_BG_MASK		(XFORM_BLUE_MASK | XFORM_GREEN_MASK)
-#define XFORM_RG_MASK		(XFORM_RED_MASK | XFORM_GREEN_MASK)
-
 
 // Local types...
 typedef ssize_t (*xform_write_cb_t)(void *, const void *, size_t);
@@ -109,6 +112,111 @@ typedef struct xform_prepare_s		// Preparation data
   pdfio_matrix_t duplex_xform;		// Back side transform matrix
 } xform_prepare_t;
 
+typedef struct xform_cpage_s		// Cached output page
+{
+  size_t	offset,			// Offset of page data in cache
+		length;			// Length of page data
+  size_t	num_strip_objs;		// Number of PCLm strip objects
+  pdfio_obj_t	**strip_objs;		// PCLm strip objects
+} xform_cpage_t;
+
+typedef struct xform_cache_s		// Rendered page cache for collated copies
+{
+  xform_write_cb_t cb;			// Output write callback
+  void		*ctx;			// Output write context
+  bool		capture,		// Capture output data?
+		error,			// Did an error occur?
+		skip_header;		// Skip the Apple raster file header on the first page?
+  size_t	num_pages,		// Number of cached pages
+		alloc_pages;		// Allocated pages
+  xform_cpage_t	*pages;			// Cached pages
+  size_t	length,			// Length of cached data
+		max_memory;		// Maximum memory to use for cached data
+  unsigned char	*buffer;		// In-memory cached data
+  size_t	bufsize;		// Size of in-memory buffer
+  int		fd;			// Spill file descriptor, if any
+  char		tempfile[1024];		// Spill filename
+} xform_cache_t;
+
+typedef struct xform_pdftoppm_s		// pdftoppm rendering state
+{
+  const char	*filename;		// PDF filename
+  char		options[256];		// pdftoppm options
+  unsigned	num_pages,		// Number of pages
+		chunk_pages,		// Number of pages per process
+		num_chunks,		// Number of chunks
+		current,		// Current chunk
+		next;			// Next chunk to start
+  int		num_jobs;		// Maximum number of concurrent processes
+  bool		use_map;		// Map output files into memory?
+  FILE		*fp;			// Output for current chunk
+  unsigned char	*map;			// Mapped output for current chunk
+  size_t	mapsize,		// Size of mapped output
+		mapoff;			// Current offset in mapped output
+  unsigned	lines;			// Lines left in current page
+  size_t	linesize;		// Bytes per line in current page
+  struct
+  {
+    FILE	*pipe;			// Pipe from pdftoppm
+    char	tempfile[1024];		// Output file, if any
+  }		jobs[XFORM_MAX_JOBS];	// Rendering processes
+} xform_pdftoppm_t;
+
+typedef struct xform_image_s		// Image source for direct printing
+{
+  xform_png_t	*png;			// PNG image
+  unsigned	width,			// Width after rotation
+		height,			// Height after rotation
+		colors,			// Colors per pixel (1 or 3)
+		next;			// Next PNG row to read
+  unsigned char	*pixels;		// Rotated image pixels, if any
+  unsigned char	*rows[2];		// Streamed rows
+  unsigned	rownum[2];		// Streamed row numbers plus 1
+} xform_image_t;
+
+typedef struct xform_itab_s		// Image scaling table entry
+{
+  unsigned	start,			// First source pixel
+		count,			// Number of source pixels
+		weight;			// Weight of second pixel (0-256) when enlarging
+} xform_itab_t;
+
+typedef enum xform_sstate_e		// PCLm strip state
+{
+  XFORM_SSTATE_FREE,			// Strip buffer is available
+  XFORM_SSTATE_QUEUED,			// Strip is waiting to be compressed
+  XFORM_SSTATE_ACTIVE,			// Strip is being compressed
+  XFORM_SSTATE_DONE			// Strip is ready to be written
+} xform_sstate_t;
+
+typedef struct xform_strip_s		// PCLm strip
+{
+  xform_sstate_t state;			// Current state
+  pdfio_obj_t	*obj;			// Strip image object
+  unsigned char	*data;			// Uncompressed strip data
+  size_t	datalen,		// Length of uncompressed data
+		datasize;		// Size of uncompressed data buffer
+  unsigned char	*comp;			// Compressed strip data
+  size_t	complen,		// Length of compressed data
+		compsize;		// Size of compressed data buffer
+} xform_strip_t;
+
+typedef struct xform_deflate_s		// PCLm strip compression pool
+{
+  cups_mutex_t	mutex;			// Mutex for pool
+  cups_cond_t	cond;			// Condition for state changes
+  int		level;			// zlib compression level
+  bool		shutdown;		// Stop the compression threads?
+  size_t	num_threads;		// Number of compression threads
+  cups_thread_t	threads[XFORM_MAX_JOBS];// Compression threads
+  size_t	num_strips,		// Number of strip buffers
+		num_pending,		// Number of strips not yet written
+		head,			// Next strip buffer to fill
+		tail;			// Next strip buffer to write
+  xform_strip_t	strips[2 * XFORM_MAX_JOBS];
+					// Strip buffers
+} xform_deflate_t;
+
 typedef struct xform_raster_s xform_raster_t;
 					// Raster context
 
@@ -137,6 +245,11 @@ struct xform_raster_s			// Raster context
   unsigned		out_blanks;	// Blank lines
   unsigned		out_length;	// Byte width of image box
   unsigned char		*comp_buffer;	// Compression buffer
+  unsigned char		*comp_delta;	// Delta row compression buffer
+  unsigned char		*comp_seed;	// Seed (previous) row
+  unsigned		comp_mode;	// Current compression mode
+  size_t		comp_bytes,	// Compressed bytes for page
+			comp_packbits;	// Compressed bytes for page using only PackBits
 
   unsigned char		dither[64][64];	// Dither array
   unsigned char		white;		// White pixel value
@@ -147,16 +260,52 @@ struct xform_raster_s			// Raster context
 					// Strip objects
   unsigned		pclm_strip_height;
 					// Height of each strip
-  pdfio_stream_t	*pclm_strip_st;	// Current strip stream
+  xform_deflate_t	*pclm_deflate;	// Strip compression pool
+  xform_strip_t		*pclm_strip;	// Current strip buffer
+  bool			pclm_strip_blank;
+					// Is the current strip blank so far?
+  pdfio_obj_t		*pclm_blank_obj;// Shared blank strip object
+  unsigned		pclm_blank_height;
+					// Height of shared blank strip
+
+  // Blank page skipping
+  bool			blank_skip;	// Skip blank pages?
+  bool			blank_page;	// Is the current page blank so far?
+  unsigned		blank_pages;	// Number of blank pages skipped
+  xform_write_cb_t	blank_cb;	// Output write callback
+  void			*blank_ctx;	// Output write context
+  unsigned char		*blank_buffer;	// Output held for the current page
+  size_t		blank_length,	// Length of held output
+			blank_size;	// Size of held output buffer
 
   // Callbacks
   void			(*end_job)(xform_raster_t *, xform_write_cb_t, void *);
-  void			(*end_page)(xform_raster_t *, unsigned, xform_write_cb_t, void *);
+  bool			(*end_page)(xform_raster_t *, unsigned, xform_write_cb_t, void *);
   bool			(*start_job)(xform_raster_t *, xform_write_cb_t, void *);
   bool			(*start_page)(xform_raster_t *, unsigned, xform_write_cb_t, void *);
-  void			(*write_line)(xform_raster_t *, unsigned, const unsigned char *, xform_write_cb_t, void *);
+  bool			(*write_line)(xform_raster_t *, unsigned, const unsigned char *, xform_write_cb_t, void *);
+
+  // Output format callbacks when skipping blank pages
+  void			(*fmt_end_job)(xform_raster_t *, xform_write_cb_t, void *);
+  bool			(*fmt_end_page)(xform_raster_t *, unsigned, xform_write_cb_t, void *);
+  bool			(*fmt_start_job)(xform_raster_t *, xform_write_cb_t, void *);
+  bool			(*fmt_start_page)(xform_raster_t *, unsigned, xform_write_cb_t, void *);
+  bool			(*fmt_write_line)(xform_raster_t *, unsigned, const unsigned char *, xform_write_cb_t, void *);
 };
 
+typedef struct xform_renderer_s		// Rasterizer backend
+{
+  const char		*name;		// Name of backend
+  void			*(*open)(const char *, xform_raster_t *, unsigned);
+					// Open a PDF file for rendering
+  bool			(*start_page)(void *, unsigned *, unsigned *, unsigned *);
+					// Start the next page (width, height, bytes per pixel)
+  unsigned char		*(*read_band)(void *, unsigned char *, unsigned);
+					// Read a band of lines
+  void			(*close)(void *);
+					// Close the PDF file
+} xform_renderer_t;
+
 
 // Local globals...
 static char		PdftopsCommand[1024] = "";
@@ -164,7 +313,16 @@ static char		PdftopsCommand[1024] = "";
 #ifndef HAVE_COREGRAPHICS_H
 static char		PdftoppmCommand[1024] = "";
 					// "pdftoppm" command path, if any
+static int		PdftoppmPoppler = -1;
+					// Poppler (1) or Xpdf (0) pdftoppm, -1 if not yet known
 #endif // !_HAVE_COREGRAPHICS_H
+static int		DeflateLevel = Z_BEST_SPEED;
+					// Compression level for PCLm strips
+static int		DeflateThreads = 0;
+					// Number of PCLm compression threads (0 = one per CPU)
+static int		NumJobs = 1;	// Number of concurrent rendering processes
+static bool		SkipBlankPages = false;
+					// Omit blank pages from the output?
 static const char	*Prefix;	// Error message prefix (typically the command name or "ERROR" if running from ippeveprinter/ippserver
 static int		Verbosity = 0;	// Log level
 
@@ -174,62 +332,119 @@ static bool	convert_image(xform_prepare_t *p, xform_document_t *d, int document)
 static bool	convert_raster(xform_prepare_t *p, xform_document_t *d, int document);
 static bool	convert_text(xform_prepare_t *p, xform_document_t *d, int document);
 static void	copy_page(xform_prepare_t *p, xform_page_t *outpage, size_t layout);
-static void	dither_gray(xform_raster_t *ras, unsigned y, unsigned char *row, size_t num_pixels);
 static bool	generate_job_error_sheet(xform_prepare_t *p);
 static bool	generate_job_sheets(xform_prepare_t *p);
 static void	media_to_rect(cups_media_t *size, pdfio_rect_t *media, pdfio_rect_t *crop);
 static void	*monitor_ipp(const char *device_uri);
-static void	pack_black(unsigned char *row, size_t num_pixels);
 #ifdef HAVE_COREGRAPHICS_H
-static void	pack_rgba(unsigned char *row, size_t num_pixels);
 static void	pack_rgba16(unsigned char *row, size_t num_pixels);
 #endif // HAVE_COREGRAPHICS_H
 static bool	page_dict_cb(pdfio_dict_t *dict, const char *key, xform_page_t *outpage);
+static size_t	pcl_compress_delta(const unsigned char *line, const unsigned char *seed, size_t length, unsigned char *buffer);
+static size_t	pcl_compress_packbits(const unsigned char *line, size_t length, unsigned char *buffer);
 static void	pcl_end_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
-static void	pcl_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
+static bool	pcl_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
 static void	pcl_init(xform_raster_t *ras);
 static bool	pcl_start_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
 static bool	pcl_start_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
-static void	pcl_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
+static bool	pcl_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
+static bool	pclm_add_page(xform_raster_t *ras, size_t num_strip_objs, pdfio_obj_t **strip_objs);
+static pdfio_obj_t *pclm_blank_strip(xform_raster_t *ras, unsigned height);
+static void	pclm_compress_strip(xform_strip_t *strip, int level);
+static void	*pclm_compress_thread(xform_deflate_t *pool);
+static pdfio_obj_t *pclm_create_strip(xform_raster_t *ras, unsigned height);
 static void	pclm_end_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
-static void	pclm_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
+static bool	pclm_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
 static bool	pclm_error_cb(pdfio_file_t *pdf, const char *message, void *data);
+static unsigned	pclm_get_height(xform_raster_t *ras, size_t strip);
+static xform_strip_t *pclm_get_strip(xform_raster_t *ras, unsigned height);
 static void	pclm_init(xform_raster_t *ras);
+static bool	pclm_put_strip(xform_raster_t *ras, xform_strip_t *strip);
 static bool	pclm_start_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
 static bool	pclm_start_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
-static void	pclm_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
+static bool	pclm_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
+static bool	pclm_write_strips(xform_raster_t *ras, size_t max_pending);
 static bool	pclps_printf(xform_write_cb_t cb, void *ctx, const char *format, ...) _CUPS_FORMAT(3, 4);
 static int	ps_convert_pdf(const char *filename, xform_write_cb_t cb, void *ctx);
 static void	ps_end_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
-static void	ps_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
+static bool	ps_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
 static void	ps_init(xform_raster_t *ras);
 static bool	ps_start_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
 static bool	ps_start_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
-static void	ps_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
+static bool	ps_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
 static void	pdfio_end_page(xform_prepare_t *p, pdfio_stream_t *st);
 static bool	pdfio_error_cb(pdfio_file_t *pdf, const char *message, void *cb_data);
 static const char *pdfio_password_cb(void *cb_data, const char *filename);
 static pdfio_stream_t *pdfio_start_page(xform_prepare_t *p, pdfio_dict_t *dict);
+#ifndef HAVE_COREGRAPHICS_H
+static void	pdftoppm_close(void *data);
+#  if !_WIN32
+static bool	pdftoppm_map(xform_pdftoppm_t *pp, int job);
+#  endif // !_WIN32
+static bool	pdftoppm_next(xform_pdftoppm_t *pp);
+static xform_pdftoppm_t *pdftoppm_open(const char *filename, xform_raster_t *ras, unsigned pages, int num_jobs, bool use_map);
+#  if !_WIN32
+static void	*pdftoppm_open_map(const char *filename, xform_raster_t *ras, unsigned pages);
+#  endif // !_WIN32
+static void	*pdftoppm_open_pipe(const char *filename, xform_raster_t *ras, unsigned pages);
+static unsigned char *pdftoppm_read_band(void *data, unsigned char *buffer, unsigned lines);
+static bool	pdftoppm_start(xform_pdftoppm_t *pp);
+static bool	pdftoppm_start_page(void *data, unsigned *width, unsigned *height, unsigned *bpp);
+#endif // !HAVE_COREGRAPHICS_H
 static bool	prepare_documents(size_t num_documents, xform_document_t *documents, ipp_options_t *options, const char *sheet_back, char *outfile, size_t outsize, const char *outformat, unsigned *outpages, bool generate_copies);
+static int	prepare_image(ipp_options_t *options, pdfio_rect_t *crop, double iw, double ih, pdfio_rect_t *rect);
 static void	prepare_log(xform_prepare_t *p, bool error, const char *message, ...);
 static void	prepare_number_up(xform_prepare_t *p);
 static void	prepare_pages(xform_prepare_t *p, size_t num_documents, xform_document_t *documents);
 static void	raster_end_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
-static void	raster_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
+static bool	raster_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
 static void	raster_init(xform_raster_t *ras);
 static bool	raster_start_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
 static bool	raster_start_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
-static void	raster_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
+static bool	raster_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
 static bool	resource_dict_cb(pdfio_dict_t *dict, const char *key, xform_page_t *outpage);
 static bool	show_aligned(pdfio_stream_t *st, pdfio_obj_t *font, double fsize, bool unicode, double x, double y, int align, const char *s);
 static bool	show_label_and_value(pdfio_stream_t *st, pdfio_obj_t *font, double fsize, bool unicode, double x, double y, cups_lang_t *lang, bool rtl, const char *label, const char *value);
 static int	usage(FILE *out);
 static ssize_t	write_fd(int *fd, const unsigned char *buffer, size_t bytes);
+static void	xform_blank_end_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
+static bool	xform_blank_end_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
+static void	xform_blank_init(xform_raster_t *ras);
+static bool	xform_blank_start_job(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
+static bool	xform_blank_start_page(xform_raster_t *ras, unsigned page, xform_write_cb_t cb, void *ctx);
+static ssize_t	xform_blank_write(xform_raster_t *ras, const unsigned char *buffer, size_t bytes);
+static bool	xform_blank_write_line(xform_raster_t *ras, unsigned y, const unsigned char *line, xform_write_cb_t cb, void *ctx);
+#ifndef HAVE_COREGRAPHICS_H
+static void	xform_cache_end_page(xform_cache_t *cache, xform_raster_t *ras);
+static void	xform_cache_free(xform_cache_t *cache);
+static bool	xform_cache_replay(xform_cache_t *cache, xform_raster_t *ras, size_t page);
+static bool	xform_cache_start_page(xform_cache_t *cache);
+static ssize_t	xform_cache_write(xform_cache_t *cache, const unsigned char *buffer, size_t bytes);
+#endif // !HAVE_COREGRAPHICS_H
 static bool	xform_document(const char *filename, unsigned pages, ipp_options_t *options, const char *outformat, const char *resolutions, const char *sheet_back, const char *types, xform_write_cb_t cb, void *ctx);
+#ifndef HAVE_COREGRAPHICS_H
+static bool	xform_image(const char *filename, ipp_options_t *options, const char *outformat, const char *resolutions, const char *sheet_back, const char *types, xform_write_cb_t cb, void *ctx);
+static bool	xform_image_check(const char *filename, ipp_options_t *options);
+static bool	xform_image_page(xform_raster_t *ras, const char *filename, ipp_options_t *options, unsigned page, xform_write_cb_t cb, void *ctx);
+static const unsigned char *xform_image_row(xform_image_t *img, unsigned row);
+static void	xform_image_table(xform_itab_t *table, unsigned count, double start, double scale, unsigned size);
+#endif // !HAVE_COREGRAPHICS_H
 static bool	xform_separator(xform_raster_t *ras, xform_write_cb_t cb, void *ctx);
 static bool	xform_setup(xform_raster_t *ras, ipp_options_t *options, const char *outformat, const char *resolutions, const char *types, const char *sheet_back, bool color, unsigned pages);
 
 
+#ifndef HAVE_COREGRAPHICS_H
+// Rasterizer backends, the first is the default...
+static const xform_renderer_t Renderers[] =
+{
+  { "pipe", pdftoppm_open_pipe, pdftoppm_start_page, pdftoppm_read_band, pdftoppm_close },
+#  if !_WIN32
+  { "mmap", pdftoppm_open_map, pdftoppm_start_page, pdftoppm_read_band, pdftoppm_close },
+#  endif // !_WIN32
+};
+#endif // !HAVE_COREGRAPHICS_H
+
+
 //
 // 'main()' - Main entry for transform utility.
 //
@@ -252,6 +467,9 @@ main(int  argc,				// I - Number of command-line args
   cups_option_t	*options = NULL;	// Options
   ipp_options_t	*ipp_options;		// IPP options
   char		pdf_file[1024];		// Temporary PDF filename
+#ifndef HAVE_COREGRAPHICS_H
+  bool		direct_image = false;	// Print a single image directly?
+#endif // !HAVE_COREGRAPHICS_H
   unsigned	pdf_pages;		// Number of pages in PDF file
   int		fd = 1;			// Output file/socket
   http_t	*http = NULL;		// Output HTTP connection
@@ -280,6 +498,15 @@ main(int  argc,				// I - Number of command-line args
   if (!sheet_back)
     sheet_back = getenv("IPP_PCLM_RASTER_BACK_SIDE");
 
+  if ((opt = getenv("IPPTRANSFORM_DEFLATE_LEVEL")) != NULL)
+    DeflateLevel = atoi(opt);
+  if ((opt = getenv("IPPTRANSFORM_DEFLATE_THREADS")) != NULL)
+    DeflateThreads = atoi(opt);
+  if ((opt = getenv("IPPTRANSFORM_JOBS")) != NULL)
+    NumJobs = atoi(opt);
+  if ((opt = getenv("IPPTRANSFORM_SKIP_BLANK_PAGES")) != NULL)
+    SkipBlankPages = atoi(opt) > 0 || !strcasecmp(opt, "true") || !strcasecmp(opt, "yes");
+
   if ((opt = getenv("SERVER_LOGLEVEL")) != NULL)
   {
     // Use "ERROR" as the prefix for error messages since they will be logged...
@@ -393,6 +620,17 @@ main(int  argc,				// I - Number of command-line args
 	      }
 	      break;
 
+	  case 'j' : // Number of rendering processes
+	      i ++;
+	      if (i >= argc || !isdigit(argv[i][0] & 255))
+	      {
+	        cupsLangPrintf(stderr, _("%s: Missing number of jobs after '-j'."), Prefix);
+	        return (usage(stderr));
+	      }
+
+	      NumJobs = atoi(argv[i]);
+	      break;
+
 	  case 'm' :
 	      i ++;
 	      if (i >= argc)
@@ -516,6 +754,38 @@ main(int  argc,				// I - Number of command-line args
   if (num_files == 0)
     return (usage(stderr));
 
+  if (NumJobs <= 0 || DeflateThreads <= 0)
+  {
+    // Use one rendering process or compression thread per CPU...
+    int	num_cpus;			// Number of CPUs
+#if _WIN32
+    SYSTEM_INFO	sysinfo;		// System information
+
+    GetSystemInfo(&sysinfo);
+    num_cpus = (int)sysinfo.dwNumberOfProcessors;
+#else
+    num_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif // _WIN32
+
+    if (NumJobs <= 0)
+      NumJobs = num_cpus;
+    if (DeflateThreads <= 0)
+      DeflateThreads = num_cpus;
+  }
+
+  if (NumJobs < 1)
+    NumJobs = 1;
+  else if (NumJobs > XFORM_MAX_JOBS)
+    NumJobs = XFORM_MAX_JOBS;
+
+  if (DeflateThreads < 1)
+    DeflateThreads = 1;
+  else if (DeflateThreads > XFORM_MAX_JOBS)
+    DeflateThreads = XFORM_MAX_JOBS;
+
+  if (DeflateLevel < Z_NO_COMPRESSION || DeflateLevel > Z_BEST_COMPRESSION)
+    DeflateLevel = Z_BEST_SPEED;
+
   if (!output_type)
   {
     // See if we can default the output type from the (legacy) program name...
@@ -548,6 +818,15 @@ main(int  argc,				// I - Number of command-line args
   // Prepare a (combined) PDF file from the input files for printing...
   ipp_options = ippOptionsNew(num_options, options);
 
+#ifndef HAVE_COREGRAPHICS_H
+  if (num_files == 1 && !strcmp(files[0].format, "image/png") && strcasecmp(output_type, "application/pdf") && strcasecmp(output_type, "application/postscript") && xform_image_check(files[0].filename, ipp_options))
+  {
+    // Print a single PNG image directly without converting to PDF, except for
+    // PostScript which is converted from the PDF file with pdftops...
+    direct_image = true;
+  }
+  else
+#endif // !HAVE_COREGRAPHICS_H
   if (!prepare_documents(num_files, files, ipp_options, sheet_back, pdf_file, sizeof(pdf_file), output_type, &pdf_pages, !strcasecmp(output_type, "application/pdf")))
   {
     // Unable to prepare documents, exit...
@@ -756,6 +1035,14 @@ main(int  argc,				// I - Number of command-line args
         types = "sgray_8";
     }
 
+#ifndef HAVE_COREGRAPHICS_H
+    if (direct_image)
+    {
+      if (!xform_image(files[0].filename, ipp_options, output_type, resolutions, sheet_back, types, write_cb, write_ptr))
+        status = 1;
+    }
+    else
+#endif // !HAVE_COREGRAPHICS_H
     if (!xform_document(pdf_file, pdf_pages, ipp_options, output_type, resolutions, sheet_back, types, write_cb, write_ptr))
       status = 1;
   }
@@ -832,11 +1119,9 @@ convert_image(
   char		iname[32];		// Image object name
   pdfio_stream_t *st;			// Page stream
   double	x, y, w, h;		// Image rectangle
-  double	cx, cy, cw, ch;		// Crop box rectangle
+  pdfio_rect_t	rect;			// Image rectangle
   double	iw, ih;			// Original image width/height
   int		irot;			// Image rotation
-  double	ratio;			// Scaling factor for image
-  ippopt_scaling_t scaling;		// Actual print-scaling to use
 
 
   // Create a temporary PDF file...
@@ -856,170 +1141,11 @@ convert_image(
   iw = pdfioImageGetWidth(image);
   ih = pdfioImageGetHeight(image);
 
-  cx = p->crop.x1;
-  cy = p->crop.y1;
-  cw = p->crop.x2 - cx;
-  ch = p->crop.y2 - cy;
-
-  switch (p->options->image_orientation)
-  {
-    case IPP_ORIENT_PORTRAIT :
-        irot = 0;
-        break;
-    case IPP_ORIENT_LANDSCAPE :
-        irot = 1;
-        break;
-    case IPP_ORIENT_REVERSE_PORTRAIT :
-        irot = 2;
-        break;
-    case IPP_ORIENT_REVERSE_LANDSCAPE :
-        irot = 3;
-        break;
-    case IPP_ORIENT_NONE : // Auto
-        if ((iw > ih && cw < ch) || (iw < ih && cw > ch))
-          irot = 3;
-	else
-	  irot = 0;
-	break;
-  }
-
-  if (p->options->print_scaling == IPPOPT_SCALING_AUTO)
-  {
-    if (irot & 1)
-    {
-      if (iw > ch || ih > cw)
-      {
-        if (cx == 0.0 && cy == 0.0)
-          scaling = IPPOPT_SCALING_FIT;
-	else
-	  scaling = IPPOPT_SCALING_FILL;
-      }
-      else
-      {
-        scaling = IPPOPT_SCALING_NONE;
-      }
-    }
-    else
-    {
-      if (iw > cw || ih > ch)
-      {
-        if (cx == 0.0 && cy == 0.0)
-          scaling = IPPOPT_SCALING_FIT;
-	else
-	  scaling = IPPOPT_SCALING_FILL;
-      }
-      else
-      {
-        scaling = IPPOPT_SCALING_NONE;
-      }
-    }
-  }
-  else if (p->options->print_scaling == IPPOPT_SCALING_AUTO_FIT)
-  {
-    if (irot & 1)
-    {
-      if (iw > ch || ih > cw)
-	scaling = IPPOPT_SCALING_FIT;
-      else
-        scaling = IPPOPT_SCALING_NONE;
-    }
-    else
-    {
-      if (iw > cw || ih > ch)
-	scaling = IPPOPT_SCALING_FIT;
-      else
-        scaling = IPPOPT_SCALING_NONE;
-    }
-  }
-  else
-  {
-    scaling = p->options->print_scaling;
-  }
-
-  if (scaling == IPPOPT_SCALING_NONE)
-  {
-    // No scaling...
-    ratio = 1.0;
-  }
-  else
-  {
-    if (irot & 1)
-      ratio = ch / iw;
-    else
-      ratio = cw / iw;
-
-    if (scaling == IPPOPT_SCALING_FIT)
-    {
-      // Scale to fit...
-      if (irot & 1)
-      {
-        if ((ih * ratio) > cw)
-          ratio = cw / ih;
-      }
-      else
-      {
-        if ((ih * ratio) > ch)
-          ratio = ch / ih;
-      }
-    }
-    else
-    {
-      // Scale to fill...
-      if (irot & 1)
-      {
-        if ((ih * ratio) < cw)
-          ratio = cw / ih;
-      }
-      else
-      {
-        if ((ih * ratio) < ch)
-          ratio = ch / ih;
-      }
-    }
-  }
-
-  if (irot & 1)
-  {
-    w = ih * ratio;
-    h = iw * ratio;
-  }
-  else
-  {
-    w = iw * ratio;
-    h = ih * ratio;
-  }
-
-  switch (p->options->x_image_position)
-  {
-    case IPPOPT_IMGPOS_NONE :
-        x = cx;
-        break;
-    case IPPOPT_IMGPOS_CENTER :
-        x = cx + (cw - w - 72.0 * p->options->x_side1_image_shift / 2540.0) / 2.0;
-        break;
-    case IPPOPT_IMGPOS_BOTTOM_LEFT :
-        x = cx + 72.0 * p->options->x_side1_image_shift / 2540.0;
-        break;
-    case IPPOPT_IMGPOS_TOP_RIGHT :
-        x = cx + cw - w - 72.0 * p->options->x_side1_image_shift / 2540.0;
-        break;
-  }
-
-  switch (p->options->y_image_position)
-  {
-    case IPPOPT_IMGPOS_NONE :
-        y = cy;
-        break;
-    case IPPOPT_IMGPOS_CENTER :
-        y = cy + (ch - h - 72.0 * p->options->y_side1_image_shift / 2540.0) / 2.0;
-        break;
-    case IPPOPT_IMGPOS_BOTTOM_LEFT :
-        y = cy + 72.0 * p->options->y_side1_image_shift / 2540.0;
-        break;
-    case IPPOPT_IMGPOS_TOP_RIGHT :
-        y = cy + ch - h - 72.0 * p->options->y_side1_image_shift / 2540.0;
-        break;
-  }
+  irot = prepare_image(p->options, &p->crop, iw, ih, &rect);
+  x    = rect.x1;
+  y    = rect.y1;
+  w    = rect.x2 - rect.x1;
+  h    = rect.y2 - rect.y1;
 
   // Create a page dictionary for the image...
   if ((dict = pdfioDictCreate(pdf)) == NULL)
@@ -1041,7 +1167,7 @@ convert_image(
   // Draw the image, cropped...
   pdfioContentSave(st);
 
-  pdfioContentPathRect(st, cx, cy, cw, ch);
+  pdfioContentPathRect(st, p->crop.x1, p->crop.y1, p->crop.x2 - p->crop.x1, p->crop.y2 - p->crop.y1);
   pdfioContentClip(st, false);
   pdfioContentPathEnd(st);
 
@@ -1054,7 +1180,7 @@ convert_image(
         pdfioStreamPrintf(st, "q 0 %g %g 0 %g %g cm /%s Do Q\n", -h, w, x, y + h, iname);
         break;
     case 2 :
-        pdfioStreamPrintf(st, "q 0 %g %g 0 %g %g cm /%s Do Q\n", -w, -h, x + w, y + h, iname);
+        pdfioStreamPrintf(st, "q %g 0 0 %g %g %g cm /%s Do Q\n", -w, -h, x + w, y + h, iname);
         break;
     case 3 :
         pdfioStreamPrintf(st, "q 0 %g %g 0 %g %g cm /%s Do Q\n", h, -w, x + w, y, iname);
@@ -1648,47 +1774,6 @@ copy_page(xform_prepare_t *p,		// I - Preparation data
 }
 
 
-//
-// 'dither_gray()' - Dither grayscale pixels.
-//
-
-static void
-dither_gray(xform_raster_t *ras,	// I - Raster info
-            unsigned       y,		// I - Row number
-            unsigned char  *row,	// I - Row pointer
-            size_t         num_pixels)	// I - Number of pixels
-{
-  unsigned	x;			// Column number
-  unsigned char	bit,			// Current bit
-		byte,			// Current byte
-		*rowptr;		// Pointer into row buffer
-  const unsigned char *ditherline;	// Pointer into dither table
-
-
-  ditherline = ras->dither[y & 63];
-
-  for (x = 0, bit = 128, byte = ras->white, rowptr = row; x < num_pixels; x ++, row ++)
-  {
-    if (*row <= ditherline[x & 63])
-      byte ^= bit;
-
-    if (bit == 1)
-    {
-      *rowptr++ = byte;
-      byte      = ras->white;
-      bit       = 128;
-    }
-    else
-    {
-      bit >>= 1;
-    }
-  }
-
-  if (bit != 128)
-    *rowptr++ = byte;
-}
-
-
 //
 // 'generate_job_error_sheet()' - Generate a job error sheet.
 //
@@ -2033,77 +2118,7 @@ monitor_ipp(const char *device_uri)	// I - Device URI
 }
 
 
-//
-// 'pack_black()' - Pack grayscale lines into black lines.
-//
-
-static void
-pack_black(unsigned char *row,		// I - Row of pixels to pack
-           size_t        num_pixels)	// I - Number of pixels in row
-{
-  while (num_pixels > 0)
-  {
-    *row = 255 - *row;
-    row ++;
-    num_pixels --;
-  }
-}
-
-
 #ifdef HAVE_COREGRAPHICS_H
-//
-// 'pack_rgba()' - Pack RGBX scanlines into RGB scanlines.
-//
-// This routine is suitable only for 8 bit RGBX data packed into RGB bytes.
-//
-
-static void
-pack_rgba(unsigned char *row,		// I - Row of pixels to pack
-	  size_t        num_pixels)	// I - Number of pixels in row
-{
-  size_t	num_quads = num_pixels / 4;
-					// Number of 4 byte samples to pack
-  size_t	leftover_pixels = num_pixels & 3;
-					// Number of pixels remaining
-  unsigned	*quad_row = (unsigned *)row;
-					// 32-bit pixel pointer
-  unsigned	*dest = quad_row;	// Destination pointer
-  unsigned char *src_byte;		// Remaining source bytes
-  unsigned char *dest_byte;		// Remaining destination bytes
-
-
- /*
-  * Copy all of the groups of 4 pixels we can...
-  */
-
-  while (num_quads > 0)
-  {
-    *dest++ = (quad_row[0] & XFORM_RGB_MASK) | (quad_row[1] << 24);
-    *dest++ = ((quad_row[1] & XFORM_BG_MASK) >> 8) |
-              ((quad_row[2] & XFORM_RG_MASK) << 16);
-    *dest++ = ((quad_row[2] & XFORM_BLUE_MASK) >> 16) | (quad_row[3] << 8);
-    quad_row += 4;
-    num_quads --;
-  }
-
- /*
-  * Then handle the leftover pixels...
-  */
-
-  src_byte  = (unsigned char *)quad_row;
-  dest_byte = (unsigned char *)dest;
-
-  while (leftover_pixels > 0)
-  {
-    *dest_byte++ = *src_byte++;
-    *dest_byte++ = *src_byte++;
-    *dest_byte++ = *src_byte++;
-    src_byte ++;
-    leftover_pixels --;
-  }
-}
-
-
 //
 // 'pack_rgba16()' - Pack 16 bit per component RGBX scanlines into RGB scanlines.
 //
@@ -2231,7 +2246,136 @@ page_dict_cb(pdfio_dict_t *dict,	// I - Dictionary
 
 
 //
-// 'pcl_end_job()' - End a PCL "job".
+// 'pcl_compress_delta()' - Compress a line using delta row (mode 3) compression.
+//
+// Each command byte contains the number of replacement bytes (1 to 8) in the
+// upper 3 bits and the offset from the previous replacement in the lower 5
+// bits, followed by extra offset bytes when the offset is 31 or more.
+//
+
+static size_t				// O - Number of compressed bytes
+pcl_compress_delta(
+    const unsigned char *line,		// I - Line to compress
+    const unsigned char *seed,		// I - Seed (previous) line
+    size_t              length,		// I - Length of line in bytes
+    unsigned char       *buffer)	// I - Output buffer
+{
+  size_t	x,			// Current byte in line
+		start,			// Start of unchanged bytes
+		offset,			// Offset from previous replacement
+		count;			// Number of replacement bytes
+  unsigned char	*bufptr = buffer;	// Pointer into output buffer
+
+
+  for (x = 0; x < length;)
+  {
+    // Skip unchanged bytes...
+    for (start = x; x < length && line[x] == seed[x]; x ++);
+
+    if (x >= length)
+      break;
+
+    // Count changed bytes...
+    offset = x - start;
+
+    for (start = x; x < length && (x - start) < 8 && line[x] != seed[x]; x ++);
+
+    count = x - start;
+
+    // Write the command byte and any additional offset bytes...
+    if (offset < 31)
+    {
+      *bufptr++ = (unsigned char)(((count - 1) << 5) | offset);
+    }
+    else
+    {
+      *bufptr++ = (unsigned char)(((count - 1) << 5) | 31);
+
+      for (offset -= 31; offset >= 255; offset -= 255)
+        *bufptr++ = 255;
+
+      *bufptr++ = (unsigned char)offset;
+    }
+
+    // Then the replacement bytes...
+    memcpy(bufptr, line + start, count);
+    bufptr += count;
+  }
+
+  return ((size_t)(bufptr - buffer));
+}
+
+
+//
+// 'pcl_compress_packbits()' - Compress a line using PackBits (mode 2) compression.
+//
+
+static size_t				// O - Number of compressed bytes
+pcl_compress_packbits(
+    const unsigned char *line,		// I - Line to compress
+    size_t              length,		// I - Length of line in bytes
+    unsigned char       *buffer)	// I - Output buffer
+{
+  const unsigned char	*lineptr,	// Pointer into line
+			*lineend,	// End of line
+			*start;		// Start of sequence
+  unsigned char		*bufptr;	// Pointer into output buffer
+  unsigned		count;		// Count of bytes for output
+
+
+  bufptr  = buffer;
+  lineptr = line;
+  lineend = line + length;
+
+  while (lineptr < lineend)
+  {
+    if ((lineptr + 1) >= lineend)
+    {
+      // Single byte on the end...
+      *bufptr++ = 0x00;
+      *bufptr++ = *lineptr++;
+    }
+    else if (lineptr[0] == lineptr[1])
+    {
+      // Repeated sequence...
+      lineptr ++;
+      count = 2;
+
+      while (lineptr < (lineend - 1) && lineptr[0] == lineptr[1] && count < 127)
+      {
+	lineptr ++;
+	count ++;
+      }
+
+      *bufptr++ = (unsigned char)(257 - count);
+      *bufptr++ = *lineptr++;
+    }
+    else
+    {
+      // Non-repeated sequence...
+      start = lineptr;
+      lineptr ++;
+      count = 1;
+
+      while (lineptr < (lineend - 1) && lineptr[0] != lineptr[1] && count < 127)
+      {
+	lineptr ++;
+	count ++;
+      }
+
+      *bufptr++ = (unsigned char)(count - 1);
+
+      memcpy(bufptr, start, count);
+      bufptr += count;
+    }
+  }
+
+  return ((size_t)(bufptr - buffer));
+}
+
+
+//
+// 'pcl_end_job()' - End a PCL "job".
 //
 
 static void
@@ -2253,7 +2397,7 @@ pcl_end_job(xform_raster_t   *ras,	// I - Raster information
 // 'pcl_end_page()' - End of PCL page.
 //
 
-static void
+static bool				// O - `true` on success, `false` on failure
 pcl_end_page(xform_raster_t   *ras,	// I - Raster information
 	     unsigned         page,	// I - Current page
              xform_write_cb_t cb,	// I - Write callback
@@ -2271,6 +2415,23 @@ pcl_end_page(xform_raster_t   *ras,	// I - Raster information
 
   if (!(ras->header.Duplex && (page & 1)))
     (*cb)(ctx, (const unsigned char *)"\014", 1);
+
+ /*
+  * Report compression savings and free the compression buffers...
+  */
+
+  if (Verbosity > 1 && ras->comp_packbits > 0)
+    fprintf(stderr, "DEBUG: PCL page %u compressed to %lu bytes, %lu bytes with PackBits only (%.1f%% savings).\n", page, (unsigned long)ras->comp_bytes, (unsigned long)ras->comp_packbits, 100.0 - 100.0 * ras->comp_bytes / ras->comp_packbits);
+
+  free(ras->comp_buffer);
+  free(ras->comp_delta);
+  free(ras->comp_seed);
+
+  ras->comp_buffer = NULL;
+  ras->comp_delta  = NULL;
+  ras->comp_seed   = NULL;
+
+  return (true);
 }
 
 
@@ -2430,21 +2591,30 @@ pcl_start_page(xform_raster_t   *ras,	// I - Raster information
   pclps_printf(cb, ctx, "\033*r1A");	// Start graphics
 
  /*
-  * Allocate the output buffer...
+  * Allocate the output buffers...
   */
 
-  ras->out_blanks  = 0;
-  ras->comp_buffer = malloc((ras->right - ras->left + 7) / 8 * 2 + 2);
+  ras->out_blanks    = 0;
+  ras->comp_mode     = 2;
+  ras->comp_bytes    = 0;
+  ras->comp_packbits = 0;
+  ras->comp_buffer   = malloc((ras->right - ras->left + 7) / 8 * 2 + 2);
+  ras->comp_delta    = malloc((ras->right - ras->left + 7) / 8 * 2 + 2);
+  ras->comp_seed     = calloc(1, (ras->right - ras->left + 7) / 8);
 
-  return (ras->comp_buffer != NULL);
+  return (ras->comp_buffer != NULL && ras->comp_delta != NULL && ras->comp_seed != NULL);
 }
 
 
 //
 // 'pcl_write_line()' - Write a line of raster data.
 //
+// Each line is compressed using both PackBits (mode 2) and delta row (mode 3)
+// compression, and the smaller of the two is sent.  The compression mode is
+// only changed when the savings are larger than the escape sequence.
+//
 
-static void
+static bool				// O - `true` on success, `false` on failure
 pcl_write_line(
     xform_raster_t      *ras,		// I - Raster information
     unsigned            y,		// I - Line number
@@ -2452,80 +2622,283 @@ pcl_write_line(
     xform_write_cb_t    cb,		// I - Write callback
     void                *ctx)		// I - Write context
 {
-  const unsigned char	*outptr,	// Pointer into output buffer
-			*outend,	// End of output buffer
-			*start;		// Start of sequence
-  unsigned char		*compptr;	// Pointer into compression buffer
-  unsigned		count;		// Count of bytes for output
+  size_t		packbits_size,	// Size of PackBits data
+			delta_size;	// Size of delta row data
+  unsigned		mode;		// Compression mode for line
+  const unsigned char	*comp;		// Compressed data for line
+  size_t		comp_size;	// Size of compressed data for line
 
 
   (void)y;
 
-  if (line[0] == 255 && !memcmp(line, line + 1, ras->out_length - 1))
+  if (xformIsBlank(line, 0, ras->out_length))
   {
     // Skip blank line...
     ras->out_blanks ++;
-    return;
+    return (true);
+  }
+
+  if (ras->out_blanks > 0)
+  {
+    // Skip blank lines first, which also clears the seed row...
+    pclps_printf(cb, ctx, "\033*b%dY", ras->out_blanks);
+    ras->out_blanks = 0;
+    memset(ras->comp_seed, 0, ras->out_length);
   }
 
   // Apply compression...
-  compptr = ras->comp_buffer;
-  outptr  = line;
-  outend  = line + ras->out_length;
+  packbits_size = pcl_compress_packbits(line, ras->out_length, ras->comp_buffer);
+  delta_size    = pcl_compress_delta(line, ras->comp_seed, ras->out_length, ras->comp_delta);
+
+  ras->comp_packbits += packbits_size;
+
+  if (ras->comp_mode == 2)
+    mode = (delta_size + 5) < packbits_size ? 3 : 2;
+  else
+    mode = (packbits_size + 5) < delta_size ? 2 : 3;
+
+  if (mode != ras->comp_mode)
+  {
+    // Change compression modes...
+    pclps_printf(cb, ctx, "\033*b%uM", mode);
+    ras->comp_mode  = mode;
+    ras->comp_bytes += 5;
+  }
+
+  if (mode == 2)
+  {
+    comp      = ras->comp_buffer;
+    comp_size = packbits_size;
+  }
+  else
+  {
+    comp      = ras->comp_delta;
+    comp_size = delta_size;
+  }
+
+  ras->comp_bytes += comp_size;
+
+  // Output the line...
+  pclps_printf(cb, ctx, "\033*b%dW", (int)comp_size);
+  if (comp_size > 0)
+    (*cb)(ctx, comp, comp_size);
+
+  // Save the line as the seed row for the next one...
+  memcpy(ras->comp_seed, line, ras->out_length);
+
+  return (true);
+}
+
+
+//
+// 'pclm_add_page()' - Add a PCLm page object that draws the given strips.
+//
+
+static bool				// O - `true` on success, `false` on failure
+pclm_add_page(
+    xform_raster_t *ras,		// I - Raster information
+    size_t         num_strip_objs,	// I - Number of strip objects
+    pdfio_obj_t    **strip_objs)	// I - Strip objects
+{
+  size_t	i;			// Looping var
+  unsigned	height;			// Height of strip
+  pdfio_dict_t	*dict;			// Page dictionary
+  pdfio_stream_t *st;			// Page stream
+  char		image[32];		// Image object name
+
+
+  // Create the page object...
+  if ((dict = pdfioDictCreate(ras->pclm)) == NULL)
+    return (false);
+
+  pdfioDictSetRect(dict, "MediaBox", &ras->pclm_media_box);
+  for (i = 0; i < num_strip_objs; i ++)
+  {
+    snprintf(image, sizeof(image), "Image%u", (unsigned)i);
+    pdfioPageDictAddImage(dict, pdfioStringCreate(ras->pclm, image), strip_objs[i]);
+  }
 
-  while (outptr < outend)
+  if ((st = pdfioFileCreatePage(ras->pclm, dict)) == NULL)
+    return (false);
+
+  pdfioContentMatrixScale(st, 72.0 / ras->header.HWResolution[0], 72.0 / ras->header.HWResolution[1]);
+  for (i = 0; i < num_strip_objs; i ++)
+  {
+    height = pclm_get_height(ras, i);
+
+    pdfioStreamPrintf(st, "/P<</MCID 0>>BDC q\n%u 0 0 %u 0 %u cm\n/Image%u Do Q\n", ras->header.cupsWidth, height, (unsigned)(ras->header.cupsHeight - i * ras->pclm_strip_height - height), (unsigned)i);
+  }
+
+  return (pdfioStreamClose(st));
+}
+
+
+//
+// 'pclm_blank_strip()' - Get the shared blank strip object.
+//
+// Full-height blank strips all reference a single image object that is
+// compressed and written once per job (or whenever the strip height changes).
+// A shorter blank strip at the bottom of the page gets its own object.
+//
+
+static pdfio_obj_t *			// O - Blank strip object or `NULL` on error
+pclm_blank_strip(xform_raster_t *ras,	// I - Raster information
+                 unsigned       height)	// I - Height of strip
+{
+  xform_strip_t		strip;		// Blank strip data
+  pdfio_obj_t		*obj;		// Blank strip object
+  pdfio_stream_t	*st;		// Blank strip stream
+
+
+  if (height == ras->pclm_strip_height && ras->pclm_blank_obj && ras->pclm_blank_height == height)
+    return (ras->pclm_blank_obj);
+
+  memset(&strip, 0, sizeof(strip));
+
+  strip.datalen = height * ras->header.cupsBytesPerLine;
+
+  if ((strip.data = malloc(strip.datalen)) == NULL)
+    return (NULL);
+
+  memset(strip.data, ras->white, strip.datalen);
+  pclm_compress_strip(&strip, ras->pclm_deflate->level);
+
+  if (strip.complen == 0 || (obj = pclm_create_strip(ras, height)) == NULL || (st = pdfioObjCreateStream(obj, PDFIO_FILTER_NONE)) == NULL)
+  {
+    free(strip.data);
+    free(strip.comp);
+    return (NULL);
+  }
+
+  pdfioStreamWrite(st, strip.comp, strip.complen);
+  pdfioStreamClose(st);
+
+  free(strip.data);
+  free(strip.comp);
+
+  if (height == ras->pclm_strip_height)
+  {
+    ras->pclm_blank_obj    = obj;
+    ras->pclm_blank_height = height;
+  }
+
+  return (obj);
+}
+
+
+//
+// 'pclm_compress_strip()' - Compress a PCLm strip.
+//
+
+static void
+pclm_compress_strip(
+    xform_strip_t *strip,		// I - Strip
+    int           level)		// I - zlib compression level
+{
+  uLongf	complen;		// Length of compressed data
+  size_t	compsize = (size_t)compressBound((uLong)strip->datalen);
+					// Required size of compressed data buffer
+
+
+  if (compsize > strip->compsize)
   {
-    if ((outptr + 1) >= outend)
+    unsigned char *comp;		// New compressed data buffer
+
+    if ((comp = realloc(strip->comp, compsize)) == NULL)
     {
-      // Single byte on the end...
-      *compptr++ = 0x00;
-      *compptr++ = *outptr++;
+      strip->complen = 0;
+      return;
     }
-    else if (outptr[0] == outptr[1])
+
+    strip->comp     = comp;
+    strip->compsize = compsize;
+  }
+
+  complen = (uLongf)strip->compsize;
+
+  if (compress2(strip->comp, &complen, strip->data, (uLong)strip->datalen, level) == Z_OK)
+    strip->complen = (size_t)complen;
+  else
+    strip->complen = 0;
+}
+
+
+//
+// 'pclm_compress_thread()' - Compress PCLm strips as they are queued.
+//
+
+static void *				// O - Thread exit status
+pclm_compress_thread(
+    xform_deflate_t *pool)		// I - Compression pool
+{
+  size_t	i;			// Looping var
+  xform_strip_t	*strip;			// Current strip
+
+
+  cupsMutexLock(&pool->mutex);
+
+  while (!pool->shutdown)
+  {
+    // Find the oldest queued strip...
+    for (i = 0, strip = NULL; i < pool->num_strips; i ++)
     {
-      // Repeated sequence...
-      outptr ++;
-      count = 2;
+      xform_strip_t *temp = pool->strips + (pool->tail + i) % pool->num_strips;
+					// Current strip
 
-      while (outptr < (outend - 1) && outptr[0] == outptr[1] && count < 127)
+      if (temp->state == XFORM_SSTATE_QUEUED)
       {
-	outptr ++;
-	count ++;
+        strip = temp;
+        break;
       }
-
-      *compptr++ = (unsigned char)(257 - count);
-      *compptr++ = *outptr++;
     }
-    else
+
+    if (!strip)
     {
-      // Non-repeated sequence...
-      start = outptr;
-      outptr ++;
-      count = 1;
+      // Nothing to do, wait for the next strip...
+      cupsCondWait(&pool->cond, &pool->mutex, 0.0);
+      continue;
+    }
 
-      while (outptr < (outend - 1) && outptr[0] != outptr[1] && count < 127)
-      {
-	outptr ++;
-	count ++;
-      }
+    // Compress the strip without holding the lock...
+    strip->state = XFORM_SSTATE_ACTIVE;
+    cupsMutexUnlock(&pool->mutex);
 
-      *compptr++ = (unsigned char)(count - 1);
+    pclm_compress_strip(strip, pool->level);
 
-      memcpy(compptr, start, count);
-      compptr += count;
-    }
+    cupsMutexLock(&pool->mutex);
+    strip->state = XFORM_SSTATE_DONE;
+    cupsCondBroadcast(&pool->cond);
   }
 
-  // Output the line...
-  if (ras->out_blanks > 0)
-  {
-    // Skip blank lines first...
-    pclps_printf(cb, ctx, "\033*b%dY", ras->out_blanks);
-    ras->out_blanks = 0;
-  }
+  cupsMutexUnlock(&pool->mutex);
+
+  return (NULL);
+}
+
+
+//
+// 'pclm_create_strip()' - Create a PCLm strip image object.
+//
 
-  pclps_printf(cb, ctx, "\033*b%dW", (int)(compptr - ras->comp_buffer));
-  (*cb)(ctx, ras->comp_buffer, (size_t)(compptr - ras->comp_buffer));
+static pdfio_obj_t *			// O - Strip object or `NULL` on error
+pclm_create_strip(xform_raster_t *ras,	// I - Raster information
+                  unsigned       height)// I - Height of strip
+{
+  pdfio_dict_t	*dict;			// Image dictionary
+
+
+  if ((dict = pdfioDictCreate(ras->pclm)) == NULL)
+    return (NULL);
+
+  pdfioDictSetNumber(dict, "Width", ras->header.cupsWidth);
+  pdfioDictSetNumber(dict, "Height", height);
+  pdfioDictSetNumber(dict, "BitsPerComponent", 8);
+  pdfioDictSetName(dict, "ColorSpace", ras->header.cupsNumColors == 3 ? "DeviceRGB" : "DeviceGray");
+  pdfioDictSetName(dict, "Filter", "FlateDecode");
+  pdfioDictSetName(dict, "Type", "XObject");
+  pdfioDictSetName(dict, "Subtype", "Image");
+
+  return (pdfioFileCreateObj(ras->pclm, dict));
 }
 
 
@@ -2541,11 +2914,41 @@ pclm_end_job(xform_raster_t   *ras,	// I - Raster information
   int		fd;			// Temporary file
   char		buffer[16384];		// Copy buffer
   ssize_t	bytes;			// Bytes to write
+  size_t	i;			// Looping var
+  xform_deflate_t *pool = ras->pclm_deflate;
+					// Compression pool
+
+
+  // Stop the compression threads and free the strip buffers...
+  cupsMutexLock(&pool->mutex);
+  pool->shutdown = true;
+  cupsCondBroadcast(&pool->cond);
+  cupsMutexUnlock(&pool->mutex);
 
+  for (i = 0; i < pool->num_threads; i ++)
+    cupsThreadWait(pool->threads[i]);
+
+  for (i = 0; i < pool->num_strips; i ++)
+  {
+    free(pool->strips[i].data);
+    free(pool->strips[i].comp);
+  }
+
+  cupsCondDestroy(&pool->cond);
+  cupsMutexDestroy(&pool->mutex);
+  free(pool);
+
+  ras->pclm_deflate = NULL;
 
   // Close the PCLm file and copy it...
   pdfioFileClose(ras->pclm);
 
+  free(ras->pclm_strip_objs);
+
+  ras->pclm_strip_objs     = NULL;
+  ras->pclm_num_strip_objs = 0;
+  ras->pclm_blank_obj      = NULL;
+
   if ((fd = open(ras->pclm_tempfile, O_RDONLY)) < 0)
   {
     fprintf(stderr, "ERROR: Unable to open PCLm file '%s' - %s\n", ras->pclm_tempfile, strerror(errno));
@@ -2569,30 +2972,59 @@ pclm_end_job(xform_raster_t   *ras,	// I - Raster information
 // 'pclm_end_page()' - End of PCLm page.
 //
 
-static void
+static bool				// O - `true` on success, `false` on failure
 pclm_end_page(xform_raster_t   *ras,	// I - Raster information
 	      unsigned         page,	// I - Current page
               xform_write_cb_t cb,	// I - Write callback
               void             *ctx)	// I - Write context
 {
-  (void)page;
+  size_t	i;			// Looping var
+  bool		ret;			// Return value
+
+
   (void)cb;
   (void)ctx;
 
-  fprintf(stderr, "DEBUG: pclm_end_page(page=%u)\n", page);
+  // Write any remaining strips...
+  ret = pclm_write_strips(ras, 0);
 
-  free(ras->pclm_strip_objs);
+  fprintf(stderr, "DEBUG: pclm_end_page(page=%u)\n", page);
 
-  ras->pclm_strip_objs     = NULL;
-  ras->pclm_num_strip_objs = 0;
-}
+  if (ras->blank_page)
+  {
+    // Don't add a page that is being skipped...
+    free(ras->pclm_strip_objs);
 
+    ras->pclm_strip_objs     = NULL;
+    ras->pclm_num_strip_objs = 0;
+    return (ret);
+  }
 
-//
-// 'pclm_error_cb()' - Error callback for PCLm output.
-//
+  // Every line of the page is written, so a missing strip object means that
+  // the strip could not be created.  The strip objects are kept until the next
+  // page or the end of the job so that they can be cached for collated
+  // copies...
+  for (i = 0; i < ras->pclm_num_strip_objs; i ++)
+  {
+    if (!ras->pclm_strip_objs[i])
+      break;
+  }
 
-static bool				// O - `false` to stop
+  if (!ret || i < ras->pclm_num_strip_objs || !pclm_add_page(ras, ras->pclm_num_strip_objs, ras->pclm_strip_objs))
+  {
+    fprintf(stderr, "ERROR: Unable to add PCLm page %u.\n", page);
+    return (false);
+  }
+
+  return (true);
+}
+
+
+//
+// 'pclm_error_cb()' - Error callback for PCLm output.
+//
+
+static bool				// O - `false` to stop
 pclm_error_cb(pdfio_file_t *pdf,	// I - PCLm file (not used)
               const char   *message,	// I - Error message
               void         *data)	// I - Callback data (not used)
@@ -2606,6 +3038,66 @@ pclm_error_cb(pdfio_file_t *pdf,	// I - PCLm file (not used)
 }
 
 
+//
+// 'pclm_get_height()' - Get the height of a strip.
+//
+// All strips use the page's strip height except the last one, which is
+// shorter when the strip height does not divide the page height.
+//
+
+static unsigned				// O - Height of strip in lines
+pclm_get_height(xform_raster_t *ras,	// I - Raster information
+                size_t         strip)	// I - Strip number (0-based)
+{
+  unsigned	y = (unsigned)strip * ras->pclm_strip_height;
+					// First line in strip
+
+
+  if ((ras->header.cupsHeight - y) < ras->pclm_strip_height)
+    return (ras->header.cupsHeight - y);
+  else
+    return (ras->pclm_strip_height);
+}
+
+
+//
+// 'pclm_get_strip()' - Get the next available strip buffer.
+//
+
+static xform_strip_t *			// O - Strip buffer or `NULL` on error
+pclm_get_strip(xform_raster_t *ras,	// I - Raster information
+               unsigned       height)	// I - Height of strip
+{
+  xform_deflate_t	*pool = ras->pclm_deflate;
+					// Compression pool
+  xform_strip_t		*strip;		// Strip buffer
+  size_t		datalen = height * ras->header.cupsBytesPerLine;
+					// Length of strip data
+
+
+  // Make room for the next strip...
+  if (!pclm_write_strips(ras, pool->num_strips - 1))
+    return (NULL);
+
+  strip = pool->strips + pool->head;
+
+  if (datalen > strip->datasize)
+  {
+    unsigned char *data;		// New strip data buffer
+
+    if ((data = realloc(strip->data, datalen)) == NULL)
+      return (NULL);
+
+    strip->data     = data;
+    strip->datasize = datalen;
+  }
+
+  strip->datalen = datalen;
+
+  return (strip);
+}
+
+
 //
 // 'pclm_init()' - Initialize callbacks for PCLm output.
 //
@@ -2621,6 +3113,41 @@ pclm_init(xform_raster_t *ras)		// I - Raster information
 }
 
 
+//
+// 'pclm_put_strip()' - Queue a filled strip buffer for compression.
+//
+
+static bool				// O - `true` on success, `false` on failure
+pclm_put_strip(xform_raster_t *ras,	// I - Raster information
+               xform_strip_t  *strip)	// I - Strip buffer
+{
+  xform_deflate_t	*pool = ras->pclm_deflate;
+					// Compression pool
+
+
+  if (pool->num_threads == 0)
+  {
+    // Compress on this thread...
+    pclm_compress_strip(strip, pool->level);
+    strip->state = XFORM_SSTATE_DONE;
+  }
+
+  cupsMutexLock(&pool->mutex);
+
+  if (strip->state != XFORM_SSTATE_DONE)
+    strip->state = XFORM_SSTATE_QUEUED;
+
+  pool->head = (pool->head + 1) % pool->num_strips;
+  pool->num_pending ++;
+
+  cupsCondBroadcast(&pool->cond);
+  cupsMutexUnlock(&pool->mutex);
+
+  // Write any strips that have been compressed...
+  return (pclm_write_strips(ras, pool->num_strips));
+}
+
+
 //
 // 'pclm_start_job()' - Start a PCLm "job".
 //
@@ -2630,6 +3157,10 @@ pclm_start_job(xform_raster_t   *ras,	// I - Raster information
               xform_write_cb_t cb,	// I - Write callback
               void             *ctx)	// I - Write context
 {
+  size_t		i;		// Looping var
+  xform_deflate_t	*pool;		// Compression pool
+
+
   (void)cb;
   (void)ctx;
 
@@ -2642,6 +3173,36 @@ pclm_start_job(xform_raster_t   *ras,	// I - Raster information
   if ((ras->pclm = pdfioFileCreateTemporary(ras->pclm_tempfile, sizeof(ras->pclm_tempfile), "PCLm-1.0", &ras->pclm_media_box, &ras->pclm_media_box, pclm_error_cb, /*error_cbdata*/NULL)) == NULL)
     return (false);
 
+  // Start the strip compression threads - strips are compressed on this
+  // thread when only one thread is requested...
+  if ((pool = calloc(1, sizeof(xform_deflate_t))) == NULL)
+  {
+    pdfioFileClose(ras->pclm);
+    unlink(ras->pclm_tempfile);
+    return (false);
+  }
+
+  cupsMutexInit(&pool->mutex);
+  cupsCondInit(&pool->cond);
+
+  pool->level      = DeflateLevel;
+  pool->num_strips = 2 * (size_t)DeflateThreads;
+
+  ras->pclm_deflate = pool;
+
+  if (DeflateThreads > 1)
+  {
+    for (i = 0; i < (size_t)DeflateThreads; i ++)
+    {
+      if ((pool->threads[i] = cupsThreadCreate((cups_thread_func_t)pclm_compress_thread, pool)) == CUPS_THREAD_INVALID)
+        break;
+
+      pool->num_threads ++;
+    }
+  }
+
+  fprintf(stderr, "DEBUG: pclm_start_job: level=%d, num_threads=%u\n", pool->level, (unsigned)pool->num_threads);
+
   return (true);
 }
 
@@ -2658,10 +3219,6 @@ pclm_start_page(xform_raster_t   *ras,	// I - Raster information
 {
   const char	*value;			// Environment variable value
   int		temp;			// Temporary value
-  size_t	i;			// Looping var
-  pdfio_dict_t	*dict;			// Page/image dictionary
-  pdfio_stream_t *st;			// Page stream
-  char		image[32];		// Image object name
 
 
   (void)cb;
@@ -2675,52 +3232,34 @@ pclm_start_page(xform_raster_t   *ras,	// I - Raster information
   ras->right  = ras->header.cupsWidth;
   ras->bottom = ras->header.cupsHeight;
 
-  // Allocate objects for each of the strips...
-  if ((value = getenv("IPP_PCLM_STRIP_HEIGHT_PREFERRED")) == NULL || (temp = atoi(value)) < 16 || temp > 256)
-    ras->pclm_strip_height = 16;
-  else
+  // Allocate the strip object array.  Without a printer preference, use 16
+  // lines per strip unless that is less than 64k per strip, since very small
+  // strips compress poorly and add per-object overhead, but use at least 4
+  // strips per compression thread so they can be compressed in parallel.  The
+  // last strip is shorter if the page height is not a multiple of the strip
+  // height...
+  if ((value = getenv("IPP_PCLM_STRIP_HEIGHT_PREFERRED")) != NULL && (temp = atoi(value)) >= 16 && temp <= 256)
+  {
     ras->pclm_strip_height = (unsigned)temp;
-
-  ras->pclm_num_strip_objs = ras->header.cupsHeight / ras->pclm_strip_height;
-  if ((ras->pclm_strip_objs = calloc(ras->pclm_num_strip_objs, sizeof(pdfio_obj_t *))) == NULL)
-    return (false);
-
-  fprintf(stderr, "DEBUG: pclm_start_page: num_strips=%u\n", (unsigned)ras->pclm_num_strip_objs);
-
-  // Create an image object for each strip...
-  for (i = 0; i < ras->pclm_num_strip_objs; i ++)
+  }
+  else
   {
-    dict = pdfioDictCreate(ras->pclm);
-    pdfioDictSetNumber(dict, "Width", ras->header.cupsWidth);
-    pdfioDictSetNumber(dict, "Height", ras->pclm_strip_height);
-    pdfioDictSetNumber(dict, "BitsPerComponent", 8);
-    pdfioDictSetName(dict, "ColorSpace", ras->header.cupsNumColors == 3 ? "DeviceRGB" : "DeviceGray");
-    pdfioDictSetName(dict, "Filter", "FlateDecode");
-    pdfioDictSetName(dict, "Type", "XObject");
-    pdfioDictSetName(dict, "Subtype", "Image");
+    ras->pclm_strip_height = 16;
 
-    if ((ras->pclm_strip_objs[i] = pdfioFileCreateObj(ras->pclm, dict)) == NULL)
-      return (false);
+    while (ras->pclm_strip_height < 256 && (ras->pclm_strip_height * ras->header.cupsBytesPerLine) < 65536 && (ras->header.cupsHeight / (2 * ras->pclm_strip_height)) >= (4 * (unsigned)DeflateThreads))
+      ras->pclm_strip_height *= 2;
   }
 
-  // Create the page object...
-  dict = pdfioDictCreate(ras->pclm);
-  pdfioDictSetRect(dict, "MediaBox", &ras->pclm_media_box);
-  for (i = 0; i < ras->pclm_num_strip_objs; i ++)
-  {
-    snprintf(image, sizeof(image), "Image%u", (unsigned)i);
-    pdfioPageDictAddImage(dict, pdfioStringCreate(ras->pclm, image), ras->pclm_strip_objs[i]);
-  }
+  free(ras->pclm_strip_objs);
 
-  st = pdfioFileCreatePage(ras->pclm, dict);
+  ras->pclm_num_strip_objs = (ras->header.cupsHeight + ras->pclm_strip_height - 1) / ras->pclm_strip_height;
+  if ((ras->pclm_strip_objs = calloc(ras->pclm_num_strip_objs, sizeof(pdfio_obj_t *))) == NULL)
+    return (false);
 
-  pdfioContentMatrixScale(st, 72.0 / ras->header.HWResolution[0], 72.0 / ras->header.HWResolution[1]);
-  for (i = 0; i < ras->pclm_num_strip_objs; i ++)
-  {
-    pdfioStreamPrintf(st, "/P<</MCID 0>>BDC q\n%u 0 0 %u 0 %u cm\n/Image%u Do Q\n", ras->header.cupsWidth, ras->pclm_strip_height, (unsigned)(ras->header.cupsHeight - (i + 1) * ras->pclm_strip_height), (unsigned)i);
-  }
+  fprintf(stderr, "DEBUG: pclm_start_page: num_strips=%u\n", (unsigned)ras->pclm_num_strip_objs);
 
-  pdfioStreamClose(st);
+  // The strip objects are created as each strip is finished, and the page
+  // object is created by pclm_end_page...
   return (true);
 }
 
@@ -2729,7 +3268,7 @@ pclm_start_page(xform_raster_t   *ras,	// I - Raster information
 // 'pclm_write_line()' - Write a line of raster data.
 //
 
-static void
+static bool				// O - `true` on success, `false` on failure
 pclm_write_line(
     xform_raster_t      *ras,		// I - Raster information
     unsigned            y,		// I - Line number
@@ -2739,8 +3278,10 @@ pclm_write_line(
 {
   size_t	ystrip = y / ras->pclm_strip_height;
 					// Strip
-  unsigned	ymod = y % ras->pclm_strip_height;
+  unsigned	ymod = y % ras->pclm_strip_height,
 					// Line within strip
+		height;			// Height of strip
+  bool		ret = true;		// Return value
 
 
   (void)cb;
@@ -2749,18 +3290,121 @@ pclm_write_line(
 //  fprintf(stderr, "DEBUG: pclm_write_line(y=%u)\n", y);
 
   if (ystrip >= ras->pclm_num_strip_objs)
-    return;
+    return (true);
+
+  height = pclm_get_height(ras, ystrip);
 
   if (ymod == 0)
-    ras->pclm_strip_st = pdfioObjCreateStream(ras->pclm_strip_objs[ystrip], PDFIO_FILTER_FLATE);
+  {
+    if ((ras->pclm_strip = pclm_get_strip(ras, height)) == NULL)
+      return (false);
+
+    ras->pclm_strip_blank = true;
+  }
+  else if (!ras->pclm_strip)
+    return (false);
+
+  if (ras->pclm_strip_blank && !xformIsBlank(line, ras->white, ras->header.cupsBytesPerLine))
+  {
+    // First non-blank line in strip, fill the lines before it...
+    memset(ras->pclm_strip->data, ras->white, ymod * ras->header.cupsBytesPerLine);
+    ras->pclm_strip_blank = false;
+  }
+
+  if (!ras->pclm_strip_blank)
+    memcpy(ras->pclm_strip->data + ymod * ras->header.cupsBytesPerLine, line, ras->header.cupsBytesPerLine);
+
+  if (ymod == (height - 1))
+  {
+    if (ras->pclm_strip_blank)
+    {
+      // Reference the shared blank strip - the strip buffer is reused...
+      ras->pclm_strip_objs[ystrip] = pclm_blank_strip(ras, height);
+    }
+    else if ((ras->pclm_strip->obj = ras->pclm_strip_objs[ystrip] = pclm_create_strip(ras, height)) != NULL)
+    {
+      ret = pclm_put_strip(ras, ras->pclm_strip);
+    }
 
-  pdfioStreamWrite(ras->pclm_strip_st, line, ras->header.cupsBytesPerLine);
+    ras->pclm_strip = NULL;
 
-  if (ymod == (ras->pclm_strip_height - 1))
+    if (!ras->pclm_strip_objs[ystrip])
+    {
+      fprintf(stderr, "ERROR: Unable to create PCLm strip %u.\n", (unsigned)ystrip);
+      return (false);
+    }
+  }
+
+  return (ret);
+}
+
+
+//
+// 'pclm_write_strips()' - Write compressed strips to the PCLm file in order.
+//
+// Strips are written until no more than "max_pending" strips remain, waiting
+// for the compression threads as needed.
+//
+
+static bool				// O - `true` on success, `false` on failure
+pclm_write_strips(
+    xform_raster_t *ras,		// I - Raster information
+    size_t         max_pending)		// I - Maximum number of pending strips
+{
+  xform_deflate_t	*pool = ras->pclm_deflate;
+					// Compression pool
+  xform_strip_t		*strip;		// Current strip
+  pdfio_stream_t	*st;		// Strip stream
+  bool			ret = true;	// Return value
+
+
+  cupsMutexLock(&pool->mutex);
+
+  while (pool->num_pending > 0)
   {
-    pdfioStreamClose(ras->pclm_strip_st);
-    ras->pclm_strip_st = NULL;
+    strip = pool->strips + pool->tail;
+
+    if (strip->state != XFORM_SSTATE_DONE)
+    {
+      if (pool->num_pending <= max_pending)
+        break;
+
+      cupsCondWait(&pool->cond, &pool->mutex, 0.0);
+      continue;
+    }
+
+    // Write the compressed data as-is since the strip object already has a
+    // FlateDecode filter...
+    cupsMutexUnlock(&pool->mutex);
+
+    if (strip->complen > 0 && (st = pdfioObjCreateStream(strip->obj, PDFIO_FILTER_NONE)) != NULL)
+    {
+      pdfioStreamWrite(st, strip->comp, strip->complen);
+      pdfioStreamClose(st);
+    }
+    else if (strip->complen == 0 && (st = pdfioObjCreateStream(strip->obj, PDFIO_FILTER_FLATE)) != NULL)
+    {
+      // Compression failed, have PDFio compress the strip as it is written...
+      fputs("DEBUG: Unable to compress PCLm strip, using PDFio compression.\n", stderr);
+      pdfioStreamWrite(st, strip->data, strip->datalen);
+      pdfioStreamClose(st);
+    }
+    else
+    {
+      fputs("ERROR: Unable to write PCLm strip.\n", stderr);
+      ret = false;
+    }
+
+    cupsMutexLock(&pool->mutex);
+
+    strip->state = XFORM_SSTATE_FREE;
+    pool->tail   = (pool->tail + 1) % pool->num_strips;
+    pool->num_pending --;
   }
+
+  cupsMutexUnlock(&pool->mutex);
+
+  return (ret);
 }
 
 
@@ -2905,7 +3549,7 @@ ps_end_job(xform_raster_t   *ras,	// I - Raster information
 // 'ps_end_page()' - End of PostScript page.
 //
 
-static void
+static bool				// O - `true` on success, `false` on failure
 ps_end_page(xform_raster_t   *ras,	// I - Raster information
 	    unsigned         page,	// I - Current page
             xform_write_cb_t cb,	// I - Write callback
@@ -2916,6 +3560,8 @@ ps_end_page(xform_raster_t   *ras,	// I - Raster information
 
   pclps_printf(cb, ctx, "grestore grestore\n");
   pclps_printf(cb, ctx, "showpage\n");
+
+  return (true);
 }
 
 
@@ -3037,7 +3683,7 @@ ps_start_page(xform_raster_t   *ras,	// I - Raster information
 // 'ps_write_line()' - Write a line of raster data.
 //
 
-static void
+static bool				// O - `true` on success, `false` on failure
 ps_write_line(
     xform_raster_t      *ras,		// I - Raster information
     unsigned            y,		// I - Line number
@@ -3045,7 +3691,7 @@ ps_write_line(
     xform_write_cb_t    cb,		// I - Write callback
     void                *ctx)		// I - Write context
 {
-  if (line[0] != ras->white || memcmp(line, line + 1, ras->out_length - 1))
+  if (!xformIsBlank(line, ras->white, ras->out_length))
   {
     unsigned		length = ras->out_length;
 					// Remaining length
@@ -3113,6 +3759,8 @@ ps_write_line(
 
     (cb)(ctx, "~>", 2);
   }
+
+  return (true);
 }
 
 
@@ -3207,919 +3855,1751 @@ pdfio_start_page(xform_prepare_t *p,	// I - Preparation data
 }
 
 
+#ifndef HAVE_COREGRAPHICS_H
 //
-// 'prepare_documents()' - Prepare one or more documents for printing.
-//
-// This function generates a single PDF file containing the union of the input
-// documents and any job sheets.
+// 'pdftoppm_close()' - Stop rendering and remove any temporary files.
 //
 
-static bool				// O - `true` on success, `false` on failure
-prepare_documents(
-    size_t           num_documents,	// I - Number of input documents
-    xform_document_t *documents,	// I - Input documents
-    ipp_options_t    *options,		// I - IPP options
-    const char       *sheet_back,	// I - Back side transform
-    char             *outfile,		// I - Output filename buffer
-    size_t           outsize,		// I - Output filename buffer size
-    const char       *outformat,	// I - Output format
-    unsigned         *outpages,		// O - Number of pages
-    bool             generate_copies)	// I - Generate copies in output PDF?
+static void
+pdftoppm_close(void *data)		// I - pdftoppm rendering state
 {
-  bool			ret = false;	// Return value
-  int			copies;		// Number of copies
-  size_t		i;		// Looping var
-  xform_prepare_t	p;		// Preparation data
-  xform_document_t	*d;		// Current document
-  xform_page_t		*outpage;	// Current output page
-  int			outdir;		// Output direction
-  bool			reverse_order;	// Should output be in reverse order?
-  size_t		layout;		// Layout cell
-  int			document;	// Document number
-  int			page;		// Current page number
-  bool			duplex = !strncmp(options->sides, "two-sided-", 10);
-					// Doing two-sided printing?
+  xform_pdftoppm_t *pp = (xform_pdftoppm_t *)data;
+					// pdftoppm rendering state
+  unsigned	chunk;			// Current chunk
+  int		job;			// Current job
 
 
-  // Initialize data for preparing input files for transform...
-  memset(&p, 0, sizeof(p));
-  p.options = options;
-  p.errors  = cupsArrayNew(NULL, NULL, NULL, 0, _cupsArrayStrdup, _cupsArrayFree);
+  if (pp->fp && pp->jobs[pp->current % pp->num_jobs].tempfile[0])
+    fclose(pp->fp);
 
-  media_to_rect(&options->media, &p.media, &p.crop);
-  prepare_number_up(&p);
+  pp->fp = NULL;
 
-  if (!strncmp(options->sides, "two-sided-", 10) && sheet_back && strcmp(sheet_back, "normal"))
+#if !_WIN32
+  if (pp->map)
+    munmap(pp->map, pp->mapsize);
+
+  pp->map = NULL;
+#endif // !_WIN32
+
+  for (chunk = pp->current; chunk < pp->next; chunk ++)
   {
-    // Need to do a transform on the back side of pages...
-    if (!strcmp(sheet_back, "flipped"))
+    job = (int)(chunk % (unsigned)pp->num_jobs);
+
+    if (pp->jobs[job].pipe)
     {
-      if (!strcmp(options->sides, "two-sided-short-edge"))
-      {
-	p.use_duplex_xform   = true;
-        p.duplex_xform[0][0] = -1.0;
-        p.duplex_xform[0][1] = 0.0;
-        p.duplex_xform[1][0] = 0.0;
-        p.duplex_xform[1][1] = 1.0;
-        p.duplex_xform[2][0] = p.media.x2;
-        p.duplex_xform[2][1] = 0.0;
-      }
-      else
-      {
-	p.use_duplex_xform   = true;
-        p.duplex_xform[0][0] = 1.0;
-        p.duplex_xform[0][1] = 0.0;
-        p.duplex_xform[1][0] = 0.0;
-        p.duplex_xform[1][1] = -1.0;
-        p.duplex_xform[2][0] = 0.0;
-        p.duplex_xform[2][1] = p.media.y2;
-      }
+#if _WIN32
+      _pclose(pp->jobs[job].pipe);
+#else
+      pclose(pp->jobs[job].pipe);
+#endif // _WIN32
+      pp->jobs[job].pipe = NULL;
     }
-    else if ((!strcmp(sheet_back, "manual-tumble") && !strcmp(options->sides, "two-sided-short-edge")) || (!strcmp(sheet_back, "rotated") && !strcmp(options->sides, "two-sided-long-edge")))
+
+    if (pp->jobs[job].tempfile[0])
     {
-      p.use_duplex_xform   = true;
-      p.duplex_xform[0][0] = -1.0;
-      p.duplex_xform[0][1] = 0.0;
-      p.duplex_xform[1][0] = 0.0;
-      p.duplex_xform[1][1] = -1.0;
-      p.duplex_xform[2][0] = p.media.x2;
-      p.duplex_xform[2][1] = p.media.y2;
+      unlink(pp->jobs[job].tempfile);
+      pp->jobs[job].tempfile[0] = '\0';
     }
   }
 
-  if ((p.pdf = pdfioFileCreateTemporary(outfile, outsize, "1.7", &p.media, &p.media, pdfio_error_cb, &p)) == NULL)
-    return (false);
+  free(pp);
+}
 
-  // Loop through the input documents to count pages, etc.
-  for (i = num_documents, d = documents, document = 1, page = 1; i > 0; i --, d ++, document ++)
-  {
-    if (Verbosity)
-      fprintf(stderr, "DEBUG: Preparing document %d: '%s' (%s)\n", document, d->filename, d->format);
 
-    if (!strcmp(d->format, "application/pdf"))
-    {
-      // PDF file...
-      d->pdf_filename = d->filename;
-    }
-    else if (!strcmp(d->format, "image/jpeg") || !strcmp(d->format, "image/png"))
-    {
-      // JPEG or PNG image...
-      if (!convert_image(&p, d, document))
-        goto done;
-    }
-    else if (!strcmp(d->format, "text/plain"))
+#if !_WIN32
+//
+// 'pdftoppm_map()' - Map the output file for the current chunk into memory.
+//
+
+static bool				// O - `true` on success, `false` on failure
+pdftoppm_map(xform_pdftoppm_t *pp,	// I - pdftoppm rendering state
+             int              job)	// I - Current job
+{
+  int		fd;			// Output file
+  struct stat	fileinfo;		// Output file information
+
+
+  if ((fd = open(pp->jobs[job].tempfile, O_RDONLY)) < 0)
+  {
+    cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), Prefix, pp->jobs[job].tempfile, strerror(errno));
+    return (false);
+  }
+
+  pp->mapoff  = 0;
+  pp->mapsize = fstat(fd, &fileinfo) ? 0 : (size_t)fileinfo.st_size;
+
+  if (pp->mapsize == 0)
+  {
+    // Nothing was rendered, mark the chunk as done...
+    close(fd);
+    pp->map = NULL;
+    return (true);
+  }
+
+  // Map a private (copy-on-write) copy so that lines can be dithered and packed
+  // in place...
+  pp->map = mmap(NULL, pp->mapsize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+  close(fd);
+
+  if (pp->map == MAP_FAILED)
+  {
+    cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), Prefix, pp->jobs[job].tempfile, strerror(errno));
+    pp->map = NULL;
+    return (false);
+  }
+
+  madvise(pp->map, pp->mapsize, MADV_SEQUENTIAL);
+
+  return (true);
+}
+#endif // !_WIN32
+
+
+//
+// 'pdftoppm_next()' - Get the output for the next rendered page.
+//
+// This function returns `true` if the current output has more data.  Otherwise
+// the next chunk of pages is waited for, and up to "num_jobs" chunks are kept
+// rendering ahead of the one being read.
+//
+
+static bool				// O - `true` if there is more output, `false` when done
+pdftoppm_next(xform_pdftoppm_t *pp)	// I - pdftoppm rendering state
+{
+  int	ch;				// Next character
+  int	job;				// Current job
+  int	status;				// Exit status
+
+
+  while (pp->current < pp->num_chunks)
+  {
+    job = (int)(pp->current % (unsigned)pp->num_jobs);
+
+#if !_WIN32
+    if (pp->map)
     {
-      // Plain text file...
-      if (!convert_text(&p, d, document))
-        goto done;
+      // See if there is more data in the mapped output...
+      if (pp->mapoff < pp->mapsize)
+        return (true);
+
+      munmap(pp->map, pp->mapsize);
+      pp->map = NULL;
+
+      unlink(pp->jobs[job].tempfile);
+      pp->jobs[job].tempfile[0] = '\0';
+
+      pp->current ++;
+      continue;
     }
-    else
+#endif // !_WIN32
+
+    if (pp->fp)
     {
-      // PWG or Apple raster file...
-      if (!convert_raster(&p, d, document))
-        goto done;
-    }
+      // See if there is more data for the current chunk...
+      if ((ch = getc(pp->fp)) != EOF)
+      {
+        ungetc(ch, pp->fp);
+        return (true);
+      }
 
-    if (Verbosity)
-      fprintf(stderr, "DEBUG: Opening prepared document %d: '%s'.\n", document, d->pdf_filename);
+      // No, finish this chunk...
+      if (pp->jobs[job].tempfile[0])
+      {
+        fclose(pp->fp);
+        unlink(pp->jobs[job].tempfile);
+        pp->jobs[job].tempfile[0] = '\0';
+      }
+      else
+      {
+#if _WIN32
+        _pclose(pp->fp);
+#else
+        pclose(pp->fp);
+#endif // _WIN32
+        pp->jobs[job].pipe = NULL;
+      }
 
-    if ((d->pdf = pdfioFileOpen(d->pdf_filename, pdfio_password_cb, &document, pdfio_error_cb, &p)) == NULL)
-      goto done;
+      pp->fp = NULL;
+      pp->current ++;
+      continue;
+    }
 
-    if (options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
+    // Start rendering chunks up to the lookahead limit...
+    while (pp->next < pp->num_chunks && pp->next < (pp->current + (unsigned)pp->num_jobs))
     {
-      d->first_page = 1;
-      d->last_page  = (int)pdfioFileGetNumPages(d->pdf);
+      if (!pdftoppm_start(pp))
+        return (false);
     }
-    else
+
+    if (!pp->jobs[job].tempfile[0])
     {
-      d->first_page = page;
-      d->last_page  = page + (int)pdfioFileGetNumPages(d->pdf) - 1;
+      // Read directly from the pipe...
+      pp->fp = pp->jobs[job].pipe;
+      continue;
     }
 
-    if (Verbosity)
-      fprintf(stderr, "DEBUG: Document %d: pages %d to %d.\n", document, d->first_page, d->last_page);
+    // Wait for the current chunk to finish and then read the output file...
+#if _WIN32
+    status = _pclose(pp->jobs[job].pipe);
+#else
+    status = pclose(pp->jobs[job].pipe);
+#endif // _WIN32
+    pp->jobs[job].pipe = NULL;
 
-    while (page <= d->last_page)
+    if (status)
+      fprintf(stderr, "DEBUG: pdftoppm for chunk %u exited with status %d.\n", pp->current + 1, status);
+
+#if !_WIN32
+    if (pp->use_map)
     {
-      if (options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
-      {
-        if (ippOptionsCheckPage(options, page - d->first_page + 1))
-          d->num_pages ++;
-      }
-      else if (ippOptionsCheckPage(options, page))
+      if (!pdftoppm_map(pp, job))
+        return (false);
+
+      if (!pp->map)
       {
-        d->num_pages ++;
+        unlink(pp->jobs[job].tempfile);
+        pp->jobs[job].tempfile[0] = '\0';
+        pp->current ++;
       }
-
-      page ++;
+      continue;
     }
+#endif // !_WIN32
 
-    if ((d->last_page & 1) && duplex && options->multiple_document_handling != IPPOPT_HANDLING_SINGLE_DOCUMENT)
+    if ((pp->fp = fopen(pp->jobs[job].tempfile, "rb")) == NULL)
     {
-      d->last_page ++;
-      page ++;
+      cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), Prefix, pp->jobs[job].tempfile, strerror(errno));
+      return (false);
     }
+  }
 
-    if ((d->num_pages & 1) && duplex && options->multiple_document_handling != IPPOPT_HANDLING_SINGLE_DOCUMENT)
-      d->num_pages ++;
+  return (false);
+}
 
-    p.num_inpages += d->num_pages;
-  }
 
-  // When doing N-up or booklet printing, the default is to scale to fit unless
-  // fill is explicitly chosen...
-  if (p.num_layout > 1 && options->print_scaling != IPPOPT_SCALING_FILL)
-    options->print_scaling = IPPOPT_SCALING_FIT;
+//
+// 'pdftoppm_open()' - Prepare to render a PDF file using pdftoppm.
+//
+// When more than one job is allowed, the pages are split into chunks of up to
+// XFORM_MAX_CHUNK pages that are rendered by separate pdftoppm processes into
+// temporary files.  When "use_map" is `true`, the output is always rendered to
+// temporary files that are mapped into memory rather than read through a pipe.
+//
 
-  // Prepare output pages...
-  prepare_pages(&p, num_documents, documents);
+static xform_pdftoppm_t *		// O - pdftoppm rendering state or `NULL` on error
+pdftoppm_open(const char     *filename,	// I - PDF filename
+              xform_raster_t *ras,	// I - Raster information
+              unsigned       pages,	// I - Number of pages
+              int            num_jobs,	// I - Maximum number of concurrent processes
+              bool           use_map)	// I - Map output files into memory?
+{
+  xform_pdftoppm_t *pp;			// pdftoppm rendering state
+  char		command[1024],		// pdftoppm command
+		output[1024];		// Ouptut from pdftoppm
+  FILE		*fp;			// Pipe for output
 
-  // Add job-sheets content...
-  if (options->job_sheets[0] && strcmp(options->job_sheets, "none"))
-    generate_job_sheets(&p);
 
-  // Copy pages to the output file...
-  for (copies = generate_copies ? options->copies : 1; copies > 0; copies --)
+  // Find the pdftoppm program...
+  if (!PdftoppmCommand[0] && !cupsFileFind("pdftoppm", getenv("PATH"), true, PdftoppmCommand, sizeof(PdftoppmCommand)))
   {
-    reverse_order = !strcmp(options->output_bin, "face-up");
-    if (options->page_delivery >= IPPOPT_DELIVERY_REVERSE_ORDER_FACE_DOWN)
-      reverse_order = !reverse_order;
+    cupsLangPrintf(stderr, _("%s: Unable to find pdftoppm helper program."), Prefix);
+    return (NULL);
+  }
 
-    if (reverse_order)
+  // There are two versions of the pdftoppm command - the one that comes with
+  // Xpdf and the one that comes with Poppler which forked from Xpdf in the
+  // v3.0 days.  Unfortunately, the two commands have drifted apart so we need
+  // to determine *which* pdftoppm command is available...
+  if (PdftoppmPoppler < 0)
+  {
+#if _WIN32
+    snprintf(command, sizeof(command), "%s -v", PdftoppmCommand);
+    if ((fp = _popen(command, "r")) != NULL)
+#else
+    snprintf(command, sizeof(command), "%s -v 2>&1", PdftoppmCommand);
+    if ((fp = popen(command, "r")) != NULL)
+#endif // _WIN32
     {
-      outpage = p.outpages + p.num_outpages - 1;
-      outdir  = -1;
+      PdftoppmPoppler = 0;
+
+      while (fgets(output, sizeof(output), fp))
+      {
+        if (strstr(output, "oppler"))
+          PdftoppmPoppler = 1;
+      }
+
+#if _WIN32
+      _pclose(fp);
+#else
+      pclose(fp);
+#endif // _WIN32
+
+      fprintf(stderr, "DEBUG: Using %s version of pdftoppm.\n", PdftoppmPoppler ? "Poppler" : "Xpdf");
     }
     else
     {
-      outpage = p.outpages;
-      outdir  = 1;
+      cupsLangPrintf(stderr, _("%s: Unable to run pdftoppm command: %s"), Prefix, strerror(errno));
+      return (NULL);
     }
+  }
 
-    if (p.num_layout == 1 && strcasecmp(outformat, "image/pwg-raster") && strcasecmp(outformat, "image/urf"))
-    {
-      // Simple path - no layout of pages so we can usually just copy the pages quickly.
-      if (Verbosity)
-	fputs("DEBUG: Doing fast copy of pages.\n", stderr);
+  if ((pp = calloc(1, sizeof(xform_pdftoppm_t))) == NULL)
+  {
+    cupsLangPrintf(stderr, _("%s: Out of memory."), Prefix);
+    return (NULL);
+  }
 
-      for (i = p.num_outpages; i > 0; i --, outpage += outdir)
-      {
-	if (outpage->input[0])
-	{
-          ippopt_scaling_t scaling = options->print_scaling;
-					// Scaling needed, if any
+  pp->filename  = filename;
+  pp->num_pages = pages;
+#if !_WIN32
+  pp->use_map   = use_map;
+#else
+  (void)use_map;
+#endif // !_WIN32
 
-          if (scaling == IPPOPT_SCALING_AUTO || scaling == IPPOPT_SCALING_AUTO_FIT)
-          {
-            // Default to no scaling for "auto" and "auto-fit"...
-            scaling = IPPOPT_SCALING_NONE;
+  if (num_jobs > XFORM_MAX_JOBS)
+    num_jobs = XFORM_MAX_JOBS;
 
-	    if (options->media_specified)
-	    {
-	      // When media is specified, see if this page needs to be scaled...
-	      pdfio_rect_t media_box;	// MediaBox for the page
-	      int	media_width,	// Media width in hundredths of millimeters
-			media_length;	// Media length in hundredths of millimeters
+  if (num_jobs > 1 && pages > 1)
+  {
+    // Split the pages between processes...
+    if ((pp->chunk_pages = (pages + (unsigned)num_jobs - 1) / (unsigned)num_jobs) > XFORM_MAX_CHUNK)
+      pp->chunk_pages = XFORM_MAX_CHUNK;
 
-	      if (pdfioDictGetRect(pdfioObjGetDict(outpage->input[0]), "MediaBox", &media_box))
-	      {
-		// Got the MediaBox so get the portrait dimensions and compare...
-		if (media_box.x2 > media_box.y2)
-		{
-		  media_width  = (int)(2540.0 * media_box.y2 / 72.0);
-		  media_length = (int)(2540.0 * media_box.x2 / 72.0);
-		}
-		else
-		{
-		  media_width  = (int)(2540.0 * media_box.x2 / 72.0);
-		  media_length = (int)(2540.0 * media_box.y2 / 72.0);
-		}
+    pp->num_chunks = (pages + pp->chunk_pages - 1) / pp->chunk_pages;
+    pp->num_jobs   = num_jobs;
+  }
+  else if (pp->use_map && pages > XFORM_MAX_CHUNK)
+  {
+    // Render chunks of pages with a single process at a time to limit the size
+    // of the temporary files...
+    pp->chunk_pages = XFORM_MAX_CHUNK;
+    pp->num_chunks  = (pages + XFORM_MAX_CHUNK - 1) / XFORM_MAX_CHUNK;
+    pp->num_jobs    = 1;
+  }
+  else
+  {
+    // Render all of the pages with a single process...
+    pp->chunk_pages = pages;
+    pp->num_chunks  = 1;
+    pp->num_jobs    = 1;
+  }
+
+  // Run the pdftoppm command:
+  //
+  //   Poppler:
+  //     pdftoppm [-gray] -thinlinemode solid -aa no -r resolution -scale-to HEIGHT filename
+  //
+  //   Xpdf:
+  //     pdftoppm [-gray] -aa no -r resolution filename -
+  if (PdftoppmPoppler)
+    snprintf(pp->options, sizeof(pp->options), "%s -aa no -r %u -scale-to %u", ras->header.cupsBitsPerPixel <= 8 ? "-gray" : "", ras->header.HWResolution[0], ras->header.cupsHeight);
+  else
+    snprintf(pp->options, sizeof(pp->options), "%s -aa no -r %u", ras->header.cupsBitsPerPixel <= 8 ? "-gray" : "", ras->header.HWResolution[0]);
 
-		if (media_width != options->media.width || media_length != options->media.length)
-		  scaling = IPPOPT_SCALING_FIT;
-	      }
-	    }
-	  }
+  if (pp->num_chunks > 1)
+    fprintf(stderr, "DEBUG: Rendering %u pages using %u chunks of %u pages and up to %d processes.\n", pages, pp->num_chunks, pp->chunk_pages, pp->num_jobs);
 
-	  if (scaling == IPPOPT_SCALING_NONE)
-	  {
-	    // Do a fast copy of the page with the original media size...
-	    pdfioPageCopy(p.pdf, outpage->input[0]);
-	  }
-	  else
-	  {
-	    // Scale to fit/fill...
-	    if (Verbosity)
-	      fprintf(stderr, "DEBUG: Scaling page %u/%u.\n", (unsigned)(outpage - p.outpages + 1), (unsigned)p.num_outpages);
+  return (pp);
+}
 
-	    // Create the page dictionary using the source page's resources...
-	    outpage->pagedict = pdfioDictCreate(p.pdf);
-	    outpage->resdict  = pdfioDictCopy(p.pdf, pdfioDictGetDict(pdfioObjGetDict(outpage->input[0]), "Resources"));
-	    outpage->annots   = pdfioArrayCopy(p.pdf, pdfioDictGetArray(pdfioObjGetDict(outpage->input[0]), "Annots"));
 
-	    pdfioDictSetRect(outpage->pagedict, "CropBox", &p.media);
-	    pdfioDictSetRect(outpage->pagedict, "MediaBox", &p.media);
-	    pdfioDictSetDict(outpage->pagedict, "Resources", outpage->resdict);
-	    pdfioDictSetArray(outpage->pagedict, "Annots", outpage->annots);
-	    pdfioDictSetName(outpage->pagedict, "Type", "Page");
+#if !_WIN32
+//
+// 'pdftoppm_open_map()' - Open a PDF file using pdftoppm and mapped output files.
+//
 
-	    // Now copy the content stream to build the page...
-	    outpage->output = pdfio_start_page(&p, outpage->pagedict);
+static void *				// O - pdftoppm rendering state or `NULL` on error
+pdftoppm_open_map(
+    const char     *filename,		// I - PDF filename
+    xform_raster_t *ras,		// I - Raster information
+    unsigned       pages)		// I - Number of pages
+{
+  return (pdftoppm_open(filename, ras, pages, NumJobs, true));
+}
+#endif // !_WIN32
 
-	    copy_page(&p, outpage, /*layout*/0);
 
-	    pdfio_end_page(&p, outpage->output);
-	    outpage->output = NULL;
-	  }
-	}
-      }
-    }
-    else
-    {
-      // Layout path - merge page resources and do mapping of resources as needed
-      if (Verbosity)
-	fprintf(stderr, "DEBUG: Doing full layout of %u pages.\n", (unsigned)p.num_outpages);
+//
+// 'pdftoppm_open_pipe()' - Open a PDF file using pdftoppm and pipes.
+//
 
-      for (i = p.num_outpages; i > 0; i --, outpage += outdir)
-      {
-	// Create a page dictionary that merges the resources from each of the
-	// input pages...
-	if (Verbosity)
-	  fprintf(stderr, "DEBUG: Laying out page %u/%u.\n", (unsigned)(outpage - p.outpages + 1), (unsigned)p.num_outpages);
-
-	outpage->pagedict = pdfioDictCreate(p.pdf);
-	outpage->resdict  = pdfioDictCreate(p.pdf);
+static void *				// O - pdftoppm rendering state or `NULL` on error
+pdftoppm_open_pipe(
+    const char     *filename,		// I - PDF filename
+    xform_raster_t *ras,		// I - Raster information
+    unsigned       pages)		// I - Number of pages
+{
+  return (pdftoppm_open(filename, ras, pages, NumJobs, false));
+}
 
-	pdfioDictSetRect(outpage->pagedict, "CropBox", &p.media);
-	pdfioDictSetRect(outpage->pagedict, "MediaBox", &p.media);
-	pdfioDictSetDict(outpage->pagedict, "Resources", outpage->resdict);
-	pdfioDictSetName(outpage->pagedict, "Type", "Page");
 
-	for (layout = 0; layout < p.num_layout; layout ++)
-	{
-	  pdfio_dict_t	*pagedict,	// Page dictionary
-			*resdict;	// Resources dictionary
-	  pdfio_obj_t	*resobj;	// Resources object
+//
+// 'pdftoppm_read_band()' - Read a band of lines from the current page.
+//
+// Lines are read into the buffer when reading from a pipe or file.  Mapped
+// output is returned directly without copying.
+//
 
-	  if (!outpage->input[layout])
-	    continue;
+static unsigned char *			// O - Lines or `NULL` on error
+pdftoppm_read_band(
+    void          *data,		// I - pdftoppm rendering state
+    unsigned char *buffer,		// I - Line buffer
+    unsigned      lines)		// I - Number of lines
+{
+  xform_pdftoppm_t *pp = (xform_pdftoppm_t *)data;
+					// pdftoppm rendering state
+  size_t	bytes;			// Number of bytes
+  unsigned char	*band;			// Band data
 
-	  outpage->layout  = layout;
-	  outpage->restype = NULL;
 
-          pagedict = pdfioObjGetDict(outpage->input[layout]);
-          if ((resdict = pdfioDictGetDict(pagedict, "Resources")) != NULL)
-	    pdfioDictIterateKeys(resdict, (pdfio_dict_cb_t)page_dict_cb, outpage);
-	  else if ((resobj = pdfioDictGetObj(pagedict, "Resources")) != NULL)
-	    pdfioDictIterateKeys(pdfioObjGetDict(resobj), (pdfio_dict_cb_t)page_dict_cb, outpage);
-          else if (Verbosity)
-            fprintf(stderr, "DEBUG: No Resources for cell %u.\n", (unsigned)layout);
+  if (lines > pp->lines)
+    lines = pp->lines;
 
-	  // TODO: Handle inherited resources from parent page objects...
-	}
+  bytes = (size_t)lines * pp->linesize;
 
-	// Now copy the content streams to build the composite page, using the
-	// resource map for any named resources...
-	outpage->output = pdfio_start_page(&p, outpage->pagedict);
+#if !_WIN32
+  if (pp->map)
+  {
+    if (bytes > (pp->mapsize - pp->mapoff))
+    {
+      pp->mapoff = pp->mapsize;
+      return (NULL);
+    }
 
-	for (layout = 0; layout < p.num_layout; layout ++)
-	  copy_page(&p, outpage, layout);
+    band       = pp->map + pp->mapoff;
+    pp->mapoff += bytes;
+    pp->lines  -= lines;
 
-	pdfio_end_page(&p, outpage->output);
-	outpage->output = NULL;
-      }
-    }
+    return (band);
   }
+#endif // !_WIN32
 
-  // Add final job-sheets content...
-  if (options->job_sheets[0] && strcmp(options->job_sheets, "none"))
-    generate_job_sheets(&p);
+  if (!pp->fp || fread(buffer, pp->linesize, lines, pp->fp) != lines)
+    return (NULL);
 
-  // Add job-error-sheet content as needed...
-  if (options->job_error_sheet.report == IPPOPT_ERROR_REPORT_ALWAYS || (options->job_error_sheet.report == IPPOPT_ERROR_REPORT_ON_ERROR && cupsArrayGetCount(p.errors) > 0))
-    generate_job_error_sheet(&p);
+  band      = buffer;
+  pp->lines -= lines;
 
-  ret = true;
+  return (band);
+}
 
-  *outpages = (unsigned)pdfioFileGetNumPages(p.pdf);
 
-  // Finalize the output and return...
-  done:
+//
+// 'pdftoppm_start()' - Start rendering the next chunk of pages.
+//
 
-  cupsArrayDelete(p.errors);
+static bool				// O - `true` on success, `false` on failure
+pdftoppm_start(xform_pdftoppm_t *pp)	// I - pdftoppm rendering state
+{
+  int		job = (int)(pp->next % (unsigned)pp->num_jobs);
+					// Job for chunk
+  unsigned	first,			// First page
+		last;			// Last page
+  int		fd;			// Temporary file
+  char		command[2048];		// pdftoppm command
 
-  for (i = p.num_outpages, outpage = p.outpages; i > 0; i --, outpage ++)
+
+  if (pp->num_chunks == 1 && !pp->use_map)
   {
-    if (outpage->output)
-      pdfioStreamClose(outpage->output);
+    // Render everything to the pipe...
+    pp->jobs[job].tempfile[0] = '\0';
+
+    if (PdftoppmPoppler)
+      snprintf(command, sizeof(command), "%s %s '%s'", PdftoppmCommand, pp->options, pp->filename);
+    else
+      snprintf(command, sizeof(command), "%s %s '%s' -", PdftoppmCommand, pp->options, pp->filename);
   }
+  else
+  {
+    // Render a range of pages to a temporary file...
+    first = pp->next * pp->chunk_pages + 1;
+    if ((last = first + pp->chunk_pages - 1) > pp->num_pages)
+      last = pp->num_pages;
 
-  if (!pdfioFileClose(p.pdf))
-    ret = false;
+    if ((fd = cupsCreateTempFd(NULL, ".ppm", pp->jobs[job].tempfile, sizeof(pp->jobs[job].tempfile))) < 0)
+    {
+      cupsLangPrintf(stderr, _("%s: Unable to create temporary file: %s"), Prefix, strerror(errno));
+      pp->jobs[job].tempfile[0] = '\0';
+      return (false);
+    }
 
-  if (!ret)
-  {
-    // Remove temporary file...
-    unlink(outfile);
-    *outfile = '\0';
+    close(fd);
+
+    if (PdftoppmPoppler)
+      snprintf(command, sizeof(command), "%s %s -f %u -l %u '%s' >'%s'", PdftoppmCommand, pp->options, first, last, pp->filename, pp->jobs[job].tempfile);
+    else
+      snprintf(command, sizeof(command), "%s %s -f %u -l %u '%s' - >'%s'", PdftoppmCommand, pp->options, first, last, pp->filename, pp->jobs[job].tempfile);
   }
 
-  // Close and delete intermediate files...
-  for (i = num_documents, d = documents; i > 0; i --, d ++)
+  fprintf(stderr, "DEBUG: Running \"%s\".\n", command);
+
+#if _WIN32
+  if ((pp->jobs[job].pipe = _popen(command, "rb")) == NULL)
+#else
+  if ((pp->jobs[job].pipe = popen(command, "r")) == NULL)
+#endif // _WIN32
   {
-    pdfioFileClose(d->pdf);
-    if (d->tempfile[0])
-      unlink(d->tempfile);
+    cupsLangPrintf(stderr, _("%s: Unable to run pdftoppm command: %s"), Prefix, strerror(errno));
+
+    if (pp->jobs[job].tempfile[0])
+    {
+      unlink(pp->jobs[job].tempfile);
+      pp->jobs[job].tempfile[0] = '\0';
+    }
+
+    return (false);
   }
 
-  // Return success/fail status...
-  return (ret);
+  pp->next ++;
+
+  return (true);
 }
 
 
 //
-// 'prepare_log()' - Log an informational or error message while preparing
-//                   documents for printing.
+// 'pdftoppm_start_page()' - Start reading the next rendered page.
+//
+// Any unread lines from the previous page are skipped.  The page header is
+// "P5" (gray) or "P6" (RGB), followed by the width, height, and maximum value.
 //
 
-static void
-prepare_log(xform_prepare_t *p,		// I - Preparation data
-            bool            error,	// I - `true` for error, `false` for info
-	    const char      *message,	// I - Printf-style message string
-	    ...)			// I - Addition arguments as needed
+static bool				// O - `true` if there is a page, `false` when done
+pdftoppm_start_page(
+    void     *data,			// I - pdftoppm rendering state
+    unsigned *width,			// O - Width in pixels
+    unsigned *height,			// O - Height in lines
+    unsigned *bpp)			// O - Bytes per pixel
 {
-  va_list	ap;			// Argument pointer
-  char		buffer[1024];		// Output buffer
+  xform_pdftoppm_t *pp = (xform_pdftoppm_t *)data;
+					// pdftoppm rendering state
+  char		header[256],		// Header from file
+		*ptr,			// Pointer into header
+		*end;			// End of header
+  unsigned	i,			// Looping var
+		values[4];		// Values from header
+  size_t	bytes,			// Bytes to skip
+		count;			// Bytes to copy/read
 
 
-  va_start(ap, message);
-  vsnprintf(buffer + 1, sizeof(buffer) - 1, message, ap);
-  va_end(ap);
-
-  buffer[0] = error ? 'E' : 'I';
+  // Skip the rest of the current page...
+  if (pp->lines > 0)
+  {
+    bytes = (size_t)pp->lines * pp->linesize;
 
-  cupsArrayAdd(p->errors, buffer);
+#if !_WIN32
+    if (pp->map)
+    {
+      if (bytes > (pp->mapsize - pp->mapoff))
+        pp->mapoff = pp->mapsize;
+      else
+        pp->mapoff += bytes;
+    }
+    else
+#endif // !_WIN32
+    {
+      // Pipes can't seek, so read and discard the remaining lines...
+      while (pp->fp && bytes > 0)
+      {
+        count = bytes > sizeof(header) ? sizeof(header) : bytes;
 
-  if (error)
-    cupsLangPrintf(stderr, _("%s: %s"), Prefix, buffer + 1);
-  else
-    fprintf(stderr, "INFO: %s\n", buffer + 1);
-}
+        if (fread(header, 1, count, pp->fp) != count)
+          break;
 
+        bytes -= count;
+      }
+    }
 
-//
-// 'prepare_number_up()' - Prepare the layout rectangles based on the number-up and orientation-requested values.
-//
+    pp->lines = 0;
+  }
 
-static void
-prepare_number_up(xform_prepare_t *p)	// I - Preparation data
-{
-  size_t	i,			// Looping var
-		cols,			// Number of columns
-		rows;			// Number of rows
-  pdfio_rect_t	*r;			// Current layout rectangle...
-  double	width,			// Width of layout rectangle
-		height;			// Height of layout rectangle
+  if (!pdftoppm_next(pp))
+    return (false);
 
+  // Get the "P5"/"P6" magic, width, height, and maximum value...
+  memset(header, 0, sizeof(header));
 
-  if (!strcmp(p->options->imposition_template, "booklet"))
+#if !_WIN32
+  if (pp->map)
   {
-    // "imposition-template" = 'booklet' forces 2-up output...
-    p->num_layout   = 2;
-    p->layout[0]    = p->media;
-    p->layout[0].y2 = p->media.y2 / 2.0;
-    p->layout[1]    = p->media;
-    p->layout[1].y1 = p->media.y2 / 2.0;
-
-    if (p->options->number_up != 1)
-      prepare_log(p, false, "Ignoring \"number-up\" = '%d'.", p->options->number_up);
+    if ((count = pp->mapsize - pp->mapoff) > (sizeof(header) - 1))
+      count = sizeof(header) - 1;
 
-    return;
+    memcpy(header, pp->map + pp->mapoff, count);
+    end = header + count;
   }
   else
+#endif // !_WIN32
   {
-    p->num_layout = (size_t)p->options->number_up;
+    // Read the three header lines...
+    for (i = 0, end = header; i < 3 && end < (header + sizeof(header) - 1); i ++)
+    {
+      if (!fgets(end, (int)(sizeof(header) - (size_t)(end - header)), pp->fp))
+        break;
+
+      end += strlen(end);
+    }
   }
 
-  // Figure out the number of rows and columns...
-  switch (p->num_layout)
+  ptr = header;
+
+  if ((end - ptr) < 3 || ptr[0] != 'P' || (ptr[1] != '5' && ptr[1] != '6') || ptr[2] != '\n')
   {
-    default : // 1-up or unknown
-	if (p->options->number_up != 1)
-	  prepare_log(p, false, "Ignoring \"number-up\" = '%d'.", p->options->number_up);
+    cupsLangPrintf(stderr, _("%s: Bad page header - <%02X%02X%02X%02X%02X%02X%02X%02X>"), Prefix, header[0] & 255, header[1] & 255, header[2] & 255, header[3] & 255, header[4] & 255, header[5] & 255, header[6] & 255, header[7] & 255);
+    return (false);
+  }
 
-        p->num_layout   = 1;
-        p->layout[0]    = p->crop;
-        return;
+  values[0] = ptr[1] == '5' ? 1 : 3;
 
-    case 2 : // 2-up
-        cols = 1;
-        rows = 2;
-        break;
-    case 4 : // 4-up
-        cols = 2;
-        rows = 2;
-        break;
-    case 6 : // 6-up
-        cols = 2;
-        rows = 3;
-        break;
-    case 9 : // 9-up
-        cols = 3;
-        rows = 3;
-        break;
-    case 12 : // 12-up
-        cols = 3;
-        rows = 4;
-        break;
-    case 16 : // 16-up
-        cols = 4;
-        rows = 4;
-        break;
-  }
+  for (i = 1, ptr += 3; i < 4 && ptr < end; i ++)
+  {
+    // Get the next number...
+    while (ptr < end && isspace(*ptr & 255))
+      ptr ++;
 
-  // Then arrange the page rectangles evenly across the page...
-  width  = (p->crop.x2 - p->crop.x1) / cols;
-  height = (p->crop.y2 - p->crop.y1) / rows;
+    for (values[i] = 0; ptr < end && isdigit(*ptr & 255) && values[i] < 0x40000000; ptr ++)
+      values[i] = values[i] * 10 + (unsigned)(*ptr - '0');
+  }
 
-  switch (p->options->orientation_requested)
+  // The maximum value is followed by a single whitespace character...
+  if (i < 4 || ptr >= end || !isspace(*ptr & 255) || values[1] == 0 || values[1] > 0x10000000 || values[2] == 0 || values[2] > 0x40000000 || values[3] != 255)
   {
-    default : // Portrait or "none"...
-        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
-        {
-          r->x1 = p->crop.x1 + width * (i % cols);
-          r->y1 = p->crop.y1 + height * (rows - 1 - i / cols);
-          r->x2 = r->x1 + width;
-          r->y2 = r->y1 + height;
-        }
-        break;
+    cupsLangPrintf(stderr, _("%s: Bad page dimensions - <%02X%02X%02X%02X%02X%02X%02X%02X>"), Prefix, header[3] & 255, header[4] & 255, header[5] & 255, header[6] & 255, header[7] & 255, header[8] & 255, header[9] & 255, header[10] & 255);
+    return (false);
+  }
 
-    case IPP_ORIENT_LANDSCAPE : // Landscape
-        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
-        {
-          r->x1 = p->crop.x1 + width * (cols - 1 - i / rows);
-          r->y1 = p->crop.y1 + height * (rows - 1 - (i % rows));
-          r->x2 = r->x1 + width;
-          r->y2 = r->y1 + height;
-        }
-        break;
+  ptr ++;
 
-    case IPP_ORIENT_REVERSE_PORTRAIT : // Reverse portrait
-        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
-        {
-          r->x1 = p->crop.x1 + width * (cols - 1 - (i % cols));
-          r->y1 = p->crop.y1 + height * (i / cols);
-          r->x2 = r->x1 + width;
-          r->y2 = r->y1 + height;
-        }
-        break;
+#if !_WIN32
+  if (pp->map)
+    pp->mapoff += (size_t)(ptr - header);
+#endif // !_WIN32
 
-    case IPP_ORIENT_REVERSE_LANDSCAPE : // Reverse landscape
-        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
-        {
-          r->x1 = p->crop.x1 + width * (i / rows);
-          r->y1 = p->crop.y1 + height * (i % rows);
-          r->x2 = r->x1 + width;
-          r->y2 = r->y1 + height;
-        }
-        break;
-  }
+  *bpp         = values[0];
+  *width       = values[1];
+  *height      = values[2];
+  pp->lines    = values[2];
+  pp->linesize = (size_t)values[0] * values[1];
+
+  if (Verbosity)
+    fprintf(stderr, "DEBUG: 'P%c' '%u %u' '255'\n", values[0] == 1 ? '5' : '6', values[1], values[2]);
+
+  return (true);
 }
+#endif // !HAVE_COREGRAPHICS_H
 
 
 //
-// 'prepare_pages()' - Prepare the pages for the output document.
+// 'prepare_documents()' - Prepare one or more documents for printing.
+//
+// This function generates a single PDF file containing the union of the input
+// documents and any job sheets.
 //
 
-static void
-prepare_pages(
-    xform_prepare_t  *p,		// I - Preparation data
-    size_t           num_documents,	// I - Number of documents
-    xform_document_t *documents)	// I - Documents
+static bool				// O - `true` on success, `false` on failure
+prepare_documents(
+    size_t           num_documents,	// I - Number of input documents
+    xform_document_t *documents,	// I - Input documents
+    ipp_options_t    *options,		// I - IPP options
+    const char       *sheet_back,	// I - Back side transform
+    char             *outfile,		// I - Output filename buffer
+    size_t           outsize,		// I - Output filename buffer size
+    const char       *outformat,	// I - Output format
+    unsigned         *outpages,		// O - Number of pages
+    bool             generate_copies)	// I - Generate copies in output PDF?
 {
-  int		page;			// Current page number in output
-  size_t	i,			// Looping var
-		current,		// Current output page index
-		layout;			// Current layout cell
-  xform_page_t	*outpage;		// Current output page
-  xform_document_t *d;			// Current document
-  bool		use_page;		// Use this page?
+  bool			ret = false;	// Return value
+  int			copies;		// Number of copies
+  size_t		i;		// Looping var
+  xform_prepare_t	p;		// Preparation data
+  xform_document_t	*d;		// Current document
+  xform_page_t		*outpage;	// Current output page
+  int			outdir;		// Output direction
+  bool			reverse_order;	// Should output be in reverse order?
+  size_t		layout;		// Layout cell
+  int			document;	// Document number
+  int			page;		// Current page number
+  bool			duplex = !strncmp(options->sides, "two-sided-", 10);
+					// Doing two-sided printing?
 
 
-  if (!strcmp(p->options->imposition_template, "booklet"))
-  {
-    // Booklet printing arranges input pages so that the folded output can be
-    // stapled along the midline...
-    p->num_outpages = (size_t)(p->num_inpages + 1) / 2;
-    if (p->num_outpages & 1)
-      p->num_outpages ++;
+  // Initialize data for preparing input files for transform...
+  memset(&p, 0, sizeof(p));
+  p.options = options;
+  p.errors  = cupsArrayNew(NULL, NULL, NULL, 0, _cupsArrayStrdup, _cupsArrayFree);
 
-    for (current = 0, layout = 0, page = 1, i = num_documents, d = documents; i > 0; i --, d ++)
+  media_to_rect(&options->media, &p.media, &p.crop);
+  prepare_number_up(&p);
+
+  if (!strncmp(options->sides, "two-sided-", 10) && sheet_back && strcmp(sheet_back, "normal"))
+  {
+    // Need to do a transform on the back side of pages...
+    if (!strcmp(sheet_back, "flipped"))
     {
-      while (page <= d->last_page)
+      if (!strcmp(options->sides, "two-sided-short-edge"))
       {
-	if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
-	  use_page = ippOptionsCheckPage(p->options, page - d->first_page + 1);
-	else
-	  use_page = ippOptionsCheckPage(p->options, page);
-
-        if (use_page)
-        {
-	  if (current < p->num_outpages)
-	    outpage = p->outpages + current;
-	  else
-	    outpage = p->outpages + 2 * p->num_outpages - current - 1;
-
-	  outpage->pdf           = p->pdf;
-	  outpage->input[layout] = pdfioFileGetPage(d->pdf, (size_t)(page - d->first_page));
-	  layout = 1 - layout;
-	  current ++;
-	}
-
-        page ++;
+	p.use_duplex_xform   = true;
+        p.duplex_xform[0][0] = -1.0;
+        p.duplex_xform[0][1] = 0.0;
+        p.duplex_xform[1][0] = 0.0;
+        p.duplex_xform[1][1] = 1.0;
+        p.duplex_xform[2][0] = p.media.x2;
+        p.duplex_xform[2][1] = 0.0;
       }
-
-      if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
-        page = 1;
+      else
+      {
+	p.use_duplex_xform   = true;
+        p.duplex_xform[0][0] = 1.0;
+        p.duplex_xform[0][1] = 0.0;
+        p.duplex_xform[1][0] = 0.0;
+        p.duplex_xform[1][1] = -1.0;
+        p.duplex_xform[2][0] = 0.0;
+        p.duplex_xform[2][1] = p.media.y2;
+      }
+    }
+    else if ((!strcmp(sheet_back, "manual-tumble") && !strcmp(options->sides, "two-sided-short-edge")) || (!strcmp(sheet_back, "rotated") && !strcmp(options->sides, "two-sided-long-edge")))
+    {
+      p.use_duplex_xform   = true;
+      p.duplex_xform[0][0] = -1.0;
+      p.duplex_xform[0][1] = 0.0;
+      p.duplex_xform[1][0] = 0.0;
+      p.duplex_xform[1][1] = -1.0;
+      p.duplex_xform[2][0] = p.media.x2;
+      p.duplex_xform[2][1] = p.media.y2;
     }
   }
-  else
+
+  if ((p.pdf = pdfioFileCreateTemporary(outfile, outsize, "1.7", &p.media, &p.media, pdfio_error_cb, &p)) == NULL)
+    return (false);
+
+  // Loop through the input documents to count pages, etc.
+  for (i = num_documents, d = documents, document = 1, page = 1; i > 0; i --, d ++, document ++)
   {
-    // Normal printing lays out N input pages on each output page...
-    for (current = 0, outpage = p->outpages, layout = 0, page = 1, i = num_documents, d = documents; i > 0; i --, d ++)
+    if (Verbosity)
+      fprintf(stderr, "DEBUG: Preparing document %d: '%s' (%s)\n", document, d->filename, d->format);
+
+    if (!strcmp(d->format, "application/pdf"))
     {
-      while (page <= d->last_page)
-      {
-	if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
-	  use_page = ippOptionsCheckPage(p->options, page - d->first_page + 1);
-	else
-	  use_page = ippOptionsCheckPage(p->options, page);
+      // PDF file...
+      d->pdf_filename = d->filename;
+    }
+    else if (!strcmp(d->format, "image/jpeg") || !strcmp(d->format, "image/png"))
+    {
+      // JPEG or PNG image...
+      if (!convert_image(&p, d, document))
+        goto done;
+    }
+    else if (!strcmp(d->format, "text/plain"))
+    {
+      // Plain text file...
+      if (!convert_text(&p, d, document))
+        goto done;
+    }
+    else
+    {
+      // PWG or Apple raster file...
+      if (!convert_raster(&p, d, document))
+        goto done;
+    }
 
-        if (use_page)
-        {
-          outpage->pdf           = p->pdf;
-          outpage->input[layout] = pdfioFileGetPage(d->pdf, (size_t)(page - d->first_page));
+    if (Verbosity)
+      fprintf(stderr, "DEBUG: Opening prepared document %d: '%s'.\n", document, d->pdf_filename);
 
-          if (Verbosity)
-	    fprintf(stderr, "DEBUG: Using page %d (%p) of document %d, cell=%u/%u, current=%u\n", page, (void *)outpage->input[layout], (int)(d - documents + 1), (unsigned)layout + 1, (unsigned)p->num_layout, (unsigned)current);
+    if ((d->pdf = pdfioFileOpen(d->pdf_filename, pdfio_password_cb, &document, pdfio_error_cb, &p)) == NULL)
+      goto done;
 
-          layout ++;
-          if (layout == p->num_layout)
-          {
-            current ++;
-            outpage ++;
-            layout = 0;
-          }
-        }
+    if (options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
+    {
+      d->first_page = 1;
+      d->last_page  = (int)pdfioFileGetNumPages(d->pdf);
+    }
+    else
+    {
+      d->first_page = page;
+      d->last_page  = page + (int)pdfioFileGetNumPages(d->pdf) - 1;
+    }
 
-        page ++;
-      }
+    if (Verbosity)
+      fprintf(stderr, "DEBUG: Document %d: pages %d to %d.\n", document, d->first_page, d->last_page);
 
-      if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
+    while (page <= d->last_page)
+    {
+      if (options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
       {
-        page = 1;
-
-        if (layout)
-        {
-	  current ++;
-	  outpage ++;
-	  layout = 0;
-        }
+        if (ippOptionsCheckPage(options, page - d->first_page + 1))
+          d->num_pages ++;
       }
-      else if (p->options->multiple_document_handling == IPPOPT_HANDLING_SINGLE_NEW_SHEET && (current & 1))
+      else if (ippOptionsCheckPage(options, page))
       {
-	current ++;
-	outpage ++;
-	layout = 0;
+        d->num_pages ++;
       }
+
+      page ++;
     }
 
-    if (layout)
-      current ++;
+    if ((d->last_page & 1) && duplex && options->multiple_document_handling != IPPOPT_HANDLING_SINGLE_DOCUMENT)
+    {
+      d->last_page ++;
+      page ++;
+    }
 
-    p->num_outpages = current;
+    if ((d->num_pages & 1) && duplex && options->multiple_document_handling != IPPOPT_HANDLING_SINGLE_DOCUMENT)
+      d->num_pages ++;
+
+    p.num_inpages += d->num_pages;
   }
-}
 
+  // When doing N-up or booklet printing, the default is to scale to fit unless
+  // fill is explicitly chosen...
+  if (p.num_layout > 1 && options->print_scaling != IPPOPT_SCALING_FILL)
+    options->print_scaling = IPPOPT_SCALING_FIT;
 
-//
-// 'raster_end_job()' - End a raster "job".
-//
+  // Prepare output pages...
+  prepare_pages(&p, num_documents, documents);
 
-static void
-raster_end_job(xform_raster_t   *ras,	// I - Raster information
-	       xform_write_cb_t cb,	// I - Write callback
-	       void             *ctx)	// I - Write context
-{
-  (void)cb;
-  (void)ctx;
+  // Add job-sheets content...
+  if (options->job_sheets[0] && strcmp(options->job_sheets, "none"))
+    generate_job_sheets(&p);
 
-  cupsRasterClose(ras->ras);
-}
+  // Copy pages to the output file...
+  for (copies = generate_copies ? options->copies : 1; copies > 0; copies --)
+  {
+    reverse_order = !strcmp(options->output_bin, "face-up");
+    if (options->page_delivery >= IPPOPT_DELIVERY_REVERSE_ORDER_FACE_DOWN)
+      reverse_order = !reverse_order;
 
+    if (reverse_order)
+    {
+      outpage = p.outpages + p.num_outpages - 1;
+      outdir  = -1;
+    }
+    else
+    {
+      outpage = p.outpages;
+      outdir  = 1;
+    }
 
-//
-// 'raster_end_page()' - End of raster page.
-//
-
-static void
-raster_end_page(xform_raster_t   *ras,	// I - Raster information
-	        unsigned         page,	// I - Current page
-		xform_write_cb_t cb,	// I - Write callback
-		void             *ctx)	// I - Write context
-{
-  (void)ras;
-  (void)page;
-  (void)cb;
-  (void)ctx;
-}
+    if (p.num_layout == 1 && strcasecmp(outformat, "image/pwg-raster") && strcasecmp(outformat, "image/urf"))
+    {
+      // Simple path - no layout of pages so we can usually just copy the pages quickly.
+      if (Verbosity)
+	fputs("DEBUG: Doing fast copy of pages.\n", stderr);
 
+      for (i = p.num_outpages; i > 0; i --, outpage += outdir)
+      {
+	if (outpage->input[0])
+	{
+          ippopt_scaling_t scaling = options->print_scaling;
+					// Scaling needed, if any
 
-//
-// 'raster_init()' - Initialize callbacks for raster output.
-//
+          if (scaling == IPPOPT_SCALING_AUTO || scaling == IPPOPT_SCALING_AUTO_FIT)
+          {
+            // Default to no scaling for "auto" and "auto-fit"...
+            scaling = IPPOPT_SCALING_NONE;
 
-static void
-raster_init(xform_raster_t *ras)	// I - Raster information
-{
-  ras->end_job    = raster_end_job;
-  ras->end_page   = raster_end_page;
-  ras->start_job  = raster_start_job;
-  ras->start_page = raster_start_page;
-  ras->write_line = raster_write_line;
-}
+	    if (options->media_specified)
+	    {
+	      // When media is specified, see if this page needs to be scaled...
+	      pdfio_rect_t media_box;	// MediaBox for the page
+	      int	media_width,	// Media width in hundredths of millimeters
+			media_length;	// Media length in hundredths of millimeters
 
+	      if (pdfioDictGetRect(pdfioObjGetDict(outpage->input[0]), "MediaBox", &media_box))
+	      {
+		// Got the MediaBox so get the portrait dimensions and compare...
+		if (media_box.x2 > media_box.y2)
+		{
+		  media_width  = (int)(2540.0 * media_box.y2 / 72.0);
+		  media_length = (int)(2540.0 * media_box.x2 / 72.0);
+		}
+		else
+		{
+		  media_width  = (int)(2540.0 * media_box.x2 / 72.0);
+		  media_length = (int)(2540.0 * media_box.y2 / 72.0);
+		}
 
-//
-// 'raster_start_job()' - Start a raster "job".
-//
+		if (media_width != options->media.width || media_length != options->media.length)
+		  scaling = IPPOPT_SCALING_FIT;
+	      }
+	    }
+	  }
 
-static bool				// O - `true` on success, `false` on error
-raster_start_job(xform_raster_t   *ras,	// I - Raster information
-		 xform_write_cb_t cb,	// I - Write callback
-		 void             *ctx)	// I - Write context
-{
-  ras->ras = cupsRasterOpenIO((cups_raster_cb_t)cb, ctx, !strcmp(ras->format, "image/pwg-raster") ? CUPS_RASTER_WRITE_PWG : CUPS_RASTER_WRITE_APPLE);
+	  if (scaling == IPPOPT_SCALING_NONE)
+	  {
+	    // Do a fast copy of the page with the original media size...
+	    pdfioPageCopy(p.pdf, outpage->input[0]);
+	  }
+	  else
+	  {
+	    // Scale to fit/fill...
+	    if (Verbosity)
+	      fprintf(stderr, "DEBUG: Scaling page %u/%u.\n", (unsigned)(outpage - p.outpages + 1), (unsigned)p.num_outpages);
 
-  return (ras->ras != NULL);
-}
+	    // Create the page dictionary using the source page's resources...
+	    outpage->pagedict = pdfioDictCreate(p.pdf);
+	    outpage->resdict  = pdfioDictCopy(p.pdf, pdfioDictGetDict(pdfioObjGetDict(outpage->input[0]), "Resources"));
+	    outpage->annots   = pdfioArrayCopy(p.pdf, pdfioDictGetArray(pdfioObjGetDict(outpage->input[0]), "Annots"));
 
+	    pdfioDictSetRect(outpage->pagedict, "CropBox", &p.media);
+	    pdfioDictSetRect(outpage->pagedict, "MediaBox", &p.media);
+	    pdfioDictSetDict(outpage->pagedict, "Resources", outpage->resdict);
+	    pdfioDictSetArray(outpage->pagedict, "Annots", outpage->annots);
+	    pdfioDictSetName(outpage->pagedict, "Type", "Page");
 
-//
-// 'raster_start_page()' - Start a raster page.
-//
+	    // Now copy the content stream to build the page...
+	    outpage->output = pdfio_start_page(&p, outpage->pagedict);
 
-static bool				// O - `true` on success, `false` on failure
-raster_start_page(xform_raster_t   *ras,// I - Raster information
-		  unsigned         page,// I - Current page
-		  xform_write_cb_t cb,	// I - Write callback
-		  void             *ctx)// I - Write context
-{
-  (void)cb;
-  (void)ctx;
+	    copy_page(&p, outpage, /*layout*/0);
 
-  ras->left   = 0;
-  ras->top    = 0;
-  ras->right  = ras->header.cupsWidth;
-  ras->bottom = ras->header.cupsHeight;
+	    pdfio_end_page(&p, outpage->output);
+	    outpage->output = NULL;
+	  }
+	}
+      }
+    }
+    else
+    {
+      // Layout path - merge page resources and do mapping of resources as needed
+      if (Verbosity)
+	fprintf(stderr, "DEBUG: Doing full layout of %u pages.\n", (unsigned)p.num_outpages);
 
-  if (ras->header.Duplex && !(page & 1))
-    return (cupsRasterWriteHeader(ras->ras, &ras->back_header));
-  else
-    return (cupsRasterWriteHeader(ras->ras, &ras->header));
-}
+      for (i = p.num_outpages; i > 0; i --, outpage += outdir)
+      {
+	// Create a page dictionary that merges the resources from each of the
+	// input pages...
+	if (Verbosity)
+	  fprintf(stderr, "DEBUG: Laying out page %u/%u.\n", (unsigned)(outpage - p.outpages + 1), (unsigned)p.num_outpages);
 
+	outpage->pagedict = pdfioDictCreate(p.pdf);
+	outpage->resdict  = pdfioDictCreate(p.pdf);
 
-//
-// 'raster_write_line()' - Write a line of raster data.
-//
+	pdfioDictSetRect(outpage->pagedict, "CropBox", &p.media);
+	pdfioDictSetRect(outpage->pagedict, "MediaBox", &p.media);
+	pdfioDictSetDict(outpage->pagedict, "Resources", outpage->resdict);
+	pdfioDictSetName(outpage->pagedict, "Type", "Page");
 
-static void
-raster_write_line(
-    xform_raster_t      *ras,		// I - Raster information
-    unsigned            y,		// I - Line number
-    const unsigned char *line,		// I - Pixels on line
-    xform_write_cb_t    cb,		// I - Write callback
-    void                *ctx)		// I - Write context
-{
-  (void)y;
-  (void)cb;
-  (void)ctx;
+	for (layout = 0; layout < p.num_layout; layout ++)
+	{
+	  pdfio_dict_t	*pagedict,	// Page dictionary
+			*resdict;	// Resources dictionary
+	  pdfio_obj_t	*resobj;	// Resources object
 
-  cupsRasterWritePixels(ras->ras, (unsigned char *)line, ras->out_length);
-}
+	  if (!outpage->input[layout])
+	    continue;
 
+	  outpage->layout  = layout;
+	  outpage->restype = NULL;
 
-//
-// 'resource_dict_cb()' - Merge resource dictionaries from multiple input pages.
-//
-// This function detects resource conflicts and maps conflicting names as
-// needed.
-//
+          pagedict = pdfioObjGetDict(outpage->input[layout]);
+          if ((resdict = pdfioDictGetDict(pagedict, "Resources")) != NULL)
+	    pdfioDictIterateKeys(resdict, (pdfio_dict_cb_t)page_dict_cb, outpage);
+	  else if ((resobj = pdfioDictGetObj(pagedict, "Resources")) != NULL)
+	    pdfioDictIterateKeys(pdfioObjGetDict(resobj), (pdfio_dict_cb_t)page_dict_cb, outpage);
+          else if (Verbosity)
+            fprintf(stderr, "DEBUG: No Resources for cell %u.\n", (unsigned)layout);
 
-static bool
-resource_dict_cb(
-    pdfio_dict_t *dict,			// I - Dictionary
-    const char   *key,			// I - Dictionary key
-    xform_page_t *outpage)		// I - Output page
-{
-  pdfio_array_t	*arrayval;		// Array value
-  pdfio_dict_t	*dictval;		// Dictionary value
-  const char	*nameval,		// Name value
-		*curname;		// Current name value
-  pdfio_obj_t	*objval;		// Object value
-  char		mapname[256];		// Mapped resource name
+	  // TODO: Handle inherited resources from parent page objects...
+	}
 
+	// Now copy the content streams to build the composite page, using the
+	// resource map for any named resources...
+	outpage->output = pdfio_start_page(&p, outpage->pagedict);
 
-  fprintf(stderr, "DEBUG: resource_dict_cb(dict=%p, key=\"%s\", outpage=%p)\n", (void *)dict, key, (void *)outpage);
+	for (layout = 0; layout < p.num_layout; layout ++)
+	  copy_page(&p, outpage, layout);
 
-  snprintf(mapname, sizeof(mapname), "%c%s", (int)('a' + outpage->layout), key);
+	pdfio_end_page(&p, outpage->output);
+	outpage->output = NULL;
+      }
+    }
+  }
 
-  switch (pdfioDictGetType(dict, key))
-  {
-    case PDFIO_VALTYPE_ARRAY : // Array
-        arrayval = pdfioDictGetArray(dict, key);
-        if (pdfioDictGetArray(outpage->restype, key))
-        {
-	  if (!outpage->resmap[outpage->layout])
-	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
+  // Add final job-sheets content...
+  if (options->job_sheets[0] && strcmp(options->job_sheets, "none"))
+    generate_job_sheets(&p);
 
-	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
-	  key = mapname;
-	}
+  // Add job-error-sheet content as needed...
+  if (options->job_error_sheet.report == IPPOPT_ERROR_REPORT_ALWAYS || (options->job_error_sheet.report == IPPOPT_ERROR_REPORT_ON_ERROR && cupsArrayGetCount(p.errors) > 0))
+    generate_job_error_sheet(&p);
 
-        pdfioDictSetArray(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioArrayCopy(outpage->pdf, arrayval));
-        break;
+  ret = true;
 
-    case PDFIO_VALTYPE_DICT : // Dictionary
-        dictval = pdfioDictGetDict(dict, key);
-        if (pdfioDictGetDict(outpage->restype, key))
-        {
-	  if (!outpage->resmap[outpage->layout])
-	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
+  *outpages = (unsigned)pdfioFileGetNumPages(p.pdf);
 
-	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
-	  key = mapname;
-	}
+  // Finalize the output and return...
+  done:
 
-        pdfioDictSetDict(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioDictCopy(outpage->pdf, dictval));
-        break;
+  cupsArrayDelete(p.errors);
 
-    case PDFIO_VALTYPE_NAME : // Name
-        nameval = pdfioDictGetName(dict, key);
-        if ((curname = pdfioDictGetName(outpage->restype, key)) != NULL)
-        {
-          if (!strcmp(nameval, curname))
-            break;
+  for (i = p.num_outpages, outpage = p.outpages; i > 0; i --, outpage ++)
+  {
+    if (outpage->output)
+      pdfioStreamClose(outpage->output);
+  }
 
-	  if (!outpage->resmap[outpage->layout])
-	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
+  if (!pdfioFileClose(p.pdf))
+    ret = false;
 
-	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
-	  key = mapname;
-	}
+  if (!ret)
+  {
+    // Remove temporary file...
+    unlink(outfile);
+    *outfile = '\0';
+  }
 
-        pdfioDictSetName(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, nameval));
-        break;
-
-    case PDFIO_VALTYPE_INDIRECT : // Object reference
-        objval = pdfioDictGetObj(dict, key);
-        if (pdfioDictGetObj(outpage->restype, key))
-        {
-	  if (!outpage->resmap[outpage->layout])
-	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
-
-	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
-	  key = mapname;
-	}
-
-        pdfioDictSetObj(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioObjCopy(outpage->pdf, objval));
-        break;
-
-    default :
-        break;
+  // Close and delete intermediate files...
+  for (i = num_documents, d = documents; i > 0; i --, d ++)
+  {
+    pdfioFileClose(d->pdf);
+    if (d->tempfile[0])
+      unlink(d->tempfile);
   }
 
-  return (true);
+  // Return success/fail status...
+  return (ret);
 }
 
 
 //
-// 'show_aligned()' - Show a string that is left, center, or right aligned.
+// 'prepare_image()' - Compute the position and rotation of an image.
+//
+// The returned rotation is 0 for portrait, 1 for landscape, 2 for reverse
+// portrait, and 3 for reverse landscape.
 //
 
-static bool				// O - `true` on success, `false` on error
-show_aligned(
-    pdfio_stream_t *st,			// I - Page stream
-    pdfio_obj_t    *font,		// I - Font
-    double         fsize,		// I - Font size
-    bool           unicode,		// I - Unicode font?
-    double         x,			// I - X position on page
-    double         y,			// I - Y position on page
-    int            align,		// I - Alignment: -1 for right, 0 for center, 1 for left
-    const char     *s)			// I - String to show
+static int				// O - Image rotation (0 to 3)
+prepare_image(ipp_options_t *options,	// I - IPP options
+              pdfio_rect_t  *crop,	// I - Crop box
+              double        iw,		// I - Image width in pixels
+              double        ih,		// I - Image height in pixels
+              pdfio_rect_t  *rect)	// O - Image rectangle
 {
-  // Adjust X for alignment...
-  if (align <= 0)
+  double	x, y, w, h;		// Image rectangle
+  double	cx, cy, cw, ch;		// Crop box rectangle
+  int		irot;			// Image rotation
+  double	ratio;			// Scaling factor for image
+  ippopt_scaling_t scaling;		// Actual print-scaling to use
+
+
+  cx = crop->x1;
+  cy = crop->y1;
+  cw = crop->x2 - cx;
+  ch = crop->y2 - cy;
+
+  switch (options->image_orientation)
   {
-    double width = pdfioContentTextMeasure(font, s, fsize);
-					// Width of string
+    case IPP_ORIENT_PORTRAIT :
+        irot = 0;
+        break;
+    case IPP_ORIENT_LANDSCAPE :
+        irot = 1;
+        break;
+    case IPP_ORIENT_REVERSE_PORTRAIT :
+        irot = 2;
+        break;
+    case IPP_ORIENT_REVERSE_LANDSCAPE :
+        irot = 3;
+        break;
+    case IPP_ORIENT_NONE : // Auto
+        if ((iw > ih && cw < ch) || (iw < ih && cw > ch))
+          irot = 3;
+	else
+	  irot = 0;
+	break;
+  }
 
-    if (align < 0)
-      x -= width;
+  if (options->print_scaling == IPPOPT_SCALING_AUTO)
+  {
+    if (irot & 1)
+    {
+      if (iw > ch || ih > cw)
+      {
+        if (cx == 0.0 && cy == 0.0)
+          scaling = IPPOPT_SCALING_FIT;
+	else
+	  scaling = IPPOPT_SCALING_FILL;
+      }
+      else
+      {
+        scaling = IPPOPT_SCALING_NONE;
+      }
+    }
     else
-      x -= 0.5 * width;
+    {
+      if (iw > cw || ih > ch)
+      {
+        if (cx == 0.0 && cy == 0.0)
+          scaling = IPPOPT_SCALING_FIT;
+	else
+	  scaling = IPPOPT_SCALING_FILL;
+      }
+      else
+      {
+        scaling = IPPOPT_SCALING_NONE;
+      }
+    }
+  }
+  else if (options->print_scaling == IPPOPT_SCALING_AUTO_FIT)
+  {
+    if (irot & 1)
+    {
+      if (iw > ch || ih > cw)
+	scaling = IPPOPT_SCALING_FIT;
+      else
+        scaling = IPPOPT_SCALING_NONE;
+    }
+    else
+    {
+      if (iw > cw || ih > ch)
+	scaling = IPPOPT_SCALING_FIT;
+      else
+        scaling = IPPOPT_SCALING_NONE;
+    }
+  }
+  else
+  {
+    scaling = options->print_scaling;
   }
 
-  return (pdfioContentTextBegin(st) && pdfioContentTextMoveTo(st, x, y) && pdfioContentTextShow(st, unicode, s) && pdfioContentTextEnd(st));
+  if (scaling == IPPOPT_SCALING_NONE)
+  {
+    // No scaling...
+    ratio = 1.0;
+  }
+  else
+  {
+    if (irot & 1)
+      ratio = ch / iw;
+    else
+      ratio = cw / iw;
+
+    if (scaling == IPPOPT_SCALING_FIT)
+    {
+      // Scale to fit...
+      if (irot & 1)
+      {
+        if ((ih * ratio) > cw)
+          ratio = cw / ih;
+      }
+      else
+      {
+        if ((ih * ratio) > ch)
+          ratio = ch / ih;
+      }
+    }
+    else
+    {
+      // Scale to fill...
+      if (irot & 1)
+      {
+        if ((ih * ratio) < cw)
+          ratio = cw / ih;
+      }
+      else
+      {
+        if ((ih * ratio) < ch)
+          ratio = ch / ih;
+      }
+    }
+  }
+
+  if (irot & 1)
+  {
+    w = ih * ratio;
+    h = iw * ratio;
+  }
+  else
+  {
+    w = iw * ratio;
+    h = ih * ratio;
+  }
+
+  switch (options->x_image_position)
+  {
+    case IPPOPT_IMGPOS_NONE :
+        x = cx;
+        break;
+    case IPPOPT_IMGPOS_CENTER :
+        x = cx + (cw - w - 72.0 * options->x_side1_image_shift / 2540.0) / 2.0;
+        break;
+    case IPPOPT_IMGPOS_BOTTOM_LEFT :
+        x = cx + 72.0 * options->x_side1_image_shift / 2540.0;
+        break;
+    case IPPOPT_IMGPOS_TOP_RIGHT :
+        x = cx + cw - w - 72.0 * options->x_side1_image_shift / 2540.0;
+        break;
+  }
+
+  switch (options->y_image_position)
+  {
+    case IPPOPT_IMGPOS_NONE :
+        y = cy;
+        break;
+    case IPPOPT_IMGPOS_CENTER :
+        y = cy + (ch - h - 72.0 * options->y_side1_image_shift / 2540.0) / 2.0;
+        break;
+    case IPPOPT_IMGPOS_BOTTOM_LEFT :
+        y = cy + 72.0 * options->y_side1_image_shift / 2540.0;
+        break;
+    case IPPOPT_IMGPOS_TOP_RIGHT :
+        y = cy + ch - h - 72.0 * options->y_side1_image_shift / 2540.0;
+        break;
+  }
+
+  rect->x1 = x;
+  rect->y1 = y;
+  rect->x2 = x + w;
+  rect->y2 = y + h;
+
+  return (irot);
 }
 
 
 //
-// 'show_label_and_value()' - Show a label and value aligned along a given central point.
+// 'prepare_log()' - Log an informational or error message while preparing
+//                   documents for printing.
 //
 
-static bool				// O - `true` on success, `false` on error
-show_label_and_value(
-    pdfio_stream_t *st,			// I - Page stream
-    pdfio_obj_t    *font,		// I - Font
-    double         fsize,		// I - Font size
-    bool           unicode,		// I - Unicode font?
-    double         x,			// I - Center X position on page
-    double         y,			// I - Y position on page
-    cups_lang_t    *lang,		// I - Language
-    bool           rtl,			// I - `true` for right-to-left presentation
-    const char     *label,		// I - Label string
-    const char     *value)		// I - Value string
+static void
+prepare_log(xform_prepare_t *p,		// I - Preparation data
+            bool            error,	// I - `true` for error, `false` for info
+	    const char      *message,	// I - Printf-style message string
+	    ...)			// I - Addition arguments as needed
 {
-  // Get the localized string for the label...
-  label = cupsLangGetString(lang, label);
+  va_list	ap;			// Argument pointer
+  char		buffer[1024];		// Output buffer
 
-  // Draw the left/right strings and return...
-  return (show_aligned(st, font, fsize, unicode, x - fsize / 3.0, y, -1, rtl ? value : label) && show_aligned(st, font, fsize, unicode, x + fsize / 3.0, y, 1, rtl ? label : value));
+
+  va_start(ap, message);
+  vsnprintf(buffer + 1, sizeof(buffer) - 1, message, ap);
+  va_end(ap);
+
+  buffer[0] = error ? 'E' : 'I';
+
+  cupsArrayAdd(p->errors, buffer);
+
+  if (error)
+    cupsLangPrintf(stderr, _("%s: %s"), Prefix, buffer + 1);
+  else
+    fprintf(stderr, "INFO: %s\n", buffer + 1);
 }
 
 
 //
-// 'usage()' - Show program usage.
+// 'prepare_number_up()' - Prepare the layout rectangles based on the number-up and orientation-requested values.
 //
 
-static int				// O - Exit status
-usage(FILE *out)			// I - Output file
+static void
+prepare_number_up(xform_prepare_t *p)	// I - Preparation data
 {
-  cupsLangPuts(out, _("Usage: ipptransform [OPTIONS] FILENAME [ ... FILENAME]"));
-  fputs("\n", out);
-  cupsLangPuts(out, _("Options:"));
-  cupsLangPuts(out, _("--help                         Show this help"));
-  cupsLangPuts(out, _("--version                      Show the program version"));
-  cupsLangPuts(out, _("-d DEVICE-URI                  Specify the output device"));
-  cupsLangPuts(out, _("-f OUTPUT-FILENAME             Specify the output file"));
-  cupsLangPuts(out, _("-i INPUT/FORMAT                Specify the input format"));
-  cupsLangPuts(out, _("-m OUTPUT/FORMAT               Specify the output format"));
-  cupsLangPuts(out, _("-o NAME=VALUE                  Specify named options"));
-  cupsLangPuts(out, _("-r RESOLUTION[,...]            Specify supported resolutions"));
-  cupsLangPuts(out, _("-s SHEET-BACK                  Specify back side transform"));
+  size_t	i,			// Looping var
+		cols,			// Number of columns
+		rows;			// Number of rows
+  pdfio_rect_t	*r;			// Current layout rectangle...
+  double	width,			// Width of layout rectangle
+		height;			// Height of layout rectangle
+
+
+  if (!strcmp(p->options->imposition_template, "booklet"))
+  {
+    // "imposition-template" = 'booklet' forces 2-up output...
+    p->num_layout   = 2;
+    p->layout[0]    = p->media;
+    p->layout[0].y2 = p->media.y2 / 2.0;
+    p->layout[1]    = p->media;
+    p->layout[1].y1 = p->media.y2 / 2.0;
+
+    if (p->options->number_up != 1)
+      prepare_log(p, false, "Ignoring \"number-up\" = '%d'.", p->options->number_up);
+
+    return;
+  }
+  else
+  {
+    p->num_layout = (size_t)p->options->number_up;
+  }
+
+  // Figure out the number of rows and columns...
+  switch (p->num_layout)
+  {
+    default : // 1-up or unknown
+	if (p->options->number_up != 1)
+	  prepare_log(p, false, "Ignoring \"number-up\" = '%d'.", p->options->number_up);
+
+        p->num_layout   = 1;
+        p->layout[0]    = p->crop;
+        return;
+
+    case 2 : // 2-up
+        cols = 1;
+        rows = 2;
+        break;
+    case 4 : // 4-up
+        cols = 2;
+        rows = 2;
+        break;
+    case 6 : // 6-up
+        cols = 2;
+        rows = 3;
+        break;
+    case 9 : // 9-up
+        cols = 3;
+        rows = 3;
+        break;
+    case 12 : // 12-up
+        cols = 3;
+        rows = 4;
+        break;
+    case 16 : // 16-up
+        cols = 4;
+        rows = 4;
+        break;
+  }
+
+  // Then arrange the page rectangles evenly across the page...
+  width  = (p->crop.x2 - p->crop.x1) / cols;
+  height = (p->crop.y2 - p->crop.y1) / rows;
+
+  switch (p->options->orientation_requested)
+  {
+    default : // Portrait or "none"...
+        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
+        {
+          r->x1 = p->crop.x1 + width * (i % cols);
+          r->y1 = p->crop.y1 + height * (rows - 1 - i / cols);
+          r->x2 = r->x1 + width;
+          r->y2 = r->y1 + height;
+        }
+        break;
+
+    case IPP_ORIENT_LANDSCAPE : // Landscape
+        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
+        {
+          r->x1 = p->crop.x1 + width * (cols - 1 - i / rows);
+          r->y1 = p->crop.y1 + height * (rows - 1 - (i % rows));
+          r->x2 = r->x1 + width;
+          r->y2 = r->y1 + height;
+        }
+        break;
+
+    case IPP_ORIENT_REVERSE_PORTRAIT : // Reverse portrait
+        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
+        {
+          r->x1 = p->crop.x1 + width * (cols - 1 - (i % cols));
+          r->y1 = p->crop.y1 + height * (i / cols);
+          r->x2 = r->x1 + width;
+          r->y2 = r->y1 + height;
+        }
+        break;
+
+    case IPP_ORIENT_REVERSE_LANDSCAPE : // Reverse landscape
+        for (i = 0, r = p->layout; i < p->num_layout; i ++, r ++)
+        {
+          r->x1 = p->crop.x1 + width * (i / rows);
+          r->y1 = p->crop.y1 + height * (i % rows);
+          r->x2 = r->x1 + width;
+          r->y2 = r->y1 + height;
+        }
+        break;
+  }
+}
+
+
+//
+// 'prepare_pages()' - Prepare the pages for the output document.
+//
+
+static void
+prepare_pages(
+    xform_prepare_t  *p,		// I - Preparation data
+    size_t           num_documents,	// I - Number of documents
+    xform_document_t *documents)	// I - Documents
+{
+  int		page;			// Current page number in output
+  size_t	i,			// Looping var
+		current,		// Current output page index
+		layout;			// Current layout cell
+  xform_page_t	*outpage;		// Current output page
+  xform_document_t *d;			// Current document
+  bool		use_page;		// Use this page?
+
+
+  if (!strcmp(p->options->imposition_template, "booklet"))
+  {
+    // Booklet printing arranges input pages so that the folded output can be
+    // stapled along the midline...
+    p->num_outpages = (size_t)(p->num_inpages + 1) / 2;
+    if (p->num_outpages & 1)
+      p->num_outpages ++;
+
+    for (current = 0, layout = 0, page = 1, i = num_documents, d = documents; i > 0; i --, d ++)
+    {
+      while (page <= d->last_page)
+      {
+	if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
+	  use_page = ippOptionsCheckPage(p->options, page - d->first_page + 1);
+	else
+	  use_page = ippOptionsCheckPage(p->options, page);
+
+        if (use_page)
+        {
+	  if (current < p->num_outpages)
+	    outpage = p->outpages + current;
+	  else
+	    outpage = p->outpages + 2 * p->num_outpages - current - 1;
+
+	  outpage->pdf           = p->pdf;
+	  outpage->input[layout] = pdfioFileGetPage(d->pdf, (size_t)(page - d->first_page));
+	  layout = 1 - layout;
+	  current ++;
+	}
+
+        page ++;
+      }
+
+      if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
+        page = 1;
+    }
+  }
+  else
+  {
+    // Normal printing lays out N input pages on each output page...
+    for (current = 0, outpage = p->outpages, layout = 0, page = 1, i = num_documents, d = documents; i > 0; i --, d ++)
+    {
+      while (page <= d->last_page)
+      {
+	if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
+	  use_page = ippOptionsCheckPage(p->options, page - d->first_page + 1);
+	else
+	  use_page = ippOptionsCheckPage(p->options, page);
+
+        if (use_page)
+        {
+          outpage->pdf           = p->pdf;
+          outpage->input[layout] = pdfioFileGetPage(d->pdf, (size_t)(page - d->first_page));
+
+          if (Verbosity)
+	    fprintf(stderr, "DEBUG: Using page %d (%p) of document %d, cell=%u/%u, current=%u\n", page, (void *)outpage->input[layout], (int)(d - documents + 1), (unsigned)layout + 1, (unsigned)p->num_layout, (unsigned)current);
+
+          layout ++;
+          if (layout == p->num_layout)
+          {
+            current ++;
+            outpage ++;
+            layout = 0;
+          }
+        }
+
+        page ++;
+      }
+
+      if (p->options->multiple_document_handling < IPPOPT_HANDLING_SINGLE_DOCUMENT)
+      {
+        page = 1;
+
+        if (layout)
+        {
+	  current ++;
+	  outpage ++;
+	  layout = 0;
+        }
+      }
+      else if (p->options->multiple_document_handling == IPPOPT_HANDLING_SINGLE_NEW_SHEET && (current & 1))
+      {
+	current ++;
+	outpage ++;
+	layout = 0;
+      }
+    }
+
+    if (layout)
+      current ++;
+
+    p->num_outpages = current;
+  }
+}
+
+
+//
+// 'raster_end_job()' - End a raster "job".
+//
+
+static void
+raster_end_job(xform_raster_t   *ras,	// I - Raster information
+	       xform_write_cb_t cb,	// I - Write callback
+	       void             *ctx)	// I - Write context
+{
+  (void)cb;
+  (void)ctx;
+
+  cupsRasterClose(ras->ras);
+}
+
+
+//
+// 'raster_end_page()' - End of raster page.
+//
+
+static bool				// O - `true` on success, `false` on failure
+raster_end_page(xform_raster_t   *ras,	// I - Raster information
+	        unsigned         page,	// I - Current page
+		xform_write_cb_t cb,	// I - Write callback
+		void             *ctx)	// I - Write context
+{
+  (void)ras;
+  (void)page;
+  (void)cb;
+  (void)ctx;
+
+  return (true);
+}
+
+
+//
+// 'raster_init()' - Initialize callbacks for raster output.
+//
+
+static void
+raster_init(xform_raster_t *ras)	// I - Raster information
+{
+  ras->end_job    = raster_end_job;
+  ras->end_page   = raster_end_page;
+  ras->start_job  = raster_start_job;
+  ras->start_page = raster_start_page;
+  ras->write_line = raster_write_line;
+}
+
+
+//
+// 'raster_start_job()' - Start a raster "job".
+//
+
+static bool				// O - `true` on success, `false` on error
+raster_start_job(xform_raster_t   *ras,	// I - Raster information
+		 xform_write_cb_t cb,	// I - Write callback
+		 void             *ctx)	// I - Write context
+{
+  ras->ras = cupsRasterOpenIO((cups_raster_cb_t)cb, ctx, !strcmp(ras->format, "image/pwg-raster") ? CUPS_RASTER_WRITE_PWG : CUPS_RASTER_WRITE_APPLE);
+
+  return (ras->ras != NULL);
+}
+
+
+//
+// 'raster_start_page()' - Start a raster page.
+//
+
+static bool				// O - `true` on success, `false` on failure
+raster_start_page(xform_raster_t   *ras,// I - Raster information
+		  unsigned         page,// I - Current page
+		  xform_write_cb_t cb,	// I - Write callback
+		  void             *ctx)// I - Write context
+{
+  (void)cb;
+  (void)ctx;
+
+  ras->left   = 0;
+  ras->top    = 0;
+  ras->right  = ras->header.cupsWidth;
+  ras->bottom = ras->header.cupsHeight;
+
+  if (ras->header.Duplex && !(page & 1))
+    return (cupsRasterWriteHeader(ras->ras, &ras->back_header));
+  else
+    return (cupsRasterWriteHeader(ras->ras, &ras->header));
+}
+
+
+//
+// 'raster_write_line()' - Write a line of raster data.
+//
+
+static bool				// O - `true` on success, `false` on failure
+raster_write_line(
+    xform_raster_t      *ras,		// I - Raster information
+    unsigned            y,		// I - Line number
+    const unsigned char *line,		// I - Pixels on line
+    xform_write_cb_t    cb,		// I - Write callback
+    void                *ctx)		// I - Write context
+{
+  (void)y;
+  (void)cb;
+  (void)ctx;
+
+  return (cupsRasterWritePixels(ras->ras, (unsigned char *)line, ras->out_length) > 0);
+}
+
+
+//
+// 'resource_dict_cb()' - Merge resource dictionaries from multiple input pages.
+//
+// This function detects resource conflicts and maps conflicting names as
+// needed.
+//
+
+static bool
+resource_dict_cb(
+    pdfio_dict_t *dict,			// I - Dictionary
+    const char   *key,			// I - Dictionary key
+    xform_page_t *outpage)		// I - Output page
+{
+  pdfio_array_t	*arrayval;		// Array value
+  pdfio_dict_t	*dictval;		// Dictionary value
+  const char	*nameval,		// Name value
+		*curname;		// Current name value
+  pdfio_obj_t	*objval;		// Object value
+  char		mapname[256];		// Mapped resource name
+
+
+  fprintf(stderr, "DEBUG: resource_dict_cb(dict=%p, key=\"%s\", outpage=%p)\n", (void *)dict, key, (void *)outpage);
+
+  snprintf(mapname, sizeof(mapname), "%c%s", (int)('a' + outpage->layout), key);
+
+  switch (pdfioDictGetType(dict, key))
+  {
+    case PDFIO_VALTYPE_ARRAY : // Array
+        arrayval = pdfioDictGetArray(dict, key);
+        if (pdfioDictGetArray(outpage->restype, key))
+        {
+	  if (!outpage->resmap[outpage->layout])
+	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
+
+	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
+	  key = mapname;
+	}
+
+        pdfioDictSetArray(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioArrayCopy(outpage->pdf, arrayval));
+        break;
+
+    case PDFIO_VALTYPE_DICT : // Dictionary
+        dictval = pdfioDictGetDict(dict, key);
+        if (pdfioDictGetDict(outpage->restype, key))
+        {
+	  if (!outpage->resmap[outpage->layout])
+	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
+
+	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
+	  key = mapname;
+	}
+
+        pdfioDictSetDict(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioDictCopy(outpage->pdf, dictval));
+        break;
+
+    case PDFIO_VALTYPE_NAME : // Name
+        nameval = pdfioDictGetName(dict, key);
+        if ((curname = pdfioDictGetName(outpage->restype, key)) != NULL)
+        {
+          if (!strcmp(nameval, curname))
+            break;
+
+	  if (!outpage->resmap[outpage->layout])
+	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
+
+	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
+	  key = mapname;
+	}
+
+        pdfioDictSetName(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, nameval));
+        break;
+
+    case PDFIO_VALTYPE_INDIRECT : // Object reference
+        objval = pdfioDictGetObj(dict, key);
+        if (pdfioDictGetObj(outpage->restype, key))
+        {
+	  if (!outpage->resmap[outpage->layout])
+	    outpage->resmap[outpage->layout] = pdfioDictCreate(outpage->pdf);
+
+	  pdfioDictSetName(outpage->resmap[outpage->layout], pdfioStringCreate(outpage->pdf, key), pdfioStringCreate(outpage->pdf, mapname));
+	  key = mapname;
+	}
+
+        pdfioDictSetObj(outpage->restype, pdfioStringCreate(outpage->pdf, key), pdfioObjCopy(outpage->pdf, objval));
+        break;
+
+    default :
+        break;
+  }
+
+  return (true);
+}
+
+
+//
+// 'show_aligned()' - Show a string that is left, center, or right aligned.
+//
+
+static bool				// O - `true` on success, `false` on error
+show_aligned(
+    pdfio_stream_t *st,			// I - Page stream
+    pdfio_obj_t    *font,		// I - Font
+    double         fsize,		// I - Font size
+    bool           unicode,		// I - Unicode font?
+    double         x,			// I - X position on page
+    double         y,			// I - Y position on page
+    int            align,		// I - Alignment: -1 for right, 0 for center, 1 for left
+    const char     *s)			// I - String to show
+{
+  // Adjust X for alignment...
+  if (align <= 0)
+  {
+    double width = pdfioContentTextMeasure(font, s, fsize);
+					// Width of string
+
+    if (align < 0)
+      x -= width;
+    else
+      x -= 0.5 * width;
+  }
+
+  return (pdfioContentTextBegin(st) && pdfioContentTextMoveTo(st, x, y) && pdfioContentTextShow(st, unicode, s) && pdfioContentTextEnd(st));
+}
+
+
+//
+// 'show_label_and_value()' - Show a label and value aligned along a given central point.
+//
+
+static bool				// O - `true` on success, `false` on error
+show_label_and_value(
+    pdfio_stream_t *st,			// I - Page stream
+    pdfio_obj_t    *font,		// I - Font
+    double         fsize,		// I - Font size
+    bool           unicode,		// I - Unicode font?
+    double         x,			// I - Center X position on page
+    double         y,			// I - Y position on page
+    cups_lang_t    *lang,		// I - Language
+    bool           rtl,			// I - `true` for right-to-left presentation
+    const char     *label,		// I - Label string
+    const char     *value)		// I - Value string
+{
+  // Get the localized string for the label...
+  label = cupsLangGetString(lang, label);
+
+  // Draw the left/right strings and return...
+  return (show_aligned(st, font, fsize, unicode, x - fsize / 3.0, y, -1, rtl ? value : label) && show_aligned(st, font, fsize, unicode, x + fsize / 3.0, y, 1, rtl ? label : value));
+}
+
+
+//
+// 'usage()' - Show program usage.
+//
+
+static int				// O - Exit status
+usage(FILE *out)			// I - Output file
+{
+  cupsLangPuts(out, _("Usage: ipptransform [OPTIONS] FILENAME [ ... FILENAME]"));
+  fputs("\n", out);
+  cupsLangPuts(out, _("Options:"));
+  cupsLangPuts(out, _("--help                         Show this help"));
+  cupsLangPuts(out, _("--version                      Show the program version"));
+  cupsLangPuts(out, _("-d DEVICE-URI                  Specify the output device"));
+  cupsLangPuts(out, _("-f OUTPUT-FILENAME             Specify the output file"));
+  cupsLangPuts(out, _("-i INPUT/FORMAT                Specify the input format"));
+  cupsLangPuts(out, _("-j JOBS                        Specify the number of rendering processes (0 for one per CPU)"));
+  cupsLangPuts(out, _("-m OUTPUT/FORMAT               Specify the output format"));
+  cupsLangPuts(out, _("-o NAME=VALUE                  Specify named options"));
+  cupsLangPuts(out, _("-r RESOLUTION[,...]            Specify supported resolutions"));
+  cupsLangPuts(out, _("-s SHEET-BACK                  Specify back side transform"));
   cupsLangPuts(out, _("-t TYPE[,...]                  Specify color spaces and bit depths"));
   cupsLangPuts(out, _("-v                             Be verbose"));
   fputs("\n", out);
@@ -4202,50 +5682,819 @@ usage(FILE *out)			// I - Output file
   cupsLangPuts(out, _("black_1                        1-bit black"));
   cupsLangPuts(out, _("black_8                        8-bit black"));
 #ifdef HAVE_COREGRAPHICS_H
-  cupsLangPuts(out, _("cmyk_8                         32-bit CMYK"));
-#endif // HAVE_COREGRAPHICS_H
-  cupsLangPuts(out, _("sgray_1                        1-bit grayscale"));
-  cupsLangPuts(out, _("sgray_8                        8-bit grayscale"));
-  cupsLangPuts(out, _("srgb_8                         24-bit sRGB"));
+  cupsLangPuts(out, _("cmyk_8                         32-bit CMYK"));
+#endif // HAVE_COREGRAPHICS_H
+  cupsLangPuts(out, _("sgray_1                        1-bit grayscale"));
+  cupsLangPuts(out, _("sgray_8                        8-bit grayscale"));
+  cupsLangPuts(out, _("srgb_8                         24-bit sRGB"));
+
+  return (out == stdout ? 0 : 1);
+}
+
+
+//
+// 'write_fd()' - Write to a file/socket.
+//
+
+static ssize_t				// O - Number of bytes written or -1 on error
+write_fd(int                 *fd,	// I - File descriptor
+         const unsigned char *buffer,	// I - Buffer
+         size_t              bytes)	// I - Number of bytes to write
+{
+  ssize_t	temp,			// Temporary byte count
+		total = 0;		// Total bytes written
+
+
+  while (bytes > 0)
+  {
+    if ((temp = write(*fd, buffer, bytes)) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      else
+        return (-1);
+    }
+
+    total  += temp;
+    bytes  -= (size_t)temp;
+    buffer += temp;
+  }
+
+  return (total);
+}
+
+
+
+//
+// 'xform_blank_end_job()' - End a job when skipping blank pages.
+//
+
+static void
+xform_blank_end_job(
+    xform_raster_t   *ras,		// I - Raster information
+    xform_write_cb_t cb,		// I - Write callback (not used)
+    void             *ctx)		// I - Write context (not used)
+{
+  (void)cb;
+  (void)ctx;
+
+  (ras->fmt_end_job)(ras, (xform_write_cb_t)xform_blank_write, ras);
+
+  if (ras->blank_pages > 0)
+    fprintf(stderr, "DEBUG: Skipped %u blank page(s).\n", ras->blank_pages);
+
+  free(ras->blank_buffer);
+
+  ras->blank_buffer = NULL;
+  ras->blank_length = 0;
+  ras->blank_size   = 0;
+}
+
+
+//
+// 'xform_blank_end_page()' - End a page when skipping blank pages.
+//
+// Output for a page that is still blank is discarded.
+//
+
+static bool				// O - `true` on success, `false` on failure
+xform_blank_end_page(
+    xform_raster_t   *ras,		// I - Raster information
+    unsigned         page,		// I - Current page
+    xform_write_cb_t cb,		// I - Write callback (not used)
+    void             *ctx)		// I - Write context (not used)
+{
+  bool	ret;				// Return value
+
+
+  (void)cb;
+  (void)ctx;
+
+  ret = (ras->fmt_end_page)(ras, page, (xform_write_cb_t)xform_blank_write, ras);
+
+  if (ras->blank_page)
+  {
+    if (Verbosity)
+      fprintf(stderr, "DEBUG: Skipping blank page %u.\n", page);
+
+    ras->blank_pages ++;
+    ras->blank_page   = false;
+    ras->blank_length = 0;
+  }
+
+  return (ret);
+}
+
+
+//
+// 'xform_blank_init()' - Skip blank pages for the current output format.
+//
+// The output format callbacks are called with a write callback that holds
+// each page's output until a non-blank line is written.
+//
+
+static void
+xform_blank_init(xform_raster_t *ras)	// I - Raster information
+{
+  ras->fmt_end_job    = ras->end_job;
+  ras->fmt_end_page   = ras->end_page;
+  ras->fmt_start_job  = ras->start_job;
+  ras->fmt_start_page = ras->start_page;
+  ras->fmt_write_line = ras->write_line;
+
+  ras->end_job    = xform_blank_end_job;
+  ras->end_page   = xform_blank_end_page;
+  ras->start_job  = xform_blank_start_job;
+  ras->start_page = xform_blank_start_page;
+  ras->write_line = xform_blank_write_line;
+  ras->blank_skip = true;
+}
+
+
+//
+// 'xform_blank_start_job()' - Start a job when skipping blank pages.
+//
+
+static bool				// O - `true` on success, `false` on error
+xform_blank_start_job(
+    xform_raster_t   *ras,		// I - Raster information
+    xform_write_cb_t cb,		// I - Write callback
+    void             *ctx)		// I - Write context
+{
+  ras->blank_cb    = cb;
+  ras->blank_ctx   = ctx;
+  ras->blank_page  = false;
+  ras->blank_pages = 0;
+
+  return ((ras->fmt_start_job)(ras, (xform_write_cb_t)xform_blank_write, ras));
+}
+
+
+//
+// 'xform_blank_start_page()' - Start a page when skipping blank pages.
+//
+
+static bool				// O - `true` on success, `false` on error
+xform_blank_start_page(
+    xform_raster_t   *ras,		// I - Raster information
+    unsigned         page,		// I - Current page
+    xform_write_cb_t cb,		// I - Write callback (not used)
+    void             *ctx)		// I - Write context (not used)
+{
+  (void)cb;
+  (void)ctx;
+
+  ras->blank_page   = ras->blank_skip;
+  ras->blank_length = 0;
+
+  return ((ras->fmt_start_page)(ras, page, (xform_write_cb_t)xform_blank_write, ras));
+}
+
+
+//
+// 'xform_blank_write()' - Write or hold output when skipping blank pages.
+//
+
+static ssize_t				// O - Number of bytes written or -1 on error
+xform_blank_write(
+    xform_raster_t      *ras,		// I - Raster information
+    const unsigned char *buffer,	// I - Buffer
+    size_t              bytes)		// I - Number of bytes to write
+{
+  if (!ras->blank_page)
+    return ((ras->blank_cb)(ras->blank_ctx, buffer, bytes));
+
+  // Hold the output until we know whether the page is blank...
+  if ((ras->blank_length + bytes) > ras->blank_size)
+  {
+    size_t	size = ras->blank_size + bytes + 65536;
+					// New buffer size
+    unsigned char *temp;		// New buffer
+
+    if ((temp = realloc(ras->blank_buffer, size)) == NULL)
+      return (-1);
+
+    ras->blank_buffer = temp;
+    ras->blank_size   = size;
+  }
+
+  memcpy(ras->blank_buffer + ras->blank_length, buffer, bytes);
+  ras->blank_length += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+//
+// 'xform_blank_write_line()' - Write a line when skipping blank pages.
+//
+
+static bool				// O - `true` on success, `false` on failure
+xform_blank_write_line(
+    xform_raster_t      *ras,		// I - Raster information
+    unsigned            y,		// I - Line number
+    const unsigned char *line,		// I - Pixels on line
+    xform_write_cb_t    cb,		// I - Write callback (not used)
+    void                *ctx)		// I - Write context (not used)
+{
+  (void)cb;
+  (void)ctx;
+
+  if (ras->blank_page && !xformIsBlank(line, ras->white, ras->out_length))
+  {
+    // Page isn't blank, write the held output...
+    ras->blank_page = false;
+
+    if (ras->blank_length > 0 && (ras->blank_cb)(ras->blank_ctx, ras->blank_buffer, ras->blank_length) < 0)
+      fputs("DEBUG: Unable to write page output.\n", stderr);
+
+    ras->blank_length = 0;
+  }
+
+  return ((ras->fmt_write_line)(ras, y, line, (xform_write_cb_t)xform_blank_write, ras));
+}
+
+
+#ifndef HAVE_COREGRAPHICS_H
+//
+// 'xform_cache_end_page()' - Finish capturing a page for collated copies.
+//
+// PCLm pages are cached as their strip image objects, which are shared by
+// the replayed page objects.
+//
+
+static void
+xform_cache_end_page(
+    xform_cache_t  *cache,		// I - Page cache
+    xform_raster_t *ras)		// I - Raster information
+{
+  xform_cpage_t	*cpage;			// Current page
+
+
+  if (!cache->capture)
+    return;
+
+  cpage           = cache->pages + cache->num_pages;
+  cpage->length   = cache->length - cpage->offset;
+  cache->capture  = false;
+  cache->num_pages ++;
+
+  if (ras->pclm_strip_objs)
+  {
+    // Take ownership of the PCLm strip objects...
+    cpage->num_strip_objs = ras->pclm_num_strip_objs;
+    cpage->strip_objs     = ras->pclm_strip_objs;
+
+    ras->pclm_num_strip_objs = 0;
+    ras->pclm_strip_objs     = NULL;
+  }
+}
+
+
+//
+// 'xform_cache_free()' - Free the memory and temporary file used by a page cache.
+//
+
+static void
+xform_cache_free(xform_cache_t *cache)	// I - Page cache
+{
+  size_t	i;			// Looping var
+
+
+  for (i = 0; i < cache->num_pages; i ++)
+    free(cache->pages[i].strip_objs);
+
+  free(cache->pages);
+  free(cache->buffer);
+
+  if (cache->fd >= 0)
+  {
+    close(cache->fd);
+    unlink(cache->tempfile);
+  }
+
+  memset(cache, 0, sizeof(xform_cache_t));
+  cache->fd = -1;
+}
+
+
+//
+// 'xform_cache_replay()' - Write a cached page.
+//
+
+static bool				// O - `true` on success, `false` on failure
+xform_cache_replay(
+    xform_cache_t  *cache,		// I - Page cache
+    xform_raster_t *ras,		// I - Raster information
+    size_t         page)		// I - Cached page index (0-based)
+{
+  xform_cpage_t	*cpage;			// Cached page
+  unsigned char	buffer[65536];		// Copy buffer
+  size_t	remaining,		// Remaining bytes
+		bytes;			// Bytes to copy
+
+
+  if (page >= cache->num_pages)
+    return (false);
+
+  cpage = cache->pages + page;
+
+  if (cpage->strip_objs)
+  {
+    // Reference the already-compressed strips from a new PCLm page...
+    return (pclm_add_page(ras, cpage->num_strip_objs, cpage->strip_objs));
+  }
+  else if (cache->fd < 0)
+  {
+    // Write the page from memory...
+    return (cpage->length == 0 || (cache->cb)(cache->ctx, cache->buffer + cpage->offset, cpage->length) >= 0);
+  }
+
+  // Copy the page from the spill file...
+  if (lseek(cache->fd, (off_t)cpage->offset, SEEK_SET) < 0)
+    return (false);
+
+  for (remaining = cpage->length; remaining > 0; remaining -= bytes)
+  {
+    if ((bytes = remaining) > sizeof(buffer))
+      bytes = sizeof(buffer);
+
+    if (read(cache->fd, buffer, bytes) != (ssize_t)bytes)
+      return (false);
+
+    if ((cache->cb)(cache->ctx, buffer, bytes) < 0)
+      return (false);
+  }
+
+  return (true);
+}
+
+
+//
+// 'xform_cache_start_page()' - Start capturing a page for collated copies.
+//
+
+static bool				// O - `true` on success, `false` on failure
+xform_cache_start_page(
+    xform_cache_t *cache)		// I - Page cache
+{
+  xform_cpage_t	*cpage;			// Current page
+
+
+  if (cache->error)
+    return (false);
+
+  if (cache->num_pages >= cache->alloc_pages)
+  {
+    if ((cpage = realloc(cache->pages, (cache->alloc_pages + 16) * sizeof(xform_cpage_t))) == NULL)
+    {
+      cache->error = true;
+      return (false);
+    }
+
+    cache->pages       = cpage;
+    cache->alloc_pages += 16;
+  }
+
+  cpage = cache->pages + cache->num_pages;
+
+  memset(cpage, 0, sizeof(xform_cpage_t));
+  cpage->offset  = cache->length;
+  cache->capture = true;
+
+  return (true);
+}
+
+
+//
+// 'xform_cache_write()' - Write output data and capture it as needed.
+//
+// Captured data is held in memory until it exceeds the "max_memory" limit, at
+// which point it is moved to a temporary file.
+//
+
+static ssize_t				// O - Number of bytes written or -1 on error
+xform_cache_write(
+    xform_cache_t       *cache,		// I - Page cache
+    const unsigned char *buffer,	// I - Buffer
+    size_t              bytes)		// I - Number of bytes to write
+{
+  ssize_t	ret;			// Return value
+
+
+  if ((ret = (cache->cb)(cache->ctx, buffer, bytes)) < 0 || !cache->capture || cache->error)
+    return (ret);
+
+  if (cache->skip_header)
+  {
+    // Don't capture the Apple raster file header, which is written by itself
+    // before the first page header...
+    cache->skip_header = false;
+    return (ret);
+  }
+
+  if (cache->fd < 0 && (cache->length + bytes) > cache->max_memory)
+  {
+    // Move the cached data to a temporary file...
+    if ((cache->fd = cupsCreateTempFd(NULL, NULL, cache->tempfile, sizeof(cache->tempfile))) < 0)
+    {
+      fprintf(stderr, "DEBUG: Unable to create page cache file: %s\n", strerror(errno));
+      cache->error = true;
+      return (ret);
+    }
+
+    if (Verbosity > 1)
+      fprintf(stderr, "DEBUG: Moving page cache to '%s'.\n", cache->tempfile);
+
+    if (cache->length > 0 && write_fd(&cache->fd, cache->buffer, cache->length) < 0)
+    {
+      fprintf(stderr, "DEBUG: Unable to write page cache file: %s\n", strerror(errno));
+      cache->error = true;
+      return (ret);
+    }
+
+    free(cache->buffer);
+    cache->buffer  = NULL;
+    cache->bufsize = 0;
+  }
+
+  if (cache->fd >= 0)
+  {
+    // Append to the temporary file...
+    if (write_fd(&cache->fd, buffer, bytes) < 0)
+    {
+      fprintf(stderr, "DEBUG: Unable to write page cache file: %s\n", strerror(errno));
+      cache->error = true;
+      return (ret);
+    }
+  }
+  else
+  {
+    // Append to the memory buffer...
+    if ((cache->length + bytes) > cache->bufsize)
+    {
+      unsigned char	*temp;		// New buffer
+      size_t		tempsize;	// New size
+
+      if ((tempsize = 2 * cache->bufsize) < 65536)
+        tempsize = 65536;
+      if (tempsize < (cache->length + bytes))
+        tempsize = cache->length + bytes;
+      if (tempsize > cache->max_memory)
+        tempsize = cache->max_memory;
+
+      if ((temp = realloc(cache->buffer, tempsize)) == NULL)
+      {
+        cache->error = true;
+        return (ret);
+      }
+
+      cache->buffer  = temp;
+      cache->bufsize = tempsize;
+    }
+
+    memcpy(cache->buffer + cache->length, buffer, bytes);
+  }
+
+  cache->length += bytes;
+
+  return (ret);
+}
+#endif // !HAVE_COREGRAPHICS_H
+
+
+#ifdef HAVE_COREGRAPHICS_H
+//
+// 'xform_document()' - Transform a file for printing.
+//
+
+static bool				// O - `true` on success, `false` on error
+xform_document(
+    const char       *filename,		// I - File to transform
+    unsigned         pages,		// I - Number of pages
+    ipp_options_t    *options,		// I - IPP options
+    const char       *outformat,	// I - Output format (MIME media type)
+    const char       *resolutions,	// I - Supported resolutions
+    const char       *sheet_back,	// I - Back side transform
+    const char       *types,		// I - Supported types
+    xform_write_cb_t cb,		// I - Write callback
+    void             *ctx)		// I - Write context
+{
+  CFURLRef		url;		// CFURL object for PDF filename
+  CGPDFDocumentRef	document = NULL;// Input document
+  CGPDFPageRef		pdf_page;	// Page in PDF file
+  xform_raster_t	ras;		// Raster info
+  size_t		max_raster;	// Maximum raster memory to use
+  const char		*max_raster_env;// IPPTRANSFORM_MAX_RASTER env var
+  size_t		bpc;		// Bits per color
+  CGColorSpaceRef	cs;		// Quartz color space
+  CGContextRef		context;	// Quartz bitmap context
+  CGBitmapInfo		info;		// Bitmap flags
+  size_t		band_size;	// Size of band line
+  double		xscale, yscale;	// Scaling factor
+  CGAffineTransform 	transform;	// Transform for page
+  CGRect		dest;		// Destination rectangle
+  bool			color = true;	// Does the PDF have color?
+  int			copy,		// Current copy
+			copies;		// Number of collated copies
+  unsigned		page;		// Current page
+  unsigned		media_sheets = 0,
+			impressions = 0;// Page/sheet counters
+  bool			ret = true;	// Return value
+
+
+  // Open the file...
+  if ((url = CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)filename, (CFIndex)strlen(filename), false)) == NULL)
+  {
+    cupsLangPrintf(stderr, _("%s: Unable to create CFURL for file."), Prefix);
+    return (false);
+  }
+
+  // Open the PDF...
+  document = CGPDFDocumentCreateWithURL(url);
+  CFRelease(url);
+
+  if (!document)
+  {
+    cupsLangPrintf(stderr, _("%s: Unable to create CFPDFDocument for file."), Prefix);
+    return (false);
+  }
+
+  // Setup the raster context...
+  if (!xform_setup(&ras, options, outformat, resolutions, sheet_back, types, color, pages))
+  {
+    CGPDFDocumentRelease(document);
+
+    return (false);
+  }
+
+  if (ras.header.cupsBitsPerPixel <= 8)
+  {
+    // Grayscale output...
+    ras.band_bpp = 1;
+    info         = kCGImageAlphaNone;
+    cs           = CGColorSpaceCreateWithName(ras.header.cupsColorSpace == CUPS_CSPACE_SW ? kCGColorSpaceGenericGrayGamma2_2 : kCGColorSpaceLinearGray);
+    bpc          = 8;
+  }
+  else if (ras.header.cupsBitsPerPixel == 24)
+  {
+    // Color (sRGB or AdobeRGB) output...
+    ras.band_bpp = 4;
+    info         = kCGImageAlphaNoneSkipLast;
+    cs           = CGColorSpaceCreateWithName(ras.header.cupsColorSpace == CUPS_CSPACE_SRGB ? kCGColorSpaceSRGB : kCGColorSpaceAdobeRGB1998);
+    bpc          = 8;
+  }
+  else if (ras.header.cupsBitsPerPixel == 32)
+  {
+    // Color (CMYK) output...
+    ras.band_bpp = 4;
+    info         = kCGImageAlphaNone;
+    cs           = CGColorSpaceCreateWithName(kCGColorSpaceGenericCMYK);
+    bpc          = 8;
+  }
+  else
+  {
+    // Color (AdobeRGB) output...
+    ras.band_bpp = 8;
+    info         = kCGImageAlphaNoneSkipLast;
+    cs           = CGColorSpaceCreateWithName(kCGColorSpaceAdobeRGB1998);
+    bpc          = 16;
+  }
+
+  max_raster     = XFORM_MAX_RASTER;
+  max_raster_env = getenv("IPPTRANSFORM_MAX_RASTER");
+  if (max_raster_env && strtol(max_raster_env, NULL, 10) > 0)
+    max_raster = (size_t)strtol(max_raster_env, NULL, 10);
+
+  band_size = ras.header.cupsWidth * ras.band_bpp;
+  if ((ras.band_height = (unsigned)(max_raster / band_size)) < 1)
+    ras.band_height = 1;
+  else if (ras.band_height > ras.header.cupsHeight)
+    ras.band_height = ras.header.cupsHeight;
+
+  ras.band_buffer = malloc(ras.band_height * band_size);
+  context         = CGBitmapContextCreate(ras.band_buffer, ras.header.cupsWidth, ras.band_height, bpc, band_size, cs, info);
+
+  CGColorSpaceRelease(cs);
+
+  // Don't anti-alias or interpolate when creating raster data
+  CGContextSetAllowsAntialiasing(context, 0);
+  CGContextSetInterpolationQuality(context, kCGInterpolationNone);
+
+  xscale = ras.header.HWResolution[0] / 72.0;
+  yscale = ras.header.HWResolution[1] / 72.0;
+
+  if (Verbosity > 1)
+    fprintf(stderr, "DEBUG: xscale=%g, yscale=%g\n", xscale, yscale);
+  CGContextScaleCTM(context, xscale, yscale);
+
+  if (Verbosity > 1)
+    fprintf(stderr, "DEBUG: Band height=%u, page height=%u, page translate 0.0,%g\n", ras.band_height, ras.header.cupsHeight, -1.0 * (ras.header.cupsHeight - ras.band_height) / yscale);
+  CGContextTranslateCTM(context, 0.0, -1.0 * (ras.header.cupsHeight - ras.band_height) / yscale);
+
+  dest.origin.x    = dest.origin.y = 0.0;
+  dest.size.width  = ras.header.cupsWidth * 72.0 / ras.header.HWResolution[0];
+  dest.size.height = ras.header.cupsHeight * 72.0 / ras.header.HWResolution[1];
+
+  // Start the conversion...
+  fprintf(stderr, "ATTR: job-impressions=%d\n", pages);
+  fprintf(stderr, "ATTR: job-pages=%d\n", pages);
+
+  if (ras.header.Duplex)
+    fprintf(stderr, "ATTR: job-media-sheets=%d\n", (pages + 1) / 2);
+  else
+    fprintf(stderr, "ATTR: job-media-sheets=%d\n", pages);
+
+  if (Verbosity > 1)
+    fprintf(stderr, "DEBUG: cupsPageSize=[%g %g]\n", ras.header.cupsPageSize[0], ras.header.cupsPageSize[1]);
+
+  if (!(ras.start_job)(&ras, cb, ctx))
+  {
+    CGPDFDocumentRelease(document);
+    CGContextRelease(context);
+    return (false);
+  }
+
+  // Render pages in the PDF...
+  if (options->multiple_document_handling == IPPOPT_HANDLING_UNCOLLATED_COPIES)
+  {
+    // Uncollated copies are handled by the printer/driver...
+    ras.header.NumCopies      = (unsigned)options->copies;
+    ras.back_header.NumCopies = (unsigned)options->copies;
+    ras.sep_header.NumCopies  = (unsigned)options->copies;
+    copies                    = 1;
+  }
+  else
+  {
+    // Collated copies are handled by ipptransform...
+    ras.header.NumCopies      = 1;
+    ras.back_header.NumCopies = 1;
+    ras.sep_header.NumCopies  = 1;
+    copies                    = options->copies;
+  }
+
+  for (copy = 0; copy < copies && ret; copy ++)
+  {
+    // Write a separator sheet as needed...
+    switch (options->separator_type)
+    {
+      case IPPOPT_SEPTYPE_NONE :
+      case IPPOPT_SEPTYPE_END_SHEET :
+          break;
+
+      case IPPOPT_SEPTYPE_SLIP_SHEETS :
+          if (copy == 0)
+            break;
+
+      case IPPOPT_SEPTYPE_START_SHEET :
+      case IPPOPT_SEPTYPE_BOTH_SHEETS :
+          xform_separator(&ras, cb, ctx);
+          break;
+    }
+
+    // Render pages in the PDF...
+    for (page = 1; page <= pages && ret; page ++)
+    {
+      unsigned		y,		// Current line
+			band_starty = 0,// Start line of band
+			band_endy = 0;	// End line of band
+      unsigned char	*lineptr;	// Pointer to line
+
+      pdf_page  = CGPDFDocumentGetPage(document, page);
+      transform = CGPDFPageGetDrawingTransform(pdf_page, kCGPDFCropBox, dest, 0, true);
+
+      if (Verbosity > 1)
+	fprintf(stderr, "DEBUG: Printing copy %d/%d, page %d/%d, transform=[%g %g %g %g %g %g]\n", copy + 1, options->copies, page, pages, transform.a, transform.b, transform.c, transform.d, transform.tx, transform.ty);
+
+      if (!(ras.start_page)(&ras, page, cb, ctx))
+        break;
+
+      ras.out_length = ((ras.right - ras.left) * ras.header.cupsBitsPerPixel + 7) / 8;
+
+      for (y = ras.top; y < ras.bottom && ret; y ++)
+      {
+	if (y >= band_endy)
+	{
+	  // Draw the next band of raster data...
+	  band_starty = y;
+	  band_endy   = y + ras.band_height;
+	  if (band_endy > ras.bottom)
+	    band_endy = ras.bottom;
+
+	  if (Verbosity > 1)
+	    fprintf(stderr, "DEBUG: Drawing band from %u to %u.\n", band_starty, band_endy);
+
+	  CGContextSaveGState(context);
+	    if (ras.header.cupsNumColors == 1)
+	      CGContextSetGrayFillColor(context, 1., 1.);
+	    else
+	      CGContextSetRGBFillColor(context, 1., 1., 1., 1.);
+
+	    CGContextSetCTM(context, CGAffineTransformIdentity);
+	    CGContextFillRect(context, CGRectMake(0., 0., ras.header.cupsWidth, ras.band_height));
+	  CGContextRestoreGState(context);
+
+	  CGContextSaveGState(context);
+	    if (Verbosity > 1)
+	      fprintf(stderr, "DEBUG: Band translate 0.0,%g\n", y / yscale);
+	    CGContextTranslateCTM(context, 0.0, y / yscale);
+	    CGContextConcatCTM(context, transform);
+
+	    CGContextClipToRect(context, CGPDFPageGetBoxRect(pdf_page, kCGPDFCropBox));
+	    CGContextDrawPDFPage(context, pdf_page);
+	  CGContextRestoreGState(context);
+	}
+
+        // Prepare and write a line...
+	lineptr = ras.band_buffer + (y - band_starty) * band_size + ras.left * ras.band_bpp;
+	if (ras.header.cupsBitsPerPixel == 1)
+	  xformDitherGray(ras.dither[y & 63], ras.white, lineptr, ras.right - ras.left);
+	else if (ras.header.cupsColorSpace == CUPS_CSPACE_K)
+	  xformPackBlack(lineptr, ras.right - ras.left);
+	else if (ras.header.cupsBitsPerPixel == 24)
+	  xformPackRGBA(lineptr, ras.right - ras.left);
+	else if (ras.header.cupsBitsPerPixel == 48)
+	  pack_rgba16(lineptr, ras.right - ras.left);
+
+	ret = (ras.write_line)(&ras, y, lineptr, cb, ctx);
+      }
+
+      if (!ret || !(ras.end_page)(&ras, page, cb, ctx))
+      {
+        ret = false;
+        break;
+      }
+
+      // Log progress...
+      impressions ++;
+      fprintf(stderr, "ATTR: job-impressions-completed=%u\n", impressions);
+      if (!ras.header.Duplex || !(page & 1))
+      {
+	media_sheets ++;
+	fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", media_sheets);
+      }
+    }
+
+    if (ret && options->copies > 1 && (pages & 1) && ras.header.Duplex)
+    {
+      // Duplex printing, add a blank back side image...
+      unsigned	y;		// Current line
 
-  return (out == stdout ? 0 : 1);
-}
+      if (Verbosity > 1)
+	fprintf(stderr, "DEBUG: Printing blank page %u for duplex.\n", pages + 1);
 
+      memset(ras.band_buffer, 255, ras.header.cupsBytesPerLine);
 
-//
-// 'write_fd()' - Write to a file/socket.
-//
+      if (!(ras.start_page)(&ras, page, cb, ctx))
+        break;
 
-static ssize_t				// O - Number of bytes written or -1 on error
-write_fd(int                 *fd,	// I - File descriptor
-         const unsigned char *buffer,	// I - Buffer
-         size_t              bytes)	// I - Number of bytes to write
-{
-  ssize_t	temp,			// Temporary byte count
-		total = 0;		// Total bytes written
+      for (y = ras.top; y < ras.bottom && ret; y ++)
+	ret = (ras.write_line)(&ras, y, ras.band_buffer, cb, ctx);
 
+      if (!ret || !(ras.end_page)(&ras, page, cb, ctx))
+      {
+        ret = false;
+        break;
+      }
 
-  while (bytes > 0)
-  {
-    if ((temp = write(*fd, buffer, bytes)) < 0)
-    {
-      if (errno == EINTR || errno == EAGAIN)
-        continue;
-      else
-        return (-1);
+      impressions ++;
+      fprintf(stderr, "ATTR: job-impressions-completed=%u\n", impressions);
+      if (!ras.header.Duplex || !(page & 1))
+      {
+	media_sheets ++;
+	fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", media_sheets);
+      }
     }
 
-    total  += temp;
-    bytes  -= (size_t)temp;
-    buffer += temp;
+    // Write a separator sheet as needed...
+    switch (options->separator_type)
+    {
+      case IPPOPT_SEPTYPE_NONE :
+      case IPPOPT_SEPTYPE_START_SHEET :
+      case IPPOPT_SEPTYPE_SLIP_SHEETS :
+	  break;
+
+      case IPPOPT_SEPTYPE_END_SHEET :
+      case IPPOPT_SEPTYPE_BOTH_SHEETS :
+          xform_separator(&ras, cb, ctx);
+          break;
+    }
   }
 
-  return (total);
-}
+  CGPDFDocumentRelease(document);
+  (ras.end_job)(&ras, cb, ctx);
 
+  // Clean up...
+  CGContextRelease(context);
 
+  free(ras.band_buffer);
+  ras.band_buffer = NULL;
 
-#ifdef HAVE_COREGRAPHICS_H
+  return (ret);
+}
+
+
+#else // pdftoppm
 //
 // 'xform_document()' - Transform a file for printing.
 //
@@ -4262,147 +6511,425 @@ xform_document(
     xform_write_cb_t cb,		// I - Write callback
     void             *ctx)		// I - Write context
 {
-  CFURLRef		url;		// CFURL object for PDF filename
-  CGPDFDocumentRef	document = NULL;// Input document
-  CGPDFPageRef		pdf_page;	// Page in PDF file
-  xform_raster_t	ras;		// Raster info
-  size_t		max_raster;	// Maximum raster memory to use
-  const char		*max_raster_env;// IPPTRANSFORM_MAX_RASTER env var
-  size_t		bpc;		// Bits per color
-  CGColorSpaceRef	cs;		// Quartz color space
-  CGContextRef		context;	// Quartz bitmap context
-  CGBitmapInfo		info;		// Bitmap flags
-  size_t		band_size;	// Size of band line
-  double		xscale, yscale;	// Scaling factor
-  CGAffineTransform 	transform;	// Transform for page
-  CGRect		dest;		// Destination rectangle
-  bool			color = true;	// Does the PDF have color?
-  int			copy,		// Current copy
-			copies;		// Number of collated copies
-  unsigned		page;		// Current page
-  unsigned		media_sheets = 0,
-			impressions = 0;// Page/sheet counters
+  xform_raster_t ras;			// Raster information
+  int		copy,			// Current copy
+		copies;			// Number of collated copies
+  unsigned	page = 0,		// Current page
+		media_sheets = 0,
+		impressions = 0;	// Page/sheet counters
+  const xform_renderer_t *renderer = Renderers;
+					// Rasterizer backend
+  const char	*renderer_env;		// IPPTRANSFORM_RENDERER env var
+  void		*rdata;			// Rasterizer data
+  unsigned	width,			// Width of rendered page
+		height,			// Height of rendered page
+		bpp,			// Bytes per pixel
+		y,			// Current output line
+		yskip,			// Rendered lines to skip
+		ystart,			// First output line
+		count,			// Lines in band
+		band_lines,		// Lines per band
+		band_y;			// Line in band
+  unsigned char	*band = NULL,		// Band buffer
+		*bandptr,		// Rendered lines
+		*line = NULL,		// Output line for narrow pages
+		*linein,		// Pointer to input pixels
+		*lineout;		// Pointer to output pixels
+  size_t	bandsize = 0,		// Size of band buffer
+		linesize,		// Size of an output line
+		srcsize;		// Size of a rendered line
+  xform_cache_t	cache;			// Rendered page cache for collated copies
+  bool		use_cache = false;	// Use the page cache?
+  const char	*max_cache_env;		// IPPTRANSFORM_MAX_CACHE env var
+  size_t	i;			// Looping var
+  bool		ret = true;		// Return value
 
 
-  // Open the file...
-  if ((url = CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)filename, (CFIndex)strlen(filename), false)) == NULL)
+  // Choose the rasterizer backend...
+  if ((renderer_env = getenv("IPPTRANSFORM_RENDERER")) != NULL && *renderer_env)
   {
-    cupsLangPrintf(stderr, _("%s: Unable to create CFURL for file."), Prefix);
+    for (i = 0; i < (sizeof(Renderers) / sizeof(Renderers[0])); i ++)
+    {
+      if (!strcmp(renderer_env, Renderers[i].name))
+      {
+        renderer = Renderers + i;
+        break;
+      }
+    }
+
+    if (i >= (sizeof(Renderers) / sizeof(Renderers[0])))
+      fprintf(stderr, "DEBUG: Unknown renderer \"%s\", using \"%s\".\n", renderer_env, renderer->name);
+  }
+
+  if (Verbosity)
+    fprintf(stderr, "DEBUG: Using \"%s\" renderer.\n", renderer->name);
+
+  // Setup the raster headers...
+  if (!xform_setup(&ras, options, outformat, resolutions, sheet_back, types, true, pages))
     return (false);
+
+  fprintf(stderr, "ATTR: job-impressions=%d\n", pages);
+  fprintf(stderr, "ATTR: job-pages=%d\n", pages);
+
+  if (ras.header.Duplex)
+    fprintf(stderr, "ATTR: job-media-sheets=%d\n", (pages + 1) / 2);
+  else
+    fprintf(stderr, "ATTR: job-media-sheets=%d\n", pages);
+
+  if (Verbosity > 1)
+    fprintf(stderr, "DEBUG: cupsPageSize=[%g %g]\n", ras.header.cupsPageSize[0], ras.header.cupsPageSize[1]);
+
+  // Setup the page cache for collated copies - pages are rendered once for the
+  // first copy and the encoded output is replayed for the remaining copies.
+  // PostScript output contains page numbers and duplex output with an odd
+  // number of pages changes sides between copies, so those are always
+  // rendered...
+  memset(&cache, 0, sizeof(cache));
+  cache.cb  = cb;
+  cache.ctx = ctx;
+  cache.fd  = -1;
+
+  if (options->multiple_document_handling != IPPOPT_HANDLING_UNCOLLATED_COPIES && options->copies > 1 && strcmp(ras.format, "application/postscript") && (!ras.header.Duplex || !(pages & 1)))
+  {
+    cache.max_memory = XFORM_MAX_CACHE;
+    max_cache_env    = getenv("IPPTRANSFORM_MAX_CACHE");
+    if (max_cache_env && strtol(max_cache_env, NULL, 10) >= 0)
+      cache.max_memory = (size_t)strtol(max_cache_env, NULL, 10);
+
+    cache.skip_header = !strcmp(ras.format, "image/urf");
+
+    cb        = (xform_write_cb_t)xform_cache_write;
+    ctx       = &cache;
+    use_cache = true;
+  }
+
+  (ras.start_job)(&ras, cb, ctx);
+
+  if (options->multiple_document_handling == IPPOPT_HANDLING_UNCOLLATED_COPIES)
+  {
+    // Uncollated copies are handled by the printer/driver...
+    ras.header.NumCopies      = options->copies;
+    ras.back_header.NumCopies = options->copies;
+    ras.sep_header.NumCopies  = options->copies;
+    copies                    = 1;
+  }
+  else
+  {
+    // Collated copies are handled by ipptransform...
+    ras.header.NumCopies      = 1;
+    ras.back_header.NumCopies = 1;
+    ras.sep_header.NumCopies  = 1;
+    copies                    = options->copies;
+  }
+
+  for (copy = 0; copy < copies && ret; copy ++)
+  {
+    // Write a separator sheet as needed...
+    switch (options->separator_type)
+    {
+      case IPPOPT_SEPTYPE_NONE :
+      case IPPOPT_SEPTYPE_END_SHEET :
+          break;
+
+      case IPPOPT_SEPTYPE_SLIP_SHEETS :
+          if (copy == 0)
+            break;
+
+      case IPPOPT_SEPTYPE_START_SHEET :
+      case IPPOPT_SEPTYPE_BOTH_SHEETS :
+          xform_separator(&ras, cb, ctx);
+          break;
+    }
+
+    if (copy > 0 && cache.num_pages > 0 && !cache.error)
+    {
+      // Replay the pages that were rendered for the first copy...
+      for (i = 0; i < cache.num_pages; i ++)
+      {
+        page ++;
+
+        if (Verbosity > 1)
+          fprintf(stderr, "DEBUG: Replaying copy %d/%d, page %u/%u.\n", copy + 1, copies, (unsigned)i + 1, (unsigned)cache.num_pages);
+
+        if (!xform_cache_replay(&cache, &ras, i))
+        {
+          cupsLangPrintf(stderr, _("%s: Unable to send data."), Prefix);
+          ret = false;
+          break;
+        }
+
+        // Log progress...
+        impressions ++;
+        fprintf(stderr, "ATTR: job-impressions-completed=%u\n", impressions);
+        if (!ras.header.Duplex || !(page & 1))
+        {
+          media_sheets ++;
+          fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", media_sheets);
+        }
+      }
+    }
+    else
+    {
+      // Render the pages...
+      if ((rdata = (renderer->open)(filename, &ras, pages)) == NULL)
+      {
+        free(band);
+        free(line);
+        xform_cache_free(&cache);
+        return (false);
+      }
+
+      while ((renderer->start_page)(rdata, &width, &height, &bpp))
+      {
+        // Figure out how to center the rendered page on the output page...
+        srcsize  = (size_t)width * bpp;
+        linesize = (size_t)ras.header.cupsWidth * bpp;
+
+        if (height > ras.header.cupsHeight)
+        {
+          yskip  = (height - ras.header.cupsHeight) / 2;
+          ystart = 0;
+        }
+        else
+        {
+          yskip  = 0;
+          ystart = (ras.header.cupsHeight - height) / 2;
+        }
+
+        if ((band_lines = (unsigned)(XFORM_MAX_BAND / srcsize)) < 1)
+          band_lines = 1;
+        else if (band_lines > height)
+          band_lines = height;
+
+        if (bandsize < (band_lines * srcsize))
+        {
+          free(band);
+          bandsize = band_lines * srcsize;
+
+          if ((band = malloc(bandsize)) == NULL)
+          {
+            cupsLangPrintf(stderr, _("%s: Out of memory."), Prefix);
+            (renderer->close)(rdata);
+            free(line);
+            xform_cache_free(&cache);
+            return (false);
+          }
+        }
+
+        if (!line && (line = malloc(ras.header.cupsWidth * 3)) == NULL)
+        {
+          cupsLangPrintf(stderr, _("%s: Out of memory."), Prefix);
+          (renderer->close)(rdata);
+          free(band);
+          xform_cache_free(&cache);
+          return (false);
+        }
+
+        lineout = line + ras.left * bpp;
+
+        if (Verbosity)
+          fprintf(stderr, "DEBUG: width=%u, height=%u, bpp=%u, ystart=%u, yskip=%u, band_lines=%u\n", width, height, bpp, ystart, yskip, band_lines);
+
+        // Send the page to the driver...
+        page ++;
+
+        if (use_cache && copy == 0)
+          xform_cache_start_page(&cache);
+
+        if (!(ras.start_page)(&ras, page, cb, ctx))
+          break;
+
+        ras.out_length = ((ras.right - ras.left) * ras.header.cupsBitsPerPixel + 7) / 8;
+
+        // Write leading blank lines...
+        memset(line, ras.white, linesize);
+
+        for (y = 0; y < ystart && ret; y ++)
+          ret = (ras.write_line)(&ras, y, lineout, cb, ctx);
+
+        // Then the rendered lines, a band at a time...
+        for (; y < ras.header.cupsHeight && height > 0 && ret; height -= count)
+        {
+          count = height > band_lines ? band_lines : height;
+
+          if ((bandptr = (renderer->read_band)(rdata, band, count)) == NULL)
+          {
+            fprintf(stderr, "DEBUG: Unable to read rendered lines for page %u.\n", page);
+            break;
+          }
+
+          for (band_y = 0; band_y < count && y < ras.header.cupsHeight && ret; band_y ++, bandptr += srcsize)
+          {
+            if (yskip > 0)
+            {
+              yskip --;
+              continue;
+            }
+
+            if (width >= ras.header.cupsWidth)
+            {
+              // Use the rendered line directly...
+              linein = bandptr + ((width - ras.header.cupsWidth) / 2 + ras.left) * bpp;
+            }
+            else
+            {
+              // Center a narrow line...
+              memset(line, 255, linesize);
+              memcpy(line + (ras.header.cupsWidth - width) / 2 * bpp, bandptr, srcsize);
+              linein = lineout;
+            }
+
+	    if (ras.header.cupsBitsPerPixel == 1)
+	      xformDitherGray(ras.dither[y & 63], ras.white, linein, ras.right - ras.left);
+	    else if (ras.header.cupsColorSpace == CUPS_CSPACE_K)
+	      xformPackBlack(linein, ras.right - ras.left);
+
+            ret = (ras.write_line)(&ras, y, linein, cb, ctx);
+            y ++;
+          }
+        }
+
+        // Write trailing blank lines...
+        memset(line, ras.white, linesize);
+
+        for (; y < ras.header.cupsHeight && ret; y ++)
+          ret = (ras.write_line)(&ras, y, lineout, cb, ctx);
+
+        if (!ret || !(ras.end_page)(&ras, page, cb, ctx))
+        {
+          ret = false;
+          break;
+        }
+
+        if (use_cache && copy == 0)
+          xform_cache_end_page(&cache, &ras);
+
+        // Log progress...
+        impressions ++;
+        fprintf(stderr, "ATTR: job-impressions-completed=%u\n", impressions);
+        if (!ras.header.Duplex || !(page & 1))
+        {
+	  media_sheets ++;
+	  fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", media_sheets);
+        }
+      }
+
+      // Close things out...
+      (renderer->close)(rdata);
+
+      if (cache.capture)
+      {
+        // Don't replay an incomplete page...
+        cache.capture = false;
+        cache.error   = true;
+      }
+    }
+
+    // Write a separator sheet as needed...
+    switch (options->separator_type)
+    {
+      case IPPOPT_SEPTYPE_NONE :
+      case IPPOPT_SEPTYPE_START_SHEET :
+      case IPPOPT_SEPTYPE_SLIP_SHEETS :
+	  break;
+
+      case IPPOPT_SEPTYPE_END_SHEET :
+      case IPPOPT_SEPTYPE_BOTH_SHEETS :
+          xform_separator(&ras, cb, ctx);
+          break;
+    }
   }
 
-  // Open the PDF...
-  document = CGPDFDocumentCreateWithURL(url);
-  CFRelease(url);
+  free(band);
+  free(line);
 
-  if (!document)
-  {
-    cupsLangPrintf(stderr, _("%s: Unable to create CFPDFDocument for file."), Prefix);
-    return (false);
-  }
+  (ras.end_job)(&ras, cb, ctx);
 
-  // Setup the raster context...
-  if (!xform_setup(&ras, options, outformat, resolutions, sheet_back, types, color, pages))
-  {
-    CGPDFDocumentRelease(document);
+  xform_cache_free(&cache);
 
-    return (false);
-  }
+  return (ret);
+}
 
-  if (ras.header.cupsBitsPerPixel <= 8)
-  {
-    // Grayscale output...
-    ras.band_bpp = 1;
-    info         = kCGImageAlphaNone;
-    cs           = CGColorSpaceCreateWithName(ras.header.cupsColorSpace == CUPS_CSPACE_SW ? kCGColorSpaceGenericGrayGamma2_2 : kCGColorSpaceLinearGray);
-    bpc          = 8;
-  }
-  else if (ras.header.cupsBitsPerPixel == 24)
-  {
-    // Color (sRGB or AdobeRGB) output...
-    ras.band_bpp = 4;
-    info         = kCGImageAlphaNoneSkipLast;
-    cs           = CGColorSpaceCreateWithName(ras.header.cupsColorSpace == CUPS_CSPACE_SRGB ? kCGColorSpaceSRGB : kCGColorSpaceAdobeRGB1998);
-    bpc          = 8;
-  }
-  else if (ras.header.cupsBitsPerPixel == 32)
-  {
-    // Color (CMYK) output...
-    ras.band_bpp = 4;
-    info         = kCGImageAlphaNone;
-    cs           = CGColorSpaceCreateWithName(kCGColorSpaceGenericCMYK);
-    bpc          = 8;
-  }
-  else
-  {
-    // Color (AdobeRGB) output...
-    ras.band_bpp = 8;
-    info         = kCGImageAlphaNoneSkipLast;
-    cs           = CGColorSpaceCreateWithName(kCGColorSpaceAdobeRGB1998);
-    bpc          = 16;
-  }
 
-  max_raster     = XFORM_MAX_RASTER;
-  max_raster_env = getenv("IPPTRANSFORM_MAX_RASTER");
-  if (max_raster_env && strtol(max_raster_env, NULL, 10) > 0)
-    max_raster = (size_t)strtol(max_raster_env, NULL, 10);
+//
+// 'xform_image()' - Transform a PNG image directly to raster data.
+//
+// This avoids converting the image to a temporary PDF file and rendering it
+// with pdftoppm.  The page is rendered once and replayed for collated copies.
+//
 
-  band_size = ras.header.cupsWidth * ras.band_bpp;
-  if ((ras.band_height = (unsigned)(max_raster / band_size)) < 1)
-    ras.band_height = 1;
-  else if (ras.band_height > ras.header.cupsHeight)
-    ras.band_height = ras.header.cupsHeight;
+static bool				// O - `true` on success, `false` on failure
+xform_image(
+    const char       *filename,		// I - PNG file to transform
+    ipp_options_t    *options,		// I - IPP options
+    const char       *outformat,	// I - Output format (MIME media type)
+    const char       *resolutions,	// I - Supported resolutions
+    const char       *sheet_back,	// I - Back side transform
+    const char       *types,		// I - Supported types
+    xform_write_cb_t cb,		// I - Write callback
+    void             *ctx)		// I - Write context
+{
+  xform_raster_t ras;			// Raster information
+  xform_png_t	*png;			// PNG image
+  bool		color;			// Color image?
+  int		copy,			// Current copy
+		copies;			// Number of collated copies
+  unsigned	page = 0;		// Current page
+  xform_cache_t	cache;			// Rendered page cache for collated copies
+  bool		use_cache = false;	// Use the page cache?
+  const char	*max_cache_env;		// IPPTRANSFORM_MAX_CACHE env var
+  bool		ret = true;		// Return value
 
-  ras.band_buffer = malloc(ras.band_height * band_size);
-  context         = CGBitmapContextCreate(ras.band_buffer, ras.header.cupsWidth, ras.band_height, bpc, band_size, cs, info);
 
-  CGColorSpaceRelease(cs);
+  // Get the image colors and setup the raster headers...
+  if ((png = xformPNGOpen(filename)) == NULL)
+  {
+    cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), Prefix, filename, strerror(errno));
+    return (false);
+  }
 
-  // Don't anti-alias or interpolate when creating raster data
-  CGContextSetAllowsAntialiasing(context, 0);
-  CGContextSetInterpolationQuality(context, kCGInterpolationNone);
+  color = xformPNGGetColors(png) == 3;
 
-  xscale = ras.header.HWResolution[0] / 72.0;
-  yscale = ras.header.HWResolution[1] / 72.0;
+  xformPNGClose(png);
 
-  if (Verbosity > 1)
-    fprintf(stderr, "DEBUG: xscale=%g, yscale=%g\n", xscale, yscale);
-  CGContextScaleCTM(context, xscale, yscale);
+  if (!xform_setup(&ras, options, outformat, resolutions, sheet_back, types, color, 1))
+    return (false);
 
-  if (Verbosity > 1)
-    fprintf(stderr, "DEBUG: Band height=%u, page height=%u, page translate 0.0,%g\n", ras.band_height, ras.header.cupsHeight, -1.0 * (ras.header.cupsHeight - ras.band_height) / yscale);
-  CGContextTranslateCTM(context, 0.0, -1.0 * (ras.header.cupsHeight - ras.band_height) / yscale);
+  fputs("ATTR: job-impressions=1\n", stderr);
+  fputs("ATTR: job-pages=1\n", stderr);
+  fputs("ATTR: job-media-sheets=1\n", stderr);
 
-  dest.origin.x    = dest.origin.y = 0.0;
-  dest.size.width  = ras.header.cupsWidth * 72.0 / ras.header.HWResolution[0];
-  dest.size.height = ras.header.cupsHeight * 72.0 / ras.header.HWResolution[1];
+  if (Verbosity > 1)
+    fprintf(stderr, "DEBUG: Printing '%s' directly, cupsPageSize=[%g %g]\n", filename, ras.header.cupsPageSize[0], ras.header.cupsPageSize[1]);
 
-  // Start the conversion...
-  fprintf(stderr, "ATTR: job-impressions=%d\n", pages);
-  fprintf(stderr, "ATTR: job-pages=%d\n", pages);
+  // Setup the page cache for collated copies...
+  memset(&cache, 0, sizeof(cache));
+  cache.cb  = cb;
+  cache.ctx = ctx;
+  cache.fd  = -1;
 
-  if (ras.header.Duplex)
-    fprintf(stderr, "ATTR: job-media-sheets=%d\n", (pages + 1) / 2);
-  else
-    fprintf(stderr, "ATTR: job-media-sheets=%d\n", pages);
+  if (options->multiple_document_handling != IPPOPT_HANDLING_UNCOLLATED_COPIES && options->copies > 1 && strcmp(ras.format, "application/postscript"))
+  {
+    cache.max_memory = XFORM_MAX_CACHE;
+    max_cache_env    = getenv("IPPTRANSFORM_MAX_CACHE");
+    if (max_cache_env && strtol(max_cache_env, NULL, 10) >= 0)
+      cache.max_memory = (size_t)strtol(max_cache_env, NULL, 10);
 
-  if (Verbosity > 1)
-    fprintf(stderr, "DEBUG: cupsPageSize=[%g %g]\n", ras.header.cupsPageSize[0], ras.header.cupsPageSize[1]);
+    cache.skip_header = !strcmp(ras.format, "image/urf");
 
-  if (!(ras.start_job)(&ras, cb, ctx))
-  {
-    CGPDFDocumentRelease(document);
-    CGContextRelease(context);
-    return (false);
+    cb        = (xform_write_cb_t)xform_cache_write;
+    ctx       = &cache;
+    use_cache = true;
   }
 
-  // Render pages in the PDF...
+  (ras.start_job)(&ras, cb, ctx);
+
   if (options->multiple_document_handling == IPPOPT_HANDLING_UNCOLLATED_COPIES)
   {
     // Uncollated copies are handled by the printer/driver...
-    ras.header.NumCopies      = (unsigned)options->copies;
-    ras.back_header.NumCopies = (unsigned)options->copies;
-    ras.sep_header.NumCopies  = (unsigned)options->copies;
+    ras.header.NumCopies      = options->copies;
+    ras.back_header.NumCopies = options->copies;
+    ras.sep_header.NumCopies  = options->copies;
     copies                    = 1;
   }
   else
@@ -4414,7 +6941,7 @@ xform_document(
     copies                    = options->copies;
   }
 
-  for (copy = 0; copy < copies; copy ++)
+  for (copy = 0; copy < copies && ret; copy ++)
   {
     // Write a separator sheet as needed...
     switch (options->separator_type)
@@ -4433,112 +6960,36 @@ xform_document(
           break;
     }
 
-    // Render pages in the PDF...
-    for (page = 1; page <= pages; page ++)
-    {
-      unsigned		y,		// Current line
-			band_starty = 0,// Start line of band
-			band_endy = 0;	// End line of band
-      unsigned char	*lineptr;	// Pointer to line
-
-      pdf_page  = CGPDFDocumentGetPage(document, page);
-      transform = CGPDFPageGetDrawingTransform(pdf_page, kCGPDFCropBox, dest, 0, true);
+    page ++;
 
+    if (copy > 0 && cache.num_pages > 0 && !cache.error)
+    {
+      // Replay the page that was rendered for the first copy...
       if (Verbosity > 1)
-	fprintf(stderr, "DEBUG: Printing copy %d/%d, page %d/%d, transform=[%g %g %g %g %g %g]\n", copy + 1, options->copies, page, pages, transform.a, transform.b, transform.c, transform.d, transform.tx, transform.ty);
-
-      if (!(ras.start_page)(&ras, page, cb, ctx))
-        break;
-
-      ras.out_length = ((ras.right - ras.left) * ras.header.cupsBitsPerPixel + 7) / 8;
-
-      for (y = ras.top; y < ras.bottom; y ++)
-      {
-	if (y >= band_endy)
-	{
-	  // Draw the next band of raster data...
-	  band_starty = y;
-	  band_endy   = y + ras.band_height;
-	  if (band_endy > ras.bottom)
-	    band_endy = ras.bottom;
-
-	  if (Verbosity > 1)
-	    fprintf(stderr, "DEBUG: Drawing band from %u to %u.\n", band_starty, band_endy);
-
-	  CGContextSaveGState(context);
-	    if (ras.header.cupsNumColors == 1)
-	      CGContextSetGrayFillColor(context, 1., 1.);
-	    else
-	      CGContextSetRGBFillColor(context, 1., 1., 1., 1.);
-
-	    CGContextSetCTM(context, CGAffineTransformIdentity);
-	    CGContextFillRect(context, CGRectMake(0., 0., ras.header.cupsWidth, ras.band_height));
-	  CGContextRestoreGState(context);
-
-	  CGContextSaveGState(context);
-	    if (Verbosity > 1)
-	      fprintf(stderr, "DEBUG: Band translate 0.0,%g\n", y / yscale);
-	    CGContextTranslateCTM(context, 0.0, y / yscale);
-	    CGContextConcatCTM(context, transform);
-
-	    CGContextClipToRect(context, CGPDFPageGetBoxRect(pdf_page, kCGPDFCropBox));
-	    CGContextDrawPDFPage(context, pdf_page);
-	  CGContextRestoreGState(context);
-	}
-
-        // Prepare and write a line...
-	lineptr = ras.band_buffer + (y - band_starty) * band_size + ras.left * ras.band_bpp;
-	if (ras.header.cupsBitsPerPixel == 1)
-	  dither_gray(&ras, y, lineptr, ras.right - ras.left);
-	else if (ras.header.cupsColorSpace == CUPS_CSPACE_K)
-	  pack_black(lineptr, ras.right - ras.left);
-	else if (ras.header.cupsBitsPerPixel == 24)
-	  pack_rgba(lineptr, ras.right - ras.left);
-	else if (ras.header.cupsBitsPerPixel == 48)
-	  pack_rgba16(lineptr, ras.right - ras.left);
-
-	(ras.write_line)(&ras, y, lineptr, cb, ctx);
-      }
-
-      (ras.end_page)(&ras, page, cb, ctx);
+        fprintf(stderr, "DEBUG: Replaying copy %d/%d.\n", copy + 1, copies);
 
-      // Log progress...
-      impressions ++;
-      fprintf(stderr, "ATTR: job-impressions-completed=%u\n", impressions);
-      if (!ras.header.Duplex || !(page & 1))
+      if (!xform_cache_replay(&cache, &ras, 0))
       {
-	media_sheets ++;
-	fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", media_sheets);
+        cupsLangPrintf(stderr, _("%s: Unable to send data."), Prefix);
+        ret = false;
       }
     }
-
-    if (options->copies > 1 && (pages & 1) && ras.header.Duplex)
+    else
     {
-      // Duplex printing, add a blank back side image...
-      unsigned	y;		// Current line
-
-      if (Verbosity > 1)
-	fprintf(stderr, "DEBUG: Printing blank page %u for duplex.\n", pages + 1);
-
-      memset(ras.band_buffer, 255, ras.header.cupsBytesPerLine);
-
-      if (!(ras.start_page)(&ras, page, cb, ctx))
-        break;
+      // Render the page...
+      if (use_cache && copy == 0)
+        xform_cache_start_page(&cache);
 
-      for (y = ras.top; y < ras.bottom; y ++)
-	(ras.write_line)(&ras, y, ras.band_buffer, cb, ctx);
+      ret = xform_image_page(&ras, filename, options, page, cb, ctx);
 
-      (ras.end_page)(&ras, page, cb, ctx);
-
-      impressions ++;
-      fprintf(stderr, "ATTR: job-impressions-completed=%u\n", impressions);
-      if (!ras.header.Duplex || !(page & 1))
-      {
-	media_sheets ++;
-	fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", media_sheets);
-      }
+      if (use_cache && copy == 0)
+        xform_cache_end_page(&cache, &ras);
     }
 
+    // Log progress...
+    fprintf(stderr, "ATTR: job-impressions-completed=%u\n", page);
+    fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", page);
+
     // Write a separator sheet as needed...
     switch (options->separator_type)
     {
@@ -4554,361 +7005,505 @@ xform_document(
     }
   }
 
-  CGPDFDocumentRelease(document);
   (ras.end_job)(&ras, cb, ctx);
 
-  // Clean up...
-  CGContextRelease(context);
-
-  free(ras.band_buffer);
-  ras.band_buffer = NULL;
+  xform_cache_free(&cache);
 
-  return (true);
+  return (ret);
 }
 
 
-#else // pdftoppm
 //
-// 'xform_document()' - Transform a file for printing.
+// 'xform_image_check()' - Check whether an image can be printed directly.
+//
+// Only single PNG images without page layout options can be printed directly.
+// Rotated images are decoded into memory and are limited in size.
 //
 
-static bool				// O - `true` on success, `false` on error
-xform_document(
-    const char       *filename,		// I - File to transform
-    unsigned         pages,		// I - Number of pages
-    ipp_options_t    *options,		// I - IPP options
-    const char       *outformat,	// I - Output format (MIME media type)
-    const char       *resolutions,	// I - Supported resolutions
-    const char       *sheet_back,	// I - Back side transform
-    const char       *types,		// I - Supported types
-    xform_write_cb_t cb,		// I - Write callback
-    void             *ctx)		// I - Write context
+static bool				// O - `true` if the image can be printed directly, `false` otherwise
+xform_image_check(
+    const char    *filename,		// I - PNG file
+    ipp_options_t *options)		// I - IPP options
 {
-  xform_raster_t ras;			// Raster information
-  int		copy,			// Current copy
-		copies;			// Number of collated copies
-  unsigned	page = 0,		// Current page
-		media_sheets = 0,
-		impressions = 0;	// Page/sheet counters
-  char		command[1024],		// pdftoppm command
-		output[1024];		// Ouptut from pdftoppm
-  FILE		*fp;			// Pipe for output
-  char		header[256];		// Header from file
-  unsigned char	*line = NULL,		// Pixel line from file
-		*linein,		// Pointer to input pixels
-		*lineout;		// Pointer to output pixels
-  size_t	linesize;		// Size of a line...
-  bool		poppler = false;	// Are we using Poppler's pdftoppm?
+  xform_png_t	*png;			// PNG image
+  pdfio_rect_t	media,			// Media box
+		crop,			// Crop box
+		rect;			// Image rectangle
+  bool		ret;			// Return value
+
+
+  // Check for options that need the PDF path...
+  if (options->number_up > 1 || (options->imposition_template[0] && strcmp(options->imposition_template, "none")) || (options->job_sheets[0] && strcmp(options->job_sheets, "none")) || cupsArrayGetCount(options->overrides) > 0 || !ippOptionsCheckPage(options, 1) || (options->orientation_requested != IPP_ORIENT_NONE && options->orientation_requested != IPP_ORIENT_PORTRAIT))
+    return (false);
+
+  // Then check the image itself...
+  if ((png = xformPNGOpen(filename)) == NULL)
+    return (false);
+
+  media_to_rect(&options->media, &media, &crop);
+
+  ret = prepare_image(options, &crop, xformPNGGetWidth(png), xformPNGGetHeight(png), &rect) == 0 || ((size_t)xformPNGGetWidth(png) * xformPNGGetHeight(png) * xformPNGGetColors(png)) <= XFORM_MAX_IMAGE;
 
+  xformPNGClose(png);
+
+  return (ret);
+}
+
+
+//
+// 'xform_image_page()' - Render an image page.
+//
+// Each output line is computed from the source rows it covers, averaging them
+// when shrinking and interpolating when enlarging, and then scaled
+// horizontally using a precomputed table.
+//
 
-  // Find the pdftoppm program...
-  if (!cupsFileFind("pdftoppm", getenv("PATH"), true, PdftoppmCommand, sizeof(PdftoppmCommand)))
-  {
-    cupsLangPrintf(stderr, _("%s: Unable to find pdftoppm helper program."), Prefix);
+static bool				// O - `true` on success, `false` on failure
+xform_image_page(
+    xform_raster_t   *ras,		// I - Raster information
+    const char       *filename,		// I - PNG file
+    ipp_options_t    *options,		// I - IPP options
+    unsigned         page,		// I - Page number
+    xform_write_cb_t cb,		// I - Write callback
+    void             *ctx)		// I - Write context
+{
+  bool		ret = false;		// Return value
+  xform_image_t	img;			// Image source
+  unsigned	iw, ih,			// Image width and height
+		r, c,			// Looping vars
+		x, y,			// Current device position
+		i, j,			// Looping vars
+		vx0, vx1, vy0, vy1,	// Visible device rectangle
+		wcolors,		// Working colors (1 or 3)
+		bpp,			// Device bytes per pixel
+		sum[3];			// Sums for each color
+  int		irot;			// Image rotation
+  ptrdiff_t	base,			// Base offset for rotated row
+		step;			// Step for rotated row
+  pdfio_rect_t	media,			// Media box
+		crop,			// Crop box
+		rect;			// Image rectangle
+  double	xscale, yscale,		// Device pixels per point
+		ix0, iy0,		// Device position of image
+		iwidth, iheight,	// Device size of image
+		sx, sy;			// Source pixels per device pixel
+  xform_itab_t	*xtab = NULL,		// Horizontal scaling table
+		ytab;			// Vertical scaling entry
+  unsigned	*accum = NULL;		// Accumulated source row
+  unsigned char	*row = NULL,		// Decoded image row
+		*vrow = NULL,		// Vertically scaled row
+		*line = NULL,		// Output line
+		*lineptr,		// Pointer into output line
+		*lineout;		// Output pixels
+  const unsigned char *srow,		// Source row
+		*srow2,			// Second source row
+		*vptr;			// Pointer into vertically scaled row
+
+
+  // Open the image and figure out where it goes...
+  memset(&img, 0, sizeof(img));
+
+  if ((img.png = xformPNGOpen(filename)) == NULL)
+  {
+    cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), Prefix, filename, strerror(errno));
     return (false);
   }
 
-  // Setup the raster headers...
-  if (!xform_setup(&ras, options, outformat, resolutions, sheet_back, types, true, pages))
-    return (false);
+  iw         = xformPNGGetWidth(img.png);
+  ih         = xformPNGGetHeight(img.png);
+  img.colors = xformPNGGetColors(img.png);
 
-  fprintf(stderr, "ATTR: job-impressions=%d\n", pages);
-  fprintf(stderr, "ATTR: job-pages=%d\n", pages);
+  media_to_rect(&options->media, &media, &crop);
+  irot = prepare_image(options, &crop, iw, ih, &rect);
 
-  if (ras.header.Duplex)
-    fprintf(stderr, "ATTR: job-media-sheets=%d\n", (pages + 1) / 2);
+  if (irot & 1)
+  {
+    img.width  = ih;
+    img.height = iw;
+  }
   else
-    fprintf(stderr, "ATTR: job-media-sheets=%d\n", pages);
+  {
+    img.width  = iw;
+    img.height = ih;
+  }
 
   if (Verbosity > 1)
-    fprintf(stderr, "DEBUG: cupsPageSize=[%g %g]\n", ras.header.cupsPageSize[0], ras.header.cupsPageSize[1]);
+    fprintf(stderr, "DEBUG: Image is %ux%u, colors=%u, irot=%d, rect=[%g %g %g %g]\n", iw, ih, img.colors, irot, rect.x1, rect.y1, rect.x2, rect.y2);
 
-  (ras.start_job)(&ras, cb, ctx);
+  // Allocate memory...
+  wcolors = ras->header.cupsNumColors > 1 ? 3 : 1;
+  bpp     = ras->header.cupsBitsPerPixel < 8 ? 1 : ras->header.cupsBitsPerPixel / 8;
 
-  if (options->multiple_document_handling == IPPOPT_HANDLING_UNCOLLATED_COPIES)
-  {
-    // Uncollated copies are handled by the printer/driver...
-    ras.header.NumCopies      = options->copies;
-    ras.back_header.NumCopies = options->copies;
-    ras.sep_header.NumCopies  = options->copies;
-    copies                    = 1;
-  }
-  else
+  if ((row = malloc((size_t)iw * img.colors)) == NULL || (vrow = malloc((size_t)img.width * img.colors)) == NULL || (accum = malloc((size_t)img.width * img.colors * sizeof(unsigned))) == NULL || (line = malloc((size_t)ras->header.cupsWidth * (bpp > wcolors ? bpp : wcolors))) == NULL || (xtab = calloc(ras->header.cupsWidth, sizeof(xform_itab_t))) == NULL)
   {
-    // Collated copies are handled by ipptransform...
-    ras.header.NumCopies      = 1;
-    ras.back_header.NumCopies = 1;
-    ras.sep_header.NumCopies  = 1;
-    copies                    = options->copies;
+    cupsLangPrintf(stderr, _("%s: Out of memory."), Prefix);
+    goto done;
   }
 
-  for (copy = 0; copy < copies; copy ++)
+  if (irot)
   {
-    // Write a separator sheet as needed...
-    switch (options->separator_type)
+    // Decode rotated images into memory...
+    if ((img.pixels = malloc((size_t)iw * ih * img.colors)) == NULL)
     {
-      case IPPOPT_SEPTYPE_NONE :
-      case IPPOPT_SEPTYPE_END_SHEET :
-          break;
-
-      case IPPOPT_SEPTYPE_SLIP_SHEETS :
-          if (copy == 0)
-            break;
-
-      case IPPOPT_SEPTYPE_START_SHEET :
-      case IPPOPT_SEPTYPE_BOTH_SHEETS :
-          xform_separator(&ras, cb, ctx);
-          break;
+      cupsLangPrintf(stderr, _("%s: Out of memory."), Prefix);
+      goto done;
     }
 
-    // There are two versions of the pdftoppm command - the one that comes with
-    // Xpdf and the one that comes with Poppler which forked from Xpdf in the
-    // v3.0 days.  Unfortunately, the two commands have drifted apart so we need
-    // to determine *which* pdftoppm command is available...
-#if _WIN32
-    snprintf(command, sizeof(command), "%s -v", PdftoppmCommand);
-    if ((fp = _popen(command, "r")) != NULL)
-#else
-    snprintf(command, sizeof(command), "%s -v 2>&1", PdftoppmCommand);
-    if ((fp = popen(command, "r")) != NULL)
-#endif // _WIN32
+    for (r = 0; r < ih; r ++)
     {
-      while (fgets(output, sizeof(output), fp))
+      if (!xformPNGReadRow(img.png, row))
       {
-        if (strstr(output, "oppler"))
-          poppler = true;
+        cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), Prefix, filename, strerror(EINVAL));
+        goto done;
       }
 
-#if _WIN32
-      _pclose(fp);
-#else
-      pclose(fp);
-#endif // _WIN32
+      switch (irot)
+      {
+        case 1 :
+            base = (ptrdiff_t)(ih - 1 - r);
+            step = (ptrdiff_t)ih;
+            break;
+        case 2 :
+            base = (ptrdiff_t)(ih - 1 - r) * iw + iw - 1;
+            step = -1;
+            break;
+        default :
+            base = (ptrdiff_t)(iw - 1) * ih + r;
+            step = -(ptrdiff_t)ih;
+            break;
+      }
 
-      fprintf(stderr, "DEBUG: Using %s version of pdftoppm.\n", poppler ? "Poppler" : "Xpdf");
-    }
-    else
-    {
-      cupsLangPrintf(stderr, _("%s: Unable to run pdftoppm command: %s"), Prefix, strerror(errno));
-      return (false);
+      for (c = 0, srow = row; c < iw; c ++, srow += img.colors, base += step)
+        memcpy(img.pixels + base * (ptrdiff_t)img.colors, srow, img.colors);
     }
+  }
+  else if ((img.rows[0] = malloc((size_t)iw * img.colors)) == NULL || (img.rows[1] = malloc((size_t)iw * img.colors)) == NULL)
+  {
+    cupsLangPrintf(stderr, _("%s: Out of memory."), Prefix);
+    goto done;
+  }
 
-    // Run the pdftoppm command:
-    //
-    //   Poppler:
-    //     pdftoppm [-gray] -thinlinemode solid -aa no -r resolution -scale-to HEIGHT filename
-    //
-    //   Xpdf:
-    //     pdftoppm [-gray] -aa no -r resolution filename -
-    if (poppler)
-      snprintf(command, sizeof(command), "%s %s -aa no -r %u -scale-to %u '%s'", PdftoppmCommand, ras.header.cupsBitsPerPixel <= 8 ? "-gray" : "", ras.header.HWResolution[0], ras.header.cupsHeight, filename);
-    else
-      snprintf(command, sizeof(command), "%s %s -aa no -r %u '%s' -", PdftoppmCommand, ras.header.cupsBitsPerPixel <= 8 ? "-gray" : "", ras.header.HWResolution[0], filename);
+  // Start the page...
+  if (!(ras->start_page)(ras, page, cb, ctx))
+    goto done;
 
-    fprintf(stderr, "DEBUG: Running \"%s\".\n", command);
-#if _WIN32
-    if ((fp = _popen(command, "rb")) == NULL)
-#else
-    if ((fp = popen(command, "r")) == NULL)
-#endif // _WIN32
+  ras->out_length = ((ras->right - ras->left) * ras->header.cupsBitsPerPixel + 7) / 8;
+
+  // Compute the visible part of the image in device pixels...
+  xscale  = ras->header.HWResolution[0] / 72.0;
+  yscale  = ras->header.HWResolution[1] / 72.0;
+  ix0     = rect.x1 * xscale;
+  iy0     = (media.y2 - rect.y2) * yscale;
+  iwidth  = (rect.x2 - rect.x1) * xscale;
+  iheight = (rect.y2 - rect.y1) * yscale;
+  sx      = img.width / iwidth;
+  sy      = img.height / iheight;
+
+  vx0 = (unsigned)(ix0 > crop.x1 * xscale ? ix0 + 0.5 : crop.x1 * xscale + 0.5);
+  vx1 = (unsigned)((ix0 + iwidth) < crop.x2 * xscale ? ix0 + iwidth + 0.5 : crop.x2 * xscale + 0.5);
+  vy0 = (unsigned)(iy0 > (media.y2 - crop.y2) * yscale ? iy0 + 0.5 : (media.y2 - crop.y2) * yscale + 0.5);
+  vy1 = (unsigned)((iy0 + iheight) < (media.y2 - crop.y1) * yscale ? iy0 + iheight + 0.5 : (media.y2 - crop.y1) * yscale + 0.5);
+
+  if (vx0 < ras->left)
+    vx0 = ras->left;
+  if (vx1 > ras->right)
+    vx1 = ras->right;
+  if (vy0 < ras->top)
+    vy0 = ras->top;
+  if (vy1 > ras->bottom)
+    vy1 = ras->bottom;
+
+  if (vx0 < vx1)
+    xform_image_table(xtab + vx0, vx1 - vx0, vx0 - ix0, sx, img.width);
+
+  // Write each line...
+  for (y = ras->top, ret = true; y < ras->bottom; y ++)
+  {
+    memset(line, 255, (size_t)ras->header.cupsWidth * wcolors);
+
+    if (y >= vy0 && y < vy1 && vx0 < vx1 && ret)
     {
-      cupsLangPrintf(stderr, _("%s: Unable to run pdftoppm command: %s"), Prefix, strerror(errno));
-      return (false);
-    }
+      // Scale the source rows for this line vertically...
+      xform_image_table(&ytab, 1, y - iy0, sy, img.height);
 
-    // Read lines from the file...
-    while (fgets(header, sizeof(header), fp))
-    {
-      // Got the P4/5/6 header...
-      unsigned	y,			// Current Y position
-		ystart,			// Start Y position
-		yend;			// End Y position
-      unsigned	width, height;		// Width and height from image...
-      unsigned	bpp;			// Bytes per pixel
-
-      if (!strcmp(header, "P5\n"))
+      if ((srow = xform_image_row(&img, ytab.start)) == NULL)
       {
-        bpp = 1;
+        ret = false;
       }
-      else if (!strcmp(header, "P6\n"))
+      else if (ytab.count == 1 && ytab.weight == 0)
       {
-        bpp = 3;
+        // Use a single source row as-is...
+        vptr = srow;
       }
-      else
+      else if (ytab.weight)
       {
-        cupsLangPrintf(stderr, _("%s: Bad page header - <%02X%02X%02X%02X%02X%02X%02X%02X>"), Prefix, header[0] & 255, header[1] & 255, header[2] & 255, header[3] & 255, header[4] & 255, header[5] & 255, header[6] & 255, header[7] & 255);
-        break;
-      }
+        // Interpolate between two source rows...
+        if ((srow2 = xform_image_row(&img, ytab.start + 1)) == NULL)
+        {
+          ret = false;
+        }
+        else
+        {
+          for (i = 0; i < (img.width * img.colors); i ++)
+            vrow[i] = (unsigned char)((srow[i] * (256 - ytab.weight) + srow2[i] * ytab.weight) >> 8);
+        }
 
-      if (Verbosity)
-      {
-	header[strlen(header) - 1] = '\0';
-        fprintf(stderr, "DEBUG: '%s'\n", header);
+        vptr = vrow;
       }
-
-      // Now get the bitmap dimensions...
-      if (!fgets(header, sizeof(header), fp))
-        break;
-
-      if (Verbosity)
+      else
       {
-	header[strlen(header) - 1] = '\0';
-        fprintf(stderr, "DEBUG: '%s'\n", header);
-      }
+        // Average the source rows...
+        for (i = 0; i < (img.width * img.colors); i ++)
+          accum[i] = srow[i];
 
-      if (sscanf(header, "%u%u", &width, &height) != 2 || width > 0x10000000 || height > 0x40000000)
-      {
-        cupsLangPrintf(stderr, _("%s: Bad page dimensions - <%02X%02X%02X%02X%02X%02X%02X%02X>"), Prefix, header[0] & 255, header[1] & 255, header[2] & 255, header[3] & 255, header[4] & 255, header[5] & 255, header[6] & 255, header[7] & 255);
-        break;
-      }
+        for (j = 1; j < ytab.count && ret; j ++)
+        {
+          if ((srow = xform_image_row(&img, ytab.start + j)) == NULL)
+            ret = false;
+          else
+          {
+            for (i = 0; i < (img.width * img.colors); i ++)
+              accum[i] += srow[i];
+          }
+        }
 
-      if (width > ras.header.cupsWidth)
-        linesize = width * bpp;
-      else
-	linesize = ras.header.cupsWidth * bpp;
+        for (i = 0; i < (img.width * img.colors); i ++)
+          vrow[i] = (unsigned char)(accum[i] / ytab.count);
 
-      if ((line = malloc(linesize)) == NULL)
-      {
-	cupsLangPrintf(stderr, _("%s: Out of memory."), Prefix);
-#if _WIN32
-        _pclose(fp);
-#else
-        pclose(fp);
-#endif // _WIN32
-	return (false);
+        vptr = vrow;
       }
 
-      if (width > ras.header.cupsWidth)
+      if (!ret)
       {
-        linein  = line;
-        lineout = line + ((width - ras.header.cupsWidth) / 2 + ras.left) * bpp;
+        cupsLangPrintf(stderr, _("%s: Unable to open '%s': %s"), Prefix, filename, strerror(EINVAL));
       }
       else
       {
-        linein  = line + (ras.header.cupsWidth - width) / 2 * bpp;
-        lineout = line + ras.left * bpp;
-      }
+        // Then scale horizontally and convert to the working colors...
+        for (x = vx0, lineptr = line + x * wcolors; x < vx1; x ++, lineptr += wcolors)
+        {
+          const unsigned char *sptr = vptr + xtab[x].start * img.colors;
+					// Pointer to source pixel
 
-      if (height > ras.header.cupsHeight)
-      {
-        ystart = (height - ras.header.cupsHeight) / 2;
-        yend   = ystart + ras.header.cupsHeight;
-      }
-      else
-      {
-        ystart = (ras.header.cupsHeight - height) / 2;
-        yend   = ystart + height;
-      }
+          if (xtab[x].weight)
+          {
+            for (i = 0; i < img.colors; i ++)
+              sum[i] = (sptr[i] * (256 - xtab[x].weight) + sptr[i + img.colors] * xtab[x].weight) >> 8;
+          }
+          else if (xtab[x].count == 1)
+          {
+            for (i = 0; i < img.colors; i ++)
+              sum[i] = sptr[i];
+          }
+          else
+          {
+            for (i = 0; i < img.colors; i ++)
+              sum[i] = 0;
 
-      memset(line, ras.white, linesize);
+            for (j = xtab[x].count; j > 0; j --, sptr += img.colors)
+            {
+              for (i = 0; i < img.colors; i ++)
+                sum[i] += sptr[i];
+            }
 
-      // Skip max value line...
-      if (!fgets(header, sizeof(header), fp))
-        break;
+            for (i = 0; i < img.colors; i ++)
+              sum[i] /= xtab[x].count;
+          }
 
-      if (Verbosity)
+          if (wcolors == 1 && img.colors == 3)
+          {
+            *lineptr = (unsigned char)((sum[0] * 31 + sum[1] * 61 + sum[2] * 8) / 100);
+          }
+          else if (wcolors == 3 && img.colors == 1)
+          {
+            lineptr[0] = lineptr[1] = lineptr[2] = (unsigned char)sum[0];
+          }
+          else
+          {
+            for (i = 0; i < wcolors; i ++)
+              lineptr[i] = (unsigned char)sum[i];
+          }
+        }
+      }
+    }
+
+    // Convert to the output format and write the line...
+    if (ras->header.cupsBitsPerPixel == 1)
+    {
+      xformDitherGray(ras->dither[y & 63], ras->white, line + ras->left, ras->right - ras->left);
+      lineout = line + ras->left;
+    }
+    else if (ras->header.cupsColorSpace == CUPS_CSPACE_K)
+    {
+      xformPackBlack(line + ras->left, ras->right - ras->left);
+      lineout = line + ras->left;
+    }
+    else if (ras->header.cupsColorSpace == CUPS_CSPACE_CMYK)
+    {
+      // Simple RGB to CMYK conversion with black generation, working backwards
+      // since CMYK pixels are larger than RGB pixels...
+      for (x = ras->right; x > ras->left;)
       {
-	header[strlen(header) - 1] = '\0';
-        fprintf(stderr, "DEBUG: '%s'\n", header);
-        fprintf(stderr, "DEBUG: width=%u, height=%u, bpp=%u, ystart=%u, yend=%u\n", width, height, bpp, ystart, yend);
+        unsigned char	cc, mm, yy, kk;	// CMYK values
+
+        x --;
+        lineptr = line + 3 * x;
+        cc      = (unsigned char)(255 - lineptr[0]);
+        mm      = (unsigned char)(255 - lineptr[1]);
+        yy      = (unsigned char)(255 - lineptr[2]);
+        kk      = cc < mm ? (cc < yy ? cc : yy) : (mm < yy ? mm : yy);
+        lineptr = line + 4 * x;
+
+        lineptr[0] = (unsigned char)(cc - kk);
+        lineptr[1] = (unsigned char)(mm - kk);
+        lineptr[2] = (unsigned char)(yy - kk);
+        lineptr[3] = kk;
       }
 
-      // Send the page to the driver...
-      page ++;
+      lineout = line + 4 * ras->left;
+    }
+    else
+    {
+      lineout = line + ras->left * bpp;
+    }
 
-      if (!(ras.start_page)(&ras, page, cb, ctx))
-        break;
+    if (!(ras->write_line)(ras, y, lineout, cb, ctx))
+    {
+      ret = false;
+      goto done;
+    }
+  }
 
-      ras.out_length = ((ras.right - ras.left) * ras.header.cupsBitsPerPixel + 7) / 8;
+  if (!(ras->end_page)(ras, page, cb, ctx))
+    ret = false;
 
-      if (height > ras.header.cupsHeight)
-      {
-        // Skip leading lines...
-        for (y = 0; y < ystart; y ++)
-          fread(linein, width, bpp, fp);
-      }
-      else
-      {
-        // Write leading blank lines...
-        for (y = 0; y < ystart; y ++)
-          (ras.write_line)(&ras, y, lineout, cb, ctx);
-      }
+  done:
 
-      for (; y < yend; y ++)
-      {
-        // Copy lines...
-        memset(line, 255, linesize);
+  xformPNGClose(img.png);
+  free(img.pixels);
+  free(img.rows[0]);
+  free(img.rows[1]);
+  free(row);
+  free(vrow);
+  free(accum);
+  free(line);
+  free(xtab);
 
-        if (fread(linein, width, bpp, fp))
-        {
-	  if (ras.header.cupsBitsPerPixel == 1)
-	    dither_gray(&ras, y, lineout, ras.right - ras.left);
-	  else if (ras.header.cupsColorSpace == CUPS_CSPACE_K)
-	    pack_black(lineout, ras.right - ras.left);
+  return (ret);
+}
 
-          (ras.write_line)(&ras, y, lineout, cb, ctx);
-        }
-      }
 
-      if (height > ras.header.cupsHeight)
-      {
-        // Skip trailing lines...
-        for (; y < height; y ++)
-          fread(linein, width, bpp, fp);
-      }
-      else
-      {
-        // Write trailing blank lines...
-        memset(line, ras.white, linesize);
+//
+// 'xform_image_row()' - Get a row from the image source.
+//
+// Streamed rows must be requested in increasing order; the current and
+// previous rows are kept for interpolation.
+//
 
-        for (; y < ras.header.cupsHeight; y ++)
-          (ras.write_line)(&ras, y, lineout, cb, ctx);
-      }
+static const unsigned char *		// O - Row pixels or `NULL` on error
+xform_image_row(xform_image_t *img,	// I - Image source
+                unsigned      row)	// I - Row number
+{
+  unsigned char	*buffer;		// Row buffer
 
-      (ras.end_page)(&ras, page, cb, ctx);
 
-      free(line);
-      line = NULL;
+  if (row >= img->height)
+    row = img->height - 1;
 
-      // Log progress...
-      impressions ++;
-      fprintf(stderr, "ATTR: job-impressions-completed=%u\n", impressions);
-      if (!ras.header.Duplex || !(page & 1))
-      {
-	media_sheets ++;
-	fprintf(stderr, "ATTR: job-media-sheets-completed=%u\n", media_sheets);
-      }
-    }
+  if (img->pixels)
+    return (img->pixels + (size_t)row * img->width * img->colors);
 
-    // Close things out...
-#if _WIN32
-    _pclose(fp);
-#else
-    pclose(fp);
-#endif // _WIN32
+  if (img->rownum[row & 1] == (row + 1))
+    return (img->rows[row & 1]);
 
-    // Write a separator sheet as needed...
-    switch (options->separator_type)
-    {
-      case IPPOPT_SEPTYPE_NONE :
-      case IPPOPT_SEPTYPE_START_SHEET :
-      case IPPOPT_SEPTYPE_SLIP_SHEETS :
-	  break;
+  if (row < img->next)
+    return (NULL);
 
-      case IPPOPT_SEPTYPE_END_SHEET :
-      case IPPOPT_SEPTYPE_BOTH_SHEETS :
-          xform_separator(&ras, cb, ctx);
-          break;
-    }
+  // Read up to the requested row, skipping any rows in between...
+  buffer = img->rows[row & 1];
+
+  while (img->next <= row)
+  {
+    if (!xformPNGReadRow(img->png, buffer))
+      return (NULL);
+
+    img->next ++;
   }
 
-  free(line);
+  img->rownum[row & 1] = row + 1;
 
-  (ras.end_job)(&ras, cb, ctx);
+  return (buffer);
+}
 
-  return (true);
+
+//
+// 'xform_image_table()' - Compute the source pixels for each output pixel.
+//
+// When shrinking, each output pixel covers one or more source pixels that are
+// averaged.  When enlarging, each output pixel interpolates between two source
+// pixels.
+//
+
+static void
+xform_image_table(
+    xform_itab_t *table,		// I - Table entries
+    unsigned     count,			// I - Number of entries
+    double       start,			// I - Position of first entry relative to the image
+    double       scale,			// I - Source pixels per output pixel
+    unsigned     size)			// I - Number of source pixels
+{
+  double	pos;			// Source position
+  unsigned	first,			// First source pixel
+		last;			// Last source pixel (exclusive)
+
+
+  for (; count > 0; count --, table ++, start += 1.0)
+  {
+    if (scale >= 1.0)
+    {
+      // Shrinking, average the covered pixels...
+      pos   = start * scale;
+      first = pos > 0.0 ? (unsigned)pos : 0;
+      pos   = (start + 1.0) * scale;
+      last  = pos > 0.0 ? (unsigned)pos : 0;
+
+      if (first >= size)
+        first = size - 1;
+      if (last > size)
+        last = size;
+      if (last <= first)
+        last = first + 1;
+
+      table->start  = first;
+      table->count  = last - first;
+      table->weight = 0;
+    }
+    else
+    {
+      // Enlarging, interpolate between the nearest pixels...
+      pos = (start + 0.5) * scale - 0.5;
+
+      if (pos <= 0.0)
+      {
+        table->start  = 0;
+        table->weight = 0;
+      }
+      else if (pos >= (size - 1))
+      {
+        table->start  = size - 1;
+        table->weight = 0;
+      }
+      else
+      {
+        table->start  = (unsigned)pos;
+        table->weight = (unsigned)(256.0 * (pos - table->start));
+      }
+
+      table->count = 1;
+    }
+  }
 }
-#endif // HAVE_COREGRAPHICS_H
+#endif // !HAVE_COREGRAPHICS_H
 
 
 //
@@ -4920,7 +7515,8 @@ xform_separator(xform_raster_t   *ras,	// I - Raster information
                 xform_write_cb_t cb,	// I - Write callback
                 void             *ctx)	// I - Callback data
 {
-  bool		ret = false;		// Return value
+  bool		ret = false,		// Return value
+		skip;			// Skip blank pages?
   unsigned	i,			// Current page
 		count,			// Number of pages
 		y;			// Current line on page
@@ -4972,20 +7568,24 @@ xform_separator(xform_raster_t   *ras,	// I - Raster information
         break;
   }
 
-  // Produce 1 or 2 blank pages...
+  // Produce 1 or 2 blank pages, which must not be skipped...
   count = ras->sep_header.Duplex ? 2 : 1;
+  skip  = ras->blank_skip;
 
-  for (i = 0; i < count; i ++)
+  ras->blank_skip = false;
+
+  for (i = 0, ret = true; i < count && ret; i ++)
   {
-    (ras->start_page)(ras, i + 1, cb, ctx);
+    ret = (ras->start_page)(ras, i + 1, cb, ctx);
 
-    for (y = 0; y < ras->sep_header.cupsHeight; y ++)
-      (ras->write_line)(ras, y, line, cb, ctx);
+    for (y = 0; y < ras->sep_header.cupsHeight && ret; y ++)
+      ret = (ras->write_line)(ras, y, line, cb, ctx);
 
-    (ras->end_page)(ras, i + 1, cb, ctx);
+    if (ret)
+      ret = (ras->end_page)(ras, i + 1, cb, ctx);
   }
 
-  ret = true;
+  ras->blank_skip = skip;
 
   done:
 
@@ -5210,6 +7810,15 @@ xform_setup(xform_raster_t *ras,	// I - Raster information
   ras->header.cupsInteger[CUPS_RASTER_PWG_TotalPageCount]      = (unsigned)options->copies * pages;
   ras->back_header.cupsInteger[CUPS_RASTER_PWG_TotalPageCount] = (unsigned)options->copies * pages;
 
+  if (SkipBlankPages && !ras->header.Duplex && strcasecmp(format, "image/urf"))
+  {
+    // Skip blank pages - not for duplex output since that would change which
+    // pages are printed on the back side, or Apple raster since the page
+    // count is written at the start of the file...
+    ras->header.cupsInteger[CUPS_RASTER_PWG_TotalPageCount] = 0;
+    xform_blank_init(ras);
+  }
+
   if (Verbosity)
   {
     fprintf(stderr, "DEBUG: cupsColorSpace=%u\n", ras->header.cupsColorSpace);
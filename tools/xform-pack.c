@@ -0,0 +1,307 @@
+//
+// Pixel dithering and packing functions for ipptransform.
+//
+// Copyright © 2026 by OpenPrinting.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// The vector code paths use the baseline instruction set of the target CPU
+// (SSE2 on x86-64, NEON on ARM64) so no runtime detection is needed.  Other
+// CPUs use the portable C code, which is also used for any trailing pixels.
+//
+
+#include "xform-pack.h"
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define XFORM_SSE2 1
+#  ifdef __SSSE3__
+#    include <tmmintrin.h>
+#    define XFORM_SSSE3 1
+#  endif // __SSSE3__
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define XFORM_NEON 1
+#endif // __SSE2__ || _M_X64 || _M_IX86_FP
+
+
+//
+// Constants...
+//
+
+#define XFORM_RED_MASK		0x000000ff
+#define XFORM_GREEN_MASK	0x0000ff00
+#define XFORM_BLUE_MASK		0x00ff0000
+#define XFORM_RGB_MASK		(XFORM_RED_MASK | XFORM_GREEN_MASK |  XFORM_BLUE_MASK)
+#define XFORM_BG_MASK		(XFORM_BLUE_MASK | XFORM_GREEN_MASK)
+#define XFORM_RG_MASK		(XFORM_RED_MASK | XFORM_GREEN_MASK)
+
+
+//
+// 'xformDitherGray()' - Dither grayscale pixels.
+//
+// The "dither" argument points to the 64-entry threshold row for the current
+// line.  Pixels less than or equal to the threshold toggle the corresponding
+// bit in the "white" value.  The packed bits are written back to the start of
+// "row".
+//
+
+void
+xformDitherGray(
+    const unsigned char *dither,	// I - Threshold row (64 values)
+    unsigned char       white,		// I - White byte value
+    unsigned char       *row,		// I - Row pointer
+    size_t              num_pixels)	// I - Number of pixels
+{
+  size_t		x = 0;		// Column number
+  unsigned char		bit,		// Current bit
+			byte,		// Current byte
+			*rowptr = row;	// Pointer into output bytes
+  const unsigned char	*pixel = row,	// Pointer into input pixels
+			*ditherptr;	// Pointer into threshold row
+
+
+#ifdef XFORM_SSE2
+  // Compare 16 pixels at a time and collect the results using movemask...
+  for (; (x + 16) <= num_pixels; x += 16, pixel += 16, rowptr += 2)
+  {
+    __m128i	pixels = _mm_loadu_si128((const __m128i *)pixel),
+		thresholds = _mm_loadu_si128((const __m128i *)(dither + (x & 63))),
+		mask;			// 0xFF where pixel <= threshold
+    unsigned	bits;			// Packed bits
+
+    mask = _mm_cmpeq_epi8(_mm_min_epu8(pixels, thresholds), pixels);
+
+    // Reverse the bytes in each half so the first pixel ends up in the MSB...
+    mask = _mm_shufflelo_epi16(mask, _MM_SHUFFLE(0, 1, 2, 3));
+    mask = _mm_shufflehi_epi16(mask, _MM_SHUFFLE(0, 1, 2, 3));
+    mask = _mm_or_si128(_mm_slli_epi16(mask, 8), _mm_srli_epi16(mask, 8));
+    bits = (unsigned)_mm_movemask_epi8(mask);
+
+    rowptr[0] = (unsigned char)(bits ^ white);
+    rowptr[1] = (unsigned char)((bits >> 8) ^ white);
+  }
+
+#elif defined(XFORM_NEON)
+  // Compare 16 pixels at a time and sum the weighted results...
+  static const unsigned char weights[16] = { 128, 64, 32, 16, 8, 4, 2, 1, 128, 64, 32, 16, 8, 4, 2, 1 };
+  uint8x16_t	vweights = vld1q_u8(weights);
+					// Bit weights
+
+  for (; (x + 16) <= num_pixels; x += 16, pixel += 16, rowptr += 2)
+  {
+    uint8x16_t	mask;			// Weighted bits
+    uint8x8_t	bits;			// Packed bits
+
+    mask = vandq_u8(vcleq_u8(vld1q_u8(pixel), vld1q_u8(dither + (x & 63))), vweights);
+    bits = vpadd_u8(vget_low_u8(mask), vget_high_u8(mask));
+    bits = vpadd_u8(bits, bits);
+    bits = vpadd_u8(bits, bits);
+
+    rowptr[0] = (unsigned char)(vget_lane_u8(bits, 0) ^ white);
+    rowptr[1] = (unsigned char)(vget_lane_u8(bits, 1) ^ white);
+  }
+#endif // XFORM_SSE2
+
+  // Pack 8 pixels at a time without branches...
+  for (; (x + 8) <= num_pixels; x += 8, pixel += 8)
+  {
+    ditherptr = dither + (x & 63);
+    *rowptr++ = (unsigned char)(white ^ (((pixel[0] <= ditherptr[0]) << 7) |
+                                         ((pixel[1] <= ditherptr[1]) << 6) |
+                                         ((pixel[2] <= ditherptr[2]) << 5) |
+                                         ((pixel[3] <= ditherptr[3]) << 4) |
+                                         ((pixel[4] <= ditherptr[4]) << 3) |
+                                         ((pixel[5] <= ditherptr[5]) << 2) |
+                                         ((pixel[6] <= ditherptr[6]) << 1) |
+                                         (pixel[7] <= ditherptr[7])));
+  }
+
+  // Then any remaining pixels...
+  if (x < num_pixels)
+  {
+    for (bit = 128, byte = white; x < num_pixels; x ++, pixel ++, bit >>= 1)
+    {
+      if (*pixel <= dither[x & 63])
+        byte ^= bit;
+    }
+
+    *rowptr = byte;
+  }
+}
+
+
+//
+// 'xformIsBlank()' - Determine whether a line contains only white pixels.
+//
+// The line is compared 64 bytes (SSE2/NEON) or one machine word at a time,
+// stopping at the first block that contains a non-white byte.
+//
+
+bool					// O - `true` if blank, `false` otherwise
+xformIsBlank(const unsigned char *row,	// I - Line to check
+             unsigned char       white,	// I - White byte value
+             size_t              bytes)	// I - Number of bytes in line
+{
+  size_t	pattern;		// White bytes in a word
+
+
+#ifdef XFORM_SSE2
+  __m128i	vwhite = _mm_set1_epi8((char)white);
+					// White bytes
+
+  for (; bytes >= 64; bytes -= 64, row += 64)
+  {
+    __m128i	diff;			// Non-zero for non-white bytes
+
+    diff = _mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)row), vwhite),
+                        _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + 16)), vwhite));
+    diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + 32)), vwhite));
+    diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + 48)), vwhite));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff)
+      return (false);
+  }
+
+#elif defined(XFORM_NEON)
+  uint8x16_t	vwhite = vdupq_n_u8(white);
+					// White bytes
+
+  for (; bytes >= 64; bytes -= 64, row += 64)
+  {
+    uint8x16_t	diff;			// Non-zero for non-white bytes
+
+    diff = vorrq_u8(veorq_u8(vld1q_u8(row), vwhite), veorq_u8(vld1q_u8(row + 16), vwhite));
+    diff = vorrq_u8(diff, veorq_u8(vld1q_u8(row + 32), vwhite));
+    diff = vorrq_u8(diff, veorq_u8(vld1q_u8(row + 48), vwhite));
+
+    if (vgetq_lane_u64(vreinterpretq_u64_u8(diff), 0) | vgetq_lane_u64(vreinterpretq_u64_u8(diff), 1))
+      return (false);
+  }
+#endif // XFORM_SSE2
+
+  // Compare a word at a time...
+  memset(&pattern, white, sizeof(pattern));
+
+  for (; bytes >= sizeof(size_t); bytes -= sizeof(size_t), row += sizeof(size_t))
+  {
+    size_t	word;			// Current word
+
+    memcpy(&word, row, sizeof(word));
+    if (word != pattern)
+      return (false);
+  }
+
+  // Then any remaining bytes...
+  for (; bytes > 0; bytes --, row ++)
+  {
+    if (*row != white)
+      return (false);
+  }
+
+  return (true);
+}
+
+
+//
+// 'xformPackBlack()' - Pack black pixels.
+//
+
+void
+xformPackBlack(unsigned char *row,	// I - Row of pixels to pack
+               size_t        num_pixels)// I - Number of pixels in row
+{
+#ifdef XFORM_SSE2
+  __m128i	ones = _mm_set1_epi8((char)0xff);
+					// All bits set
+
+  for (; num_pixels >= 16; num_pixels -= 16, row += 16)
+    _mm_storeu_si128((__m128i *)row, _mm_xor_si128(_mm_loadu_si128((const __m128i *)row), ones));
+
+#elif defined(XFORM_NEON)
+  for (; num_pixels >= 16; num_pixels -= 16, row += 16)
+    vst1q_u8(row, vmvnq_u8(vld1q_u8(row)));
+#endif // XFORM_SSE2
+
+  while (num_pixels > 0)
+  {
+    *row = 255 - *row;
+    row ++;
+    num_pixels --;
+  }
+}
+
+
+//
+// 'xformPackRGBA()' - Pack RGBX scanlines into RGB scanlines.
+//
+// This routine is suitable only for 8 bit RGBX data packed into RGB bytes.
+//
+
+void
+xformPackRGBA(unsigned char *row,	// I - Row of pixels to pack
+	      size_t        num_pixels)	// I - Number of pixels in row
+{
+  unsigned char	*src_byte = row;	// Remaining source bytes
+  unsigned char	*dest_byte = row;	// Remaining destination bytes
+
+
+#if defined(XFORM_SSSE3)
+  // Shuffle 4 pixels at a time - each store writes 4 extra bytes that are
+  // overwritten by the next store and never reach unread source pixels...
+  __m128i	shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+					// RGBX to RGB shuffle
+
+  for (; num_pixels >= 4; num_pixels -= 4, src_byte += 16, dest_byte += 12)
+    _mm_storeu_si128((__m128i *)dest_byte, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src_byte), shuffle));
+
+#elif defined(XFORM_NEON)
+  // De-interleave and re-interleave 16 pixels at a time...
+  for (; num_pixels >= 16; num_pixels -= 16, src_byte += 64, dest_byte += 48)
+  {
+    uint8x16x4_t rgbx = vld4q_u8(src_byte);
+					// Source pixels
+    uint8x16x3_t rgb;			// Destination pixels
+
+    rgb.val[0] = rgbx.val[0];
+    rgb.val[1] = rgbx.val[1];
+    rgb.val[2] = rgbx.val[2];
+
+    vst3q_u8(dest_byte, rgb);
+  }
+
+#else
+  // Copy all of the groups of 4 pixels we can...
+  size_t	num_quads = num_pixels / 4;
+					// Number of 4 byte samples to pack
+  unsigned	*quad_row = (unsigned *)row;
+					// 32-bit pixel pointer
+  unsigned	*dest = quad_row;	// Destination pointer
+
+  num_pixels &= 3;
+
+  while (num_quads > 0)
+  {
+    *dest++ = (quad_row[0] & XFORM_RGB_MASK) | (quad_row[1] << 24);
+    *dest++ = ((quad_row[1] & XFORM_BG_MASK) >> 8) |
+              ((quad_row[2] & XFORM_RG_MASK) << 16);
+    *dest++ = ((quad_row[2] & XFORM_BLUE_MASK) >> 16) | (quad_row[3] << 8);
+    quad_row += 4;
+    num_quads --;
+  }
+
+  src_byte  = (unsigned char *)quad_row;
+  dest_byte = (unsigned char *)dest;
+#endif // XFORM_SSSE3
+
+  // Then handle the leftover pixels...
+  while (num_pixels > 0)
+  {
+    *dest_byte++ = *src_byte++;
+    *dest_byte++ = *src_byte++;
+    *dest_byte++ = *src_byte++;
+    src_byte ++;
+    num_pixels --;
+  }
+}
@@ -0,0 +1,26 @@
+//
+// Pixel dithering and packing definitions for ipptransform.
+//
+// Copyright © 2026 by OpenPrinting.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+#ifndef XFORM_PACK_H
+#  define XFORM_PACK_H
+#  include <stdbool.h>
+#  include <stddef.h>
+
+
+//
+// Functions...
+//
+
+extern void	xformDitherGray(const unsigned char *dither, unsigned char white, unsigned char *row, size_t num_pixels);
+extern bool	xformIsBlank(const unsigned char *row, unsigned char white, size_t bytes);
+extern void	xformPackBlack(unsigned char *row, size_t num_pixels);
+extern void	xformPackRGBA(unsigned char *row, size_t num_pixels);
+
+
+#endif // !XFORM_PACK_H
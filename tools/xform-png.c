@@ -0,0 +1,558 @@
+//
+// Streaming PNG image reader for ipptransform.
+//
+// Copyright © 2026 by OpenPrinting.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// This reader decodes non-interlaced PNG images one row at a time, keeping
+// only the current and previous rows in memory.  Rows are returned as 8-bit
+// grayscale or RGB pixels with any transparency composited over white.
+// Interlaced images are not supported and must be printed using the PDF path.
+//
+
+#include "xform-png.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+
+//
+// Constants...
+//
+
+#define XFORM_PNG_MAX_SIZE	0x100000	// Maximum width/height
+
+
+//
+// Types...
+//
+
+struct xform_png_s			// PNG image reader
+{
+  FILE		*fp;			// PNG file
+  unsigned	width,			// Width in columns
+		height,			// Height in lines
+		depth,			// Bits per sample
+		color_type,		// PNG color type
+		channels,		// Samples per pixel
+		colors,			// Output colors per pixel (1 or 3)
+		fbpp,			// Filter bytes per pixel
+		y;			// Current row
+  size_t	stride;			// Bytes per row
+  unsigned char	palette[256][4];	// Palette entries (RGBA)
+  unsigned char	*cur,			// Current row with filter byte
+		*prev;			// Previous row with filter byte
+  z_stream	stream;			// Inflate stream
+  bool		stream_init;		// Is the inflate stream initialized?
+  size_t	remaining;		// Bytes remaining in current IDAT chunk
+  unsigned char	buffer[65536];		// Compressed data buffer
+};
+
+
+//
+// Local functions...
+//
+
+static bool	png_fill(xform_png_t *png);
+static unsigned	png_get_uint(const unsigned char *data);
+static bool	png_read_chunk(xform_png_t *png, unsigned *length, char *type);
+
+
+//
+// 'xformPNGClose()' - Close a PNG image.
+//
+
+void
+xformPNGClose(xform_png_t *png)		// I - PNG image
+{
+  if (!png)
+    return;
+
+  if (png->stream_init)
+    inflateEnd(&png->stream);
+
+  fclose(png->fp);
+  free(png->cur);
+  free(png->prev);
+  free(png);
+}
+
+
+//
+// 'xformPNGGetColors()' - Get the number of output colors (1 or 3).
+//
+
+unsigned				// O - Number of colors
+xformPNGGetColors(xform_png_t *png)	// I - PNG image
+{
+  return (png ? png->colors : 0);
+}
+
+
+//
+// 'xformPNGGetHeight()' - Get the height of a PNG image.
+//
+
+unsigned				// O - Height in lines
+xformPNGGetHeight(xform_png_t *png)	// I - PNG image
+{
+  return (png ? png->height : 0);
+}
+
+
+//
+// 'xformPNGGetWidth()' - Get the width of a PNG image.
+//
+
+unsigned				// O - Width in columns
+xformPNGGetWidth(xform_png_t *png)	// I - PNG image
+{
+  return (png ? png->width : 0);
+}
+
+
+//
+// 'xformPNGOpen()' - Open a PNG image and read its header.
+//
+// `NULL` is returned if the file cannot be opened, is not a PNG image, or uses
+// features that are not supported by the streaming reader.
+//
+
+xform_png_t *				// O - PNG image or `NULL` on error
+xformPNGOpen(const char *filename)	// I - Filename
+{
+  xform_png_t	*png;			// PNG image
+  unsigned char	data[13];		// Chunk data
+  unsigned	i,			// Looping var
+		length;			// Chunk length
+  char		type[5];		// Chunk type
+  unsigned	num_palette = 0;	// Number of palette entries
+  static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+					// PNG file signature
+
+
+  if ((png = calloc(1, sizeof(xform_png_t))) == NULL)
+    return (NULL);
+
+  if ((png->fp = fopen(filename, "rb")) == NULL)
+  {
+    free(png);
+    return (NULL);
+  }
+
+  // Check the signature and IHDR chunk...
+  if (fread(data, 1, 8, png->fp) != 8 || memcmp(data, signature, 8))
+    goto error;
+
+  if (!png_read_chunk(png, &length, type) || strcmp(type, "IHDR") || length != 13 || fread(data, 1, 13, png->fp) != 13 || fseek(png->fp, 4, SEEK_CUR))
+    goto error;
+
+  png->width      = png_get_uint(data);
+  png->height     = png_get_uint(data + 4);
+  png->depth      = data[8];
+  png->color_type = data[9];
+
+  if (png->width == 0 || png->width > XFORM_PNG_MAX_SIZE || png->height == 0 || png->height > XFORM_PNG_MAX_SIZE || data[10] != 0 || data[11] != 0 || data[12] != 0)
+    goto error;				// Bad size, unknown compression/filter, or interlaced
+
+  switch (png->color_type)
+  {
+    case 0 : // Grayscale
+        png->channels = 1;
+        png->colors   = 1;
+        if (png->depth != 1 && png->depth != 2 && png->depth != 4 && png->depth != 8 && png->depth != 16)
+          goto error;
+        break;
+
+    case 2 : // RGB
+        png->channels = 3;
+        png->colors   = 3;
+        if (png->depth != 8 && png->depth != 16)
+          goto error;
+        break;
+
+    case 3 : // Indexed
+        png->channels = 1;
+        png->colors   = 1;
+        if (png->depth != 1 && png->depth != 2 && png->depth != 4 && png->depth != 8)
+          goto error;
+        break;
+
+    case 4 : // Grayscale + alpha
+        png->channels = 2;
+        png->colors   = 1;
+        if (png->depth != 8 && png->depth != 16)
+          goto error;
+        break;
+
+    case 6 : // RGB + alpha
+        png->channels = 4;
+        png->colors   = 3;
+        if (png->depth != 8 && png->depth != 16)
+          goto error;
+        break;
+
+    default :
+        goto error;
+  }
+
+  png->stride = ((size_t)png->width * png->channels * png->depth + 7) / 8;
+  png->fbpp   = (png->channels * png->depth + 7) / 8;
+
+  for (i = 0; i < 256; i ++)
+    png->palette[i][3] = 255;
+
+  // Read chunks up to the first IDAT chunk...
+  for (;;)
+  {
+    if (!png_read_chunk(png, &length, type))
+      goto error;
+
+    if (!strcmp(type, "IDAT"))
+    {
+      png->remaining = length;
+      break;
+    }
+    else if (!strcmp(type, "PLTE") && png->color_type == 3)
+    {
+      if (length > 768 || (length % 3) != 0)
+        goto error;
+
+      for (num_palette = 0; num_palette < (length / 3); num_palette ++)
+      {
+        if (fread(png->palette[num_palette], 1, 3, png->fp) != 3)
+          goto error;
+      }
+
+      if (fseek(png->fp, 4, SEEK_CUR))
+        goto error;
+    }
+    else if (!strcmp(type, "tRNS") && png->color_type == 3)
+    {
+      if (length > 256)
+        goto error;
+
+      for (i = 0; i < length; i ++)
+      {
+        int ch = getc(png->fp);		// Alpha value
+
+        if (ch == EOF)
+          goto error;
+
+        png->palette[i][3] = (unsigned char)ch;
+      }
+
+      if (fseek(png->fp, 4, SEEK_CUR))
+        goto error;
+    }
+    else if (!strcmp(type, "IEND"))
+    {
+      goto error;
+    }
+    else if (fseek(png->fp, (long)length + 4, SEEK_CUR))
+    {
+      goto error;
+    }
+  }
+
+  if (png->color_type == 3)
+  {
+    // Output color for palettes with colors...
+    if (num_palette == 0)
+      goto error;
+
+    for (i = 0; i < num_palette; i ++)
+    {
+      if (png->palette[i][0] != png->palette[i][1] || png->palette[i][0] != png->palette[i][2])
+      {
+        png->colors = 3;
+        break;
+      }
+    }
+
+    // Composite transparent palette entries over white...
+    for (i = 0; i < 256; i ++)
+    {
+      unsigned alpha = png->palette[i][3];
+					// Alpha value
+
+      png->palette[i][0] = (unsigned char)((png->palette[i][0] * alpha + 255 * (255 - alpha)) / 255);
+      png->palette[i][1] = (unsigned char)((png->palette[i][1] * alpha + 255 * (255 - alpha)) / 255);
+      png->palette[i][2] = (unsigned char)((png->palette[i][2] * alpha + 255 * (255 - alpha)) / 255);
+    }
+  }
+
+  // Allocate row buffers and start decompressing...
+  if ((png->cur = malloc(png->stride + 1)) == NULL || (png->prev = calloc(1, png->stride + 1)) == NULL)
+    goto error;
+
+  if (inflateInit(&png->stream) != Z_OK)
+    goto error;
+
+  png->stream_init = true;
+
+  return (png);
+
+  error:
+
+  xformPNGClose(png);
+
+  return (NULL);
+}
+
+
+//
+// 'xformPNGReadRow()' - Read the next row of a PNG image.
+//
+// The row buffer must hold "width * colors" bytes.
+//
+
+bool					// O - `true` on success, `false` on error
+xformPNGReadRow(xform_png_t   *png,	// I - PNG image
+                unsigned char *row)	// I - Row buffer
+{
+  int		status;			// Inflate status
+  size_t	i;			// Looping var
+  unsigned	x,			// Current column
+		bpp,			// Filter bytes per pixel
+		maxval,			// Maximum sample value
+		shift,			// Bit shift for sub-byte samples
+		alpha;			// Alpha value
+  unsigned char	*cur,			// Current row
+		*prev,			// Previous row
+		*temp;			// Temporary pointer
+  const unsigned char *palptr;		// Palette entry
+
+
+  if (!png || !row || png->y >= png->height)
+    return (false);
+
+  // Decompress the next row...
+  png->stream.next_out  = png->cur;
+  png->stream.avail_out = (uInt)(png->stride + 1);
+
+  while (png->stream.avail_out > 0)
+  {
+    if (png->stream.avail_in == 0 && !png_fill(png))
+      return (false);
+
+    if ((status = inflate(&png->stream, Z_NO_FLUSH)) == Z_STREAM_END)
+    {
+      if (png->stream.avail_out > 0)
+        return (false);
+    }
+    else if (status != Z_OK)
+    {
+      return (false);
+    }
+  }
+
+  // Undo the row filter...
+  cur  = png->cur + 1;
+  prev = png->prev + 1;
+  bpp  = png->fbpp;
+
+  switch (png->cur[0])
+  {
+    case 0 : // None
+        break;
+
+    case 1 : // Sub
+        for (i = bpp; i < png->stride; i ++)
+          cur[i] = (unsigned char)(cur[i] + cur[i - bpp]);
+        break;
+
+    case 2 : // Up
+        for (i = 0; i < png->stride; i ++)
+          cur[i] = (unsigned char)(cur[i] + prev[i]);
+        break;
+
+    case 3 : // Average
+        for (i = 0; i < png->stride; i ++)
+          cur[i] = (unsigned char)(cur[i] + ((i >= bpp ? cur[i - bpp] : 0) + prev[i]) / 2);
+        break;
+
+    case 4 : // Paeth
+        for (i = 0; i < png->stride; i ++)
+        {
+          int	a = i >= bpp ? cur[i - bpp] : 0,
+					// Left
+		b = prev[i],		// Above
+		c = i >= bpp ? prev[i - bpp] : 0,
+					// Upper left
+		p = a + b - c,		// Initial estimate
+		pa = abs(p - a),	// Distance to left
+		pb = abs(p - b),	// Distance to above
+		pc = abs(p - c);	// Distance to upper left
+
+          if (pa <= pb && pa <= pc)
+            cur[i] = (unsigned char)(cur[i] + a);
+          else if (pb <= pc)
+            cur[i] = (unsigned char)(cur[i] + b);
+          else
+            cur[i] = (unsigned char)(cur[i] + c);
+        }
+        break;
+
+    default :
+        return (false);
+  }
+
+  // Convert to 8-bit gray or RGB...
+  switch (png->color_type)
+  {
+    case 0 : // Grayscale
+        if (png->depth == 8)
+        {
+          memcpy(row, cur, png->width);
+        }
+        else if (png->depth == 16)
+        {
+          for (x = 0; x < png->width; x ++)
+            row[x] = cur[2 * x];
+        }
+        else
+        {
+          maxval = (1U << png->depth) - 1;
+
+          for (x = 0; x < png->width; x ++)
+          {
+            shift  = 8 - png->depth - (x * png->depth) % 8;
+            row[x] = (unsigned char)(((cur[x * png->depth / 8] >> shift) & maxval) * 255 / maxval);
+          }
+        }
+        break;
+
+    case 2 : // RGB
+        if (png->depth == 8)
+        {
+          memcpy(row, cur, 3 * (size_t)png->width);
+        }
+        else
+        {
+          for (x = 0; x < 3 * png->width; x ++)
+            row[x] = cur[2 * x];
+        }
+        break;
+
+    case 3 : // Indexed
+        maxval = (1U << png->depth) - 1;
+
+        for (x = 0; x < png->width; x ++)
+        {
+          shift  = 8 - png->depth - (x * png->depth) % 8;
+          palptr = png->palette[(cur[x * png->depth / 8] >> shift) & maxval];
+
+          if (png->colors == 1)
+          {
+            *row++ = palptr[0];
+          }
+          else
+          {
+            *row++ = palptr[0];
+            *row++ = palptr[1];
+            *row++ = palptr[2];
+          }
+        }
+        break;
+
+    case 4 : // Grayscale + alpha
+        for (x = 0, i = png->depth / 8; x < png->width; x ++, cur += 2 * i)
+        {
+          alpha  = cur[i];
+          row[x] = (unsigned char)((cur[0] * alpha + 255 * (255 - alpha)) / 255);
+        }
+        break;
+
+    case 6 : // RGB + alpha
+        for (x = 0, i = png->depth / 8; x < png->width; x ++, cur += 4 * i, row += 3)
+        {
+          alpha  = cur[3 * i];
+          row[0] = (unsigned char)((cur[0] * alpha + 255 * (255 - alpha)) / 255);
+          row[1] = (unsigned char)((cur[i] * alpha + 255 * (255 - alpha)) / 255);
+          row[2] = (unsigned char)((cur[2 * i] * alpha + 255 * (255 - alpha)) / 255);
+        }
+        break;
+  }
+
+  // Save the current row for the next filter...
+  temp      = png->prev;
+  png->prev = png->cur;
+  png->cur  = temp;
+
+  png->y ++;
+
+  return (true);
+}
+
+
+//
+// 'png_fill()' - Read more compressed data from the IDAT chunks.
+//
+
+static bool				// O - `true` on success, `false` on end of data
+png_fill(xform_png_t *png)		// I - PNG image
+{
+  unsigned	length;			// Chunk length
+  char		type[5];		// Chunk type
+  size_t	bytes;			// Bytes to read
+
+
+  while (png->remaining == 0)
+  {
+    // Skip the CRC and read the next chunk header...
+    if (fseek(png->fp, 4, SEEK_CUR) || !png_read_chunk(png, &length, type) || strcmp(type, "IDAT"))
+      return (false);
+
+    png->remaining = length;
+  }
+
+  if ((bytes = png->remaining) > sizeof(png->buffer))
+    bytes = sizeof(png->buffer);
+
+  if (fread(png->buffer, 1, bytes, png->fp) != bytes)
+    return (false);
+
+  png->remaining        -= bytes;
+  png->stream.next_in  = png->buffer;
+  png->stream.avail_in = (uInt)bytes;
+
+  return (true);
+}
+
+
+//
+// 'png_get_uint()' - Get a big-endian 32-bit unsigned integer.
+//
+
+static unsigned				// O - Value
+png_get_uint(const unsigned char *data)	// I - Data
+{
+  return (((unsigned)data[0] << 24) | ((unsigned)data[1] << 16) | ((unsigned)data[2] << 8) | data[3]);
+}
+
+
+//
+// 'png_read_chunk()' - Read a chunk header.
+//
+
+static bool				// O - `true` on success, `false` on error
+png_read_chunk(xform_png_t *png,	// I - PNG image
+               unsigned    *length,	// O - Chunk length
+               char        *type)	// O - Chunk type
+{
+  unsigned char	header[8];		// Chunk header
+
+
+  if (fread(header, 1, 8, png->fp) != 8)
+    return (false);
+
+  *length = png_get_uint(header);
+  memcpy(type, header + 4, 4);
+  type[4] = '\0';
+
+  return (*length < 0x80000000);
+}
@@ -0,0 +1,35 @@
+//
+// Streaming PNG image reader definitions for ipptransform.
+//
+// Copyright © 2026 by OpenPrinting.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+#ifndef XFORM_PNG_H
+#  define XFORM_PNG_H
+#  include <stdbool.h>
+#  include <stddef.h>
+
+
+//
+// Types...
+//
+
+typedef struct xform_png_s xform_png_t;	// PNG image reader
+
+
+//
+// Functions...
+//
+
+extern void		xformPNGClose(xform_png_t *png);
+extern unsigned		xformPNGGetColors(xform_png_t *png);
+extern unsigned		xformPNGGetHeight(xform_png_t *png);
+extern unsigned		xformPNGGetWidth(xform_png_t *png);
+extern xform_png_t	*xformPNGOpen(const char *filename);
+extern bool		xformPNGReadRow(xform_png_t *png, unsigned char *row);
+
+
+#endif // !XFORM_PNG_H
@@ -0,0 +1,426 @@
+//
+// Pixel dithering and packing benchmark for ipptransform.
+//
+// Copyright © 2026 by OpenPrinting.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage:
+//
+//   ./xformbench [OPTIONS]
+//
+// Options:
+//
+//   --help         Show program help.
+//   -l LINES       Number of lines per pass.
+//   -n PASSES      Number of passes to run for each kernel.
+//   -w WIDTH       Line width in pixels.
+//
+
+#include <config.h>
+#include <cups/cups.h>
+#include "xform-pack.h"
+#include "dither.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+
+//
+// Local functions...
+//
+
+static void	ref_dither_gray(const unsigned char *dither, unsigned char white, unsigned char *row, size_t num_pixels);
+static bool	ref_is_blank(const unsigned char *row, unsigned char white, size_t bytes);
+static void	ref_pack_black(unsigned char *row, size_t num_pixels);
+static void	ref_pack_rgba(unsigned char *row, size_t num_pixels);
+static void	run_bench(const char *name, int kernel, unsigned char *lines, size_t width, size_t num_lines, int passes);
+static bool	test_kernel(const char *name, int kernel, size_t max_width);
+static int	usage(FILE *out);
+
+
+//
+// 'main()' - Test and benchmark the pixel dithering and packing functions.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int		i;			// Looping var
+  const char	*opt;			// Current option
+  size_t	width = 5100,		// Line width in pixels (8.5in @ 600dpi)
+		num_lines = 64,		// Number of lines per pass
+		x, y;			// Looping vars
+  int		passes = 100;		// Number of passes
+  unsigned char	*lines,			// Line buffer
+		*lineptr;		// Pointer into line buffer
+  bool		ret = true;		// Return value
+
+
+  // Parse command-line...
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      return (usage(stdout));
+    }
+    else if (argv[i][0] == '-' && argv[i][1] != '-')
+    {
+      for (opt = argv[i] + 1; *opt; opt ++)
+      {
+        switch (*opt)
+        {
+          case 'l' : // -l LINES
+              i ++;
+              if (i >= argc || !isdigit(argv[i][0] & 255) || (num_lines = (size_t)strtoul(argv[i], NULL, 10)) < 1)
+              {
+                fputs("xformbench: Expected number of lines after '-l'.\n", stderr);
+                return (usage(stderr));
+              }
+              break;
+
+          case 'n' : // -n PASSES
+              i ++;
+              if (i >= argc || (passes = atoi(argv[i])) < 1)
+              {
+                fputs("xformbench: Expected number of passes after '-n'.\n", stderr);
+                return (usage(stderr));
+              }
+              break;
+
+          case 'w' : // -w WIDTH
+              i ++;
+              if (i >= argc || !isdigit(argv[i][0] & 255) || (width = (size_t)strtoul(argv[i], NULL, 10)) < 1)
+              {
+                fputs("xformbench: Expected line width after '-w'.\n", stderr);
+                return (usage(stderr));
+              }
+              break;
+
+          default :
+              fprintf(stderr, "xformbench: Unknown option '-%c'.\n", *opt);
+              return (usage(stderr));
+        }
+      }
+    }
+    else
+    {
+      fprintf(stderr, "xformbench: Unknown option '%s'.\n", argv[i]);
+      return (usage(stderr));
+    }
+  }
+
+  // Verify that the optimized functions match the reference functions...
+  ret &= test_kernel("dither_gray", 0, 300);
+  ret &= test_kernel("pack_black", 1, 300);
+  ret &= test_kernel("pack_rgba", 2, 300);
+  ret &= test_kernel("is_blank", 3, 300);
+
+  if (!ret)
+    return (1);
+
+  // Create a gradient with some noise for the benchmarks...
+  if ((lines = malloc(4 * width * num_lines)) == NULL)
+  {
+    perror("xformbench: Unable to allocate memory for lines");
+    return (1);
+  }
+
+  for (y = 0, lineptr = lines; y < num_lines; y ++)
+  {
+    for (x = 0; x < (4 * width); x ++)
+      *lineptr++ = (unsigned char)((x * 255 / (4 * width)) ^ (rand() & 15));
+  }
+
+  printf("%-12s %10s %10s %8s\n", "Kernel", "Ref MP/s", "Opt MP/s", "Speedup");
+
+  run_bench("dither_gray", 0, lines, width, num_lines, passes);
+  run_bench("pack_black", 1, lines, width, num_lines, passes);
+  run_bench("pack_rgba", 2, lines, width, num_lines, passes);
+
+  // Blank detection only scans the whole line when it is white...
+  memset(lines, 255, 4 * width * num_lines);
+
+  run_bench("is_blank", 3, lines, width, num_lines, passes);
+
+  free(lines);
+
+  return (0);
+}
+
+
+//
+// 'ref_dither_gray()' - Reference implementation of grayscale dithering.
+//
+
+static void
+ref_dither_gray(
+    const unsigned char *dither,	// I - Threshold row (64 values)
+    unsigned char       white,		// I - White byte value
+    unsigned char       *row,		// I - Row pointer
+    size_t              num_pixels)	// I - Number of pixels
+{
+  size_t	x;			// Column number
+  unsigned char	bit,			// Current bit
+		byte,			// Current byte
+		*rowptr = row;		// Pointer into output bytes
+  const unsigned char *pixel = row;	// Pointer into input pixels
+
+
+  for (x = 0, bit = 128, byte = white; x < num_pixels; x ++, pixel ++)
+  {
+    if (*pixel <= dither[x & 63])
+      byte ^= bit;
+
+    if (bit == 1)
+    {
+      *rowptr++ = byte;
+      byte      = white;
+      bit       = 128;
+    }
+    else
+      bit >>= 1;
+  }
+
+  if (bit != 128)
+    *rowptr = byte;
+}
+
+
+//
+// 'ref_is_blank()' - Reference implementation of blank line detection.
+//
+
+static bool				// O - `true` if blank, `false` otherwise
+ref_is_blank(const unsigned char *row,	// I - Line to check
+             unsigned char       white,	// I - White byte value
+             size_t              bytes)	// I - Number of bytes in line
+{
+  while (bytes > 0)
+  {
+    if (*row != white)
+      return (false);
+
+    row ++;
+    bytes --;
+  }
+
+  return (true);
+}
+
+
+//
+// 'ref_pack_black()' - Reference implementation of black pixel packing.
+//
+
+static void
+ref_pack_black(unsigned char *row,	// I - Row of pixels to pack
+               size_t        num_pixels)// I - Number of pixels in row
+{
+  while (num_pixels > 0)
+  {
+    *row = 255 - *row;
+    row ++;
+    num_pixels --;
+  }
+}
+
+
+//
+// 'ref_pack_rgba()' - Reference implementation of RGBX to RGB packing.
+//
+
+static void
+ref_pack_rgba(unsigned char *row,	// I - Row of pixels to pack
+	      size_t        num_pixels)	// I - Number of pixels in row
+{
+  unsigned char	*src_byte = row,	// Source bytes
+		*dest_byte = row;	// Destination bytes
+
+
+  while (num_pixels > 0)
+  {
+    *dest_byte++ = *src_byte++;
+    *dest_byte++ = *src_byte++;
+    *dest_byte++ = *src_byte++;
+    src_byte ++;
+    num_pixels --;
+  }
+}
+
+
+//
+// 'run_bench()' - Benchmark the reference and optimized versions of a kernel.
+//
+
+static void
+run_bench(const char    *name,		// I - Kernel name
+          int           kernel,		// I - Kernel number
+          unsigned char *lines,		// I - Source lines
+          size_t        width,		// I - Line width in pixels
+          size_t        num_lines,	// I - Number of lines
+          int           passes)		// I - Number of passes
+{
+  int		pass,			// Current pass
+		opt;			// Optimized version?
+  size_t	y,			// Current line
+		linesize = 4 * width;	// Bytes per line
+  unsigned char	*row;			// Working row
+  double	start,			// Start time
+		secs[2];		// Elapsed time for each version
+
+
+  if ((row = malloc(linesize)) == NULL)
+    return;
+
+  for (opt = 0; opt < 2; opt ++)
+  {
+    start = cupsGetClock();
+
+    for (pass = 0; pass < passes; pass ++)
+    {
+      for (y = 0; y < num_lines; y ++)
+      {
+        memcpy(row, lines + y * linesize, linesize);
+
+        switch (kernel)
+        {
+          case 0 :
+              if (opt)
+                xformDitherGray(threshold[y & 63], 0, row, width);
+              else
+                ref_dither_gray(threshold[y & 63], 0, row, width);
+              break;
+          case 1 :
+              if (opt)
+                xformPackBlack(row, width);
+              else
+                ref_pack_black(row, width);
+              break;
+          case 2 :
+              if (opt)
+                xformPackRGBA(row, width);
+              else
+                ref_pack_rgba(row, width);
+              break;
+          case 3 :
+              if (opt)
+                row[0] ^= (unsigned char)xformIsBlank(row, 255, linesize);
+              else
+                row[0] ^= (unsigned char)ref_is_blank(row, 255, linesize);
+              break;
+        }
+      }
+    }
+
+    if ((secs[opt] = cupsGetClock() - start) <= 0.0)
+      secs[opt] = 0.000001;
+  }
+
+  free(row);
+
+  printf("%-12s %10.1f %10.1f %7.2fx\n", name, (double)passes * num_lines * width / secs[0] / 1000000.0, (double)passes * num_lines * width / secs[1] / 1000000.0, secs[0] / secs[1]);
+}
+
+
+//
+// 'test_kernel()' - Compare the optimized and reference kernels.
+//
+
+static bool				// O - `true` on success, `false` on mismatch
+test_kernel(const char *name,		// I - Kernel name
+            int        kernel,		// I - Kernel number
+            size_t     max_width)	// I - Maximum line width to test
+{
+  size_t	width,			// Current width
+		x, y,			// Looping vars
+		outsize;		// Number of output bytes to compare
+  unsigned char	*ref,			// Reference output
+		*opt,			// Optimized output
+		white;			// White byte value
+
+
+  if ((ref = malloc(4 * max_width)) == NULL || (opt = malloc(4 * max_width)) == NULL)
+  {
+    free(ref);
+    return (false);
+  }
+
+  for (width = 1; width <= max_width; width ++)
+  {
+    for (y = 0; y < 64; y ++)
+    {
+      for (x = 0; x < (4 * max_width); x ++)
+        ref[x] = (unsigned char)rand();
+
+      memcpy(opt, ref, 4 * max_width);
+
+      switch (kernel)
+      {
+        case 0 :
+            ref_dither_gray(threshold[y], (unsigned char)(y & 1 ? 255 : 0), ref, width);
+            xformDitherGray(threshold[y], (unsigned char)(y & 1 ? 255 : 0), opt, width);
+            outsize = (width + 7) / 8;
+            break;
+        case 1 :
+            ref_pack_black(ref, width);
+            xformPackBlack(opt, width);
+            outsize = width;
+            break;
+        case 2 :
+            ref_pack_rgba(ref, width);
+            xformPackRGBA(opt, width);
+            outsize = 3 * width;
+            break;
+        default :
+            // Make the line blank except for (maybe) one random byte...
+            white = (unsigned char)(y & 1 ? 255 : 0);
+            memset(ref, white, 4 * width);
+            if (y & 2)
+              ref[rand() % (4 * width)] ^= (unsigned char)(1 << (rand() & 7));
+
+            memcpy(opt, ref, 4 * width);
+            ref[0] = (unsigned char)ref_is_blank(ref, white, 4 * width);
+            opt[0] = (unsigned char)xformIsBlank(opt, white, 4 * width);
+            outsize = 1;
+            break;
+      }
+
+      if (memcmp(ref, opt, outsize))
+      {
+        printf("%s: FAIL (width=%u, line=%u)\n", name, (unsigned)width, (unsigned)y);
+        free(ref);
+        free(opt);
+        return (false);
+      }
+    }
+  }
+
+  free(ref);
+  free(opt);
+
+  printf("%s: PASS\n", name);
+
+  return (true);
+}
+
+
+//
+// 'usage()' - Show program usage.
+//
+
+static int				// O - Exit status
+usage(FILE *out)			// I - Output file
+{
+  fputs("Usage: xformbench [OPTIONS]\n", out);
+  fputs("Options:\n", out);
+  fputs("  --help         Show program help.\n", out);
+  fputs("  -l LINES       Number of lines per pass (default 64).\n", out);
+  fputs("  -n PASSES      Number of passes to run for each kernel (default 100).\n", out);
+  fputs("  -w WIDTH       Line width in pixels (default 5100).\n", out);
+
+  return (out == stdout ? 0 : 1);
+}
@@ -153,6 +153,13 @@ typedef unsigned long useconds_t;
 #endif // !HAVE_STRTOLL
 
 
+//
+// Do we have the pipe2() function?
+//
+
+// #undef HAVE_PIPE2
+
+
 //
 // Do we have the geteuid() function?
 //
@@ -73,6 +73,13 @@
 #endif // !HAVE_STRTOLL
 
 
+//
+// Do we have the pipe2() function?
+//
+
+// #undef HAVE_PIPE2
+
+
 //
 // Do we have the geteuid() function?
 //